@@ -11,25 +11,60 @@
 #include "BLcanonical.h"
 #endif
 
+#include <algorithm>
+
+
+// orders set numbers by the size of the sets, given by their offsets
+struct SmallerSet {
+  const vector<unsigned int> &m_offsets;
+  SmallerSet(const vector<unsigned int> &offsets): m_offsets(offsets) {}
+  bool operator()(unsigned int a, unsigned int b) const {
+    return m_offsets[a+1] - m_offsets[a] < m_offsets[b+1] - m_offsets[b];
+  }
+};
 
 void BLAccessPolicy::init(){
-  m_minimal_sets = parseFromExpression(0,m_description);
+  parseFromExpression(m_description, m_setMembers, m_setOffsets);
+  m_setsBySize.clear();
+  for (unsigned int i = 0; i < getNumMinimalSets(); i++) {
+    m_setsBySize.push_back(i);
+  }
+  std::stable_sort(m_setsBySize.begin(), m_setsBySize.end(), SmallerSet(m_setOffsets));
+  computeHash();
+}
+
+// the policy kind comes first, with the value of blPolicy in the policy cache, so that no ShTree policy has the same hash. The offsets separate the sets
+void BLAccessPolicy::computeHash() {
+  StructuralHash h = hashParticipants(hashCombine(HASH_SEED, 1));
+  for (unsigned int i = 0; i < m_setOffsets.size(); i++) {
+    h = hashCombine(h, m_setOffsets[i]);
+  }
+  for (unsigned int i = 0; i < m_setMembers.size(); i++) {
+    h = hashCombine(h, m_setMembers[i]);
+  }
+  m_hash = h;
 }
 
 BLAccessPolicy::BLAccessPolicy():
-  m_description("")
-{}
+  m_description(""),
+  m_setChoice(firstSatisfiedSet)
+{
+  m_setOffsets.push_back(0);
+  computeHash();
+}
 
 BLAccessPolicy::BLAccessPolicy(const string &description, const int n):
   AccessPolicy(n),
-  m_description(description)
+  m_description(description),
+  m_setChoice(firstSatisfiedSet)
 {
   init();
 }
 
 BLAccessPolicy::BLAccessPolicy(const string &description, const vector<int> &parts):
   AccessPolicy(parts),
-  m_description(description)
+  m_description(description),
+  m_setChoice(firstSatisfiedSet)
 {
   init();
 }
@@ -37,209 +72,257 @@ BLAccessPolicy::BLAccessPolicy(const string &description, const vector<int> &par
 BLAccessPolicy::BLAccessPolicy(const BLAccessPolicy& other):
   AccessPolicy(other.m_participants),
   m_description(other.m_description),
-  m_minimal_sets(other.m_minimal_sets)
+  m_setMembers(other.m_setMembers),
+  m_setOffsets(other.m_setOffsets),
+  m_setsBySize(other.m_setsBySize),
+  m_setChoice(other.m_setChoice),
+  m_hash(other.m_hash)
 {}
 
 BLAccessPolicy& BLAccessPolicy::operator=(const BLAccessPolicy& other)
 {
   m_description = other.m_description;
   m_participants = other.m_participants;
-  m_minimal_sets = other.m_minimal_sets;
+  m_setMembers = other.m_setMembers;
+  m_setOffsets = other.m_setOffsets;
+  m_setsBySize = other.m_setsBySize;
+  m_setChoice = other.m_setChoice;
+  m_hash = other.m_hash;
   return *this;
 }
 
+bool BLAccessPolicy::operator==(const BLAccessPolicy& rhs) const
+{
+  return (m_hash == rhs.m_hash) && (m_participants == rhs.m_participants) && (m_setOffsets == rhs.m_setOffsets) && (m_setMembers == rhs.m_setMembers);
+}
+
+StructuralHash BLAccessPolicy::getStructuralHash() const
+{
+  return m_hash;
+}
+
 std::string BLAccessPolicy::getDescription() const
 {
   return m_description;
 }
 
-vector<vector<int> >& BLAccessPolicy::getMinimalSets() {
-  return m_minimal_sets;
+vector<vector<int> > BLAccessPolicy::getMinimalSets() const {
+  vector<vector<int> > minimalSets;
+  for (unsigned int i = 0; i < getNumMinimalSets(); i++) {
+    minimalSets.push_back(vector<int>(m_setMembers.begin() + m_setOffsets[i], m_setMembers.begin() + m_setOffsets[i+1]));
+  }
+  return minimalSets;
 }
 
-vector<Big> BLAccessPolicy::findCoefficients(const vector<std::string> shareIDs, const Big& order) const {
-  vector<Big> coeffs;
-  for (unsigned int i = 0; i < shareIDs.size(); i++) {
-    std::string id = shareIDs[i];
-    int n = contains<std::string>(shareIDs, id);
-    if (n >= 0) {
-      coeffs.push_back(1); 
-    } else {
-      coeffs.push_back(0); 
-    }
+void BLAccessPolicy::writeBinary(BinaryWriter &out) const {
+  out.putString(m_description);
+  out.putInts(m_participants);
+  out.putInts(m_setMembers);
+  out.putUInts(m_setOffsets);
+  out.putUInts(m_setsBySize);
+  out.putByte(m_setChoice);
+}
+
+shared_ptr<BLAccessPolicy> BLAccessPolicy::readBinary(BinaryReader &in) {
+  shared_ptr<BLAccessPolicy> policy = make_shared<BLAccessPolicy>();
+  policy->m_description = in.getString();
+  in.getInts(policy->m_participants);
+  in.getInts(policy->m_setMembers);
+  in.getUInts(policy->m_setOffsets);
+  in.getUInts(policy->m_setsBySize);
+  unsigned char choice = in.getByte();
+  if ((choice != firstSatisfiedSet) && (choice != smallestSatisfiedSet)) in.fail("unknown choice of minimal set");
+  policy->m_setChoice = (MinimalSetChoice) choice;
+
+  const vector<unsigned int> &offsets = policy->m_setOffsets;
+  if (offsets.empty() || (offsets[0] != 0) || (offsets.back() != policy->m_setMembers.size())) in.fail("set offsets do not match the members");
+  for (unsigned int i = 0; i + 1 < offsets.size(); i++) {
+    if (offsets[i] > offsets[i+1]) in.fail("set offsets are not increasing");
   }
-  return coeffs;
+  if (policy->m_setsBySize.size() != policy->getNumMinimalSets()) in.fail("order of the sets does not match the sets");
+  for (unsigned int i = 0; i < policy->m_setsBySize.size(); i++) {
+    if (policy->m_setsBySize[i] >= policy->getNumMinimalSets()) in.fail("set number out of range");
+  }
+  policy->computeHash();
+  return policy;
 }
 
-unsigned int BLAccessPolicy::getNumShares()  {
-  unsigned int nshares = 0;
-  for (unsigned int i = 0; i < m_minimal_sets.size(); i++)
-    {
-      nshares += m_minimal_sets[i].size();
-    }
-  return nshares;
+unsigned int BLAccessPolicy::getNumMinimalSets() const {
+  return m_setOffsets.size() - 1;
 }
 
+const vector<int>& BLAccessPolicy::getSetMembers() const {
+  return m_setMembers;
+}
 
-bool BLAccessPolicy::satisfyMinimalSet(int setID, vector<int> set, vector<std::string> shareIDs, vector<int> &satisfyingSharesIndices) const{
-  //  DEBUG("SatisfyMinimalSet");
-  //  DEBUG("shareIDs size " << shareIDs.size());
+const vector<unsigned int>& BLAccessPolicy::getSetOffsets() const {
+  return m_setOffsets;
+}
 
-  //  debugVector(shareIDs, "ShareID");
+void BLAccessPolicy::setMinimalSetChoice(MinimalSetChoice choice) {
+  m_setChoice = choice;
+}
 
-  bool missedElement = false;
-  for (unsigned int i = 0; (!missedElement) && (i < set.size()); i++) {
-    int setElem = set[i];
-    std::string elemID = convertIntToStr(setID) + ":" + convertIntToStr(setElem);
-    bool elemFound = false;
+BLAccessPolicy::MinimalSetChoice BLAccessPolicy::getMinimalSetChoice() const {
+  return m_setChoice;
+}
 
-    for (unsigned int j = 0; (!elemFound)  && (j < shareIDs.size()); j++) {
-      std::string shareID = shareIDs[j];
-      if (elemID == shareID) {
-	elemFound = true;
-	satisfyingSharesIndices.push_back(j);
-	// Found element at position i
-      }
-    }
-    if (!elemFound) {
-      missedElement = true;
-    }
+// in BL, the secret is the sum of the shares of a minimal set, so every coefficient is 1
+void BLAccessPolicy::findCoefficients(const vector<ShareID>& shareIDs, const Big&, vector<Big>& coeffs) const {
+  coeffs.assign(shareIDs.size(), Big(1));
+}
+
+unsigned int BLAccessPolicy::getNumShares()  {
+  return m_setOffsets.back();
+}
+
+// returns true if all the bits from begin to end-1 are set. Each word is tested with one mask
+static bool rangeIsSet(const vector<unsigned long long> &words, unsigned int begin, unsigned int end) {
+  while (begin < end) {
+    unsigned int w = begin >> 6;
+    unsigned int low = begin & 63;
+    unsigned int high = std::min(end - (w << 6), 64U); // the range covers the bits [low, high) of this word
+    unsigned long long mask = (high == 64) ? ~0ULL : ((1ULL << high) - 1);
+    mask &= ~0ULL << low;
+    if ((words[w] & mask) != mask) return false;
+    begin = (w + 1) << 6;
   }
-  if (missedElement) {
-    // I have missed some element of the set. Returning false.
-    satisfyingSharesIndices.clear();
+  return true;
+}
+
+// received has a bit set for each share of the policy that was received, and sharePositions holds the position of that share in the list of
+// received shares. Since the shares of a set have consecutive indices, the set is satisfied if all the bits of its range are set
+bool BLAccessPolicy::satisfyMinimalSet(unsigned int setNo, const vector<unsigned long long> &received, const vector<int> &sharePositions, vector<int> &satisfyingSharesIndices) const{
+  if (!rangeIsSet(received, m_setOffsets[setNo], m_setOffsets[setNo+1])) {
     return false;
   }
-  // I have not missed any element. Returning true."
+  for (unsigned int index = m_setOffsets[setNo]; index < m_setOffsets[setNo+1]; index++) {
+    satisfyingSharesIndices.push_back(sharePositions[index]);
+  }
   return true;
 }
 
-std::string BLAccessPolicy::createShareID(std::string setID, std::string partID){
-  std::string id = setID + ":" + partID;
-  return id;
+ShareID BLAccessPolicy::createShareID(unsigned int setNo, unsigned int position) const {
+  return ShareID(m_setOffsets[setNo] + position, position);
 }
 
 
-bool BLAccessPolicy::evaluateIDs(const vector<std::string> shareIDs, vector<int> &witnessSharesIndices) const{
+bool BLAccessPolicy::evaluateIDs(const vector<ShareID>& shareIDs, vector<int> &witnessSharesIndices) const{
   witnessSharesIndices.clear();
 
-  vector<int> satisfyingSharesIndices;
-  for (unsigned int i = 0; i < m_minimal_sets.size(); i++)
-  {
-	  vector<int> minimalSet = m_minimal_sets[i]; 
-	  if (satisfyMinimalSet(i+1, minimalSet, shareIDs, satisfyingSharesIndices)){
-	    addVector(witnessSharesIndices, satisfyingSharesIndices);
-	    return true;
-	  }
-	  satisfyingSharesIndices.clear();
+  // an identifier that the policy did not issue can not satisfy any set, and is ignored. If a share was received twice, the first one is used
+  unsigned int nShares = m_setOffsets.back();
+  vector<int> sharePositions(nShares, -1);
+  vector<unsigned long long> received((nShares + 63) / 64, 0);
+  for (unsigned int i = 0; i < shareIDs.size(); i++) {
+    unsigned int index = shareIDs[i].getIndex();
+    if ((index < nShares) && (sharePositions[index] < 0)) {
+      sharePositions[index] = i;
+      received[index >> 6] |= 1ULL << (index & 63);
+    }
+  }
+
+  for (unsigned int i = 0; i < getNumMinimalSets(); i++) {
+    unsigned int setNo = (m_setChoice == smallestSatisfiedSet) ? m_setsBySize[i] : i;
+    if (satisfyMinimalSet(setNo, received, sharePositions, witnessSharesIndices)) {
+      return true;
+    }
   }
   return false;
 }
 
-void BLAccessPolicy::obtainCoveredFrags(const vector<int> &atts, vector<int> &attFragIndices, vector<int> &keyFragIndices, vector<std::string> &coveredShareIDs) const {
-  int count = 0;
-  for (unsigned int i = 0; i < m_minimal_sets.size(); i++) {
-    vector<int> minimalSet = m_minimal_sets[i]; 
-    for (unsigned int j = 0; j < minimalSet.size(); j++) {
-      int att_index = minimalSet[j];
-      int n = contains(atts, att_index);
+void BLAccessPolicy::obtainCoveredFrags(const CoveredSet &covered, vector<int> &attFragIndices, vector<int> &keyFragIndices, vector<ShareID> &coveredShareIDs) const {
+  for (unsigned int i = 0; i < getNumMinimalSets(); i++) {
+    for (unsigned int index = m_setOffsets[i]; index < m_setOffsets[i+1]; index++) {
+      int n = covered.position(m_setMembers[index]);
       if (n >= 0) {
-	std::string shareID = convertIntToStr(i+1) + ":" + convertIntToStr(att_index);
-    	keyFragIndices.push_back(count);
+    	keyFragIndices.push_back(index);
 	attFragIndices.push_back(n);
-	coveredShareIDs.push_back(shareID);
+	coveredShareIDs.push_back(ShareID(index, index - m_setOffsets[i]));
       }
-      count++;
     }
   }
 }
 
-std::vector<std::vector<int> > BLAccessPolicy::parseFromExpression(int level, std::string expr) {
+std::string BLAccessPolicy::renderShareID(const ShareID& id) const {
+  if (id.getIndex() >= m_setOffsets.back()) {
+    return AccessPolicy::renderShareID(id);
+  }
+  unsigned int setNo = std::upper_bound(m_setOffsets.begin(), m_setOffsets.end(), id.getIndex()) - m_setOffsets.begin() - 1;
+  int att = m_setMembers[id.getIndex()];
+  return convertIntToStr(setNo + 1) + ":" + convertIntToStr(att);
+}
+
 // level 0 denotes the top-level of the expression. An OR is expected here
 // level 1 denotes the arguments of the OR. These could be either leaves or AND expressions
+// level 2 denotes the arguments of an AND, which can only be leaves
+std::vector<std::vector<int> > BLAccessPolicy::parseFromExpression(int level, const std::string& expr) {
+  vector<int> setMembers;
+  vector<unsigned int> setOffsets(1, 0);
+  PolicyParser parser(expr);
+  if (!parser.atEnd()) {
+    switch (level) {
+    case 0:
+      parseDNF(parser, setMembers, setOffsets);
+      break;
+    case 1:
+      parseMinimalSet(parser, setMembers);
+      setOffsets.push_back(setMembers.size());
+      break;
+    default:
+      setMembers.push_back(parser.parseInteger());
+      setOffsets.push_back(setMembers.size());
+      break;
+    }
+    parser.expectEnd();
+  }
 
   vector<vector<int> > minimalSets;
-  if (expr == "") {
-    return minimalSets;
+  for (unsigned int i = 0; i + 1 < setOffsets.size(); i++) {
+    minimalSets.push_back(vector<int>(setMembers.begin() + setOffsets[i], setMembers.begin() + setOffsets[i+1]));
   }
+  return minimalSets;
+}
 
-  try {
-    int leafValue = convertStrToInt(expr);
-    // If possible, create a leaf node with that value
-    // This can happen at any level
-    vector<int> minimalSet;
-    minimalSet.push_back(leafValue);
-    minimalSets.push_back(minimalSet);
-    return minimalSets;
-  } catch (std::exception &e) {
-	  // If not, it must be some operator, depending on the level we are
-
-    // look for string until "("
-    size_t start_index = expr.find("(");
-    if (start_index == std::string::npos) {
-      stringstream ss(ERR_BAD_POLICY);
-      ss << ": Could not parse policy: it does not have an operator " << std::endl;
-      throw std::runtime_error(ss.str());
-    }
-    std::string op = expr.substr(0,start_index);
-
-    // check it is the right operator
-    bool right_or = ((level == 0) && (op == op_OR));
-    bool right_and = ((level == 1) && (op == op_AND));
-    if (! (right_or || right_and)) {
-      stringstream ss(ERR_BAD_POLICY);
-      ss << ": Could not parse BLAccessPolicy: wrong operator for this level: " << op << " level: " << level << std::endl;
-      throw std::runtime_error(ss.str());
-    }
-    // find the whole sub-expression of operator arguments
-    size_t end_index = expr.rfind(")");
-    if (end_index == std::string::npos) {
-      stringstream ss(ERR_BAD_POLICY);
-      ss << ": Could not parse policy: it does not have a closing [ ) ]" << std::endl;
-      throw std::runtime_error(ss.str());
-    }
-    if (end_index != expr.length()-1) {
-      stringstream ss;
-      ss << ": Could not parse policy: there is content beyond last [ ) ]" << std::endl;
-      throw std::runtime_error(ss.str());
-    }
-    //start: 4
-    //end: 10
-    //string: 5 to 9
-    //number chars: 9 - 5 + 1 = 5 = end-1-(start+1)+1 = end-1-start-1+1 = end - start - 1
-    std::string sub_expr = expr.substr(start_index+1, end_index - start_index - 1);
-    // parse sub-expression into tokens, separated by ","
-    vector<std::string> tokens;
-    exprTokenize(sub_expr, tokens, ",","(",")");
-
-	// if we are at level 0, each token must construct an AND
-	// and so we expect to receive a full minimal set.
-	// Because of the signature, this is wrapped
-	// inside an external vector, but it is its single element.
-    if (level == 0) {
-		for (unsigned int i = 0; i < tokens.size(); i++) {
-			vector<vector<int> > minimalSet = parseFromExpression(level+1, tokens[i]);
-			minimalSets.push_back(minimalSet[0]);
-		}
-		return minimalSets;
-    }
-    // if we are at level 1, we are constructing a minimal set for an AND expression
-    // each token is a single leaf and will be returned as a single element set
-    // inside a vector
-    if (level == 1) {
-      vector<int> minimalSet;
-      for (unsigned int i = 0; i < tokens.size(); i++) {
-	vector<vector<int> > literal = parseFromExpression(level+1, tokens[i]);
-	minimalSet.push_back(literal[0][0]);
-      }
-      minimalSets.push_back(minimalSet);
-      return minimalSets;
-    }
-    minimalSets.clear();
-    return minimalSets;
+void BLAccessPolicy::parseFromExpression(const std::string& expr, vector<int> &setMembers, vector<unsigned int> &setOffsets) {
+  setMembers.clear();
+  setOffsets.assign(1, 0);
+  PolicyParser parser(expr);
+  if (parser.atEnd()) return;
+  parseDNF(parser, setMembers, setOffsets);
+  parser.expectEnd();
+}
+
+void BLAccessPolicy::parseDNF(PolicyParser& parser, vector<int> &setMembers, vector<unsigned int> &setOffsets) {
+  if (parser.peekInteger()) {
+    setMembers.push_back(parser.parseInteger());
+    setOffsets.push_back(setMembers.size());
+    return;
   }
-  minimalSets.clear();
-  return minimalSets;
+  if (!parser.acceptOperator(op_OR)) {
+    parser.fail("wrong operator for this level: " + parser.nextWord() + " level: 0");
+  }
+  parser.expect('(');
+  do {
+    parseMinimalSet(parser, setMembers);
+    setOffsets.push_back(setMembers.size());
+  } while (parser.accept(','));
+  parser.expect(')');
+}
+
+void BLAccessPolicy::parseMinimalSet(PolicyParser& parser, vector<int> &setMembers) {
+  if (parser.peekInteger()) {
+    setMembers.push_back(parser.parseInteger());
+    return;
+  }
+  if (!parser.acceptOperator(op_AND)) {
+    parser.fail("wrong operator for this level: " + parser.nextWord() + " level: 1");
+  }
+  parser.expect('(');
+  do {
+    setMembers.push_back(parser.parseInteger());
+  } while (parser.accept(','));
+  parser.expect(')');
 }
 
 
@@ -256,7 +339,6 @@ void BLSS::initPolicy(){
     
 void BLSS::init(){
   initPolicy();
-  manageRandomness(RandomnessActions::init);
 }
   
 BLSS::BLSS(shared_ptr<BLAccessPolicy>  policy, PFC &pfc):
@@ -273,56 +355,48 @@ BLSS::BLSS(shared_ptr<BLAccessPolicy>  policy, const Big &order, PFC &pfc):
  
 
 
-void BLSS::manageRandomness(RandomnessActions action) {  
-  int count = 0;
-  vector< vector<int> > &minimalSets = i_policy->getMinimalSets();
-  for (unsigned int i = 0; i < minimalSets.size(); i++) {
-    vector<int> set = minimalSets[i];
-    for (unsigned int j = 0; j < set.size()-1; j++) {
-      if (action == RandomnessActions::init) {
-	m_randomness.push_back(0);
-      } else if (action == RandomnessActions::randomize){
-	m_pfc.random(m_randomness[count]);
-	count++;
-      }
-    }
-  }
-}
-
 // virtual inherited methods:
-vector<Big> BLSS::getDistribRandomness() {  
-  return m_randomness;
-}
-
 
-
-std::vector<ShareTuple> BLSS::distribute_random(const Big& s){
-  manageRandomness(RandomnessActions::randomize);
-  return distribute_determ(s, m_randomness);
+// every element of a set but the last receives a random share
+unsigned int BLSS::getNumRandomness() {
+  unsigned int count = 0;
+  const vector<unsigned int> &offsets = i_policy->getSetOffsets();
+  for (unsigned int i = 0; i < i_policy->getNumMinimalSets(); i++) {
+    if (offsets[i+1] > offsets[i]) {
+      count += offsets[i+1] - offsets[i] - 1;
+    }
+  }
+  return count;
 }
 
-std::vector<ShareTuple> BLSS::distribute_determ(const Big& s, const vector<Big>& randomness){
+std::vector<ShareTuple> BLSS::distribute_determ(const Big& s, const RandomnessSource& randomness){
   int count = 0;
   vector<ShareTuple> shares;
-
-  vector< vector<int> > minimalSets = i_policy->getMinimalSets();
-  for (unsigned int i = 0; i < minimalSets.size(); i++) {
-    vector<int> set = minimalSets[i];
-    Big currentSum = 0;
-    for (unsigned int j = 0; j < set.size(); j++) {      
-      int partIndex = set[j];
-      std::string shareID = BLAccessPolicy::createShareID(convertIntToStr(i+1), convertIntToStr(partIndex));
-      Big value;
-      if (j < set.size()-1) {
-    	  value = randomness[count];
+  shares.reserve(i_policy->getNumShares());
+
+  BigScope scope;
+  Big& currentSum = scope.get();
+  Big& value = scope.get();
+
+  const vector<int> &members = i_policy->getSetMembers();
+  const vector<unsigned int> &offsets = i_policy->getSetOffsets();
+  for (unsigned int i = 0; i < i_policy->getNumMinimalSets(); i++) {
+    currentSum = 0;
+    for (unsigned int index = offsets[i]; index < offsets[i+1]; index++) {
+      int partIndex = members[index];
+      ShareID shareID(index, index - offsets[i]);
+      if (index < offsets[i+1]-1) {
+    	  randomness.get(count, 1, &value);
     	  count++;
-    	  currentSum += value % m_order;
+    	  currentSum += value;
+    	  currentSum %= m_order;
       } else {
-	value = (s - currentSum + m_order) % m_order;
+	value = s;
+	value += m_order;
+	value -= currentSum;
+	value %= m_order;
       }
-      ShareTuple share(partIndex, value, shareID);
-      shares.push_back(share);
-
+      shares.push_back(ShareTuple(partIndex, value, shareID));
     }    
   }
   return shares;
@@ -20,47 +20,75 @@
 
 
 class BLAccessPolicy : public AccessPolicy{
+ public:
+  // when several minimal sets are satisfied, evaluation returns either the first one in the policy or the one with fewer shares, which is the cheapest to decrypt
+  enum MinimalSetChoice {firstSatisfiedSet, smallestSatisfiedSet};
+
+ private:
   std::string m_description; // to facilitate parsing, the description should be input in prefix, that is functional, notation.
-  vector<vector<int>> m_minimal_sets;
+  // the minimal sets are kept one after the other in m_setMembers: minimal set i is m_setMembers[m_setOffsets[i]] to m_setMembers[m_setOffsets[i+1]-1].
+  // Each element of a set receives one share, in this order, so the same offsets give the indices of the shares of each set
+  vector<int> m_setMembers;
+  vector<unsigned int> m_setOffsets;
+  vector<unsigned int> m_setsBySize; // the minimal sets, from the smallest to the largest. Sets of the same size keep their order
+  MinimalSetChoice m_setChoice;
+  StructuralHash m_hash;
   void init();
+  void computeHash();
+  static void parseDNF(PolicyParser& parser, vector<int> &setMembers, vector<unsigned int> &setOffsets); // level 0: a literal or an OR of minimal sets
+  static void parseMinimalSet(PolicyParser& parser, vector<int> &setMembers); // level 1: a literal or an AND of literals
 
  protected:
-  bool satisfyMinimalSet(int setID, vector<int> set, vector<std::string> shareIDs, vector<int> &satisfyingSharesIndices) const;
+  bool satisfyMinimalSet(unsigned int setNo, const vector<unsigned long long> &received, const vector<int> &sharePositions, vector<int> &satisfyingSharesIndices) const;
  public:
-  static std::vector<std::vector<int>> parseFromExpression(int level, std::string expr);
-  vector<vector<int> >& getMinimalSets();
+  static std::vector<std::vector<int>> parseFromExpression(int level, const std::string& expr);
+  // parses a whole description straight into the layout of the minimal sets. Throws a BAD_POLICY runtime_error that gives the position of the error
+  static void parseFromExpression(const std::string& expr, vector<int> &setMembers, vector<unsigned int> &setOffsets);
+  vector<vector<int> > getMinimalSets() const; // builds a copy of the minimal sets, one vector per set
+  unsigned int getNumMinimalSets() const;
+  const vector<int>& getSetMembers() const;
+  const vector<unsigned int>& getSetOffsets() const; // has one more element than the number of sets
+  void setMinimalSetChoice(MinimalSetChoice choice);
+  MinimalSetChoice getMinimalSetChoice() const;
   BLAccessPolicy();
   BLAccessPolicy(const string &description, const int n); // constructor with participants numbered from 1 to n, each participant holding one share
   BLAccessPolicy(const string &description, const vector<int> &parts); // constructor with participants specified freely, each participant holding one share
   BLAccessPolicy(const BLAccessPolicy& other);
   BLAccessPolicy& operator=(const BLAccessPolicy& other);
+  // the same participants and minimal sets, in the same order. The descriptions and the choice of minimal set may differ
+  bool operator==(const BLAccessPolicy& rhs) const;
   std::string getDescription() const;
+  StructuralHash getStructuralHash() const; // the hash of the participants and of the minimal sets, in order
+  // the binary form holds the description, the participants, the minimal sets and their order by size
+  void writeBinary(BinaryWriter &out) const;
+  static shared_ptr<BLAccessPolicy> readBinary(BinaryReader &in);
   unsigned int getNumShares();
   //  bool evaluate(const vector<ShareTuple> shares, vector<ShareTuple> &witnessShares) const;
-  static std::string createShareID(std::string setID, std::string partID);
-  bool evaluateIDs(const vector<std::string> shareIDs, vector<int> &witnessSharesIndices) const;
-  vector<Big> findCoefficients(const vector<std::string> shareIDs, const Big& order) const;
-  void obtainCoveredFrags(const vector<int> &atts, vector<int> &attFragIndices, vector<int> &keyFragIndices, vector<std::string> &coveredShareIDs) const;
+  ShareID createShareID(unsigned int setNo, unsigned int position) const; // the identifier of the share of an element of a minimal set
+  bool evaluateIDs(const vector<ShareID>& shareIDs, vector<int> &witnessSharesIndices) const;
+  using AccessPolicy::findCoefficients;
+  void findCoefficients(const vector<ShareID>& shareIDs, const Big& order, vector<Big>& coeffs) const;
+  using AccessPolicy::obtainCoveredFrags;
+  void obtainCoveredFrags(const CoveredSet &covered, vector<int> &attFragIndices, vector<int> &keyFragIndices, vector<ShareID> &coveredShareIDs) const;
+  std::string renderShareID(const ShareID& id) const; // <minimal set, counted from 1>:<attribute>
 };
 
 class BLSS : public SecretSharing
 {
  private:
   shared_ptr<BLAccessPolicy>  i_policy; 
-  vector<Big> m_randomness;
   
  protected:
   void init();
   void initPolicy();
-  void manageRandomness(RandomnessActions action);
 
  public:
   BLSS(shared_ptr<BLAccessPolicy> policy, PFC &pfc);
   BLSS(shared_ptr<BLAccessPolicy> policy, const Big &order, PFC &pfc);  
 
   // virtual inherited methods:
-  vector<Big> getDistribRandomness();  
-  std::vector<ShareTuple> distribute_random(const Big& s);
-  std::vector<ShareTuple> distribute_determ(const Big& s, const vector<Big>& randomness);
+  unsigned int getNumRandomness();
+  using SecretSharing::distribute_determ;
+  std::vector<ShareTuple> distribute_determ(const Big& s, const RandomnessSource& randomness);
   Big reconstruct (const vector<ShareTuple> shares);
 };
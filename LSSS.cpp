@@ -0,0 +1,435 @@
+/*
+  Testbed for empirical evaluation of KP-ABE schemes, according to Crampton, Pinto (CSF2014).
+  Code by: Alexandre Miranda Pinto
+
+  This file implements the span program and the LSSS scheme declared in LSSS.h
+*/
+
+#ifndef DEF_LSSS
+#include "LSSS.h"
+#endif
+
+#include <climits>
+#include <cstdlib>
+
+
+// a row of the matrix while it is being built. The columns are increasing, since a gate only adds columns after those of its own vector
+struct SparseRow {
+  vector<unsigned int> columns;
+  vector<int> bases;
+  vector<unsigned int> exponents;
+
+  void add(unsigned int column, int base, unsigned int exponent) {
+    columns.push_back(column);
+    bases.push_back(base);
+    exponents.push_back(exponent);
+  }
+};
+
+SpanProgram::SpanProgram():
+  m_rowOffsets(1, 0),
+  m_numColumns(1)
+{}
+
+void SpanProgram::addEntry(unsigned int column, int base, unsigned int exponent) {
+  m_columns.push_back(column);
+  m_bases.push_back(base);
+  m_exponents.push_back(exponent);
+  if (base == 1) {
+    m_units.push_back(1);
+  } else if (base == -1) {
+    m_units.push_back((exponent % 2 == 1) ? -1 : 1);
+  } else {
+    m_units.push_back(0);
+  }
+}
+
+// the new columns of a gate are those of its randomness in ShTree, after the column of the secret
+SpanProgram::SpanProgram(const CompiledTree& tree):
+  m_rowOffsets(1, 0),
+  m_numColumns(1 + tree.getNumRandomness())
+{
+  if (tree.size() == 0) return;
+  vector<SparseRow> vectors(tree.size());
+  vectors[tree.root()].add(0, 1, 1);
+
+  for (int n = tree.root(); n >= 0; n--) {
+    const CompiledTree::Node &node = tree.getNode(n);
+    if (node.kind != CompiledTree::gateNode) {
+      continue;
+    }
+    const SparseRow &gateVector = vectors[n];
+    unsigned int base = 1 + node.randomnessBase;
+    bool isAnd = (node.threshold > 1) && (node.threshold == node.numChildren);
+    for (unsigned int j = 0; j < node.numChildren; j++) {
+      unsigned int child = tree.getChild(node, j);
+      if (tree.getNode(child).kind == CompiledTree::nilNode) {
+	continue;
+      }
+      SparseRow &row = vectors[child];
+      if (isAnd && (j < node.numChildren - 1)) {
+	row.add(base + j, 1, 1);
+	continue;
+      }
+      row = gateVector;
+      if (isAnd) {
+	for (unsigned int k = 0; k < node.numChildren - 1; k++) {
+	  row.add(base + k, -1, 1);
+	}
+      } else if (node.threshold > 1) {
+	for (unsigned int k = 0; k < node.threshold - 1; k++) {
+	  row.add(base + k, j + 1, k + 1);
+	}
+      }
+    }
+    // the vector of a gate is no longer needed once its children have theirs
+    vectors[n] = SparseRow();
+  }
+
+  for (unsigned int i = 0; i < tree.getNumLeaves(); i++) {
+    const SparseRow &row = vectors[tree.getLeafNode(i)];
+    for (unsigned int e = 0; e < row.columns.size(); e++) {
+      addEntry(row.columns[e], row.bases[e], row.exponents[e]);
+    }
+    m_rowOffsets.push_back(m_columns.size());
+  }
+}
+
+void SpanProgram::reducedEntry(unsigned int entry, const Big& order, Big& out) const {
+  int base = m_bases[entry];
+  if (m_units[entry] != 0) {
+    out = (m_units[entry] == 1) ? 1 : order - 1;
+    return;
+  }
+  out = pow((Big) std::abs(base), (Big) (int) m_exponents[entry], order);
+  if ((base < 0) && (m_exponents[entry] % 2 == 1) && (out != 0)) {
+    out = order - out;
+  }
+}
+
+void SpanProgram::reducedEntries(const Big& order, vector<Big>& entries) const {
+  entries.resize(m_columns.size());
+  for (unsigned int e = 0; e < m_columns.size(); e++) {
+    reducedEntry(e, order, entries[e]);
+  }
+}
+
+bool SpanProgram::operator==(const SpanProgram& rhs) const {
+  return (m_numColumns == rhs.m_numColumns) && (m_rowOffsets == rhs.m_rowOffsets) && (m_columns == rhs.m_columns) && (m_bases == rhs.m_bases)
+    && (m_exponents == rhs.m_exponents);
+}
+
+// a power is written out while it fits in a long long, and as base^exponent beyond
+std::string SpanProgram::rowToString(unsigned int row) const {
+  stringstream ss;
+  for (unsigned int e = rowBegin(row); e < rowEnd(row); e++) {
+    ss << m_columns[e] << ":";
+    long long value = 1;
+    unsigned int k = 0;
+    while ((k < m_exponents[e]) && (std::abs(value) <= LLONG_MAX / std::abs(m_bases[e]))) {
+      value *= m_bases[e];
+      k++;
+    }
+    if (k == m_exponents[e]) {
+      ss << value;
+    } else {
+      ss << m_bases[e] << "^" << m_exponents[e];
+    }
+    if (e < rowEnd(row) - 1) ss << " ";
+  }
+  return ss.str();
+}
+
+//==============================================
+
+// the description is parsed and compiled as in ShTree, and the matrix is built from the compiled tree
+void LSSSAccessPolicy::init(){
+  static thread_local TreeArena arena;
+  ShTreeAccessPolicy::parseIntoArena(m_description, arena);
+  m_compiled = CompiledTree(arena);
+  m_program = SpanProgram(m_compiled);
+  m_coeffCache = make_shared<CoefficientCache>();
+  m_hash = hashPolicy();
+}
+
+// the kind comes first, with a value that no kind of the policy cache has, so that no policy of another scheme has the same hash.
+// The matrix is a function of the compiled tree, which is hashed in its place
+StructuralHash LSSSAccessPolicy::hashPolicy() const {
+  return hashCombine(hashParticipants(hashCombine(HASH_SEED, 3)), m_compiled.getStructuralHash());
+}
+
+LSSSAccessPolicy::LSSSAccessPolicy():
+  m_description(""),
+  m_coeffCache(make_shared<CoefficientCache>())
+{
+  m_hash = hashPolicy();
+}
+
+LSSSAccessPolicy::LSSSAccessPolicy(const string &description, const int n):
+  AccessPolicy(n),
+  m_description(description)
+{
+  init();
+}
+
+LSSSAccessPolicy::LSSSAccessPolicy(const string &description, const vector<int> &parts):
+  AccessPolicy(parts),
+  m_description(description)
+{
+  init();
+}
+
+bool LSSSAccessPolicy::operator==(const LSSSAccessPolicy& rhs) const
+{
+  if (this == &rhs) return true;
+  return (m_hash == rhs.m_hash) && (m_participants == rhs.m_participants) && (m_program == rhs.m_program);
+}
+
+std::string LSSSAccessPolicy::getDescription() const
+{
+  return m_description;
+}
+
+const CompiledTree& LSSSAccessPolicy::getCompiledTree() const
+{
+  return m_compiled;
+}
+
+const SpanProgram& LSSSAccessPolicy::getSpanProgram() const
+{
+  return m_program;
+}
+
+shared_ptr<CoefficientCache> LSSSAccessPolicy::getCoefficientCache() const
+{
+  return m_coeffCache;
+}
+
+StructuralHash LSSSAccessPolicy::getStructuralHash() const
+{
+  return m_hash;
+}
+
+unsigned int LSSSAccessPolicy::getNumShares()  {
+  return m_program.getNumRows();
+}
+
+// a set of rows spans the column of the secret exactly when its leaves satisfy the tree, so the tree decides, and its witness shares are a set of rows
+// that is minimal at every gate
+bool LSSSAccessPolicy::evaluateIDs(const vector<ShareID>& shareIDs, vector<int> &witnessSharesIndices) const{
+  witnessSharesIndices.clear();
+
+  // an identifier that the policy did not issue is ignored. If a share was received twice, the first one is used
+  vector<int> sharePositions(m_program.getNumRows(), -1);
+  for (unsigned int i = 0; i < shareIDs.size(); i++) {
+    unsigned int index = shareIDs[i].getIndex();
+    if ((index < sharePositions.size()) && (sharePositions[index] < 0)) {
+      sharePositions[index] = i;
+    }
+  }
+  return m_compiled.satisfy(sharePositions, witnessSharesIndices);
+}
+
+// the reduction of a value, between 0 and order-1
+static void reduce(Big& value, const Big& order) {
+  value %= order;
+  if (value < 0) value += order;
+}
+
+bool LSSSAccessPolicy::solveCoefficients(const SpanProgram& program, const vector<int>& rows, const Big& order, vector<Big>& coeffs) {
+  // the equations are the columns touched by the rows, numbered as they are first seen, with the column of the secret first. Equation e reads
+  // sum_i coeffs[i] * M[rows[i]][column of e] = (e == 0), and holds the coefficients of the unknowns followed by its right side
+  std::map<unsigned int, unsigned int> equationOf;
+  equationOf[0] = 0;
+  for (unsigned int i = 0; i < rows.size(); i++) {
+    for (unsigned int e = program.rowBegin(rows[i]); e < program.rowEnd(rows[i]); e++) {
+      equationOf.insert(std::make_pair(program.getColumn(e), (unsigned int) equationOf.size()));
+    }
+  }
+  unsigned int nUnknowns = rows.size();
+  vector<vector<Big> > system(equationOf.size(), vector<Big>(nUnknowns + 1, 0));
+  system[0][nUnknowns] = 1;
+  for (unsigned int i = 0; i < rows.size(); i++) {
+    for (unsigned int e = program.rowBegin(rows[i]); e < program.rowEnd(rows[i]); e++) {
+      program.reducedEntry(e, order, system[equationOf[program.getColumn(e)]][i]);
+    }
+  }
+
+  // Gauss-Jordan: each unknown that has a non-zero coefficient in some equation not yet used becomes the pivot of that equation, and is eliminated from
+  // every other equation. The unknowns that never become pivots are free, and are set to 0
+  BigScope scope;
+  Big& inverse = scope.get();
+  Big& factor = scope.get();
+  Big& term = scope.get();
+  vector<int> pivotOf(nUnknowns, -1);
+  unsigned int rank = 0;
+  for (unsigned int i = 0; (i < nUnknowns) && (rank < system.size()); i++) {
+    unsigned int p = rank;
+    while ((p < system.size()) && (system[p][i] == 0)) p++;
+    if (p == system.size()) continue;
+    system[p].swap(system[rank]);
+
+    vector<Big> &pivot = system[rank];
+    inverse = moddiv(1, pivot[i], order);
+    for (unsigned int c = i; c <= nUnknowns; c++) {
+      if (pivot[c] != 0) pivot[c] = modmult(pivot[c], inverse, order);
+    }
+    for (unsigned int r = 0; r < system.size(); r++) {
+      if ((r == rank) || (system[r][i] == 0)) continue;
+      factor = system[r][i];
+      for (unsigned int c = i; c <= nUnknowns; c++) {
+	if (pivot[c] == 0) continue;
+	term = modmult(factor, pivot[c], order);
+	system[r][c] -= term;
+	if (system[r][c] < 0) system[r][c] += order;
+      }
+    }
+    pivotOf[i] = rank;
+    rank++;
+  }
+
+  // an equation left without a pivot reads 0 = its right side
+  for (unsigned int r = rank; r < system.size(); r++) {
+    if (system[r][nUnknowns] != 0) return false;
+  }
+  coeffs.assign(nUnknowns, 0);
+  for (unsigned int i = 0; i < nUnknowns; i++) {
+    if (pivotOf[i] >= 0) coeffs[i] = system[pivotOf[i]][nUnknowns];
+  }
+  return true;
+}
+
+void LSSSAccessPolicy::findCoefficients(const vector<ShareID>& shareIDs, const Big& order, vector<Big>& coeffs) const {
+  vector<int> rows;
+  rows.reserve(shareIDs.size());
+  for (unsigned int i = 0; i < shareIDs.size(); i++) {
+    guard("findCoefficients: share identifier beyond the rows of the policy", shareIDs[i].getIndex() < m_program.getNumRows());
+    rows.push_back(shareIDs[i].getIndex());
+  }
+
+  if (m_coeffCache->find(order, m_program.getNumRows(), rows, coeffs)) {
+    return;
+  }
+  DEBUG("solving the coefficients of " << rows.size() << " rows");
+  if (!solveCoefficients(m_program, rows, order, coeffs)) {
+    stringstream ss;
+    ss << ERR_BAD_SHARE << ": the rows of the shares do not span the secret. Rows: " << rows.size() << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+  m_coeffCache->insert(order, m_program.getNumRows(), rows, coeffs);
+}
+
+void LSSSAccessPolicy::obtainCoveredFrags(const CoveredSet &covered, vector<int> &attFragIndices, vector<int> &keyFragIndices, vector<ShareID> &coveredShareIDs) const {
+  for (unsigned int i = 0; i < m_compiled.getNumLeaves(); i++) {
+    const CompiledTree::Node &leaf = m_compiled.getNode(m_compiled.getLeafNode(i));
+    int n = covered.position(leaf.leafValue);
+    if (n >= 0) {
+      keyFragIndices.push_back(i);
+      attFragIndices.push_back(n);
+      coveredShareIDs.push_back(ShareID(i, leaf.childNo));
+    }
+  }
+}
+
+std::string LSSSAccessPolicy::renderShareID(const ShareID& id) const {
+  if (id.getIndex() >= m_program.getNumRows()) {
+    return AccessPolicy::renderShareID(id);
+  }
+  const CompiledTree::Node &leaf = m_compiled.getNode(m_compiled.getLeafNode(id.getIndex()));
+  return convertIntToStr(leaf.leafValue) + "=[" + m_program.rowToString(id.getIndex()) + "]";
+}
+
+//==============================================
+
+void LSSSSS::initPolicy(){
+  i_policy = std::dynamic_pointer_cast<LSSSAccessPolicy>(m_policy);
+  if (!i_policy) {
+    stringstream ss;
+    ss << ERR_BAD_POLICY << ": LSSSSS has an AccessPolicy that is not LSSSAccessPolicy!" << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+}
+
+void LSSSSS::init(){
+  initPolicy();
+  i_policy->getSpanProgram().reducedEntries(m_order, i_entries);
+}
+
+LSSSSS::LSSSSS(shared_ptr<LSSSAccessPolicy>  policy, PFC &pfc):
+  SecretSharing(policy, pfc)
+{
+  init();
+}
+
+LSSSSS::LSSSSS(shared_ptr<LSSSAccessPolicy>  policy, const Big &order, PFC &pfc):
+  SecretSharing(policy, order, pfc)
+{
+  init();
+}
+
+// virtual inherited methods:
+
+unsigned int LSSSSS::getNumRandomness() {
+  return i_policy->getSpanProgram().getNumColumns() - 1;
+}
+
+// the share of each row is the product of the row by the vector of the secret and the randomness. The entries of AND and OR gates are units, and are
+// added or subtracted without a multiplication. The sum is kept between 0 and order-1 at every step
+std::vector<ShareTuple> LSSSSS::distribute_determ(const Big& s, const RandomnessSource& randomness){
+  const SpanProgram &program = i_policy->getSpanProgram();
+  const CompiledTree &tree = i_policy->getCompiledTree();
+  vector<ShareTuple> shares;
+  shares.reserve(program.getNumRows());
+
+  vector<Big> rho(program.getNumColumns());
+  rho[0] = s;
+  if (program.getNumColumns() > 1) {
+    randomness.get(0, program.getNumColumns() - 1, &rho[1]);
+  }
+
+  BigScope scope;
+  Big& value = scope.get();
+  Big& term = scope.get();
+  for (unsigned int i = 0; i < program.getNumRows(); i++) {
+    value = 0;
+    for (unsigned int e = program.rowBegin(i); e < program.rowEnd(i); e++) {
+      switch (program.getUnit(e)) {
+      case 1:
+	value += rho[program.getColumn(e)];
+	break;
+      case -1:
+	value -= rho[program.getColumn(e)];
+	break;
+      default:
+	term = modmult(i_entries[e], rho[program.getColumn(e)], m_order);
+	value += term;
+	break;
+      }
+      reduce(value, m_order);
+    }
+    const CompiledTree::Node &leaf = tree.getNode(tree.getLeafNode(i));
+    shares.push_back(ShareTuple(leaf.leafValue, value, ShareID(i, leaf.childNo)));
+  }
+  return shares;
+}
+
+Big LSSSSS::reconstruct(const vector<ShareTuple> shares){
+  vector<ShareTuple> witnessShares;
+  if (!i_policy->evaluate(shares, witnessShares)) return -1;
+
+  vector<ShareID> shareIDs;
+  shareIDs.reserve(witnessShares.size());
+  for (unsigned int i = 0; i < witnessShares.size(); i++) {
+    shareIDs.push_back(witnessShares[i].getShareID());
+  }
+  vector<Big> coeffs = i_policy->findCoefficients(shareIDs, m_order);
+
+  BigScope scope;
+  Big& sum = scope.get();
+  sum = 0;
+  for (unsigned int i = 0; i < witnessShares.size(); i++) {
+    sum += modmult(coeffs[i], witnessShares[i].getShare(), m_order);
+    sum %= m_order;
+  }
+  return sum;
+}
@@ -0,0 +1,151 @@
+/*
+  Testbed for empirical evaluation of KP-ABE schemes, according to Crampton, Pinto (CSF2014).
+  Code by: Alexandre Miranda Pinto
+
+  This file implements a specific Secret Sharing scheme: a linear secret sharing scheme given by a monotone span program.
+  The policy is written in the language of ShTree, and compiled into a matrix with one row for each leaf. A distribution multiplies the matrix by a vector
+  that holds the secret followed by random values; a set of shares is authorized if the first unit vector is a combination of its rows, and the
+  coefficients of that combination reconstruct the secret.
+  There are three classes implemented here:
+  - SpanProgram is the matrix, stored by rows with only its non-zero entries
+  - LSSSAccessPolicy is a subclass of the abstract AccessPolicy
+  - LSSSSS is a subclass of the abstract SecretSharing
+*/
+
+#ifndef DEF_UTILS
+#include "utils.h"
+#endif
+
+#ifndef DEF_SECRET_SHARING
+#include "secretsharing.h"
+#endif
+
+#ifndef DEF_SH_TREE
+#include "ShTree.h"
+#endif
+
+#define DEF_LSSS
+
+
+/*
+  The matrix is built from the compiled tree, from the root down, as in Lewko and Waters. Each node receives a vector, and the root receives the first
+  unit vector, which is the column of the secret. A gate passes its vector on to its children:
+  - OR: every child receives the vector of the gate
+  - AND of n children: the gate takes n-1 new columns. Child i < n-1 receives the unit vector of the i-th new column, and the last child receives the
+    vector of the gate minus all those unit vectors, so that the n rows add up to the vector of the gate
+  - THR of threshold t: the gate takes t-1 new columns, and child j receives the vector of the gate plus x, x^2 ... x^(t-1) on the new columns, with
+    x = j+1. These are the values of a Shamir polynomial whose coefficients are the new columns, and any t children recover the vector of the gate
+  The rows of the leaves are the rows of the matrix, in the order of the leaves. Every gate takes as many columns as ShTree takes random values for it,
+  so both schemes take the same randomness, and the entries of AND and OR are 0, 1 or -1.
+  Each entry is stored as a power x^k of a small base, since the powers of a large gate do not fit in a Big. The group order is not known to the policy,
+  so a scheme takes the entries reduced by its order, once, from reducedEntries.
+*/
+class SpanProgram {
+  vector<unsigned int> m_rowOffsets; // the entries of row i are m_columns[m_rowOffsets[i]] to m_columns[m_rowOffsets[i+1]-1], and the same below
+  vector<unsigned int> m_columns;
+  vector<int> m_bases;
+  vector<unsigned int> m_exponents;
+  vector<int> m_units; // 1 or -1 if the entry is that unit, which distribution adds without a multiplication. 0 otherwise
+  unsigned int m_numColumns;
+
+  void addEntry(unsigned int column, int base, unsigned int exponent);
+
+ public:
+  SpanProgram();
+  SpanProgram(const CompiledTree& tree);
+
+  inline unsigned int getNumRows() const {
+    return m_rowOffsets.size() - 1;
+  }
+  inline unsigned int getNumColumns() const { // the secret and the random values of a distribution
+    return m_numColumns;
+  }
+  inline unsigned int getNumEntries() const {
+    return m_columns.size();
+  }
+  inline unsigned int rowBegin(unsigned int row) const {
+    return m_rowOffsets[row];
+  }
+  inline unsigned int rowEnd(unsigned int row) const {
+    return m_rowOffsets[row+1];
+  }
+  inline unsigned int getColumn(unsigned int entry) const {
+    return m_columns[entry];
+  }
+  inline int getBase(unsigned int entry) const {
+    return m_bases[entry];
+  }
+  inline unsigned int getExponent(unsigned int entry) const {
+    return m_exponents[entry];
+  }
+  inline int getUnit(unsigned int entry) const {
+    return m_units[entry];
+  }
+  void reducedEntry(unsigned int entry, const Big& order, Big& out) const; // the entry, between 0 and order-1
+  void reducedEntries(const Big& order, vector<Big>& entries) const; // all the entries, in the order of the rows
+  bool operator==(const SpanProgram& rhs) const;
+  std::string rowToString(unsigned int row) const; // the entries of the row, as "0:1 3:-1 4:16", or "4:7^30" for a power too large for a long long
+};
+
+//=============================================================================
+
+/*
+  The coefficients of a set of rows are the solution of a linear system modulo the order, with one unknown for each row and one equation for each column
+  that the rows touch; rows are sparse, so that is usually far fewer columns than the matrix has. The system is solved by Gauss-Jordan elimination, which
+  skips the equations that have a zero in the pivot column. Rows that are not needed for the solution receive the coefficient 0.
+  The solution depends only on the set of rows, and is kept in a CoefficientCache, keyed by the sorted row numbers.
+  Shares are identified as in ShTree: the index is the number of the leaf, and the child number is the position of the leaf among the children of its gate.
+*/
+class LSSSAccessPolicy : public AccessPolicy
+{
+  std::string m_description;
+  CompiledTree m_compiled; // decides whether a set of shares is authorized, and picks the witness shares as ShTree does
+  SpanProgram m_program;
+  StructuralHash m_hash;
+  shared_ptr<CoefficientCache> m_coeffCache;
+  void init();
+  StructuralHash hashPolicy() const;
+
+ public:
+  LSSSAccessPolicy();
+  LSSSAccessPolicy(const string &description, const int n); // constructor with participants numbered from 1 to n, each participant holding one share
+  LSSSAccessPolicy(const string &description, const vector<int> &parts); // constructor with participants specified freely, each participant holding one share
+  bool operator==(const LSSSAccessPolicy& rhs) const; // the same participants and matrix. The descriptions may differ
+  std::string getDescription() const;
+  const CompiledTree& getCompiledTree() const;
+  const SpanProgram& getSpanProgram() const;
+  shared_ptr<CoefficientCache> getCoefficientCache() const;
+  StructuralHash getStructuralHash() const;
+  unsigned int getNumShares();
+  bool evaluateIDs(const vector<ShareID>& shareIDs, vector<int> &witnessSharesIndices) const;
+  // throws a BAD_SHARE runtime_error if the rows of the shares do not span the column of the secret
+  using AccessPolicy::findCoefficients;
+  void findCoefficients(const vector<ShareID>& shareIDs, const Big& order, vector<Big>& coeffs) const;
+  using AccessPolicy::obtainCoveredFrags;
+  void obtainCoveredFrags(const CoveredSet &covered, vector<int> &attFragIndices, vector<int> &keyFragIndices, vector<ShareID> &coveredShareIDs) const;
+  std::string renderShareID(const ShareID& id) const; // the row of the share, as in "4=[0:1 2:-1]"
+
+  // the coefficients of the rows, without the cache. False if the rows do not span the column of the secret
+  static bool solveCoefficients(const SpanProgram& program, const vector<int>& rows, const Big& order, vector<Big>& coeffs);
+};
+
+class LSSSSS : public SecretSharing
+{
+ private:
+  shared_ptr<LSSSAccessPolicy>  i_policy;
+  vector<Big> i_entries; // the entries of the span program, reduced by the order of the scheme
+
+ protected:
+  void init();
+  void initPolicy();
+
+ public:
+  LSSSSS(shared_ptr<LSSSAccessPolicy> policy, PFC &pfc);
+  LSSSSS(shared_ptr<LSSSAccessPolicy> policy, const Big &order, PFC &pfc);
+
+  // virtual inherited methods:
+  unsigned int getNumRandomness(); // one value for each column but that of the secret
+  using SecretSharing::distribute_determ;
+  std::vector<ShareTuple> distribute_determ(const Big& s, const RandomnessSource& randomness);
+  Big reconstruct (const vector<ShareTuple> shares);
+};
@@ -3,7 +3,9 @@
   Code by: Alexandre Miranda Pinto
 
   This file implements a specific Secret Sharing scheme: a tree of Shamir threshold schemes.
-  There are two classes implemented here: 
+  There are four classes implemented here: 
+  - CompiledTree is the parse tree of a policy lowered into flat arrays, over which the policy is evaluated
+  - CoefficientCache keeps the Lagrange coefficients of the sets of children already seen, for reuse by later decryptions
   - ShTreeAccessPolicy is a subclass of the abstract AccessPolicy
   - ShTreeSS is a subclass of the abstract SecretSharing
 */
@@ -11,13 +13,397 @@
 
 #include "ShTree.h"
 
+#include <algorithm>
+#include <set>
+
+CompiledTree::CompiledTree():
+  m_numGates(0),
+  m_numRandomness(0)
+{
+  computeHash();
+}
+
+CompiledTree::CompiledTree(shared_ptr<TreeNode> tree):
+  m_numGates(0),
+  m_numRandomness(0)
+{
+  if (tree) {
+    TreeArena arena(tree);
+    compileNode(arena, arena.root(), ShareID::ROOT_SHARE);
+  }
+  computeHash();
+}
+
+CompiledTree::CompiledTree(const TreeArena& arena):
+  m_numGates(0),
+  m_numRandomness(0)
+{
+  if (arena.size() > 0) {
+    m_nodes.reserve(arena.size());
+    compileNode(arena, arena.root(), ShareID::ROOT_SHARE);
+  }
+  computeHash();
+}
+
+// the gate takes its number and its randomness before its children, so that both are in pre-order, but is placed in the array after them
+unsigned int CompiledTree::compileNode(const TreeArena& arena, unsigned int source, int childNo) {
+  Node node;
+  node.kind = nilNode;
+  node.threshold = 0;
+  node.firstChild = 0;
+  node.numChildren = 0;
+  node.leafValue = 0;
+  node.leafNo = -1;
+  node.gateNo = -1;
+  node.parent = -1;
+  node.childNo = childNo;
+  node.randomnessBase = 0;
+
+  vector<unsigned int> children;
+  const TreeArena::Node &content = arena.getNode(source);
+  switch (content.type) {
+  case NodeContentType::nil:
+    break;
+  case NodeContentType::leaf:
+    node.kind = leafNode;
+    node.leafValue = content.leafValue;
+    node.leafNo = m_leaves.size();
+    break;
+  case NodeContentType::inner:
+    node.kind = gateNode;
+    node.threshold = content.threshold; // the arena gives OR and AND their thresholds
+    node.gateNo = m_numGates++;
+    node.randomnessBase = m_numRandomness;
+    if (node.threshold > 0) {
+      m_numRandomness += node.threshold - 1;
+    }
+    for (unsigned int i = 0; i < content.numChildren; i++) {
+      children.push_back(compileNode(arena, arena.getChild(content, i), i));
+    }
+    node.firstChild = m_children.size();
+    node.numChildren = children.size();
+    addVector(m_children, children);
+    break;
+  }
+
+  unsigned int n = m_nodes.size();
+  for (unsigned int i = 0; i < children.size(); i++) {
+    m_nodes[children[i]].parent = n;
+  }
+  if (node.kind == leafNode) {
+    m_leaves.push_back(n);
+  }
+  if (node.kind == gateNode) {
+    if (m_gates.size() <= (unsigned int) node.gateNo) {
+      m_gates.resize(node.gateNo + 1);
+    }
+    m_gates[node.gateNo] = n;
+  }
+  m_nodes.push_back(node);
+  return n;
+}
+
+// the nodes are in post-order, so the hashes of the children of a gate are known when the gate is reached. The numbering of leaves, gates and randomness
+// follows from the shape, and is left out
+void CompiledTree::computeHash() {
+  if (m_nodes.empty()) {
+    m_hash = hashCombine(HASH_SEED, 0);
+    return;
+  }
+  vector<StructuralHash> hashes(m_nodes.size());
+  for (unsigned int n = 0; n < m_nodes.size(); n++) {
+    const Node &node = m_nodes[n];
+    StructuralHash h = hashCombine(HASH_SEED, node.kind + 1);
+    switch (node.kind) {
+    case nilNode:
+      break;
+    case leafNode:
+      h = hashCombine(h, node.leafValue);
+      break;
+    case gateNode:
+      h = hashCombine(h, node.threshold);
+      h = hashCombine(h, node.numChildren);
+      for (unsigned int i = 0; i < node.numChildren; i++) {
+	h = hashCombine(h, hashes[getChild(node, i)]);
+      }
+      break;
+    }
+    hashes[n] = h;
+  }
+  m_hash = hashes[root()];
+}
+
+bool CompiledTree::operator==(const CompiledTree& rhs) const {
+  if (this == &rhs) return true;
+  if ((m_hash != rhs.m_hash) || (m_nodes.size() != rhs.m_nodes.size()) || (m_children != rhs.m_children)) return false;
+  for (unsigned int n = 0; n < m_nodes.size(); n++) {
+    const Node &a = m_nodes[n];
+    const Node &b = rhs.m_nodes[n];
+    if ((a.kind != b.kind) || (a.threshold != b.threshold) || (a.numChildren != b.numChildren) || (a.leafValue != b.leafValue)) return false;
+  }
+  return true;
+}
+
+void CompiledTree::writeBinary(BinaryWriter &out) const {
+  out.putUInt(m_nodes.size());
+  for (unsigned int n = 0; n < m_nodes.size(); n++) {
+    const Node &node = m_nodes[n];
+    out.putByte(node.kind);
+    out.putUInt(node.threshold);
+    out.putUInt(node.firstChild);
+    out.putUInt(node.numChildren);
+    out.putInt(node.leafValue);
+    out.putInt(node.leafNo);
+    out.putInt(node.gateNo);
+    out.putInt(node.parent);
+    out.putInt(node.childNo);
+    out.putUInt(node.randomnessBase);
+  }
+  out.putUInts(m_children);
+  out.putUInts(m_leaves);
+  out.putUInts(m_gates);
+  out.putUInt(m_numRandomness);
+}
+
+// the reader checks every position against the arrays it points into, that children come before their parents, that each child and its parent name
+// each other, that only the root has no parent and only gates have children, and that the threshold and the randomness of each gate fit the tree, so
+// that no operation on a tree read from a damaged file can leave the arrays
+CompiledTree CompiledTree::readBinary(BinaryReader &in) {
+  CompiledTree tree;
+  unsigned int size = in.getUInt();
+  tree.m_nodes.reserve(std::min(size, 1u << 16)); // grown as the nodes are read, so that a damaged size does not allocate
+  for (unsigned int n = 0; n < size; n++) {
+    Node node;
+    node.kind = (NodeKind) in.getByte();
+    node.threshold = in.getUInt();
+    node.firstChild = in.getUInt();
+    node.numChildren = in.getUInt();
+    node.leafValue = in.getInt();
+    node.leafNo = in.getInt();
+    node.gateNo = in.getInt();
+    node.parent = in.getInt();
+    node.childNo = in.getInt();
+    node.randomnessBase = in.getUInt();
+    if ((node.kind != nilNode) && (node.kind != leafNode) && (node.kind != gateNode)) in.fail("unknown kind of node");
+    if ((node.parent < -1) || (node.parent >= (int) size)) in.fail("parent out of range");
+    tree.m_nodes.push_back(node);
+  }
+  in.getUInts(tree.m_children);
+  in.getUInts(tree.m_leaves);
+  in.getUInts(tree.m_gates);
+  tree.m_numGates = tree.m_gates.size();
+  tree.m_numRandomness = in.getUInt();
+
+  for (unsigned int n = 0; n < size; n++) {
+    const Node &node = tree.m_nodes[n];
+    if ((node.firstChild > tree.m_children.size()) || (node.numChildren > tree.m_children.size() - node.firstChild)) in.fail("children out of range");
+    for (unsigned int i = 0; i < node.numChildren; i++) {
+      unsigned int child = tree.getChild(node, i);
+      if (child >= n) in.fail("child placed after its parent");
+      if ((tree.m_nodes[child].parent != (int) n) || (tree.m_nodes[child].childNo != (int) i)) in.fail("child does not name its parent");
+    }
+    if ((node.kind != gateNode) && (node.numChildren != 0)) in.fail("children of a node that is not a gate");
+    if ((node.kind == leafNode) && ((node.leafNo < 0) || ((unsigned int) node.leafNo >= tree.m_leaves.size()))) in.fail("leaf number out of range");
+    if (node.kind == gateNode) {
+      if ((node.gateNo < 0) || ((unsigned int) node.gateNo >= tree.m_numGates)) in.fail("gate number out of range");
+      if (node.threshold > node.numChildren) in.fail("threshold above the number of children");
+      // the polynomial of the gate reads threshold-1 values of randomness from its base
+      unsigned int degree = (node.threshold > 0) ? node.threshold - 1 : 0;
+      if ((degree > tree.m_numRandomness) || (node.randomnessBase > tree.m_numRandomness - degree)) in.fail("randomness out of range");
+    }
+  }
+  // the children of every gate are now known to be in range, so the parent of each node can be checked the other way: only the root has none, and
+  // every other node is listed by its parent at its child number
+  for (unsigned int n = 0; n < size; n++) {
+    const Node &node = tree.m_nodes[n];
+    if (node.parent < 0) {
+      if (n != size - 1) in.fail("node other than the root without a parent");
+      continue;
+    }
+    if (n == size - 1) in.fail("root with a parent");
+    const Node &parent = tree.m_nodes[node.parent];
+    if ((parent.kind != gateNode) || (node.childNo < 0) || ((unsigned int) node.childNo >= parent.numChildren) || (tree.getChild(parent, node.childNo) != n)) {
+      in.fail("parent does not list the node");
+    }
+  }
+  for (unsigned int i = 0; i < tree.m_leaves.size(); i++) {
+    if ((tree.m_leaves[i] >= size) || (tree.m_nodes[tree.m_leaves[i]].leafNo != (int) i)) in.fail("leaf table does not match the nodes");
+  }
+  for (unsigned int i = 0; i < tree.m_gates.size(); i++) {
+    if ((tree.m_gates[i] >= size) || (tree.m_nodes[tree.m_gates[i]].gateNo != (int) i)) in.fail("gate table does not match the nodes");
+  }
+  tree.computeHash(); // not stored, so that a damaged file can not give a tree the hash of another
+  return tree;
+}
+
+// the first pass, bottom-up, finds which nodes are satisfied. The second, top-down from the root, collects the shares of the children that each
+// satisfied gate uses. The stack holds the children of a gate in reverse, so that the shares come out in the order of the leaves
+bool CompiledTree::satisfy(const vector<int> &sharePositions, vector<int> &satisfyingSharesIndices) const {
+  satisfyingSharesIndices.clear();
+  if (m_nodes.empty()) {
+    return false;
+  }
+
+  vector<char> satisfied(m_nodes.size(), 0);
+  for (unsigned int n = 0; n < m_nodes.size(); n++) {
+    const Node &node = m_nodes[n];
+    switch (node.kind) {
+    case nilNode:
+      break;
+    case leafNode:
+      satisfied[n] = ((unsigned int) node.leafNo < sharePositions.size()) && (sharePositions[node.leafNo] >= 0);
+      break;
+    case gateNode:
+      {
+	unsigned int nSat = 0;
+	for (unsigned int i = 0; (i < node.numChildren) && (nSat < node.threshold); i++) {
+	  nSat += satisfied[getChild(node, i)];
+	}
+	satisfied[n] = (nSat >= node.threshold);
+      }
+      break;
+    }
+  }
+  if (!satisfied[root()]) {
+    return false;
+  }
+
+  vector<unsigned int> stack(1, root());
+  vector<unsigned int> used;
+  while (!stack.empty()) {
+    const Node &node = m_nodes[stack.back()];
+    stack.pop_back();
+    if (node.kind == leafNode) {
+      satisfyingSharesIndices.push_back(sharePositions[node.leafNo]);
+      continue;
+    }
+    used.clear();
+    for (unsigned int i = 0; (i < node.numChildren) && (used.size() < node.threshold); i++) {
+      unsigned int child = getChild(node, i);
+      if (satisfied[child]) used.push_back(child);
+    }
+    for (int i = used.size() - 1; i >= 0; i--) {
+      stack.push_back(used[i]);
+    }
+  }
+  return true;
+}
+
+//==============================================
+
+CoefficientCache::CoefficientCache():
+  m_hasOrder(false)
+{}
+
+void CoefficientCache::makeKey(unsigned int arity, const vector<int>& childNos, vector<int>& key, vector<unsigned int>& positions) {
+  positions.resize(childNos.size());
+  for (unsigned int i = 0; i < positions.size(); i++) {
+    positions[i] = i;
+  }
+  // sets are small, so an insertion sort of the positions is enough
+  for (unsigned int i = 1; i < positions.size(); i++) {
+    unsigned int p = positions[i];
+    int j = i - 1;
+    while ((j >= 0) && (childNos[positions[j]] > childNos[p])) {
+      positions[j+1] = positions[j];
+      j--;
+    }
+    positions[j+1] = p;
+  }
+  key.clear();
+  key.reserve(childNos.size() + 1);
+  key.push_back(arity);
+  for (unsigned int i = 0; i < positions.size(); i++) {
+    key.push_back(childNos[positions[i]]);
+  }
+}
+
+bool CoefficientCache::find(const Big& order, unsigned int arity, const vector<int>& childNos, vector<Big>& coeffs) const {
+  vector<int> key;
+  vector<unsigned int> positions;
+  makeKey(arity, childNos, key, positions);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_hasOrder || (m_order != order)) return false;
+  Table::const_iterator it = m_table.find(key);
+  if (it == m_table.end()) return false;
+  coeffs.resize(childNos.size());
+  for (unsigned int i = 0; i < positions.size(); i++) {
+    coeffs[positions[i]] = it->second[i];
+  }
+  return true;
+}
+
+void CoefficientCache::insert(const Big& order, unsigned int arity, const vector<int>& childNos, const vector<Big>& coeffs) {
+  vector<int> key;
+  vector<unsigned int> positions;
+  makeKey(arity, childNos, key, positions);
+  vector<Big> sorted(coeffs.size());
+  for (unsigned int i = 0; i < positions.size(); i++) {
+    sorted[i] = coeffs[positions[i]];
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_hasOrder) {
+    m_order = order;
+    m_hasOrder = true;
+  }
+  if ((m_order != order) || (m_table.size() >= MAX_ENTRIES)) return;
+  m_table[key] = sorted;
+}
+
+bool CoefficientCache::claimFill(const Big& order, unsigned int arity, unsigned int threshold) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_hasOrder) {
+    m_order = order;
+    m_hasOrder = true;
+  }
+  if ((m_order != order) || (m_table.size() >= MAX_ENTRIES)) return false;
+  return m_filled.insert(std::make_pair(arity, threshold)).second;
+}
+
+unsigned int CoefficientCache::size() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_table.size();
+}
+
+void CoefficientCache::clear() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_table.clear();
+  m_filled.clear();
+  m_hasOrder = false;
+}
+
+//==============================================
+
+// the description is parsed into a per-thread arena, which keeps its capacity from one policy to the next, and compiled from there.
+// The parse tree is only built if getPolicy asks for it
 void ShTreeAccessPolicy::init(){
-  m_treePolicy = parsePolicy();
+  static thread_local TreeArena arena;
+  parseIntoArena(m_description, arena);
+  m_compiled = CompiledTree(arena);
+  m_coeffCache = make_shared<CoefficientCache>();
+  m_flat = ShamirAccessPolicy::fromCompiledTree(m_compiled, m_participants);
+  m_hash = hashPolicy();
 } 
 
+std::string ShTreeAccessPolicy::optimizeDescription(const std::string& expr) {
+  TreeArena arena;
+  parseIntoArena(expr, arena);
+  return TreeOptimizer::toDescription(TreeOptimizer::optimize(arena.toTree()));
+}
+
+// the policy kind comes first, with the value of shTreePolicy in the policy cache, so that no BL policy has the same hash
+StructuralHash ShTreeAccessPolicy::hashPolicy() const {
+  return hashCombine(hashParticipants(hashCombine(HASH_SEED, 2)), m_compiled.getStructuralHash());
+}
+
 ShTreeAccessPolicy::ShTreeAccessPolicy():
-  m_description("")
-{}
+  m_description(""),
+  m_coeffCache(make_shared<CoefficientCache>())
+{
+  m_hash = hashPolicy();
+}
 
 ShTreeAccessPolicy::ShTreeAccessPolicy(const string &description, const int n):
   AccessPolicy(n), 
@@ -33,27 +419,57 @@ ShTreeAccessPolicy::ShTreeAccessPolicy(const string &description, const vector<i
   init();
 }
 
+ShTreeAccessPolicy::ShTreeAccessPolicy(const string &description, const vector<int> &parts, const CompiledTree &compiled):
+  AccessPolicy(parts),
+  m_description(description),
+  m_compiled(compiled),
+  m_coeffCache(make_shared<CoefficientCache>()),
+  m_flat(ShamirAccessPolicy::fromCompiledTree(compiled, parts))
+{
+  m_hash = hashPolicy();
+}
+
 ShTreeAccessPolicy::ShTreeAccessPolicy(const ShTreeAccessPolicy& other):
   AccessPolicy(other.m_participants), 
   m_description(other.m_description),
-  m_treePolicy(other.m_treePolicy)
+  m_treePolicy(other.getTreeIfParsed()),
+  m_compiled(other.m_compiled),
+  m_hash(other.m_hash),
+  m_coeffCache(other.m_coeffCache),
+  m_flat(other.m_flat)
 {}
 
 ShTreeAccessPolicy& ShTreeAccessPolicy::operator=(const ShTreeAccessPolicy& other)
 {
   m_description = other.m_description;
   m_participants = other.m_participants;
-  m_treePolicy = other.m_treePolicy;
+  shared_ptr<TreeNode> tree = other.getTreeIfParsed();
+  std::lock_guard<std::mutex> lock(m_treeMutex);
+  m_treePolicy = tree;
+  m_compiled = other.m_compiled;
+  m_hash = other.m_hash;
+  m_coeffCache = other.m_coeffCache;
+  m_flat = other.m_flat;
   return *this;
 }
 
+bool ShTreeAccessPolicy::operator==(const ShTreeAccessPolicy& rhs) const
+{
+  return (m_hash == rhs.m_hash) && (m_participants == rhs.m_participants) && (m_compiled == rhs.m_compiled);
+}
+
+StructuralHash ShTreeAccessPolicy::getStructuralHash() const
+{
+  return m_hash;
+}
+
 std::string ShTreeAccessPolicy::getDescription() const
 {
   return m_description;
 }
 
 unsigned int ShTreeAccessPolicy::getNumShares()  {
-  return m_treePolicy->getNumLeaves();
+  return m_compiled.getNumLeaves();
 }
 
 // this function returns true if the shares received are enough to satisfy the policy. In ShTree, this requires checking the whole tree. All the nodes are Shamir
@@ -70,13 +486,23 @@ unsigned int ShTreeAccessPolicy::getNumShares()  {
 //   return result;
 // }
 
-bool ShTreeAccessPolicy::evaluateIDs(const vector<std::string> shareIDs, vector<int> &witnessSharesIndices) const{
+bool ShTreeAccessPolicy::evaluateIDs(const vector<ShareID>& shareIDs, vector<int> &witnessSharesIndices) const{
+  if (m_flat) {
+    return m_flat->evaluateIDs(shareIDs, witnessSharesIndices);
+  }
   witnessSharesIndices.clear();
   //  ENHDEBUG("Tree: " << m_treePolicy->to_string());
-  
-  bool success = satisfyNodeID(m_treePolicy, shareIDs, witnessSharesIndices);
 
-  return success;
+  // an identifier that the policy did not issue can not satisfy any leaf, and is ignored. If a share was received twice, the first one is used
+  vector<int> sharePositions(m_compiled.getNumLeaves(), -1);
+  for (unsigned int i = 0; i < shareIDs.size(); i++) {
+    unsigned int index = shareIDs[i].getIndex();
+    if ((index < sharePositions.size()) && (sharePositions[index] < 0)) {
+      sharePositions[index] = i;
+    }
+  }
+
+  return m_compiled.satisfy(sharePositions, witnessSharesIndices);
 }
 
 bool ShTreeAccessPolicy::satisfyNode(shared_ptr<TreeNode> treeNode, vector<ShareTuple> shares, vector<ShareTuple> &satisfyingShares){ 
@@ -97,7 +523,7 @@ bool ShTreeAccessPolicy::satisfyNode(shared_ptr<TreeNode> treeNode, vector<Share
 
   DEBUG("Creating ID vector");
   
-  vector<std::string> shareIDs;
+  vector<ShareID> shareIDs;
   for (unsigned int i = 0; i < shares.size(); i++) {
     shareIDs.push_back(shares[i].getShareID());
   }
@@ -113,102 +539,17 @@ bool ShTreeAccessPolicy::satisfyNode(shared_ptr<TreeNode> treeNode, vector<Share
   return success;
 }
 
-
-bool ShTreeAccessPolicy::satisfyNodeID(shared_ptr<TreeNode> treeNode, vector<std::string> shareIDs, vector<int> &satisfyingSharesIndices){ 
-
-  ENHDEBUG("Satisfy Node ID");
-
-  debugVector("Received ShareIDs: ", shareIDs);
-
-  vector<int> goodShares;
-  satisfyingSharesIndices.clear();
-
-  shared_ptr<NodeContent> node = treeNode->getNode();
-  if (node->getType() == NodeContentType::nil) {
-    //    DEBUG("Fail: nilNode");
-    return false;
-  }
-
-  if (node->getType() == NodeContentType::leaf) {
-    DEBUG("Checking leaf");
-    std::string shareID = treeNode->getNodeID();
-    DEBUG("Tree ShareID: " << shareID);
-    for (unsigned int i = 0; i < shareIDs.size(); i++) {
-      std::string currentID = shareIDs[i];
-      if (shareID == currentID)  {
-	satisfyingSharesIndices.push_back(i);
-	DEBUG("Leaf satisfied");
-	return true;
-      }
-    }
-    //    DEBUG("Fail: wrong leaf id");
-    DEBUG("Leaf not satisfied");
-    satisfyingSharesIndices.clear();
-    return false;
-  } else {
-    switch(node->getInnerNodeType()){
-    case InnerNodeType::AND:     
-      DEBUG("AND node");
-      for (unsigned int i = 0; i < treeNode->getNumChildren(); i++){
-	if (!satisfyNodeID(treeNode->getChild(i), shareIDs, goodShares)) {
-	  //	  DEBUG("Fail: AND Node with a non-satisfied child");
-	  DEBUG("AND not satisfied");
-	  satisfyingSharesIndices.clear();
-	  return false;
-	} else {
-	  DEBUG("AND satisfied");
-	  addVector(satisfyingSharesIndices, goodShares);
-	}
-      }      
-      return true; 
-      break;
-    case InnerNodeType::OR:
-      DEBUG("OR node");
-      //      DEBUG("Or node verification");
-      for (unsigned int i = 0; i < treeNode->getNumChildren(); i++){
-	//	DEBUG("Checking child " << i);
-	if (satisfyNodeID(treeNode->getChild(i), shareIDs, goodShares)) {
-	  //	  DEBUG("child " << i << " passed");
-	  DEBUG("OR satisfied");
-	  addVector(satisfyingSharesIndices, goodShares);
-	  return true;
-	}
-      }
-      //      DEBUG("Fail: OR: all nodes are unsatisfied");
-      DEBUG("OR not satisfied");
-      satisfyingSharesIndices.clear();
-      return false;
-      break;
-    case InnerNodeType::THR:
-      DEBUG("THR node");
-      int nSat = 0;
-      int threshold = node->getThreshold();
-      unsigned int i = 0;
-      while ((nSat < threshold) && (i < treeNode->getNumChildren())){
-	ENHDEBUG("Threshold node. Checking child: " << i);
-	if (satisfyNodeID(treeNode->getChild(i), shareIDs, goodShares)) {	  
-	  //	  DEBUG("Satisfied");
-	  nSat++;
-	  addVector(satisfyingSharesIndices, goodShares);
-	} else {
-	  //	  DEBUG("not Satisfied");
-	}
-	i++;
-      }
-      if (nSat >= threshold) {
-	DEBUG("Threshold satisfied");
-	return true;
-      }
-      DEBUG("Fail: Threshold - insufficient nodes satisfied");
-      satisfyingSharesIndices.clear();
-      DEBUG("Threshold not satisfied");
-      return false; break;
-      //default: return false;break;
+// the leaves of treeNode are numbered in the order of distribution, as the policy would do it if treeNode were its tree
+bool ShTreeAccessPolicy::satisfyNodeID(shared_ptr<TreeNode> treeNode, const vector<ShareID>& shareIDs, vector<int> &satisfyingSharesIndices){ 
+  CompiledTree compiled(treeNode);
+  vector<int> sharePositions(compiled.getNumLeaves(), -1);
+  for (unsigned int i = 0; i < shareIDs.size(); i++) {
+    unsigned int index = shareIDs[i].getIndex();
+    if ((index < sharePositions.size()) && (sharePositions[index] < 0)) {
+      sharePositions[index] = i;
     }
   }
-  //  DEBUG("Fail: Default case - not leaf, not inner node");
-  satisfyingSharesIndices.clear();
-  return false;
+  return compiled.satisfy(sharePositions, satisfyingSharesIndices);
 }
 
 
@@ -216,351 +557,311 @@ shared_ptr<TreeNode> ShTreeAccessPolicy::parsePolicy() {
   return parseTreeFromExpression(m_description);
 }
 
-shared_ptr<TreeNode> ShTreeAccessPolicy::parseTreeFromExpression(std::string expr) {
-  //  DEBUG("Parse Tree From Expression");
-  //  ENHDEBUG("Expression: " << expr);
-  // try to parse string as an int.   
-  // this code can be changed in the future to something more general, if I decide to change the representation of participants to something else than integers
-  if (expr == "") {
-    shared_ptr<TreeNode> pTree = make_shared<TreeNode>();
-    return pTree;
-  }
-  try {
-    int leafValue = convertStrToInt(expr);
-    //    DEBUG("Create Leaf node: " << leafValue);
-    // If possible, create a leaf node with that value  
-    shared_ptr<NodeContent> newNode = NodeContent::makeLeafNode(leafValue);
-    shared_ptr<TreeNode> pTree = TreeNode::makeTree(newNode);
-    //    DEBUG("Leaf ID: " << pTree->getNodeID());
-    return pTree;
-  } catch (std::exception &e) {
-    // if not possible, look for string until "("    
-    size_t start_index = expr.find("(");
-    if (start_index == std::string::npos) {
-      stringstream ss(ERR_BAD_POLICY);
-      ss << ": Could not parse policy: it is not a literal but does not have [ op( ] " << "(" << expr << ")" << std::endl;
-      throw std::runtime_error(ss.str());
-    }
-    std::string op = expr.substr(0,start_index);
-    
-    // check it is an operator
-    if (!( (op == op_OR) || (op == op_AND) || (op == op_THR))) { 
-      stringstream ss(ERR_BAD_POLICY);
-      ss << ": Could not parse ShTreeAccessPolicy: operator not recognized: " << op  << "(" << expr << ")" << std::endl;
-      throw std::runtime_error(ss.str());
-    }
-    // find the whole sub-expression of operator arguments
-    size_t end_index = expr.rfind(")");
-    if (end_index == std::string::npos) {
-      stringstream ss(ERR_BAD_POLICY);
-      ss << ": Could not parse policy: it is not a literal but does not have a closing [ ) ]" << "(" << expr << ")" << std::endl;
-      throw std::runtime_error(ss.str());
-    }
-    if (end_index != expr.length()-1) {
-      stringstream ss;
-      ss << ": Could not parse policy: there is content beyond last [ ) ]" << "(" << expr << ")" << std::endl;
-      throw std::runtime_error(ss.str());
-    }
-    //start: 4
-    //end: 10
-    //string: 5 to 9
-    //number chars: 9 - 5 + 1 = 5 = end-1-(start+1)+1 = end-1-start-1+1 = end - start - 1
-    std::string sub_expr = expr.substr(start_index+1, end_index - start_index - 1);
-    //ENHDEBUG("sub-expression to tokenize: " << sub_expr);
-    // parse sub-expression into tokens, separated by ","
-    vector<std::string> tokens;
-    exprTokenize(sub_expr, tokens, ",","(",")");
-    // create a node for the correct operator
-    shared_ptr<NodeContent> newNode = NodeContent::makeNILNode(); // default initialization
-    int arity = tokens.size();
-    if (op == op_OR) {
-      newNode = NodeContent::makeThreshNode(arity,1);
-    }
-    if (op == op_AND) {
-      newNode = NodeContent::makeThreshNode(arity, arity);
-    }
-    if (op == op_THR) {
-      if (tokens.size() < 2) {
-	stringstream ss(ERR_BAD_POLICY);
-	ss << ": Threshold gate with missing arguments" << std::endl;
-	throw std::runtime_error(ss.str());
-      }
-      int threshold = convertStrToInt(tokens[0]); // throws exception if token is not a number
-      newNode = NodeContent::makeThreshNode(arity - 1, threshold); // first element in the argument list is the threshold
-    }    
-    shared_ptr<TreeNode> pTree = TreeNode::makeTree(newNode);
-    //    DEBUG("create inner node: " << pTree->to_string());
-    //    DEBUG("nodeID: " << pTree->getNodeID());
-    // obtain the corresponding tree for each token and append it to the children of the tree
-
-    if (op != op_THR) {
-      for (unsigned int i = 0; i < tokens.size(); i++) {
-	shared_ptr<TreeNode> child = parseTreeFromExpression(tokens[i]);
-	//	DEBUG("Adding new child. Current version: " << pTree->to_string() << " -- child: " << child->to_string());
-	pTree->appendTree(child);
-	//	DEBUG("Added new child. Current version: " << pTree->to_string());
-      }
-    } else {
-      for (unsigned int i = 1; i < tokens.size(); i++) {
-	shared_ptr<TreeNode> child = parseTreeFromExpression(tokens[i]);
-	//	DEBUG("Adding new child. Current version: " << pTree->to_string() << " -- child: " << child->to_string());
-	pTree->appendTree(child);
-	//	DEBUG("Added new child. Current version: " << pTree->to_string());
-      }
-    }
-    return pTree;
-  }
+shared_ptr<TreeNode> ShTreeAccessPolicy::parseTreeFromExpression(const std::string& expr) {
+  TreeArena arena;
+  parseIntoArena(expr, arena);
+  return arena.toTree();
 }
 
-void ShTreeAccessPolicy::obtainCoveredFrags(const vector<int> &atts, vector<int> &attFragIndices, vector<int> &keyFragIndices, vector<std::string> &coveredShareIDs) const {
-  int count = 0; // needed, because count is passed as reference to the next function
-  obtainCoveredFragsRec(count, m_treePolicy, atts, attFragIndices, keyFragIndices, coveredShareIDs);
+void ShTreeAccessPolicy::parseIntoArena(const std::string& expr, TreeArena& arena) {
+  arena.clear();
+  PolicyParser parser(expr);
+  vector<unsigned int> pending;
+  parseNode(parser, arena, pending);
+  parser.expectEnd();
 }
 
-void ShTreeAccessPolicy::obtainCoveredFragsRec(int &count, shared_ptr<TreeNode> tree, const vector<int> &atts, vector<int> &attFragIndices, vector<int> &keyFragIndices, vector<std::string> &coveredShareIDs) const {
-//  attFragIndices.clear();
-//  keyFragIndices.clear();
-//  coveredShareIDs.clear();
+// parses one expression at the cursor of the parser and returns its position in the arena. The children of a gate are added before the gate, which
+// needs them all. They wait in pending, above the children of the enclosing gates, so that one vector serves every level of the descent.
+// An empty expression, at the top or as an argument of a gate, is a NIL node
+unsigned int ShTreeAccessPolicy::parseNode(PolicyParser& parser, TreeArena& arena, vector<unsigned int>& pending) {
+  if (parser.atEnd() || parser.peek(',') || parser.peek(')')) {
+    return arena.addNil();
+  }
+  // this code can be changed in the future to something more general, if I decide to change the representation of participants to something else than integers
+  if (parser.peekInteger()) {
+    return arena.addLeaf(parser.parseInteger());
+  }
 
-  shared_ptr<NodeContent> node = tree->getNode();
-  if (node->getType() == NodeContentType::nil) {  
-    return;
+  InnerNodeType type = InnerNodeType::OR;
+  if (parser.acceptOperator(op_OR)) {
+    type = InnerNodeType::OR;
+  } else if (parser.acceptOperator(op_AND)) {
+    type = InnerNodeType::AND;
+  } else if (parser.acceptOperator(op_THR)) {
+    type = InnerNodeType::THR;
+  } else {
+    parser.fail("operator not recognized: " + parser.nextWord());
   }
+  parser.expect('(');
+
+  // the first element in the argument list of a threshold gate is the threshold
+  int threshold = 0;
+  size_t thresholdPos = parser.position();
+  if (type == InnerNodeType::THR) {
+    threshold = parser.parseInteger();
+    if (!parser.accept(',')) {
+      parser.fail("threshold gate with missing arguments");
+    }
+  }
+
+  unsigned int base = pending.size();
+  do {
+    unsigned int child = parseNode(parser, arena, pending);
+    pending.push_back(child);
+  } while (parser.accept(','));
+  parser.expect(')');
+
+  int arity = pending.size() - base;
+  switch (type) {
+  case InnerNodeType::OR: threshold = 1; break;
+  case InnerNodeType::AND: threshold = arity; break;
+  case InnerNodeType::THR:
+    if ((threshold < 0) || (threshold > arity)) {
+      parser.fail("threshold " + convertIntToStr(threshold) + " is not between 0 and the arity " + convertIntToStr(arity), thresholdPos);
+    }
+    break;
+  }
+  // every gate is a threshold gate, as the schemes share with threshold polynomials
+  unsigned int n = arena.addGate(InnerNodeType::THR, threshold, &pending[base], arity);
+  pending.resize(base);
+  return n;
+}
 
-  if (node->getType() == NodeContentType::leaf) {
-    int att_index = node->getLeafValue();
-    std::string shareID = tree->getNodeID();
-    int n = contains(atts, att_index);
+void ShTreeAccessPolicy::obtainCoveredFrags(const CoveredSet &covered, vector<int> &attFragIndices, vector<int> &keyFragIndices, vector<ShareID> &coveredShareIDs) const {
+  for (unsigned int i = 0; i < m_compiled.getNumLeaves(); i++) {
+    const CompiledTree::Node &leaf = m_compiled.getNode(m_compiled.getLeafNode(i));
+    int n = covered.position(leaf.leafValue);
     if (n >= 0) {
-      keyFragIndices.push_back(count);
+      keyFragIndices.push_back(i);
       attFragIndices.push_back(n);
-      coveredShareIDs.push_back(shareID);
+      coveredShareIDs.push_back(ShareID(i, leaf.childNo));
     }
-    count++;
-  } else {
-    for (unsigned int i = 0; i < tree->getNumChildren(); i++){
-	obtainCoveredFragsRec(count, tree->getChild(i), atts, attFragIndices, keyFragIndices, coveredShareIDs);
-    }      
   }
 }
 
+std::string ShTreeAccessPolicy::renderShareID(const ShareID& id) const {
+  if (id.getIndex() >= m_compiled.getNumLeaves()) {
+    return AccessPolicy::renderShareID(id);
+  }
+  // the path is found from the leaf up, and written from the root down
+  const CompiledTree::Node &leaf = m_compiled.getNode(m_compiled.getLeafNode(id.getIndex()));
+  vector<int> path;
+  const CompiledTree::Node *node = &leaf;
+  while (node->parent >= 0) {
+    path.push_back(node->childNo);
+    node = &m_compiled.getNode(node->parent);
+  }
+  std::string rendered = "0";
+  for (int i = path.size() - 1; i >= 0; i--) {
+    rendered += ":" + convertIntToStr(path[i]);
+  }
+  return rendered + ":=" + convertIntToStr(leaf.leafValue);
+}
+
 shared_ptr<TreeNode>& ShTreeAccessPolicy::getPolicy(){
+  std::lock_guard<std::mutex> lock(m_treeMutex);
+  if (!m_treePolicy) {
+    m_treePolicy = parsePolicy();
+  }
   return m_treePolicy;
 }
 
-bool ShTreeAccessPolicy::extractPrefixAndNoFromID(std::string& shareID, std::string& prefix, int& childNo) {
-  int n = shareID.find(":");
-  if (n == -1) return false;
-  int m = shareID.find(":", n+1);
-  if (m == -1) return false;
-  int p = shareID.find(":=");
-  if (p < m) return false;
-  prefix = shareID.substr(0, n+1);
-  childNo = convertStrToInt(shareID.substr(n+1, m-n-1));
-  shareID = shareID.substr(n+1);
-  return true;
+shared_ptr<TreeNode> ShTreeAccessPolicy::getTreeIfParsed() const {
+  std::lock_guard<std::mutex> lock(m_treeMutex);
+  return m_treePolicy;
 }
 
-void ShTreeAccessPolicy::storeSharePrefixes(std::map<std::string, vector<int> >& setChildNos, std::string& shareID) {
-  std::string ID = shareID;
-  std::string prefix;
-  std::string oldprefix = "";
-  int childNo;
-  std::map<std::string, vector<int> >::iterator it;
-  while (extractPrefixAndNoFromID(ID, prefix, childNo)) {
-    prefix = oldprefix + prefix;
-    it = setChildNos.find(prefix);
-    if (it == setChildNos.end()) { // prefix does not exist in map
-      vector<int> vec;
-      vec.push_back(childNo);     
-      setChildNos[prefix] = vec;
-    } else { // see if childNo is already part of the prefix's vector. If not, add it
-      vector<int> vec = it->second;
-      ENHDEBUG("current vector in " + prefix);
-      debugVector("vec", vec);
-      DEBUG("ChildNo: " << childNo);
-      int n = contains(vec, childNo);
-      if (n == -1) {
-	DEBUG("Adding a new element: " << childNo);
-	vec.push_back(childNo);
-      } else {
-	DEBUG("No change in vector: ");
-      }
-      setChildNos[prefix] = vec;
-      ENHDEBUG("current vector in " + prefix);
-      debugVector("vec", vec);
-    }      
-    oldprefix = prefix;
-  }  
+void ShTreeAccessPolicy::writeBinary(BinaryWriter &out) const {
+  out.putString(m_description);
+  out.putInts(m_participants);
+  m_compiled.writeBinary(out);
 }
 
-Big ShTreeAccessPolicy::findFinalCoefficient(const std::string& shareID,  std::map<std::string,  vector<int> >& setChildNos, 
-				   std::map<std::string, vector<Big> >& setCoeffs, const Big& order) {
-  Big acc = 1;
-  std::string tempID = shareID;
-  std::string prefix;
-  int childNo;
-  std::string oldprefix = "";
-  ENHDEBUG("findFinalCoefficient. shareID: " << shareID);
-  while (extractPrefixAndNoFromID(tempID, prefix, childNo)) {
-    prefix = oldprefix + prefix;
-    ENHDEBUG("findFinalCoefficient. Prefix: " << prefix);
-    ENHDEBUG("findFinalCoefficient. tempID: " << tempID);
-    ENHDEBUG("findFinalCoefficient. childNo: " << childNo);
-    vector<int> childNos = setChildNos[prefix];
-    vector<Big> coeffs = setCoeffs[prefix];
-    debugVector("childNos", childNos);
-    debugVector("coeffs", coeffs);
-
-    int n = contains(childNos, childNo);
-    DEBUG("n: " << n);
-    guard("findFinalCoefficient: all prefixes found should be in map. " + prefix + "[" + prefix + "]", n >= 0);
-    Big coeff = coeffs[n];
-    DEBUG("coeff to multiply: " << coeff);
-    acc = modmult(acc, coeff, order);
-    oldprefix = prefix;
-  }
-  return acc;
+shared_ptr<ShTreeAccessPolicy> ShTreeAccessPolicy::readBinary(BinaryReader &in) {
+  std::string description = in.getString();
+  vector<int> parts;
+  in.getInts(parts);
+  CompiledTree compiled = CompiledTree::readBinary(in);
+  return make_shared<ShTreeAccessPolicy>(description, parts, compiled);
 }
 
-/*
-Simple approach:
-- place all shares in the map, organized by prefix. Instead of storing the share, store its child number. 
-- everytime a new prefix is stored, also create an entry for its predecessors that are not yet in the map, with the position it occupies in it.
+const CompiledTree& ShTreeAccessPolicy::getCompiledTree() const {
+  return m_compiled;
+}
 
-Example shares:
+shared_ptr<CoefficientCache> ShTreeAccessPolicy::getCoefficientCache() const {
+  return m_coeffCache;
+}
 
-0:1:0:=2
-0:1:1:=3
-0:1:2:=4
+shared_ptr<ShamirAccessPolicy> ShTreeAccessPolicy::getFlatPolicy() const {
+  return m_flat;
+}
 
-0:2:1:=2
+// the sets of threshold children of a gate are enumerated as the bit masks of arity bits with threshold bits set. Gates with the same arity and
+// threshold have the same sets, and the cache records which pairs were filled, so each pair is only done once for all the copies of the policy
+void ShTreeAccessPolicy::fillCoefficients(const Big& order, unsigned int arity, unsigned int threshold) const {
+  // the sets are enumerated as masks of arity bits, which only the arities up to PRECOMPUTED_ARITY keep within an unsigned int and within the cache
+  if ((arity > PRECOMPUTED_ARITY) || (threshold == 0) || (threshold > arity) || !m_coeffCache->claimFill(order, arity, threshold)) return;
+  LagrangeEngine engine(order, arity);
+  vector<int> childNos;
+  vector<Big> coeffs;
+  for (unsigned int mask = 0; mask < (1U << arity); mask++) {
+    if ((unsigned int) __builtin_popcount(mask) != threshold) continue;
+    childNos.clear();
+    for (unsigned int i = 0; i < arity; i++) {
+      if ((mask >> i) & 1) childNos.push_back(i);
+    }
+    computeLagrangeCoefficientsChildNos(childNos, engine, coeffs);
+    m_coeffCache->insert(order, arity, childNos, coeffs);
+  }
+}
 
-0:2:2:1:=4
+// a flat policy computes its coefficients with the tables of its own engine, and does not use the cache
+void ShTreeAccessPolicy::precomputeCoefficients(const Big& order, unsigned int maxArity) const {
+  if (m_flat) {
+    m_flat->getEngine(order);
+    return;
+  }
+  if (maxArity > PRECOMPUTED_ARITY) maxArity = PRECOMPUTED_ARITY;
+  for (unsigned int g = 0; g < m_compiled.getNumGates(); g++) {
+    const CompiledTree::Node &gate = m_compiled.getNode(m_compiled.getGateNode(g));
+    if (gate.numChildren <= maxArity) {
+      fillCoefficients(order, gate.numChildren, gate.threshold);
+    }
+  }
+}
 
-This leads to the following map:
+/*
+Each share is the last step of a path of (gate, child number) pairs that goes from the root to its leaf. The coefficient of a share is the product of the
+Lagrange coefficients of each step, where the coefficient of a step depends on which other children of the same gate are used.
+
+So, first collect for each gate the children that lead to some share. These are found by going up from each leaf, until the root, or until a gate
+that was already reached through the same child, since the rest of the path has then already been collected.
+Then, compute the Lagrange coefficients of each gate for its children, and finally multiply, for each share, the coefficients along its path.
 
-0:1:0:=2:
-	"0:1" ---> {0}
-	"0" ---> {1}
+Example shares:
+
+0:1:0:=2
 0:1:1:=3
-	"0:1" ---> {0,1}
-	"0" ---> {1} (no change)
 0:1:2:=4
-	"0:1" ---> {0,1,2}
-	"0" ---> {1} (no change)
 0:2:1:=2
-	"0:1" ---> {0,1,2} (no change)
-	"0" ---> {1,2} 
-	"0:2" ---> {1}
-0:2:2:1:=4
-	"0:2:2" ---> {1}
-	"0:1" ---> {0,1,2} (no change)
-	"0" ---> {1,2} (no change)
-	"0:2" ---> {1,2}
-
-Now, we can traverse the map and compute the coefficients as we go.
-For future expansion, it is better to create a different map that has prefixes as keys and vectors of coefficients as values. For each prefix, we compute the corresponding vector of coefficients and store it in the new map.
-Finally, we look at each share and proceed from the beginning, each time extracting a prefix and its position in it to obtain a coefficient, then multiplying that with an accumulator.
-
-Example:
-
-map of coefficients:
-
-"0" ---> [c1_1, c1_2]
-"0:1" ---> [c2_1, c2_2, c2_3]
-"0:2" ---> [c3_1, c3_2]
-"0:2:2" ---> [c4_1]
-
 0:2:2:1:=4
 
-Prefix "0" ---> {1,2} / [c1_1, c1_2] 
-Position 2 ---> find index (1) in set, retrieve coefficient (1): c1_2
+With gates "0", "0:1", "0:2" and "0:2:2", this leads to the child numbers:
 
-Prefix "0:2" ---> {1,2} / [c3_1, c3_2]
-Position 2 ---> find index (1) in set, retrieve coefficient (1): c3_2
-
-Prefix "0:2:2" ---> {1} / [c4_1]
-Position 1 ---> find index (0) in set, retrieve coefficient (1): c4_1
+"0" ---> {1,2}
+"0:1" ---> {0,1,2}
+"0:2" ---> {1,2}
+"0:2:2" ---> {1}
 
+and the coefficient of 0:2:2:1:=4 is the coefficient of child 2 in "0", times the coefficient of child 2 in "0:2", times the coefficient of child 1 in "0:2:2".
 */
-vector<Big> ShTreeAccessPolicy::findCoefficients(const vector<std::string> shareIDs, const Big& order) const {
-  vector<Big> coeffs;
-
-  std::map<std::string, vector<int> > setChildNos;
-  std::map<std::string, vector<Big> > setCoeffs;
-
+void ShTreeAccessPolicy::collectGateChildNos(const vector<ShareID>& shareIDs, vector<vector<int> >& gateChildNos) const {
+  gateChildNos.assign(m_compiled.getNumGates(), vector<int>());
   for (unsigned int i = 0; i < shareIDs.size(); i++) {
-    std::string shareID = shareIDs[i];
-    ShTreeAccessPolicy::storeSharePrefixes(setChildNos, shareID);
-  }
-
-  Big coeff;
-  vector<Big> vec_coeffs;
-  for (std::map<std::string, vector<int> >::iterator it=setChildNos.begin(); !(it==setChildNos.end()); ++it) {
-    vector<int> childNos = it->second;
-    DEBUG("computing lagrange coefficients for childNos");
-    debugVector("childNos", childNos);
-    vec_coeffs.clear();
-    for (unsigned int i = 0; i < childNos.size(); i++) {
-      coeff = ShTreeAccessPolicy::computeLagrangeCoefficientChildNos(i, childNos, order);
-      DEBUG("lagrange coeff for " << i << ": " << coeff);
-      vec_coeffs.push_back(coeff);
+    unsigned int leaf = shareIDs[i].getIndex();
+    guard("collectGateChildNos: share identifier beyond the leaves of the policy", leaf < m_compiled.getNumLeaves());
+    const CompiledTree::Node *node = &m_compiled.getNode(m_compiled.getLeafNode(leaf));
+    while (node->parent >= 0) {
+      const CompiledTree::Node &gate = m_compiled.getNode(node->parent);
+      if (contains(gateChildNos[gate.gateNo], node->childNo) >= 0) break;
+      gateChildNos[gate.gateNo].push_back(node->childNo);
+      node = &gate;
     }
-    guard("coefficients vector should have the same size as childNos", vec_coeffs.size() == childNos.size());
-    setCoeffs[it->first] = vec_coeffs;
   }
-  ENHDEBUG("===================================");
+}
 
-  ENHDEBUG("findCoefficients");
-  debugVector("shareIDs", shareIDs);
-  DEBUG("...");
+void ShTreeAccessPolicy::gateCoefficients(const CompiledTree::Node& gate, const vector<int>& childNos, const Big& order, unsigned int maxPoints,
+					  shared_ptr<LagrangeEngine>& engine, vector<Big>& coeffs) const {
+  unsigned int arity = gate.numChildren;
+  if (m_coeffCache->find(order, arity, childNos, coeffs)) return;
+  if ((childNos.size() == gate.threshold) && (arity <= PRECOMPUTED_ARITY)) {
+    fillCoefficients(order, arity, gate.threshold);
+    if (m_coeffCache->find(order, arity, childNos, coeffs)) return;
+  }
+  DEBUG("computing lagrange coefficients for a gate of arity " << arity);
+  debugVector("childNos", childNos);
+  if (!engine) {
+    engine = make_shared<LagrangeEngine>(order, maxPoints);
+  }
+  computeLagrangeCoefficientsChildNos(childNos, *engine, coeffs);
+  m_coeffCache->insert(order, arity, childNos, coeffs);
+}
 
+void ShTreeAccessPolicy::findCoefficients(const vector<ShareID>& shareIDs, const Big& order, vector<Big>& coeffs) const {
+  if (m_flat) {
+    m_flat->findCoefficients(shareIDs, order, coeffs);
+    return;
+  }
+  vector<vector<int> > gateChildNos;
+  collectGateChildNos(shareIDs, gateChildNos);
 
-  ENHDEBUG("findCoefficients: contents of maps");
-  for (std::map<std::string, vector<int> >::iterator it=setChildNos.begin(); !(it==setChildNos.end()); ++it) {
-    DEBUG("childNos: " << it->first);
+  unsigned int maxPoints = 0;
+  for (unsigned int g = 0; g < gateChildNos.size(); g++) {
+    maxPoints = std::max(maxPoints, (unsigned int) gateChildNos[g].size());
   }
-  for (std::map<std::string, vector<Big> >::iterator it=setCoeffs.begin(); !(it==setCoeffs.end()); ++it) {
-    DEBUG("coeffs: " << it->first);
+  shared_ptr<LagrangeEngine> engine; // only built if some set is not in the cache
+
+  vector<vector<Big> > gateCoeffs(gateChildNos.size());
+  for (unsigned int g = 0; g < gateChildNos.size(); g++) {
+    if (gateChildNos[g].empty()) continue;
+    gateCoefficients(m_compiled.getNode(m_compiled.getGateNode(g)), gateChildNos[g], order, maxPoints, engine, gateCoeffs[g]);
   }
+
+  coeffs.resize(shareIDs.size());
+  BigScope scope;
+  Big& acc = scope.get();
   for (unsigned int i = 0; i < shareIDs.size(); i++) {
-    std::string shareID = shareIDs[i];
-    Big coeff = ShTreeAccessPolicy::findFinalCoefficient(shareID, setChildNos, setCoeffs, order);
-    coeffs.push_back(coeff);
+    const CompiledTree::Node *node = &m_compiled.getNode(m_compiled.getLeafNode(shareIDs[i].getIndex()));
+    acc = 1;
+    while (node->parent >= 0) {
+      const CompiledTree::Node &gate = m_compiled.getNode(node->parent);
+      int n = contains(gateChildNos[gate.gateNo], node->childNo);
+      guard("findCoefficients: every step of the path of a share should have been collected", n >= 0);
+      acc = modmult(acc, gateCoeffs[gate.gateNo][n], order);
+      node = &gate;
+    }
+    coeffs[i] = acc;
   }
 
-  ENHDEBUG("Returning coeffs");
   debugVector("coeffs to return", coeffs);
-  ENHDEBUG("Printed coeffs to return");
-  return coeffs;
 }
 
-int ShTreeAccessPolicy::extractChildNoFromID(std::string& shareID) {
-  int n0 = shareID.rfind(":=");
-  int n1 = shareID.rfind(":", n0-1);
-  if (n1 == -1) {
+int ShTreeAccessPolicy::extractChildNoFromID(const ShareID& shareID) {
+  if (shareID.isRootShare()) {
     stringstream ss(ERR_BAD_SHARE);
-    ss << "Bad share received. It is a root share: " + shareID;
+    ss << "Bad share received. It is a root share: " + shareID.to_string();
     throw std::runtime_error(ss.str());	  
   }
-  int index = convertStrToInt(shareID.substr(n1+1, n0-n1-1));
-  return index;
+  return shareID.getChildNo();
 }
 
 Big ShTreeAccessPolicy::computeLagrangeCoefficient(unsigned int shareIndex, vector<ShareTuple>& witnessShares, const Big& order) {
   vector<int> childNos;
   for (unsigned int i = 0; i < witnessShares.size(); i++) {
-    std::string shareID = witnessShares[i].getShareID();
-    int index = extractChildNoFromID(shareID);
-    childNos.push_back(index);
+    childNos.push_back(extractChildNoFromID(witnessShares[i].getShareID()));
   }
   return computeLagrangeCoefficientChildNos(shareIndex, childNos, order);
 }
 
+void ShTreeAccessPolicy::computeLagrangeCoefficientsChildNos(const vector<int>& witnessChildNos, const LagrangeEngine& engine, vector<Big>& coeffs) {
+  vector<int> points;
+  points.reserve(witnessChildNos.size());
+  for (unsigned int i = 0; i < witnessChildNos.size(); i++) {
+    int point = ShTreeAccessPolicy::extractPublicInfoFromChildNo(witnessChildNos[i]);
+    guard("Participant index must be positive", point > 0);
+    points.push_back(point);
+  }
+  engine.coefficients(points, coeffs);
+}
+
 Big ShTreeAccessPolicy::computeLagrangeCoefficientChildNos(unsigned int shareIndex, vector<int>& witnessChildNos, const Big& order) {
-  Big z=1;
-  Big shareCoef;
+  BigScope scope;
+  Big& z = scope.get();
+  Big& num = scope.get();
+  Big& den = scope.get();
+  z = 1;
 
   ENHDEBUG("Lagrange coefficient");
   debugVector("childNos", witnessChildNos);
@@ -576,9 +877,14 @@ Big ShTreeAccessPolicy::computeLagrangeCoefficientChildNos(unsigned int shareInd
     
     DEBUG("varying share: " << tempIndex);
     
-    shareCoef = moddiv(order - tempIndex,(Big)(order + index - tempIndex),order);
-    DEBUG("Multiplying term: " << shareCoef);
-    z=modmult(z,shareCoef,order);
+    // term: (0 - tempIndex) / (index - tempIndex), with both sides moved to positive values
+    num = order;
+    num -= tempIndex;
+    den = order;
+    den += index - tempIndex;
+    num = moddiv(num, den, order);
+    DEBUG("Multiplying term: " << num);
+    z = modmult(z, num, order);
   }
   return z;
 }
@@ -596,7 +902,9 @@ void ShTreeSS::initPolicy(){
     
 void ShTreeSS::init(){
   initPolicy();
-  manageRandomness(RandomnessActions::init);
+  if (i_policy->getFlatPolicy()) {
+    i_flat = make_shared<ShamirSS>(i_policy->getFlatPolicy(), m_order, m_pfc);
+  }
 }
   
 ShTreeSS::ShTreeSS(shared_ptr<ShTreeAccessPolicy>  policy, PFC &pfc):
@@ -611,430 +919,142 @@ ShTreeSS::ShTreeSS(shared_ptr<ShTreeAccessPolicy>  policy, const Big &order, PFC
   init();
 }
 
-void ShTreeSS::manageRandomness(RandomnessActions action, shared_ptr<TreeNode> root, int &count) {  
-  //  ENHDEBUG("inside manageRandomness.");
-
-//   if (action == RandomnessActions::init) {
-//     DEBUG("Operation: init");
-//   }
-// 
-//   if (action == RandomnessActions::randomize) {
-//     DEBUG("Operation: randomize");
-//     ENHDEBUG("randomness size: " << m_randomness.size());
-//   }
-
-  shared_ptr<NodeContent> node = root->getNode();
-  
-  if (root->isNil() || root->isLeaf()) {
-    return;
-  }
-
-  if (node->getInnerNodeType() != InnerNodeType::THR) {
-    stringstream ss(ERR_BAD_TREE);  
-    ss << ": ShTreeSS: ManageRandomness algorithm received a gate different from Threshold: " << node->to_string();
-    throw std::runtime_error(ss.str());
-  }
-
-  unsigned int arity = node->getArity();
-  unsigned int threshold = node->getThreshold();
-
-  for (unsigned int i = 0; i < threshold-1; i++){
-    if (action == RandomnessActions::init) {
-      m_randomness.push_back(0);
-    } else if (action == RandomnessActions::randomize){
-      m_pfc.random(m_randomness[count]);
-      count++;
-    }
-  }
-
-  for (unsigned int j=0;j<arity;j++) {     
-    shared_ptr<TreeNode> child = root->getChild(j);
-    if (child->isLeaf() || child->isNil()) {
-      continue;
-    }
-    
-    if (child->isInner()) {
-      DEBUG("calling manageRandomness for child");
-      manageRandomness(action, child, count);
-      continue;
-    }
-  }
-//   DEBUG("manageRandomness over");
-//   ENHDEBUG("m_randomness count: " << count);
-//   ENHDEBUG("m_randomness size: " << m_randomness.size());
-}
-
-void ShTreeSS::manageRandomness(RandomnessActions action) {  
-  int count = 0;
-  manageRandomness(action, i_policy->getPolicy(), count);
-}
-
-  // Need to review this after I start implementing distrib algorithms. Those will dictate the best way to use randomness
-  /*
-  int count = 0;
-  vector< vector<int> > &minimalSets = i_policy->getMinimalSets();
-  for (unsigned int i = 0; i < minimalSets.size(); i++) {
-    vector<int> set = minimalSets[i];
-    for (unsigned int j = 0; j < set.size()-1; j++) {
-      if (action == RandomnessActions::init) {
-	m_randomness.push_back(0);
-      } else if (action == RandomnessActions::randomize){
-	m_pfc.random(m_randomness[count]);
-	count++;
-      }
-    }
-  }
-  */
-
-
 // virtual inherited methods:
-vector<Big> ShTreeSS::getDistribRandomness() {  
-  return m_randomness;
-}
 
-std::vector<ShareTuple> ShTreeSS::distribute_random(const Big& s){
-  ENHDEBUG("Inside distribute_random");
-  DEBUG("Calling manageRandomness to randomize");
-  manageRandomness(RandomnessActions::randomize);
-  DEBUG("Calling distribute determ");
-  return distribute_determ(s, m_randomness);
+// every gate takes threshold-1 values of randomness, in the pre-order of the gates
+unsigned int ShTreeSS::getNumRandomness() {
+  return i_policy->getCompiledTree().getNumRandomness();
 }
 
-
-std::vector<ShareTuple> ShTreeSS::distribute_determ(shared_ptr<TreeNode> root, const Big& s, const vector<Big>& randomness, int &count){
-  ENHDEBUG("Inside distribute_determ");
-  vector<ShareTuple> shares;
-
-  shared_ptr<NodeContent> node = root->getNode();
-
-  DEBUG("got node");
-
-  if (root->isNil()) {
-    return shares;
+std::vector<ShareTuple> ShTreeSS::distribute_determ(const Big& s, const RandomnessSource& randomness){
+  if (i_flat) {
+    return i_flat->distribute_determ(s, randomness);
   }
 
-  if (root->isLeaf()) {
-    ShareTuple newShare(node->getLeafValue(), s, root->getNodeID());
-    shares.push_back(newShare);
+  // each node in the policy tree is a threshold node. distribution works by computing a share of the secret for each child of that node
+  // then, if the child is not a leaf, take its share as the new secret and repeat the process
+  // each distribution requires some share public information, that is simply going to be the index of the respective child for that tree
+  // this is therefore independent of the participant's value
+  // this applies normally even to the case where a participant receives several different shares
+  // The nodes are visited from the root down, which in the compiled tree is from the last node to the first. The share of each node is kept until
+  // its children have been given theirs, and the shares of the leaves are issued at the end, in the order of the leaves.
+  const CompiledTree &tree = i_policy->getCompiledTree();
+  vector<ShareTuple> shares;
+  if (tree.size() == 0) {
     return shares;
   }
-
-  if (node->getInnerNodeType() != InnerNodeType::THR) {
-    stringstream ss(ERR_BAD_TREE);  
-    ss << ": ShTreeSS: Distribution algorithm received a gate different from Threshold: " << node->to_string();
-    throw std::runtime_error(ss.str());
-  }
-
-  DEBUG("getting arity and threshold");
-  int arity = node->getArity();
-  unsigned int threshold = node->getThreshold();
-
-  Big acc; // cummulative sum for computing the polynomial
-  Big accX; // cummulative value for the variable power (x^i)
-  Big temp; // individual term a*x^i
-  int point;
-
-  vector<Big> poly(threshold);
-  poly[0]=s;
-  unsigned int base = count;
-  for (unsigned int i = 1; i < threshold; i++){
-    unsigned int index = base + i - 1;
-    guard("tried to access poly vector out of bounds", i < poly.size());
-    guard("tried to access randomness vector out of bounds", index < randomness.size());
-    poly[i] = randomness[index];
-    count++;
-  }
-
-//   debugVector("Poly", poly);
-//   debugVector("Randomness vector", randomness);
-//   DEBUG("threshold: " << threshold);
-//   DEBUG("arity: " << arity);
-//   DEBUG("order: " << m_order);
-
-  for (int j=0;j<arity;j++) {   
-    //    DEBUG("child: " << j);
-    point = j+1; // take notice: we should not have a point 0, because that would reveal the secret immediately as the share. 
-    // Reconstruction has to remember to include this +1 in its calculations
-    acc=poly[0]; accX=point;
-    DEBUG("computing powers for point: " << point);
-    for (unsigned int k=1;k<threshold;k++) { 
-      // evaluate polynomial a0+a1*x+a2*x^2... for x=point;
-      //      DEBUG("making mult");
-      temp = modmult(poly[k],(Big)accX,m_order); 
-      DEBUG("a" << k << ": " << poly[k]);
-      DEBUG("x^" << k << ": " << accX);
-      DEBUG("a" << k << " * x^" << k << ": " << temp);
-      //      DEBUG("adding term");
-      acc = (acc + temp + m_order) % m_order;
-      accX = modmult((Big) accX, point, m_order);
+  shares.reserve(tree.getNumLeaves());
+
+  BigScope scope;
+  vector<Big*> values(tree.size(), NULL); // the share of each node
+  vector<Big*> childValues;
+  vector<Big> coeffs; // the random coefficients of the polynomial of the current gate
+  values[tree.root()] = &scope.get();
+  *values[tree.root()] = s;
+
+  for (int n = tree.root(); n >= 0; n--) {
+    const CompiledTree::Node &node = tree.getNode(n);
+    if (node.kind != CompiledTree::gateNode) {
+      continue;
     }
-    DEBUG("final acc: " << acc);
-    
 
-    shared_ptr<TreeNode> child = root->getChild(j);
-    if (child->isNil()) {
-      continue;
+    // the coefficients of the polynomial are the secret, followed by the next threshold-1 values of randomness
+    unsigned int base = node.randomnessBase;
+    unsigned int degree = (node.threshold > 0) ? node.threshold - 1 : 0;
+    if (coeffs.size() < degree) {
+      coeffs.resize(degree);
+    }
+    if (degree > 0) {
+      randomness.get(base, degree, &coeffs[0]);
     }
 
-    if (child->isLeaf()) {
-      ShareTuple newShare(child->getNode()->getLeafValue(), acc, child->getNodeID());
-      shares.push_back(newShare);
-      continue;
+    // take notice: we should not have a point 0, because that would reveal the secret immediately as the share. 
+    // Child j receives the point j+1, and reconstruction has to remember to include this +1 in its calculations
+    childValues.resize(node.numChildren);
+    for (unsigned int j = 0; j < node.numChildren; j++) {
+      childValues[j] = &scope.get();
     }
-    
-    if (child->isInner()) {
-      vector<ShareTuple> childShares = distribute_determ(child, acc, randomness, count);
-      addVector(shares, childShares);
-      continue;
+    SharePolynomial::evaluateConsecutive(*values[n], coeffs.data(), degree, node.numChildren, m_order, childValues);
+    for (unsigned int j = 0; j < node.numChildren; j++) {
+      unsigned int child = tree.getChild(node, j);
+      if (tree.getNode(child).kind != CompiledTree::nilNode) {
+	values[child] = childValues[j];
+      }
     }
   }
-  ENHDEBUG("returning shares");
-  return shares;
-}
-  
-
-std::vector<ShareTuple> ShTreeSS::distribute_determ(const Big& s, const vector<Big>& randomness){
 
-  // each node in the policy tree is a threshold node. distribution works by computing a share of the secret for each child of that node
-  // then, if the child is not a leaf, take its share as the new secret and repeat the process
-  // each distribution requires some share public information, that is simply going to be the index of the respective child for that tree
-  // this is therefore independent of the participant's value
-  // this applies normally even to the case where a participant receives several different shares
-  int count = 0;
-  vector<ShareTuple> shares = distribute_determ(i_policy->getPolicy(), s, randomness, count);
+  for (unsigned int i = 0; i < tree.getNumLeaves(); i++) {
+    unsigned int n = tree.getLeafNode(i);
+    const CompiledTree::Node &leaf = tree.getNode(n);
+    shares.push_back(ShareTuple(leaf.leafValue, *values[n], ShareID(i, leaf.childNo)));
+  }
   return shares;
 }
 
          
-void ShTreeSS::updateSet(std::map<std::string, vector<ShareTuple> >& setShares, const std::string& prefix, ShareTuple& share) { 
-  vector<ShareTuple> set = setShares.find(prefix)->second;
-  set.push_back(share);
-  setShares[prefix] = set; 
-  // I have to include the previous line because the map has copies of vectors, not references for them. 
-  // So, after I add a new element to the vector, this is a different copy from the one in the map, which was not updated.
-  // I have to copy the new vector in the map
-  // The reason I don't have reference to vectors in the map is because such references would be created in addNewSet, by a temporary variable, and then point at
-  // deleted memory. Since I don't want static functions to do memory management, I preferred to take the performance hit with copying
-}
-
-      
-void ShTreeSS::addNewSet(std::map<std::string, vector<ShareTuple> >& setShares, const std::string& prefix, ShareTuple& share) { 
-  vector<ShareTuple> set;
-  set.push_back(share);
-  setShares[prefix] = set;
-}
-
-void ShTreeSS::putShareInSet(std::map<std::string, vector<ShareTuple> >& setShares, const std::string& prefix, ShareTuple& share) { 
-  std::map<std::string, vector<ShareTuple> >::iterator it;
-  it = setShares.find(prefix);
-  if (it == setShares.end()) {
-    addNewSet(setShares, prefix, share);
-  } else {
-    it->second.push_back(share);
-  }
-}
-
-std::string ShTreeSS::getSetPrefix(std::string& shareID) {
-  int n1 = shareID.rfind(":=");
-  int n2 = shareID.rfind(":", n1-1);
-  std::string result;  
-  if (n2 == -1) {
-    return "";
-  } else {
-    return shareID.substr(0, n2);
-  }
-}
-
-// int ShTreeSS::extractPublicInfoFromID(std::string& shareID) {
-//   return extractChildNoFromID(shareID) + 1;
-// }
-
-
-ShareTuple ShTreeSS::detailedReconstruction(vector<ShareTuple>& minimalShares, std::string& prefix, const Big& order){
-  Big sum = 0;
-  for (unsigned int i = 0; i < minimalShares.size(); i++) {
-    Big coeff = ShTreeAccessPolicy::computeLagrangeCoefficient(i, minimalShares, order);
-    Big term = modmult(minimalShares[i].getShare(),coeff,order);
-    sum = (sum + term); 
+/*
+  The secret is rebuilt from the root of the witness set up, in one pass over the compiled tree in post-order. The value of each leaf of the witness is its
+  share; the value of a gate is the combination of the values of its children that have one, with the Lagrange coefficients of those children, from the
+  cache of the policy. Every gate that has a value was chosen by the witness set, and uses exactly the children that the witness set chose for it, so the
+  value of the root is the secret.
+  The values are Bigs of the arena, reached from an array indexed by node, and the shares are read in place from the vector received.
+*/
+Big ShTreeSS::reconstruct(const vector<ShareTuple> shares){
+  if (i_flat) {
+    return i_flat->reconstruct(shares);
   }
-  sum = ((sum + order) % order);
-
-  std::string newShareID = TreeNode::findIDForNode(getSetPrefix(prefix), ShTreeAccessPolicy::extractChildNoFromID(prefix), NodeContentType::leaf, "?");
-  ShareTuple newShare(0, sum, newShareID);
-  return newShare;
-}
 
-  ShareTuple ShTreeSS::solveSet(std::map<std::string, vector<ShareTuple> >& setShares, std::string& prefix, const Big& order) { 
-  std::map<std::string, vector<ShareTuple> >::iterator it;
-  it = setShares.find(prefix);
-  vector<ShareTuple> minimalShares = it->second;      
-  setShares.erase(it);
-  ShareTuple share = detailedReconstruction(minimalShares, prefix, order);
-  return share;
-}
-
-ShareTuple ShTreeSS::reduceMapShares(std::string& prefix, const std::string& target, 
-			   std::map<std::string, vector<ShareTuple> >& setShares, const Big& order){
-  ShareTuple computedShare;
-  DEBUG("Prefix: " << prefix);
-  DEBUG("Target: " << target);
-  DEBUG("setShares size: " << setShares.size());
-  
-  while ( (prefix != target) && (setShares.size() > 0)) {
-    DEBUG("Inside While. Current Prefix: " << prefix << " -- target: " << target);
-    computedShare = ShTreeSS::solveSet(setShares, prefix, order);
-    DEBUG("computedShare: " << computedShare.to_string());
-    prefix = ShTreeSS::getSetPrefix(prefix);
-    if (prefix != "0") {
-    // still more work to do, so keep this share and loop again
-      ShTreeSS::putShareInSet(setShares, prefix, computedShare);
-    } else {
-      // we can't go above "0". We must get out.
-      break;
-    }
+  vector<ShareID> shareIDs;
+  shareIDs.reserve(shares.size());
+  for (unsigned int i = 0; i < shares.size(); i++) {
+    shareIDs.push_back(shares[i].getShareID());
   }
-
-  if (prefix != target) {
-    stringstream ss(ERR_BAD_TREE);
-    DEBUG("prefix: " << prefix);
-    DEBUG("target: " << target);
-    ss << ": Could not finish reconstruction. Reached the end of shares but did not finish computation." << std::endl;
-    throw std::runtime_error(ss.str());	      
+  vector<int> witness;
+  if (!i_policy->evaluateIDs(shareIDs, witness)) return -1;
+
+  const CompiledTree &tree = i_policy->getCompiledTree();
+  BigScope scope;
+  vector<Big*> values(tree.size(), NULL);
+  unsigned int maxPoints = 0; // the engine is only needed for sets of children that are not in the cache, which have at most threshold children
+  for (unsigned int i = 0; i < witness.size(); i++) {
+    unsigned int n = tree.getLeafNode(shareIDs[witness[i]].getIndex());
+    values[n] = &scope.get();
+    *values[n] = shares[witness[i]].getShare();
   }
-
-  if (setShares.size() > 0) {
-    stringstream ss(ERR_BAD_TREE);
-    DEBUG("prefix: " << prefix);
-    DEBUG("target: " << target);
-    ss << ": Could not finish reconstruction. Reached the top level, but still had more shares." << std::endl;
-    throw std::runtime_error(ss.str());	      
+  for (unsigned int g = 0; g < tree.getNumGates(); g++) {
+    maxPoints = std::max(maxPoints, tree.getNode(tree.getGateNode(g)).threshold);
   }
 
-  return computedShare;
-}
-
-
-  // a vector of shares will have shares at many different levels.
-  // deepest shares have longer prefixes, but all of them can be traced to root
-  // the plan is to find a set of shares at the lowest level, reduce them to find a share at the level above and replace those shares by the new share
-  // repeat until there is only one share left
-
-  // since we obtain our witnessShares vector from a controlled source (the evaluate function) we know the structure of the vector and we can use that to make
-  // shortcuts in the computation
-
-  // Example:
-  // 0:0:=
-  // 0:1:0:=
-  // 0:1:1:0:=
-  // 0:1:1:1:0:=
-  // 0:1:1:1:1:=
-  // 0:1:1:1:2:=
-  // 0:1:1:2:...
-
-  // when the new prefix is not a suffix of the current one, a part of the tree is solvable.
-  // then, we can gather the vector for that prefix, solve it and insert the new resulting share in the map
-  // if the new resulting share's prefix is also not a prefix of the current one, we can solve that prefix and so on, until we reach a point where these prefixes will be equal
-  // then we proceed until we have no more shares
-
-ShareTuple ShTreeSS::reduceLowestShares(const vector<ShareTuple>& shares, Big order) {
-  DEBUG("Inside Reduce");
-  debugVectorObj("shares in reduce", shares);
-  bool finished = false;
-  ShareTuple computedShare;
-  std::map<std::string, vector<ShareTuple> > setShares;
-  
-  std::string currentSetPrefix = "";
-  for (unsigned int i = 0; i < shares.size(); i++) {
-    DEBUG("Iteration: " << i);
-    ShareTuple share = shares[i];
-    std::string shareID = share.getShareID();
-    std::string setPrefix = ShTreeSS::getSetPrefix(shareID);
-
-    DEBUG("Before main IF: " << currentSetPrefix << " -- setPrefix: " << setPrefix);
-    if (currentSetPrefix == setPrefix) {  
-      DEBUG("calling updateSet");
-      // a new share in a set that has been previously found
-      ShTreeSS::updateSet(setShares, setPrefix, share);
-    } else if (isSuffix(currentSetPrefix, setPrefix)) { // if SetPrefix is a suffix of currentSetPrefix
-      DEBUG("calling addNewSet");
-      // a new set, that will contribute to solve the previous one
-      ShTreeSS::addNewSet(setShares, setPrefix, share);
-      currentSetPrefix = setPrefix;            
-    } else {
-      // a new set in a different subtree. Sets that come before can be solved until their prefix matches the new one
-      DEBUG("default: entering while");
-      computedShare = reduceMapShares(currentSetPrefix, setPrefix, setShares, order);
-      if (currentSetPrefix == "0") {
-	// should have found the share. Check other conditions that should be true
-	if ( (setShares.size() != 1) || (i < shares.size()-1) ) {
-	  stringstream ss(ERR_BAD_TREE);
-	  ss << ": Could not finish reconstruction. Reached root share, but there are still unprocessed shares." << std::endl;
-	  throw std::runtime_error(ss.str());	  
-	}
-	finished = true;
-	break;
-      }
-    }
-  }
-  if (!finished) {
-    // there's no more shares, setShares is complete and all nodes should be solvable
-    computedShare = reduceMapShares(currentSetPrefix, "0", setShares, order);
-  } 
-  return computedShare;
-}
-
-
-Big ShTreeSS::reconstruct_old(const vector<ShareTuple> shares){
-    vector<ShareTuple> witnessShares;
-    DEBUG("CALLING EVALUATE");
-    if (!i_policy->evaluate(shares, witnessShares)) return -1;
-    ENHDEBUG("FINISHED EVALUATE");
-
-    if (witnessShares.size() == 1) {
-      ENHDEBUG("Shortcut returning");
-      return witnessShares[0].getShare();
+  shared_ptr<LagrangeEngine> engine;
+  vector<int> childNos;
+  vector<Big*> childValues;
+  vector<Big> coeffs;
+  for (unsigned int n = 0; n < tree.size(); n++) {
+    const CompiledTree::Node &node = tree.getNode(n);
+    if (node.kind != CompiledTree::gateNode) {
+      continue;
     }
-
-    ShareTuple share = reduceLowestShares(shares, m_order);
-    ENHDEBUG("FINISHED REDUCE");
-    return share.getShare();
-    
-}
-
-
-Big ShTreeSS::reconstruct(const vector<ShareTuple> shares){
-    vector<ShareTuple> witnessShares;
-    DEBUG("CALLING EVALUATE");
-    if (!i_policy->evaluate(shares, witnessShares)) return -1;
-    ENHDEBUG("FINISHED EVALUATE");
-
-    if (witnessShares.size() == 1) {
-      ENHDEBUG("Shortcut returning");
-      return witnessShares[0].getShare();
+    childNos.clear();
+    childValues.clear();
+    for (unsigned int j = 0; j < node.numChildren; j++) {
+      Big *value = values[tree.getChild(node, j)];
+      if (value != NULL) {
+	childNos.push_back(j);
+	childValues.push_back(value);
+      }
     }
-//     DEBUG("CALLING REDUCE");
-//     debugVectorObj("shares", shares);
-//     debugVectorObj("witnessShares", witnessShares);
-//     DEBUG("====");
-    vector<std::string> shareIDs;
-    for (unsigned int i = 0; i < shares.size(); i++) {
-      //      DEBUG("adding shareID: " << shares[i].getShareID());
-      shareIDs.push_back(shares[i].getShareID());
+    if (childNos.empty()) {
+      continue;
     }
-    //    debugVector("shareIDs", shareIDs);
 
-    vector<Big> coeffs = i_policy->findCoefficients(shareIDs, getOrder());
-    
-    ENHDEBUG("Reconstruct:");
-    debugVector("coeffs", coeffs);
-    ENHDEBUG("Coeffs printed");
-    Big sum = 0;
-    for (unsigned int i = 0; i < shares.size(); i++) {
-      ENHDEBUG("i " << i);
-      Big term = modmult(coeffs[i], shares[i].getShare(), m_order);
-      sum = (sum + term) % m_order;
+    i_policy->gateCoefficients(node, childNos, m_order, maxPoints, engine, coeffs);
+    Big &sum = scope.get();
+    sum = 0;
+    for (unsigned int k = 0; k < childValues.size(); k++) {
+      sum += modmult(coeffs[k], *childValues[k], m_order);
     }
-    return sum;
-    
+    sum %= m_order;
+    values[n] = &sum;
+  }
+  return (values[tree.root()] != NULL) ? *values[tree.root()] : Big(-1);
 }
-
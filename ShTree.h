@@ -3,9 +3,12 @@
   Code by: Alexandre Miranda Pinto
 
   This file implements a specific Secret Sharing scheme: a tree of Shamir threshold schemes.
-  There are two classes implemented here: 
+  There are four classes implemented here: 
+  - CompiledTree is the parse tree of a policy lowered into flat arrays, over which the policy is evaluated
+  - CoefficientCache keeps the Lagrange coefficients of the sets of children already seen, for reuse by later decryptions
   - ShTreeAccessPolicy is a subclass of the abstract AccessPolicy
   - ShTreeSS is a subclass of the abstract SecretSharing
+  A policy that is a single gate over leaves is handed to the flat Shamir scheme of shamir.h, which gives the same shares without walking the tree.
 */
 
 #ifndef DEF_UTILS
@@ -20,48 +23,215 @@
 #include "tree.h"
 #endif
 
+#ifndef DEF_SHAMIR
+#include "shamir.h"
+#endif
+
 #define DEF_SH_TREE
 
+#include <mutex>
+#include <set>
+
+
+/*
+  Walking the parse tree means following shared_ptrs from node to node, and copying one at each step. The policy compiles its tree once into an array of
+  nodes in post-order, so that every child comes before its parent and the root is the last node. A pass from the first node to the last visits the tree
+  bottom-up, and a pass in the opposite direction visits it top-down.
+  The children of a gate are not contiguous in post-order, so each gate holds a range of the children array, which lists them from left to right.
+  Leaves are numbered in the order in which the shares are distributed, which is the index of their ShareID. Gates are numbered in pre-order, starting
+  with 0 for the root, and take their randomness for distribution in that same order.
+*/
+class CompiledTree {
+ public:
+  enum NodeKind {nilNode, leafNode, gateNode};
+
+  struct Node {
+    NodeKind kind;
+    unsigned int threshold; // gates: AND and OR are compiled as thresholds
+    unsigned int firstChild; // gates: the children are m_children[firstChild] to m_children[firstChild + numChildren - 1]
+    unsigned int numChildren;
+    int leafValue; // leaves: the attribute
+    int leafNo; // leaves: the number of the leaf. -1 for other nodes
+    int gateNo; // gates: the number of the gate. -1 for other nodes
+    int parent; // -1 for the root
+    int childNo; // the position of the node among the children of its parent, or ShareID::ROOT_SHARE for the root
+    unsigned int randomnessBase; // gates: the position of the first value of randomness used by the polynomial of the gate
+  };
+
+ private:
+  vector<Node> m_nodes;
+  vector<unsigned int> m_children;
+  vector<unsigned int> m_leaves; // the node of each leaf
+  vector<unsigned int> m_gates; // the node of each gate
+  unsigned int m_numGates;
+  unsigned int m_numRandomness;
+  StructuralHash m_hash;
+
+  unsigned int compileNode(const TreeArena& arena, unsigned int source, int childNo); // returns the position of the node
+  void computeHash();
+
+ public:
+  CompiledTree();
+  CompiledTree(shared_ptr<TreeNode> tree);
+  CompiledTree(const TreeArena& arena); // compiles the tree at the root of the arena
+
+  inline unsigned int size() const {
+    return m_nodes.size();
+  }
+  inline unsigned int root() const { // only valid if the tree is not empty
+    return m_nodes.size() - 1;
+  }
+  inline const Node& getNode(unsigned int n) const {
+    return m_nodes[n];
+  }
+  inline unsigned int getChild(const Node& gate, unsigned int i) const {
+    return m_children[gate.firstChild + i];
+  }
+  inline unsigned int getLeafNode(unsigned int leafNo) const {
+    return m_leaves[leafNo];
+  }
+  inline unsigned int getNumLeaves() const {
+    return m_leaves.size();
+  }
+  inline unsigned int getNumGates() const {
+    return m_numGates;
+  }
+  inline unsigned int getGateNode(unsigned int gateNo) const {
+    return m_gates[gateNo];
+  }
+  inline unsigned int getNumRandomness() const { // the number of random values that distribution takes
+    return m_numRandomness;
+  }
+
+  // the hash of the shape of the tree, its thresholds and its leaves. AND and OR gates are thresholds here, so they hash as the equivalent THR gates
+  inline StructuralHash getStructuralHash() const {
+    return m_hash;
+  }
+  bool operator==(const CompiledTree& rhs) const;
+
+  void writeBinary(BinaryWriter &out) const;
+  static CompiledTree readBinary(BinaryReader &in); // throws an ERR_BAD_SERIAL runtime_error if the input does not hold a consistent tree
+
+  // sharePositions holds, for each leaf, the position of its share in the list of received shares, or -1 if it was not received.
+  // Each satisfied gate contributes the shares of its first satisfied children, up to its threshold
+  bool satisfy(const vector<int> &sharePositions, vector<int> &satisfyingSharesIndices) const;
+};
+
+//=============================================================================
+
+/*
+  The Lagrange coefficients of a gate depend only on which of its children were used, and decryptions with the same key and similar ciphertexts use
+  the same children over and over. The cache keeps the coefficients of each set of children, keyed by the arity of the gate followed by the sorted child
+  numbers, and gives them back in the order in which the children were asked for.
+  Coefficients are only meaningful for one group order: the cache takes the order of its first entry, and ignores requests for any other one.
+  It also records which pairs of arity and threshold have had all their sets filled in, so that each pair is filled once for the order of the cache.
+  It is shared by every copy of a policy and by all threads, and a mutex guards every access. The number of entries is bounded by MAX_ENTRIES;
+  once it is full, new sets are computed but not kept.
+*/
+class CoefficientCache {
+  typedef std::map<vector<int>, vector<Big> > Table;
+
+  Table m_table;
+  std::set<std::pair<unsigned int, unsigned int> > m_filled; // the pairs of arity and threshold whose sets are all in the table
+  Big m_order;
+  bool m_hasOrder;
+  mutable std::mutex m_mutex;
+
+  // the key of a set of children, and for each position of the sorted set, the position of that child in childNos
+  static void makeKey(unsigned int arity, const vector<int>& childNos, vector<int>& key, vector<unsigned int>& positions);
+
+ public:
+  static const unsigned int MAX_ENTRIES = 1 << 16;
+
+  CoefficientCache();
+  bool find(const Big& order, unsigned int arity, const vector<int>& childNos, vector<Big>& coeffs) const; // false if the set is not in the cache
+  void insert(const Big& order, unsigned int arity, const vector<int>& childNos, const vector<Big>& coeffs);
+  // true for the first caller that asks to fill the pair for the order of the cache, who is then expected to insert its sets. False if the pair was
+  // already claimed, if the order is another one, or if the cache is full
+  bool claimFill(const Big& order, unsigned int arity, unsigned int threshold);
+  unsigned int size() const;
+  void clear();
+};
+
+//=============================================================================
 
 class ShTreeAccessPolicy : public AccessPolicy
 {
   std::string m_description; // to facilitate parsing, the description should be input in prefix, that is functional, notation.
+  // the parse tree is only needed by the callers of getPolicy. The policy works from its compiled tree, and parses the description into a parse tree
+  // the first time it is asked for one. The mutex guards that first parse
   shared_ptr<TreeNode> m_treePolicy;
+  mutable std::mutex m_treeMutex;
+  CompiledTree m_compiled; // compiled once by init or read back by readBinary, and used by every operation of the policy
+  StructuralHash m_hash;
+  shared_ptr<CoefficientCache> m_coeffCache;
+  // a tree that is a single gate over leaves is handed to a ShamirAccessPolicy, which evaluates it and finds its coefficients without the tree
+  shared_ptr<ShamirAccessPolicy> m_flat;
   void init();
+  StructuralHash hashPolicy() const;
+  static unsigned int parseNode(PolicyParser& parser, TreeArena& arena, vector<unsigned int>& pending);
+  shared_ptr<TreeNode> getTreeIfParsed() const;
+  void fillCoefficients(const Big& order, unsigned int arity, unsigned int threshold) const; // every set of threshold children of the arity, if not claimed
 
- protected:
-  void obtainCoveredFragsRec(int &count, shared_ptr<TreeNode> tree, const vector<int> &atts, vector<int> &attFragIndices, vector<int> &keyFragIndices, vector<std::string> &coveredShareIDs) const;
  public:
-  static bool satisfyNodeID(shared_ptr<TreeNode> treeNode, vector<std::string> shareIDs, vector<int> &satisfyingSharesIndices);
+  static bool satisfyNodeID(shared_ptr<TreeNode> treeNode, const vector<ShareID>& shareIDs, vector<int> &satisfyingSharesIndices);
   static bool satisfyNode(shared_ptr<TreeNode> node, vector<ShareTuple> shares, vector<ShareTuple> &satisfyingShares);
   shared_ptr<TreeNode> parsePolicy(); // takes the policy description and returns an equivalent parse tree
-  shared_ptr<TreeNode> parseTreeFromExpression(std::string expr);
+  shared_ptr<TreeNode> parseTreeFromExpression(const std::string& expr); // throws a BAD_POLICY runtime_error that gives the position of the error
+  static void parseIntoArena(const std::string& expr, TreeArena& arena); // the same, with the tree left in the arena
+  // the description of an equivalent policy with fewer gates and shares (TreeOptimizer). The shares of the two policies differ, so a key is generated
+  // from the optimized description. Throws a BAD_POLICY runtime_error as the parser
+  static std::string optimizeDescription(const std::string& expr);
   shared_ptr<TreeNode>& getPolicy();
+  const CompiledTree& getCompiledTree() const;
+  shared_ptr<CoefficientCache> getCoefficientCache() const;
+  shared_ptr<ShamirAccessPolicy> getFlatPolicy() const; // an empty pointer if the tree is not a single gate over leaves
+
+  // fills the cache with the coefficients of every set of threshold children of the gates of arity up to maxArity, which is bounded by
+  // PRECOMPUTED_ARITY. Witness sets use exactly threshold children of each gate, so decryptions on these gates never compute coefficients. Pairs of
+  // arity and threshold already filled for the order are skipped. gateCoefficients fills a gate this way the first time a witness set of the gate is
+  // not in the cache, so nothing is computed for a policy until its first decryption
+  static const unsigned int PRECOMPUTED_ARITY = 16;
+  void precomputeCoefficients(const Big& order, unsigned int maxArity = PRECOMPUTED_ARITY) const;
   ShTreeAccessPolicy();
   ShTreeAccessPolicy(const string &description, const int n); // constructor with participants numbered from 1 to n, each participant holding one share
   ShTreeAccessPolicy(const string &description, const vector<int> &parts); // constructor with participants specified freely, each participant holding one share
+  ShTreeAccessPolicy(const string &description, const vector<int> &parts, const CompiledTree &compiled); // takes an already compiled tree, without parsing
   ShTreeAccessPolicy(const ShTreeAccessPolicy& other);
   ShTreeAccessPolicy& operator=(const ShTreeAccessPolicy& other);
+  bool operator==(const ShTreeAccessPolicy& rhs) const; // the same participants and compiled tree. The descriptions may differ
   std::string getDescription() const;
+  StructuralHash getStructuralHash() const;
+  // the binary form holds the description, the participants and the compiled tree, with the layout of the shares and of the randomness
+  void writeBinary(BinaryWriter &out) const;
+  static shared_ptr<ShTreeAccessPolicy> readBinary(BinaryReader &in);
   unsigned int getNumShares();
   //  bool evaluate(const vector<ShareTuple> shares, vector<ShareTuple> &witnessShares) const;
-  bool evaluateIDs(const vector<std::string> shareIDs, vector<int> &witnessSharesIndices) const;
-  vector<Big> findCoefficients(const vector<std::string> shareIDs, const Big& order) const;
-  void obtainCoveredFrags(const vector<int> &atts, vector<int> &attFragIndices, vector<int> &keyFragIndices, vector<std::string> &coveredShareIDs) const;
-
-  static void storeSharePrefixes(std::map<std::string, vector<int> >& setChildNos, std::string& shareID);
-  static bool extractPrefixAndNoFromID(std::string& shareID, std::string& prefix, int& childNo);
-  static Big findFinalCoefficient(const std::string& shareID,  std::map<std::string,  vector<int> >& setChildNos, 
-			   std::map<std::string, vector<Big> >& setCoeffs, const Big& order);
+  bool evaluateIDs(const vector<ShareID>& shareIDs, vector<int> &witnessSharesIndices) const;
+  using AccessPolicy::findCoefficients;
+  void findCoefficients(const vector<ShareID>& shareIDs, const Big& order, vector<Big>& coeffs) const;
+  using AccessPolicy::obtainCoveredFrags;
+  void obtainCoveredFrags(const CoveredSet &covered, vector<int> &attFragIndices, vector<int> &keyFragIndices, vector<ShareID> &coveredShareIDs) const;
+  std::string renderShareID(const ShareID& id) const; // the path of the share from the root, as in "0:2:1:=4"
+
+  // for each gate, the child numbers of its children that lead to some of the shares, in the order in which they are found
+  void collectGateChildNos(const vector<ShareID>& shareIDs, vector<vector<int> >& gateChildNos) const;
   static Big computeLagrangeCoefficient(unsigned int shareIndex, vector<ShareTuple>& witnessShares, const Big& order);
   static Big computeLagrangeCoefficientChildNos(unsigned int shareIndex, vector<int>& witnessChildNos, const Big& order);
-  static int extractChildNoFromID(std::string& shareID);
+  // the coefficients of all the children of a gate at once. The engine must hold tables for at least as many points as witnessChildNos
+  static void computeLagrangeCoefficientsChildNos(const vector<int>& witnessChildNos, const LagrangeEngine& engine, vector<Big>& coeffs);
+  // the coefficients of a set of children of a gate, from the cache, or computed and then kept in it. A set of threshold children that is not in the
+  // cache first fills the cache with every such set of the gate, if its arity is up to PRECOMPUTED_ARITY. The engine is built, for sets of up to
+  // maxPoints children, the first time a set is still not in the cache
+  void gateCoefficients(const CompiledTree::Node& gate, const vector<int>& childNos, const Big& order, unsigned int maxPoints,
+			shared_ptr<LagrangeEngine>& engine, vector<Big>& coeffs) const;
+  static int extractChildNoFromID(const ShareID& shareID);
 
   inline static int extractPublicInfoFromChildNo(int childNo) {
     return childNo + 1;
   }
 
-  inline static int extractPublicInfoFromID(std::string ID) {
+  inline static int extractPublicInfoFromID(const ShareID& ID) {
     int childNo = extractChildNoFromID(ID);
     return extractPublicInfoFromChildNo(childNo);
   }
@@ -72,37 +242,20 @@ class ShTreeSS : public SecretSharing
 {
  private:
   shared_ptr<ShTreeAccessPolicy>  i_policy; 
-  vector<Big> m_randomness;
+  shared_ptr<ShamirSS> i_flat; // distributes and reconstructs when the policy has a flat form
   
  protected:
   void init();
   void initPolicy();
-  void manageRandomness(RandomnessActions action, shared_ptr<TreeNode> root, int &count);
-  void manageRandomness(RandomnessActions action);
 
  public:
   ShTreeSS(shared_ptr<ShTreeAccessPolicy> policy, PFC &pfc);
   ShTreeSS(shared_ptr<ShTreeAccessPolicy> policy, const Big &order, PFC &pfc);  
 
   // virtual inherited methods:
-  vector<Big> getDistribRandomness();  
-  std::vector<ShareTuple> distribute_random(const Big& s);
-  std::vector<ShareTuple> distribute_determ(const Big& s, const vector<Big>& randomness);
-  std::vector<ShareTuple> distribute_determ(shared_ptr<TreeNode> root, const Big& s, const vector<Big>& randomness, int &count);
+  unsigned int getNumRandomness();
+  using SecretSharing::distribute_determ;
+  std::vector<ShareTuple> distribute_determ(const Big& s, const RandomnessSource& randomness);
   Big reconstruct (const vector<ShareTuple> shares);
-  Big reconstruct_old(const vector<ShareTuple> shares);
-
-  // util-type functions
-  static void updateSet(std::map<std::string, vector<ShareTuple> >& setShares, const std::string& prefix, ShareTuple& share);
-  static void addNewSet(std::map<std::string, vector<ShareTuple> >& setShares, const std::string& prefix, ShareTuple& share);
-  static void putShareInSet(std::map<std::string, vector<ShareTuple> >& setShares, const std::string& prefix, ShareTuple& share);
-  static std::string getSetPrefix(std::string &shareID);
-
-  static ShareTuple detailedReconstruction(vector<ShareTuple>& minimalShares, std::string& prefix, const Big& order);
-  static ShareTuple solveSet(std::map<std::string, vector<ShareTuple> >& setShares, std::string& prefix, const Big& order);
-  static ShareTuple reduceLowestShares(const vector<ShareTuple>& shares, Big order);
-  static ShareTuple reduceMapShares(std::string& prefix, const std::string& target, 
-				    std::map<std::string, vector<ShareTuple> >& setShares, const Big& order);
-
 
 };
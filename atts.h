@@ -1,2 +0,0 @@
-#define AttOnG1_KeyOnG2
-
@@ -7,14 +7,12 @@
 
   The group structure has two groups G1 and G2 and one Pairing Group GT. One of the groups will serve to build the key fragments, while the other group will build
   the attribute fragments. 
-  The function of each group is determined by using one of two constants: #define AttOnG1_KeyOnG2 or #define AttOnG2_KeyOnG1.
+  The function of each group is chosen at runtime, with the argument g1 (attributes on G1, the default) or g2 (attributes on G2).
 
-  This source code is used to produce 4 different variants: for each of the two variants of attribute use, there are two possible secret sharing schemes to use: 
-  a canonical Benaloh-Leichter or a tree of Shamir schemes.
+  This source code is used to produce 2 different executables, one for each of the two possible secret sharing schemes to use: 
+  a canonical Benaloh-Leichter or a tree of Shamir schemes. Each of them can run both variants of attribute use.
 
-  These variants are obtained by four different compiling instructions: 
-  - the definition of attribute use is defined in atts.h, which is a copy of either atts.h_1 or atts.h_2
-  - the definition of secret sharing scheme to use is defined in benchmark_defs.h, which is a copy of either benchmark_defs_bl.h or benchmark_defs_sh.h.
+  The secret sharing scheme to use is defined in benchmark_defs.h, which is a copy of either benchmark_defs_bl.h or benchmark_defs_sh.h.
 
   My tests with measuring time by counting clicks have shown that this
   is not reliable. They usually give me half of the actual time
@@ -122,6 +120,7 @@ bool DecLin = false;
 bool DecExp = false;
 bool DecLinInv = false; 
 bool DecExpInv = false; // the Inv versions put the largest sets at the front, instead of at the end
+GroupPlacement placement = attOnG1;
  
   
 void parseInput(int argc, char* argv[]){
@@ -139,6 +138,7 @@ void parseInput(int argc, char* argv[]){
     if (arg == "dx") DecExp = true;
     if (arg == "dli") DecLinInv = true;
     if (arg == "dxi") DecExpInv = true;
+    if ((arg == "g1") || (arg == "g2")) parsePlacement(arg, placement);
     if (arg == "all") {
       Setup = Encrp = KeyUnif = KeyLin = KeyExp = KeyLinInv = KeyExpInv = DecUnif = DecLin = DecExp = DecLinInv = DecExpInv = true;
     }
@@ -288,6 +288,7 @@ void report_dec_data(int max, int k, long repeats, long nLeaves, long nSets, lon
        << "\t" << policy << std::endl;
 }
 
+template <class Placement>
 void measureSetup(PFC &pfc) {
   Big order; // can not be initialized at global scope because that will require work from the mip, that is still not initialized
   G1 P;
@@ -319,7 +320,7 @@ void measureSetup(PFC &pfc) {
   for (int i = 0; i < attInUnivVars; i++){
     int nAtts = attrsInUniverse[i];
     repeats = varRepeats[i];
-    KPABE testClass(testScheme, pfc, nAtts);    
+    KPABE<Placement> testClass(testScheme, pfc, nAtts);    
     testClass.paramsgen(P, Q, order);
 
     get_time(&t0);
@@ -334,6 +335,7 @@ void measureSetup(PFC &pfc) {
   }
 }
 
+template <class Placement>
 void measureEncrp(PFC &pfc, miracl* mip) {
   Big order; // can not be initialized at global scope because that will require work from the mip, that is still not initialized
   G1 P;
@@ -357,17 +359,12 @@ void measureEncrp(PFC &pfc, miracl* mip) {
  
 
   vector<int> CTAtts;
-#ifdef AttOnG1_KeyOnG2
-  vector<G1> AttFrags;
-#endif
-#ifdef AttOnG2_KeyOnG1
-  vector<G2> AttFrags;
-#endif
+  vector<typename Placement::AttGroup> AttFrags;
 
   GT CT;
   Big sCT;
 
-  KPABE testClass(testScheme, pfc, attrsInUniverse);
+  KPABE<Placement> testClass(testScheme, pfc, attrsInUniverse);
   testClass.paramsgen(P, Q, order);
   testClass.setup();
   Big rand;
@@ -613,6 +610,7 @@ int middleSetExpPolInv(int nLeaves, int nSets, int increment, int &begin){
 }
 
 
+template <class Placement>
 void measureKeyFunc(PFC &pfc, std::string (*makePolicy) (int, int, int&, int&), int leavesInPolicy[], const int nLeavesVars, int varRepeats[], 
 		    int (*next) (int), bool (*stop) (int, int), int start_k, std::string policy_type, std::string k_meaning ) {
   Big order; // can not be initialized at global scope because that will require work from the mip, that is still not initialized
@@ -653,7 +651,7 @@ void measureKeyFunc(PFC &pfc, std::string (*makePolicy) (int, int, int&, int&),
       shared_ptr<SS_TYPE> testScheme = make_shared<SS_TYPE>(policy, pfc);
       DEBUG("created SS scheme");
 
-      KPABE testClass(testScheme, pfc, nLeaves);    
+      KPABE<Placement> testClass(testScheme, pfc, nLeaves);    
       DEBUG("created ABE scheme");
       testClass.paramsgen(P, Q, order);
       DEBUG("generated params");
@@ -684,6 +682,7 @@ void measureKeyFunc(PFC &pfc, std::string (*makePolicy) (int, int, int&, int&),
 }
  
 
+template <class Placement>
 void measureDecFunc(PFC &pfc, miracl* mip, std::string (*makePolicy) (int, int, int&, int&), 
 		    int leavesInPolicy[], const int lvsInPol, int varRepeats[], 
 		    int (*next) (int), bool (*stop) (int, int), int (*findMiddleSetSizeAndFirstElement) (int, int, int, int&),
@@ -721,12 +720,7 @@ void measureDecFunc(PFC &pfc, miracl* mip, std::string (*makePolicy) (int, int,
   const int attInCTVars = 5; 
 
   vector<int> CTAtts;
-#ifdef AttOnG1_KeyOnG2
-  vector<G1> AttFrags;
-#endif
-#ifdef AttOnG2_KeyOnG1
-  vector<G2> AttFrags;
-#endif
+  vector<typename Placement::AttGroup> AttFrags;
 
   GT CT;
   Big sCT;
@@ -773,18 +767,13 @@ void measureDecFunc(PFC &pfc, miracl* mip, std::string (*makePolicy) (int, int,
       shared_ptr<SS_ACC_POL_TYPE> policy = make_shared<SS_ACC_POL_TYPE>(expr, realNLeaves);
       shared_ptr<SS_TYPE> testScheme = make_shared<SS_TYPE>(policy, pfc);
 
-      KPABE testClass(testScheme, pfc, attrsInUniverse);    
+      KPABE<Placement> testClass(testScheme, pfc, attrsInUniverse);    
       testClass.paramsgen(P, Q, order);
       // OUT("Setting up scheme");
       testClass.setup();
       // OUT("Scheme set up");
 
-#ifdef AttOnG1_KeyOnG2
-      vector<G2> keyFrags = testClass.genKey();
-#endif
-#ifdef AttOnG2_KeyOnG1
-      vector<G1> keyFrags = testClass.genKey();
-#endif
+      vector<typename Placement::KeyGroup> keyFrags = testClass.genKey();
 
       // Uniform policy:
       // except when there is only one minimal set, the number of minimal sets is always even
@@ -860,6 +849,7 @@ void measureDecFunc(PFC &pfc, miracl* mip, std::string (*makePolicy) (int, int,
 }
 
 
+template <class Placement>
 void measureKeyUnif(PFC &pfc) {
   int leavesInPolicy[] = {8, 32, 128, 512, 1024};
   const int lvsInPol = 5; 
@@ -874,9 +864,10 @@ void measureKeyUnif(PFC &pfc) {
 
 
   DEBUG("Calling measureKeyFunc");
-  measureKeyFunc(pfc, makeKeyUnifPolicy, leavesInPolicy, lvsInPol, varRepeats, nextUnifPol, stopUnifPol, 1, "Uniform", "");
+  measureKeyFunc<Placement>(pfc, makeKeyUnifPolicy, leavesInPolicy, lvsInPol, varRepeats, nextUnifPol, stopUnifPol, 1, "Uniform", "");
 }
 
+template <class Placement>
 void measureKeyLin(PFC &pfc) {
   int leavesInPolicy[] = {8, 32, 128, 512, 1024};
   const int lvsInPol = 5; 
@@ -887,9 +878,10 @@ void measureKeyLin(PFC &pfc) {
   int varRepeats[] = {5000, 2500, 500, 250, 100};
 #endif
 
-  measureKeyFunc(pfc, makeKeyLinPolicy, leavesInPolicy, lvsInPol, varRepeats, nextLinPol, stopLinPol, 2, "Linear", "set size increment");
+  measureKeyFunc<Placement>(pfc, makeKeyLinPolicy, leavesInPolicy, lvsInPol, varRepeats, nextLinPol, stopLinPol, 2, "Linear", "set size increment");
 }
  
+template <class Placement>
 void measureKeyExp(PFC &pfc) {
   int leavesInPolicy[] = {8, 32, 128, 512, 1024};
   const int lvsInPol = 5; 
@@ -901,9 +893,10 @@ void measureKeyExp(PFC &pfc) {
 #endif
 
 
-  measureKeyFunc(pfc, makeKeyExpPolicy, leavesInPolicy, lvsInPol, varRepeats, nextExpPol, stopExpPol, 2, "Exponential", "set size increment factor");
+  measureKeyFunc<Placement>(pfc, makeKeyExpPolicy, leavesInPolicy, lvsInPol, varRepeats, nextExpPol, stopExpPol, 2, "Exponential", "set size increment factor");
 }
  
+template <class Placement>
 void measureKeyLinInv(PFC &pfc) {
   int leavesInPolicy[] = {8, 32, 128, 512, 1024};
   const int lvsInPol = 5; 
@@ -915,9 +908,10 @@ void measureKeyLinInv(PFC &pfc) {
 #endif
 
 
-  measureKeyFunc(pfc, makeKeyLinPolicyInv, leavesInPolicy, lvsInPol, varRepeats, nextLinPol, stopLinPol, 2, "Inverse Linear", "set size decrement");
+  measureKeyFunc<Placement>(pfc, makeKeyLinPolicyInv, leavesInPolicy, lvsInPol, varRepeats, nextLinPol, stopLinPol, 2, "Inverse Linear", "set size decrement");
 }
  
+template <class Placement>
 void measureKeyExpInv(PFC &pfc) {
   int leavesInPolicy[] = {8, 32, 128, 512, 1024};
   const int lvsInPol = 5; 
@@ -929,9 +923,10 @@ void measureKeyExpInv(PFC &pfc) {
 #endif
 
 
-  measureKeyFunc(pfc, makeKeyExpPolicyInv, leavesInPolicy, lvsInPol, varRepeats, nextExpPol, stopExpPol, 2, "Inverse Exponential", "set size decrement factor");
+  measureKeyFunc<Placement>(pfc, makeKeyExpPolicyInv, leavesInPolicy, lvsInPol, varRepeats, nextExpPol, stopExpPol, 2, "Inverse Exponential", "set size decrement factor");
 }
  
+template <class Placement>
 void measureDecUnif(PFC &pfc, miracl* mip) { 
   int leavesInPolicy[] = {8, 32, 128, 512, 1024};
   const int lvsInPol = 5; 
@@ -943,9 +938,10 @@ void measureDecUnif(PFC &pfc, miracl* mip) {
 #endif
 
 
-  measureDecFunc(pfc, mip, makeKeyUnifPolicy, leavesInPolicy, lvsInPol, varRepeats, nextUnifPol, stopUnifPol, middleSetUnifPol, 1, "Uniform", ""); 
+  measureDecFunc<Placement>(pfc, mip, makeKeyUnifPolicy, leavesInPolicy, lvsInPol, varRepeats, nextUnifPol, stopUnifPol, middleSetUnifPol, 1, "Uniform", ""); 
 }
 
+template <class Placement>
 void measureDecLin(PFC &pfc, miracl* mip) {
   int leavesInPolicy[] = {8, 32, 128, 512, 1024};
   const int lvsInPol = 5; 
@@ -959,9 +955,10 @@ void measureDecLin(PFC &pfc, miracl* mip) {
 
 
 
-  measureDecFunc(pfc, mip, makeKeyLinPolicy, leavesInPolicy, lvsInPol, varRepeats, nextLinPol, stopLinPol, middleSetLinPol, 2, "Linear", "set size increment"); 
+  measureDecFunc<Placement>(pfc, mip, makeKeyLinPolicy, leavesInPolicy, lvsInPol, varRepeats, nextLinPol, stopLinPol, middleSetLinPol, 2, "Linear", "set size increment"); 
 }
  
+template <class Placement>
 void measureDecExp(PFC &pfc, miracl* mip) {
   int leavesInPolicy[] = {8, 32, 128, 512, 1024};
   const int lvsInPol = 5; 
@@ -974,9 +971,10 @@ void measureDecExp(PFC &pfc, miracl* mip) {
 #endif
 
 
-  measureDecFunc(pfc, mip, makeKeyExpPolicy, leavesInPolicy, lvsInPol, varRepeats, nextExpPol, stopExpPol, middleSetExpPol, 2, "Exponential", "set size increment factor"); 
+  measureDecFunc<Placement>(pfc, mip, makeKeyExpPolicy, leavesInPolicy, lvsInPol, varRepeats, nextExpPol, stopExpPol, middleSetExpPol, 2, "Exponential", "set size increment factor"); 
 }
  
+template <class Placement>
 void measureDecLinInv(PFC &pfc, miracl* mip) {
   int leavesInPolicy[] = {8, 32, 128, 512, 1024};
   const int lvsInPol = 5; 
@@ -988,9 +986,10 @@ void measureDecLinInv(PFC &pfc, miracl* mip) {
   int varRepeats[] = {9000, 15000, 20000, 40000,40000};
 #endif
 
-  measureDecFunc(pfc, mip, makeKeyLinPolicyInv, leavesInPolicy, lvsInPol, varRepeats, nextLinPol, stopLinPol, middleSetLinPolInv, 2, "Inverse Linear", "set size decrement"); 
+  measureDecFunc<Placement>(pfc, mip, makeKeyLinPolicyInv, leavesInPolicy, lvsInPol, varRepeats, nextLinPol, stopLinPol, middleSetLinPolInv, 2, "Inverse Linear", "set size decrement"); 
 }
  
+template <class Placement>
 void measureDecExpInv(PFC &pfc, miracl* mip) {
   int leavesInPolicy[] = {8, 32, 128, 512, 1024};
   const int lvsInPol = 5; 
@@ -1002,79 +1001,101 @@ void measureDecExpInv(PFC &pfc, miracl* mip) {
   int varRepeats[] = {9000, 15000, 20000, 40000,40000};
 #endif
 
-  measureDecFunc(pfc, mip, makeKeyExpPolicyInv, leavesInPolicy, lvsInPol, varRepeats, nextExpPol, stopExpPol, middleSetExpPolInv, 2, "Inverse Exponential", "set size decrement factor"); 
+  measureDecFunc<Placement>(pfc, mip, makeKeyExpPolicyInv, leavesInPolicy, lvsInPol, varRepeats, nextExpPol, stopExpPol, middleSetExpPolInv, 2, "Inverse Exponential", "set size decrement factor"); 
 }
 
 
 
-int main(int argc, char* argv[] ) {
-  PFC pfc(AES_SECURITY);  // initialise pairing-friendly curve
-  miracl *mip=get_mip();  // get handle on mip (Miracl Instance Pointer)
-
-  mip->IOBASE=16;
-
-  time_t seed;            // crude randomisation. Check if this is the version that is crypto-secure.
-  time(&seed);
-  irand((long)seed);
-
-  parseInput(argc, argv);
-  cout << endl;
-
-  time_t t0;
-  time_t t1;
-
-  report_start(&t0);
+template <class Placement>
+void runBenchmarks(PFC &pfc, miracl* mip) {
+  cout << "Placement: " << Placement::name() << endl;
 
   // Setup
   if (Setup) {
-    measureSetup(pfc);
+    measureSetup<Placement>(pfc);
   }
   
   // Encryption
   if (Encrp) {
-    measureEncrp(pfc, mip);
+    measureEncrp<Placement>(pfc, mip);
   }
 
   // Key Generation: Uniform policies
   if (KeyUnif) {
-    measureKeyUnif(pfc);
+    measureKeyUnif<Placement>(pfc);
   }
  
   if (KeyLin) {
-    measureKeyLin(pfc);
+    measureKeyLin<Placement>(pfc);
   }
  
   if (KeyExp) {
-    measureKeyExp(pfc);
+    measureKeyExp<Placement>(pfc);
   }
  
   if (KeyLinInv) {
-    measureKeyLinInv(pfc);
+    measureKeyLinInv<Placement>(pfc);
   }
  
   if (KeyExpInv) {
-    measureKeyExpInv(pfc);
+    measureKeyExpInv<Placement>(pfc);
   }
  
   if (DecUnif) {
-    measureDecUnif(pfc, mip);
+    measureDecUnif<Placement>(pfc, mip);
   }
  
   if (DecLin) {
-    measureDecLin(pfc, mip);
+    measureDecLin<Placement>(pfc, mip);
   }
  
   if (DecExp) {
-    measureDecExp(pfc, mip);
+    measureDecExp<Placement>(pfc, mip);
   }
  
   if (DecLinInv) {
-    measureDecLinInv(pfc, mip);
+    measureDecLinInv<Placement>(pfc, mip);
   }
  
   if (DecExpInv) {
-    measureDecExpInv(pfc, mip);
+    measureDecExpInv<Placement>(pfc, mip);
   }
+}
+
+struct Benchmarks {
+  PFC &pfc;
+  miracl *mip;
+
+  Benchmarks(PFC &p, miracl *m): pfc(p), mip(m) {}
+
+  template <class Placement>
+  void run() {
+    runBenchmarks<Placement>(pfc, mip);
+  }
+};
+
+
+int main(int argc, char* argv[] ) {
+  PFC pfc(AES_SECURITY);  // initialise pairing-friendly curve
+  miracl *mip=get_mip();  // get handle on mip (Miracl Instance Pointer)
+
+  mip->IOBASE=16;
+
+  time_t seed;            // crude randomisation. Check if this is the version that is crypto-secure.
+  time(&seed);
+  irand((long)seed);
+
+  parseInput(argc, argv);
+  cout << endl;
+
+  time_t t0;
+  time_t t1;
+
+  report_start(&t0);
+
+  Benchmarks benchmarks(pfc, mip);
+  runWithPlacement(placement, benchmarks);
+
   cout << "Nothing left to do" << endl;
 
   report_finish(&t1);
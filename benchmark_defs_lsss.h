@@ -0,0 +1,6 @@
+#ifndef DEF_LSSS
+#include "LSSS.h"
+#endif
+
+#define SS_TYPE LSSSSS
+#define SS_ACC_POL_TYPE LSSSAccessPolicy
@@ -0,0 +1,305 @@
+/*
+  Testbed for empirical evaluation of KP-ABE schemes, according to Crampton, Pinto (CSF2014).
+  Code by: Alexandre Miranda Pinto
+
+  This file implements the compressed bitmap declared in bitmap.h
+*/
+
+#ifndef DEF_BITMAP
+#include "bitmap.h"
+#endif
+
+#include <algorithm>
+
+Bitmap::Container::Container(unsigned int k):
+  key(k), dense(false)
+{}
+
+unsigned int Bitmap::Container::cardinality() const {
+  if (!dense) return sparse.size();
+  unsigned int count = 0;
+  for (unsigned int i = 0; i < words.size(); i++) {
+    count += __builtin_popcountll(words[i]);
+  }
+  return count;
+}
+
+bool Bitmap::Container::contains(unsigned short low) const {
+  if (dense) {
+    return (words[low >> 6] >> (low & 63)) & 1ULL;
+  }
+  return std::binary_search(sparse.begin(), sparse.end(), low);
+}
+
+void Bitmap::Container::add(unsigned short low) {
+  if (dense) {
+    words[low >> 6] |= (1ULL << (low & 63));
+    return;
+  }
+  // the store assigns identifiers in increasing order, so appending at the end is the common case
+  if (sparse.empty() || (sparse.back() < low)) {
+    sparse.push_back(low);
+  } else {
+    vector<unsigned short>::iterator it = std::lower_bound(sparse.begin(), sparse.end(), low);
+    if (*it == low) return;
+    sparse.insert(it, low);
+  }
+  if (sparse.size() > MAX_SPARSE) {
+    makeDense();
+  }
+}
+
+void Bitmap::Container::makeDense() {
+  if (dense) return;
+  expand(words);
+  sparse.clear();
+  sparse.shrink_to_fit();
+  dense = true;
+}
+
+void Bitmap::Container::expand(vector<unsigned long long> &out) const {
+  if (dense) {
+    out = words;
+    return;
+  }
+  out.assign(CHUNK_WORDS, 0);
+  for (unsigned int i = 0; i < sparse.size(); i++) {
+    out[sparse[i] >> 6] |= (1ULL << (sparse[i] & 63));
+  }
+}
+
+void Bitmap::Container::compact() {
+  if (!dense) return;
+  if (cardinality() > MAX_SPARSE) return;
+  for (unsigned int i = 0; i < CHUNK_WORDS; i++) {
+    unsigned long long w = words[i];
+    while (w != 0) {
+      sparse.push_back((i << 6) + __builtin_ctzll(w));
+      w &= w - 1;
+    }
+  }
+  words.clear();
+  words.shrink_to_fit();
+  dense = false;
+}
+
+//==============================================
+
+Bitmap::Bitmap()
+{}
+
+int Bitmap::findContainer(unsigned int key) const {
+  int low = 0;
+  int high = m_containers.size() - 1;
+  while (low <= high) {
+    int mid = (low + high) / 2;
+    if (m_containers[mid].key == key) return mid;
+    if (m_containers[mid].key < key) {
+      low = mid + 1;
+    } else {
+      high = mid - 1;
+    }
+  }
+  return -1;
+}
+
+void Bitmap::add(unsigned int id) {
+  unsigned int key = id >> CHUNK_BITS;
+  unsigned short low = id & 0xFFFF;
+  if (m_containers.empty() || (m_containers.back().key < key)) {
+    m_containers.push_back(Container(key));
+    m_containers.back().add(low);
+    return;
+  }
+  int n = findContainer(key);
+  if (n >= 0) {
+    m_containers[n].add(low);
+    return;
+  }
+  unsigned int pos = 0;
+  while (m_containers[pos].key < key) pos++;
+  m_containers.insert(m_containers.begin() + pos, Container(key));
+  m_containers[pos].add(low);
+}
+
+bool Bitmap::contains(unsigned int id) const {
+  int n = findContainer(id >> CHUNK_BITS);
+  if (n < 0) return false;
+  return m_containers[n].contains(id & 0xFFFF);
+}
+
+unsigned int Bitmap::cardinality() const {
+  unsigned int count = 0;
+  for (unsigned int i = 0; i < m_containers.size(); i++) {
+    count += m_containers[i].cardinality();
+  }
+  return count;
+}
+
+bool Bitmap::isEmpty() const {
+  return m_containers.empty();
+}
+
+void Bitmap::clear() {
+  m_containers.clear();
+}
+
+vector<unsigned int> Bitmap::toVector() const {
+  vector<unsigned int> ids;
+  ids.reserve(cardinality());
+  for (unsigned int i = 0; i < m_containers.size(); i++) {
+    const Container &c = m_containers[i];
+    unsigned int base = c.key << CHUNK_BITS;
+    if (c.dense) {
+      for (unsigned int j = 0; j < CHUNK_WORDS; j++) {
+	unsigned long long w = c.words[j];
+	while (w != 0) {
+	  ids.push_back(base + (j << 6) + __builtin_ctzll(w));
+	  w &= w - 1;
+	}
+      }
+    } else {
+      for (unsigned int j = 0; j < c.sparse.size(); j++) {
+	ids.push_back(base + c.sparse[j]);
+      }
+    }
+  }
+  return ids;
+}
+
+bool Bitmap::operator==(const Bitmap& rhs) const {
+  return toVector() == rhs.toVector();
+}
+
+void Bitmap::appendFromWords(Bitmap &result, unsigned int key, const vector<unsigned long long> &words) {
+  Container c(key);
+  c.dense = true;
+  c.words = words;
+  if (c.cardinality() == 0) return;
+  c.compact();
+  result.m_containers.push_back(c);
+}
+
+Bitmap Bitmap::And(const Bitmap &a, const Bitmap &b) {
+  vector<const Bitmap*> operands;
+  operands.push_back(&a);
+  operands.push_back(&b);
+  return And(operands);
+}
+
+Bitmap Bitmap::Or(const Bitmap &a, const Bitmap &b) {
+  vector<const Bitmap*> operands;
+  operands.push_back(&a);
+  operands.push_back(&b);
+  return Or(operands);
+}
+
+Bitmap Bitmap::And(const vector<const Bitmap*> &operands) {
+  if (operands.empty()) return Bitmap();
+  return Threshold(operands.size(), operands);
+}
+
+Bitmap Bitmap::Or(const vector<const Bitmap*> &operands) {
+  return Threshold(1, operands);
+}
+
+// The threshold operation works one chunk at a time. Only the chunks that appear in at least k operands can hold a result.
+// For those, the containers of the operands are expanded into words, and the number of operands holding each bit is kept as a bit-sliced counter:
+// plane p of the counter holds bit p of the count of every one of the 64 positions of a word. Adding a word to the counter is a ripple-carry addition
+// over the planes, and the final comparison with k is also done plane by plane, from the most significant to the least significant one.
+// The two extreme cases, k == 1 (OR) and k == n (AND), do not need the counter.
+Bitmap Bitmap::Threshold(unsigned int k, const vector<const Bitmap*> &operands) {
+  Bitmap result;
+  unsigned int n = operands.size();
+  if ((k == 0) || (k > n)) {
+    guard("Bitmap::Threshold requires a threshold of at least 1", k > 0);
+    return result;
+  }
+
+  unsigned int nplanes = 1;
+  while ((1U << nplanes) <= n) nplanes++;
+
+  vector<unsigned int> cursors(n, 0);
+  vector<unsigned long long> acc(CHUNK_WORDS);
+  vector<unsigned long long> buffer;
+  vector<vector<unsigned long long> > planes(nplanes, vector<unsigned long long>(CHUNK_WORDS));
+
+  while (true) {
+    // find the smallest key not yet processed, and how many operands hold it
+    bool found = false;
+    unsigned int key = 0;
+    for (unsigned int i = 0; i < n; i++) {
+      if (cursors[i] < operands[i]->m_containers.size()) {
+	unsigned int ckey = operands[i]->m_containers[cursors[i]].key;
+	if (!found || (ckey < key)) {
+	  key = ckey;
+	  found = true;
+	}
+      }
+    }
+    if (!found) break;
+
+    vector<const Container*> present;
+    for (unsigned int i = 0; i < n; i++) {
+      if ((cursors[i] < operands[i]->m_containers.size()) && (operands[i]->m_containers[cursors[i]].key == key)) {
+	present.push_back(&operands[i]->m_containers[cursors[i]]);
+	cursors[i]++;
+      }
+    }
+    if (present.size() < k) continue;
+
+    if (k == 1) {
+      acc.assign(CHUNK_WORDS, 0);
+      for (unsigned int i = 0; i < present.size(); i++) {
+	present[i]->expand(buffer);
+	for (unsigned int w = 0; w < CHUNK_WORDS; w++) acc[w] |= buffer[w];
+      }
+    } else if (k == present.size()) {
+      present[0]->expand(acc);
+      for (unsigned int i = 1; i < present.size(); i++) {
+	present[i]->expand(buffer);
+	for (unsigned int w = 0; w < CHUNK_WORDS; w++) acc[w] &= buffer[w];
+      }
+    } else {
+      for (unsigned int p = 0; p < nplanes; p++) planes[p].assign(CHUNK_WORDS, 0);
+      for (unsigned int i = 0; i < present.size(); i++) {
+	present[i]->expand(buffer);
+	for (unsigned int w = 0; w < CHUNK_WORDS; w++) {
+	  unsigned long long carry = buffer[w];
+	  for (unsigned int p = 0; (p < nplanes) && (carry != 0); p++) {
+	    unsigned long long t = planes[p][w] & carry;
+	    planes[p][w] ^= carry;
+	    carry = t;
+	  }
+	}
+      }
+      for (unsigned int w = 0; w < CHUNK_WORDS; w++) {
+	unsigned long long greater = 0;
+	unsigned long long equal = ~0ULL;
+	for (int p = nplanes - 1; p >= 0; p--) {
+	  if ((k >> p) & 1) {
+	    equal &= planes[p][w];
+	  } else {
+	    greater |= equal & planes[p][w];
+	    equal &= ~planes[p][w];
+	  }
+	}
+	acc[w] = greater | equal;
+      }
+    }
+    appendFromWords(result, key, acc);
+  }
+  return result;
+}
+
+std::string Bitmap::to_string() const {
+  vector<unsigned int> ids = toVector();
+  stringstream ss;
+  ss << "{";
+  for (unsigned int i = 0; i < ids.size(); i++) {
+    ss << ids[i];
+    if (i < ids.size() - 1) ss << ",";
+  }
+  ss << "}";
+  return ss.str();
+}
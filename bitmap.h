@@ -0,0 +1,63 @@
+/*
+  Testbed for empirical evaluation of KP-ABE schemes, according to Crampton, Pinto (CSF2014).
+  Code by: Alexandre Miranda Pinto
+
+  This file declares a compressed bitmap of unsigned integer identifiers, used to hold posting lists for the ciphertext store.
+  The identifier space is split in chunks of 65536 consecutive values, and each chunk that holds at least one element is kept in a container:
+  - a sparse container holds the sorted list of the low 16 bits of its elements. It is used while the chunk has few elements.
+  - a dense container holds a plain bitset of 1024 words. A sparse container is converted to a dense one once it grows beyond MAX_SPARSE elements.
+  Besides the usual AND and OR operations, the bitmap implements a threshold operation, which selects the elements that are present in at least k of
+  a list of bitmaps. This is what is needed to evaluate threshold gates directly over posting lists.
+*/
+
+#define DEF_BITMAP
+
+#ifndef DEF_UTILS
+#include "utils.h"
+#endif
+
+class Bitmap {
+ public:
+  static const unsigned int CHUNK_BITS = 16;
+  static const unsigned int CHUNK_WORDS = 1024; // 65536 bits in words of 64 bits
+  static const unsigned int MAX_SPARSE = 4096;  // above this number of elements, a dense container is smaller
+
+ private:
+  struct Container {
+    unsigned int key; // the high bits shared by all the elements of the container
+    bool dense;
+    vector<unsigned short> sparse; // sorted low bits, when the container is sparse
+    vector<unsigned long long> words; // CHUNK_WORDS words, when the container is dense
+
+    Container(unsigned int k);
+    unsigned int cardinality() const;
+    bool contains(unsigned short low) const;
+    void add(unsigned short low);
+    void makeDense();
+    void expand(vector<unsigned long long> &out) const; // writes the container as CHUNK_WORDS words
+    void compact(); // turns a dense container back to sparse if it is small enough
+  };
+
+  vector<Container> m_containers; // sorted by key
+
+  int findContainer(unsigned int key) const;
+  static void appendFromWords(Bitmap &result, unsigned int key, const vector<unsigned long long> &words);
+
+ public:
+  Bitmap();
+  void add(unsigned int id);
+  bool contains(unsigned int id) const;
+  unsigned int cardinality() const;
+  bool isEmpty() const;
+  void clear();
+  vector<unsigned int> toVector() const;
+  bool operator==(const Bitmap& rhs) const;
+
+  static Bitmap And(const Bitmap &a, const Bitmap &b);
+  static Bitmap Or(const Bitmap &a, const Bitmap &b);
+  static Bitmap And(const vector<const Bitmap*> &operands);
+  static Bitmap Or(const vector<const Bitmap*> &operands);
+  static Bitmap Threshold(unsigned int k, const vector<const Bitmap*> &operands); // elements present in at least k operands. k must be at least 1
+
+  std::string to_string() const;
+};
@@ -0,0 +1,208 @@
+/*
+  Testbed for empirical evaluation of KP-ABE schemes, according to Crampton, Pinto (CSF2014).
+  Code by: Alexandre Miranda Pinto
+
+  This file implements the ciphertext store and the policy compiler declared in ctstore.h
+*/
+
+#ifndef DEF_CT_STORE
+#include "ctstore.h"
+#endif
+
+#include <deque>
+
+IndexQuery::IndexQuery()
+{}
+
+void IndexQuery::load(int att) {
+  Op op;
+  op.type = LOAD;
+  op.arg1 = att;
+  op.arg2 = 0;
+  m_ops.push_back(op);
+}
+
+void IndexQuery::threshold(int nOperands, int threshold) {
+  Op op;
+  op.type = THRESHOLD;
+  op.arg1 = nOperands;
+  op.arg2 = threshold;
+  m_ops.push_back(op);
+}
+
+void IndexQuery::none() {
+  Op op;
+  op.type = NONE;
+  op.arg1 = 0;
+  op.arg2 = 0;
+  m_ops.push_back(op);
+}
+
+const vector<IndexQuery::Op>& IndexQuery::getOps() const {
+  return m_ops;
+}
+
+std::string IndexQuery::to_string() const {
+  stringstream ss;
+  for (unsigned int i = 0; i < m_ops.size(); i++) {
+    switch (m_ops[i].type) {
+    case LOAD: ss << "LOAD(" << m_ops[i].arg1 << ")"; break;
+    case THRESHOLD: ss << "THR(" << m_ops[i].arg2 << "/" << m_ops[i].arg1 << ")"; break;
+    case NONE: ss << "NONE"; break;
+    }
+    if (i < m_ops.size() - 1) ss << " ";
+  }
+  return ss.str();
+}
+
+//==============================================
+
+CiphertextStore::CiphertextStore()
+{
+  m_attOffsets.push_back(0);
+}
+
+unsigned int CiphertextStore::add(const vector<int> &atts) {
+  unsigned int id = size();
+  for (unsigned int i = 0; i < atts.size(); i++) {
+    m_attValues.push_back(atts[i]);
+    m_index[atts[i]].add(id);
+  }
+  m_attOffsets.push_back(m_attValues.size());
+  return id;
+}
+
+unsigned int CiphertextStore::size() const {
+  return m_attOffsets.size() - 1;
+}
+
+vector<int> CiphertextStore::getAttributes(unsigned int id) const {
+  if (id >= size()) {
+    stringstream ss;
+    ss << "Wrong ciphertext access. Size: " << size() << "; Requested id: " << id << endl;
+    throw std::range_error(ss.str());
+  }
+  return vector<int>(m_attValues.begin() + m_attOffsets[id], m_attValues.begin() + m_attOffsets[id+1]);
+}
+
+const Bitmap& CiphertextStore::getPostings(int att) const {
+  std::map<int, Bitmap>::const_iterator it = m_index.find(att);
+  if (it == m_index.end()) return m_empty;
+  return it->second;
+}
+
+// the nodes of a compiled tree are in post-order, which is already the order of a postfix program: every child comes before its gate
+void CiphertextStore::compileTree(const CompiledTree &tree, IndexQuery &query) {
+  for (unsigned int n = 0; n < tree.size(); n++) {
+    const CompiledTree::Node &node = tree.getNode(n);
+    switch (node.kind) {
+    case CompiledTree::nilNode:
+      query.none();
+      break;
+    case CompiledTree::leafNode:
+      query.load(node.leafValue);
+      break;
+    case CompiledTree::gateNode:
+      query.threshold(node.numChildren, node.threshold);
+      break;
+    }
+  }
+  if (tree.size() == 0) {
+    query.none();
+  }
+}
+
+bool CiphertextStore::compile(shared_ptr<AccessPolicy> policy, IndexQuery &query) {
+  shared_ptr<BLAccessPolicy> blPolicy = std::dynamic_pointer_cast<BLAccessPolicy>(policy);
+  if (blPolicy) {
+    const vector<int> &members = blPolicy->getSetMembers();
+    const vector<unsigned int> &offsets = blPolicy->getSetOffsets();
+    unsigned int nSets = blPolicy->getNumMinimalSets();
+    if (nSets == 0) {
+      query.none();
+      return true;
+    }
+    for (unsigned int i = 0; i < nSets; i++) {
+      for (unsigned int j = offsets[i]; j < offsets[i+1]; j++) {
+	query.load(members[j]);
+      }
+      query.threshold(offsets[i+1] - offsets[i], offsets[i+1] - offsets[i]);
+    }
+    query.threshold(nSets, 1);
+    return true;
+  }
+
+  shared_ptr<ShTreeAccessPolicy> treePolicy = std::dynamic_pointer_cast<ShTreeAccessPolicy>(policy);
+  if (treePolicy) {
+    compileTree(treePolicy->getCompiledTree(), query);
+    return true;
+  }
+  return false;
+}
+
+Bitmap CiphertextStore::run(const IndexQuery &query) const {
+  // the stack holds pointers, so that posting lists are not copied when they are loaded. Intermediate results live in the deque, whose elements
+  // do not move when it grows
+  std::deque<Bitmap> results;
+  vector<const Bitmap*> stack;
+  const vector<IndexQuery::Op> &ops = query.getOps();
+
+  for (unsigned int i = 0; i < ops.size(); i++) {
+    const IndexQuery::Op &op = ops[i];
+    switch (op.type) {
+    case IndexQuery::LOAD:
+      stack.push_back(&getPostings(op.arg1));
+      break;
+    case IndexQuery::NONE:
+      stack.push_back(&m_empty);
+      break;
+    case IndexQuery::THRESHOLD:
+      {
+	guard("IndexQuery: threshold operation with more operands than the stack holds", (op.arg1 >= 0) && ((unsigned int) op.arg1 <= stack.size()));
+	vector<const Bitmap*> operands(stack.end() - op.arg1, stack.end());
+	stack.resize(stack.size() - op.arg1);
+	if (op.arg2 <= 0) {
+	  // a gate with threshold 0 is satisfied by every ciphertext
+	  Bitmap all;
+	  for (unsigned int id = 0; id < size(); id++) all.add(id);
+	  results.push_back(all);
+	} else {
+	  results.push_back(Bitmap::Threshold(op.arg2, operands));
+	}
+	stack.push_back(&results.back());
+      }
+      break;
+    }
+  }
+  guard("IndexQuery: a query must leave exactly one result", stack.size() == 1);
+  return *stack[0];
+}
+
+Bitmap CiphertextStore::findCandidates(shared_ptr<AccessPolicy> policy) const {
+  IndexQuery query;
+  if (!compile(policy, query)) {
+    return findCandidatesByScan(policy);
+  }
+  DEBUG("Compiled query: " << query.to_string());
+  return run(query);
+}
+
+Bitmap CiphertextStore::findCandidatesByScan(shared_ptr<AccessPolicy> policy) const {
+  Bitmap candidates;
+  CoveredSet covered;
+  vector<int> attFragIndices;
+  vector<int> keyFragIndices;
+  vector<ShareID> coveredShareIDs;
+  vector<int> witnessSharesIndices;
+  for (unsigned int id = 0; id < size(); id++) {
+    covered.assign(getAttributes(id));
+    attFragIndices.clear();
+    keyFragIndices.clear();
+    coveredShareIDs.clear();
+    policy->obtainCoveredFrags(covered, attFragIndices, keyFragIndices, coveredShareIDs);
+    if (policy->evaluateIDs(coveredShareIDs, witnessSharesIndices)) {
+      candidates.add(id);
+    }
+  }
+  return candidates;
+}
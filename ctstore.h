@@ -0,0 +1,84 @@
+/*
+  Testbed for empirical evaluation of KP-ABE schemes, according to Crampton, Pinto (CSF2014).
+  Code by: Alexandre Miranda Pinto
+
+  This file declares a local store of ciphertext descriptions, indexed by attribute.
+  The question it answers is: given a key, which of the stored ciphertexts can it decrypt? Without the index, the only way of answering it is to run the
+  key's policy over the attribute vector of every ciphertext. The store keeps instead an inverted index from each attribute to the set of ciphertexts
+  that were encrypted with it, as a compressed Bitmap. A policy is compiled into a short program of bitmap operations (load a posting list, combine the
+  last n results with a threshold), which is then run over the index to produce the candidate set in one pass.
+
+  The store only keeps the attribute vectors of the ciphertexts. Each ciphertext receives an identifier when it is added, and the caller keeps the
+  ciphertext itself (attribute fragments and blinded message) under that identifier.
+
+  There are two classes declared here:
+  - IndexQuery: a policy compiled into bitmap operations, in postfix order
+  - CiphertextStore: the store and its index
+*/
+
+#define DEF_CT_STORE
+
+#ifndef DEF_UTILS
+#include "utils.h"
+#endif
+
+#ifndef DEF_SECRET_SHARING
+#include "secretsharing.h"
+#endif
+
+#ifndef DEF_BL_CANON
+#include "BLcanonical.h"
+#endif
+
+#ifndef DEF_SH_TREE
+#include "ShTree.h"
+#endif
+
+#ifndef DEF_BITMAP
+#include "bitmap.h"
+#endif
+
+class IndexQuery {
+ public:
+  enum OpType {LOAD, THRESHOLD, NONE};
+
+  struct Op {
+    OpType type;
+    int arg1; // LOAD: the attribute. THRESHOLD: the number of operands, taken from the top of the stack
+    int arg2; // THRESHOLD: the threshold. OR is a threshold of 1 and AND a threshold of arg1
+  };
+
+ private:
+  vector<Op> m_ops;
+
+ public:
+  IndexQuery();
+  void load(int att);
+  void threshold(int nOperands, int threshold);
+  void none(); // a policy that is satisfied by no ciphertext
+  const vector<Op>& getOps() const;
+  std::string to_string() const;
+};
+
+//=============================================================================
+
+class CiphertextStore {
+  vector<unsigned int> m_attOffsets; // attributes of ciphertext i are m_attValues[m_attOffsets[i]] to m_attValues[m_attOffsets[i+1]-1]
+  vector<int> m_attValues;
+  std::map<int, Bitmap> m_index; // attribute -> ciphertexts encrypted with it
+  Bitmap m_empty;
+
+  static void compileTree(const CompiledTree &tree, IndexQuery &query);
+
+ public:
+  CiphertextStore();
+  unsigned int add(const vector<int> &atts); // returns the identifier of the new ciphertext
+  unsigned int size() const;
+  vector<int> getAttributes(unsigned int id) const;
+  const Bitmap& getPostings(int att) const;
+
+  static bool compile(shared_ptr<AccessPolicy> policy, IndexQuery &query); // returns false if the type of policy is not known to the compiler
+  Bitmap run(const IndexQuery &query) const;
+  Bitmap findCandidates(shared_ptr<AccessPolicy> policy) const; // compiles and runs the policy, or scans the store if it can not be compiled
+  Bitmap findCandidatesByScan(shared_ptr<AccessPolicy> policy) const; // trial evaluation of each ciphertext. It is the fallback for unknown policies
+};
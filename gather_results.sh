@@ -10,11 +10,11 @@ yellow='\x1b[1;33m'
 none='\x1b[0m'
 
 echo -e "${red} Benchmark BL 1"
-./benchmark_bl_1 all | tee "benchmark-results-BL-1.txt"
+./benchmark_bl g1 all | tee "benchmark-results-BL-1.txt"
 echo -e "${cyan} Benchmark BL 2"
-./benchmark_bl_2 all | tee "benchmark-results-BL-2.txt"
+./benchmark_bl g2 all | tee "benchmark-results-BL-2.txt"
 echo -e "${purple} Benchmark SH 1"
-./benchmark_sh_1 all | tee "benchmark-results-SH-1.txt"
+./benchmark_sh g1 all | tee "benchmark-results-SH-1.txt"
 echo -e "${yellow} Benchmark SH 2"
-./benchmark_sh_2 all | tee "benchmark-results-SH-2.txt"
+./benchmark_sh g2 all | tee "benchmark-results-SH-2.txt"
 echo -e "${none} Done"
\ No newline at end of file
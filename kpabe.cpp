@@ -22,72 +22,81 @@
 #endif
 
 
-unsigned int KPABE::numberAttr() const
+bool parsePlacement(const std::string& name, GroupPlacement& placement)
+{
+  if (name == "g1") {
+    placement = attOnG1;
+    return true;
+  }
+  if (name == "g2") {
+    placement = attOnG2;
+    return true;
+  }
+  return false;
+}
+
+template <class Placement>
+unsigned int KPABE<Placement>::numberAttr() const
 {
   return m_nAttr;
 }
 
-vector<Big>& KPABE::getPrivateAttributes() 
+template <class Placement>
+vector<Big>& KPABE<Placement>::getPrivateAttributes() 
 {
   return m_privateAttributes;
 }
 
-Big& KPABE::getPrivateKeyRand() 
+template <class Placement>
+Big& KPABE<Placement>::getPrivateKeyRand() 
 {
   return m_privateKeyRand;
 }
 
-#ifdef AttOnG1_KeyOnG2
-vector<G1>& KPABE::getPublicAttributes() 
+template <class Placement>
+vector<typename KPABE<Placement>::AttGroup>& KPABE<Placement>::getPublicAttributes() 
 {
   return m_publicAtts;
 }
-#endif
-#ifdef AttOnG2_KeyOnG1
-vector<G2>& KPABE::getPublicAttributes() 
-{
-  return m_publicAtts;
-}
-#endif
 
 
-Big& KPABE::getLastEncryptionRandomness() 
+template <class Placement>
+Big& KPABE<Placement>::getLastEncryptionRandomness() 
 {
   return m_lastCTRandomness;
 }
 
 
-GT& KPABE::getPublicCTBlinder() 
+template <class Placement>
+GT& KPABE<Placement>::getPublicCTBlinder() 
 {
   return m_publicCTBlinder;
 }
 
 
-KPABE::KPABE(PFC& pfc, int nAttr): // the last argument specifies which group is used to build attribute fragments.
+template <class Placement>
+KPABE<Placement>::KPABE(PFC& pfc, int nAttr):
   m_scheme(nullptr), m_pfc(pfc), m_nAttr(nAttr), m_privateKeyRand(0), m_lastCTRandomness(0), m_order(m_pfc.order())
 {
   m_privateAttributes.reserve(m_nAttr);
   m_publicAtts.reserve(m_nAttr);
 }
 
-KPABE::KPABE(shared_ptr<SecretSharing> scheme, PFC& pfc, int nAttr): // the last argument specifies which group is used to build attribute fragments.
+template <class Placement>
+KPABE<Placement>::KPABE(shared_ptr<SecretSharing> scheme, PFC& pfc, int nAttr):
   m_scheme(scheme), m_pfc(pfc), m_nAttr(nAttr), m_privateKeyRand(0), m_lastCTRandomness(0), m_order(m_pfc.order())
 {
   m_privateAttributes.reserve(m_nAttr);
   m_publicAtts.reserve(m_nAttr);
 }
 
-void KPABE::paramsgen(G1& P, G2& Q, Big& order)  // all arguments have their values changed on the outside of the function
+template <class Placement>
+void KPABE<Placement>::paramsgen(G1& P, G2& Q, Big& order)  // all arguments have their values changed on the outside of the function
 {
   m_pfc.random(P);
   m_pfc.random(Q);
 
-#ifdef AttOnG1_KeyOnG2
-  m_pfc.precomp_for_mult(Q);
-#endif
-#ifdef AttOnG2_KeyOnG1
-  m_pfc.precomp_for_mult(P);
-#endif
+  m_pfc.precomp_for_mult(Placement::keyBase(P,Q)); // key fragments are all computed from the same base element
 
   m_P = P;
   m_Q = Q;
@@ -95,7 +104,8 @@ void KPABE::paramsgen(G1& P, G2& Q, Big& order)  // all arguments have their val
   order = m_order; // sending the value of order to the outside
 }
 
-void KPABE::setup(){
+template <class Placement>
+void KPABE<Placement>::setup(){
   m_privateAttributes.clear();
   m_publicAtts.clear();
   m_pfc.random(m_privateKeyRand);
@@ -107,25 +117,15 @@ void KPABE::setup(){
     m_privateAttributes.push_back(0);
     m_pfc.random(m_privateAttributes[i]);
 
-#ifdef AttOnG1_KeyOnG2
-    m_publicAtts.push_back(m_pfc.mult(m_P,m_privateAttributes[i]));
+    m_publicAtts.push_back(m_pfc.mult(Placement::attBase(m_P,m_Q),m_privateAttributes[i]));
     m_pfc.precomp_for_mult(m_publicAtts[i],TRUE);
-#endif
-#ifdef AttOnG2_KeyOnG1   
-    m_publicAtts.push_back(m_pfc.mult(m_Q,m_privateAttributes[i]));
-    m_pfc.precomp_for_mult(m_publicAtts[i],TRUE);
-#endif
   }
   guard("[SETUP:] Attribute's vector size should be m_nAttr", m_privateAttributes.size() == m_nAttr);
 }
 
 
-#ifdef AttOnG1_KeyOnG2
-vector<G2> KPABE::genKey()
-#endif
-#ifdef AttOnG2_KeyOnG1
-vector<G1> KPABE::genKey()
-#endif
+template <class Placement>
+vector<typename KPABE<Placement>::KeyGroup> KPABE<Placement>::genKey()
 {
   guard("genKey was called with a null scheme", !(m_scheme==0));
   //  SecretSharing ssscheme(policy, m_pfc);
@@ -140,12 +140,8 @@ vector<G1> KPABE::genKey()
   return makeKeyFrags(shares);
 }
 
-#ifdef AttOnG1_KeyOnG2
-vector<G2> KPABE::genKey(vector<Big> randomness)
-#endif
-#ifdef AttOnG2_KeyOnG1
-vector<G1> KPABE::genKey(vector<Big> randomness)
-#endif
+template <class Placement>
+vector<typename KPABE<Placement>::KeyGroup> KPABE<Placement>::genKey(vector<Big> randomness)
 {
   guard("genKey(randomness) was called with a null scheme", !(m_scheme==0));
   ENHDEBUG("Inside genKey(randomness)");
@@ -155,31 +151,25 @@ vector<G1> KPABE::genKey(vector<Big> randomness)
   return makeKeyFrags(shares);
 }
 
-#ifdef AttOnG1_KeyOnG2
-vector<G2> KPABE::makeKeyFrags(std::vector<ShareTuple> shares)
-#endif
-#ifdef AttOnG2_KeyOnG1
-vector<G1> KPABE::makeKeyFrags(std::vector<ShareTuple> shares)
-#endif
+template <class Placement>
+vector<typename KPABE<Placement>::KeyGroup> KPABE<Placement>::genKeyFromSeed(const vector<char>& seed)
+{
+  guard("genKeyFromSeed was called with a null scheme", !(m_scheme==0));
+  std::vector<ShareTuple> shares = m_scheme->distribute_seeded(m_privateKeyRand, seed);
+  return makeKeyFrags(shares);
+}
+
+template <class Placement>
+vector<typename KPABE<Placement>::KeyGroup> KPABE<Placement>::makeKeyFrags(std::vector<ShareTuple> shares)
 {
 
   
-#ifdef AttOnG1_KeyOnG2
-  vector<G2> keyFrags(shares.size());
-#endif
-#ifdef AttOnG2_KeyOnG1
-  vector<G1> keyFrags(shares.size());
-#endif
+  vector<KeyGroup> keyFrags(shares.size());
          
   for (unsigned int i = 0; i < shares.size(); i++){
     
-#ifdef AttOnG1_KeyOnG2
-    keyFrags[i] = m_pfc.mult(m_Q,moddiv(shares[i].getShare(),m_privateAttributes[shares[i].getPartIndex()],m_order));
-    m_pfc.precomp_for_pairing(keyFrags[i]);  // precomputes on the G2 element
-#endif
-#ifdef AttOnG2_KeyOnG1          
-    keyFrags[i] = m_pfc.mult(m_P,moddiv(shares[i].getShare(),m_privateAttributes[shares[i].getPartIndex()],m_order));
-#endif
+    keyFrags[i] = m_pfc.mult(Placement::keyBase(m_P,m_Q),moddiv(shares[i].getShare(),m_privateAttributes[shares[i].getPartIndex()],m_order));
+    Placement::precompKeyFrag(m_pfc, keyFrags[i]);
 
     // DEBUG("Iter: " << i << " Share: " << shares[i].getShare() 
     // 	<< " Attribute: " << m_privateAttributes[shares[i].getPartIndex()]);
@@ -192,12 +182,8 @@ vector<G1> KPABE::makeKeyFrags(std::vector<ShareTuple> shares)
 // encryption takes a series of attributes it wants to encrypt to. The indices of these attributes are stored in the vector atts.
 // during encryption, we first get att_index to identify the proper index of each attribute frag we want to create.
 // then we access the corresponding public element by using this att_index to pick the element at the right position.
-#ifdef AttOnG1_KeyOnG2
-bool KPABE::encrypt_main_body(const vector<int> &atts, vector<G1>& attFrags, GT& blinder)
-#endif
-#ifdef AttOnG2_KeyOnG1
-  bool KPABE::encrypt_main_body(const vector<int> &atts, vector<G2>& attFrags, GT& blinder)
-#endif
+template <class Placement>
+bool KPABE<Placement>::encrypt_main_body(const vector<int> &atts, vector<AttGroup>& attFrags, GT& blinder)
 {
   attFrags.clear();
   //  guard("Attribute fragments should be an empty vector", attFrags.size() == 0);
@@ -216,21 +202,15 @@ bool KPABE::encrypt_main_body(const vector<int> &atts, vector<G1>& attFrags, GT&
     //    OUT("Attribute " << i << ": " << att_index);
     if (att_index >= m_nAttr) return false; 
     attFrags.push_back( m_pfc.mult(getPublicAttributes()[att_index],m_lastCTRandomness));
-#ifdef AttOnG2_KeyOnG1
-    m_pfc.precomp_for_pairing(attFrags[i]);  // precomputes on the G2 element
-#endif
+    Placement::precompAttFrag(m_pfc, attFrags[i]);
 
   }
   guard("Attribute fragments must be as many as attributes", atts.size() == attFrags.size());
   return true;
 }
 
-#ifdef AttOnG1_KeyOnG2
-bool KPABE::encryptS(const vector<int> &atts, const Big& M, Big& CT, vector<G1>& attFrags)
-#endif
-#ifdef AttOnG2_KeyOnG1
-bool KPABE::encryptS(const vector<int> &atts, const Big& M, Big& CT, vector<G2>& attFrags)
-#endif
+template <class Placement>
+bool KPABE<Placement>::encryptS(const vector<int> &atts, const Big& M, Big& CT, vector<AttGroup>& attFrags)
 {
   GT blinder;
   bool success = encrypt_main_body(atts, attFrags, blinder);
@@ -240,12 +220,8 @@ bool KPABE::encryptS(const vector<int> &atts, const Big& M, Big& CT, vector<G2>&
 }
 
 
-#ifdef AttOnG1_KeyOnG2
-bool KPABE::encrypt(const vector<int> &atts, const GT& M, GT& CT, vector<G1>& attFrags)
-#endif
-#ifdef AttOnG2_KeyOnG1
-bool KPABE::encrypt(const vector<int> &atts, const GT& M, GT& CT, vector<G2>& attFrags)
-#endif
+template <class Placement>
+bool KPABE<Placement>::encrypt(const vector<int> &atts, const GT& M, GT& CT, vector<AttGroup>& attFrags)
 {
   GT blinder;
   bool success = encrypt_main_body(atts, attFrags, blinder);
@@ -255,12 +231,8 @@ bool KPABE::encrypt(const vector<int> &atts, const GT& M, GT& CT, vector<G2>& at
 }
 
 
-#ifdef AttOnG1_KeyOnG2
-bool KPABE::decrypt_main_body(vector<G2> keyFrags, const vector<int>& atts, vector<G1>& attFrags, GT& blinder)
-#endif
-#ifdef AttOnG2_KeyOnG1
-  bool KPABE::decrypt_main_body(vector<G1> keyFrags, const vector<int>& atts, vector<G2>& attFrags, GT& blinder)
-#endif
+template <class Placement>
+bool KPABE<Placement>::decrypt_main_body(const vector<KeyGroup>& keyFrags, const vector<int>& atts, vector<AttGroup>& attFrags, GT& blinder)
 {
   // the first step in decryption is finding which key fragments (keyFrags) are covered by the attribute fragments (attFrags).
   // these are the fragments that have matching participants index. these indices for the attFrags are contained in the atts vector.
@@ -285,79 +257,48 @@ bool KPABE::decrypt_main_body(vector<G2> keyFrags, const vector<int>& atts, vect
   // but these are now split among two structures, the coveredShareIDs and the witnessSharesIndices vectors. These are then first brought together
   // before being passed to findCoefficient
 
-  vector<int> attFragIndices;
-  vector<int> keyFragIndices;
-  vector<std::string> coveredShareIDs;
+  DecryptWorkspace<Placement>& ws = getWorkspace();
+  ws.clear();
 
   debugVector("Ciphertext attributes", atts);
 
-  getPolicy()->obtainCoveredFrags(atts, attFragIndices, keyFragIndices, coveredShareIDs); // this computation is independent of the values of fragments themselves
+  ws.covered.assign(atts);
+  getPolicy()->obtainCoveredFrags(ws.covered, ws.attFragIndices, ws.keyFragIndices, ws.coveredShareIDs); // this computation is independent of the values of fragments themselves
 
-  debugVector("IDs of covered shares", coveredShareIDs);
-  debugVector("Indices for att fragments", attFragIndices);
-  debugVector("Indices for key fragments", keyFragIndices);
+  debugVector("IDs of covered shares", ws.coveredShareIDs);
+  debugVector("Indices for att fragments", ws.attFragIndices);
+  debugVector("Indices for key fragments", ws.keyFragIndices);
 
 
-  vector<int> witnessSharesIndices;
-  if (!getPolicy()->evaluateIDs(coveredShareIDs, witnessSharesIndices)) return false;
+  if (!getPolicy()->evaluateIDs(ws.coveredShareIDs, ws.witnessSharesIndices)) return false;
 
-  debugVector("witnessSharesIndices", witnessSharesIndices);
+  debugVector("witnessSharesIndices", ws.witnessSharesIndices);
 
-  vector<std::string> minimalShareIDs;
-  for (unsigned int i = 0; i < witnessSharesIndices.size(); i++) {
-    minimalShareIDs.push_back(coveredShareIDs[witnessSharesIndices[i]]);
+  for (unsigned int i = 0; i < ws.witnessSharesIndices.size(); i++) {
+    ws.minimalShareIDs.push_back(ws.coveredShareIDs[ws.witnessSharesIndices[i]]);
   }
-  
-  //  int countAtts = attFragIndices.size();  
-
-  //  vector<int> minimalParts(countAtts);
-//  for (int i = 0; i < countAtts; i++) {    
-//    minimalParts[i] = atts[attFragIndices[i]];
-//    //    DEBUG("Minimal Part[" << i << "]: " << minimalParts[i]);
-//  }
-//
 
-  int countAtts = witnessSharesIndices.size();  
-  G1 *g1[countAtts];
-  G2 *g2[countAtts];
+  int countAtts = ws.witnessSharesIndices.size();  
+  ws.reserve(countAtts); // the buffer gives the computed fragments an address that can be used by g1 or g2
 
-#ifdef AttOnG1_KeyOnG2
-  G1 bufferArray[countAtts]; // this is a temporary placeholder so that computed fragments can have an address that can be used by g1 or g2
-#endif
-#ifdef AttOnG2_KeyOnG1
-  G2 bufferArray[countAtts]; // this is a temporary placeholder so that computed fragments can have an address that can be used by g1 or g2
-#endif
-
-  vector<Big> coeffs = getPolicy()->findCoefficients(minimalShareIDs, m_order);
+  getPolicy()->findCoefficients(ws.minimalShareIDs, m_order, ws.coeffs);
   for (int i = 0; i < countAtts; i++) {    
-    Big coeff = coeffs[i];
-    int keyFragIndex = keyFragIndices[witnessSharesIndices[i]];
-    int attFragIndex = attFragIndices[witnessSharesIndices[i]];
-
-#ifdef AttOnG1_KeyOnG2
-    bufferArray[i] = m_pfc.mult(attFrags[attFragIndex], coeff); // necessary to fix an address that can be passed to g1.
-    g1[i] = &bufferArray[i];
-    g2[i] = &keyFrags[keyFragIndex];
-#endif
-#ifdef AttOnG2_KeyOnG1
-    bufferArray[i] = m_pfc.mult(attFrags[attFragIndex], coeff);
-    g1[i] = &keyFrags[keyFragIndex]; 
-    g2[i] = &bufferArray[i];
-#endif
+    int keyFragIndex = ws.keyFragIndices[ws.witnessSharesIndices[i]];
+    int attFragIndex = ws.attFragIndices[ws.witnessSharesIndices[i]];
+
+    ws.buffer[i] = m_pfc.mult(attFrags[attFragIndex], ws.coeffs[i]);
+    ws.g1[i] = Placement::pairingG1(&ws.buffer[i], &keyFrags[keyFragIndex]);
+    ws.g2[i] = Placement::pairingG2(&ws.buffer[i], &keyFrags[keyFragIndex]);
   }
 
-  blinder = m_pfc.multi_pairing(countAtts,g2,g1);
+  blinder = m_pfc.multi_pairing(countAtts,ws.g2.data(),ws.g1.data());
 
   return true;   
 
 }
   
-#ifdef AttOnG1_KeyOnG2
-bool KPABE::decryptS(vector<G2> keyFrags, const vector<int>& atts, const Big& CT,  vector<G1>& attFrags, Big& PT)
-#endif
-#ifdef AttOnG2_KeyOnG1
-  bool KPABE::decryptS(vector<G1> keyFrags, const vector<int>& atts, const Big& CT,  vector<G2>& attFrags, Big& PT)
-#endif
+template <class Placement>
+bool KPABE<Placement>::decryptS(const vector<KeyGroup>& keyFrags, const vector<int>& atts, const Big& CT,  vector<AttGroup>& attFrags, Big& PT)
 {
   GT blinder;
   bool success = decrypt_main_body(keyFrags, atts, attFrags, blinder);
@@ -368,12 +309,8 @@ bool KPABE::decryptS(vector<G2> keyFrags, const vector<int>& atts, const Big& CT
   return true;  
 }
 
-#ifdef AttOnG1_KeyOnG2
-bool KPABE::decrypt(vector<G2> keyFrags, const vector<int>& atts, const GT& CT,  vector<G1>& attFrags, GT& PT)
-#endif
-#ifdef AttOnG2_KeyOnG1
-  bool KPABE::decrypt(vector<G1> keyFrags, const vector<int>& atts, const GT& CT,  vector<G2>& attFrags, GT& PT)  
-#endif
+template <class Placement>
+bool KPABE<Placement>::decrypt(const vector<KeyGroup>& keyFrags, const vector<int>& atts, const GT& CT,  vector<AttGroup>& attFrags, GT& PT)
 {
   GT blinder;
   bool success = decrypt_main_body(keyFrags, atts, attFrags, blinder);
@@ -383,3 +320,34 @@ bool KPABE::decrypt(vector<G2> keyFrags, const vector<int>& atts, const GT& CT,
   return true;  
 
 }
+
+template <class Placement>
+void DecryptWorkspace<Placement>::reserve(unsigned int n)
+{
+  if (buffer.size() >= n) return;
+  g1.resize(n);
+  g2.resize(n);
+  buffer.resize(n);
+}
+
+template <class Placement>
+void DecryptWorkspace<Placement>::clear()
+{
+  attFragIndices.clear();
+  keyFragIndices.clear();
+  coveredShareIDs.clear();
+  witnessSharesIndices.clear();
+  minimalShareIDs.clear();
+}
+
+template <class Placement>
+DecryptWorkspace<Placement>& KPABE<Placement>::getWorkspace()
+{
+  static thread_local DecryptWorkspace<Placement> workspace;
+  return workspace;
+}
+
+template struct DecryptWorkspace<AttOnG1_KeyOnG2>;
+template struct DecryptWorkspace<AttOnG2_KeyOnG1>;
+template class KPABE<AttOnG1_KeyOnG2>;
+template class KPABE<AttOnG2_KeyOnG1>;
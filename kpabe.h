@@ -12,9 +12,115 @@
 
 #define DEF_KPABE
 
-#include "atts.h"
+/*
+  The scheme can place the public attributes (and hence the ciphertext's attribute fragments) in G1 and the key fragments in G2, or the other way around.
+  The two layouts have different costs for encryption and decryption, so the choice is made per instance: KPABE is a template on one of the two placement
+  structures below, and both instantiations are built into the library.
+  Each placement structure names the group of each kind of fragment, the base element from which that kind of fragment is computed, and the precomputations
+  that are worth doing on each kind of fragment. The pairing always takes the G1 element from one side and the G2 element from the other;
+  pairingG1 and pairingG2 pick them from an (attribute fragment, key fragment) pair. The key fragments are only read by the pairing, which still takes
+  non-const pointers, so they are given as const and their constness is dropped there.
+*/
+
+enum GroupPlacement {attOnG1, attOnG2};
+
+struct AttOnG1_KeyOnG2 {
+  typedef G1 AttGroup;
+  typedef G2 KeyGroup;
+  static const GroupPlacement placement = attOnG1;
+
+  static inline AttGroup& attBase(G1& P, G2&) {
+    return P;
+  }
+  static inline KeyGroup& keyBase(G1&, G2& Q) {
+    return Q;
+  }
+  static inline void precompAttFrag(PFC&, AttGroup&) {
+  }
+  static inline void precompKeyFrag(PFC& pfc, KeyGroup& frag) {
+    pfc.precomp_for_pairing(frag);  // precomputes on the G2 element
+  }
+  static inline G1* pairingG1(AttGroup* attFrag, const KeyGroup*) {
+    return attFrag;
+  }
+  static inline G2* pairingG2(AttGroup*, const KeyGroup* keyFrag) {
+    return const_cast<KeyGroup*>(keyFrag);
+  }
+  static inline std::string name() {
+    return "AttOnG1_KeyOnG2";
+  }
+};
+
+struct AttOnG2_KeyOnG1 {
+  typedef G2 AttGroup;
+  typedef G1 KeyGroup;
+  static const GroupPlacement placement = attOnG2;
 
+  static inline AttGroup& attBase(G1&, G2& Q) {
+    return Q;
+  }
+  static inline KeyGroup& keyBase(G1& P, G2&) {
+    return P;
+  }
+  static inline void precompAttFrag(PFC& pfc, AttGroup& frag) {
+    pfc.precomp_for_pairing(frag);  // precomputes on the G2 element
+  }
+  static inline void precompKeyFrag(PFC&, KeyGroup&) {
+  }
+  static inline G1* pairingG1(AttGroup*, const KeyGroup* keyFrag) {
+    return const_cast<KeyGroup*>(keyFrag);
+  }
+  static inline G2* pairingG2(AttGroup* attFrag, const KeyGroup*) {
+    return attFrag;
+  }
+  static inline std::string name() {
+    return "AttOnG2_KeyOnG1";
+  }
+};
+
+// reads a placement from its short name ("g1" or "g2", after the group of the attributes). Returns false if the name is not known.
+bool parsePlacement(const std::string& name, GroupPlacement& placement);
+
+// calls task.template run<Placement>() with the placement structure that corresponds to the value chosen at runtime
+template <class Task>
+void runWithPlacement(GroupPlacement placement, Task& task) {
+  switch (placement) {
+  case attOnG1: task.template run<AttOnG1_KeyOnG2>(); break;
+  case attOnG2: task.template run<AttOnG2_KeyOnG1>(); break;
+  }
+}
+
+/*
+  Buffers used by decryption. The pairing takes arrays of pointers to the G1 and G2 elements, and the attribute fragments raised to their coefficients
+  must have an address for those pointers. The buffers are kept per thread and per placement, and are only grown, up to the largest witness set seen, so
+  that in steady state a decryption does not allocate them again. They also keep the attributes of the ciphertext, the indices of covered fragments
+  and the IDs of the witness shares, with their coefficients.
+*/
+template <class Placement>
+struct DecryptWorkspace {
+  vector<G1*> g1;
+  vector<G2*> g2;
+  vector<typename Placement::AttGroup> buffer;
+
+  CoveredSet covered;
+  vector<int> attFragIndices;
+  vector<int> keyFragIndices;
+  vector<ShareID> coveredShareIDs;
+  vector<int> witnessSharesIndices;
+  vector<ShareID> minimalShareIDs;
+  vector<Big> coeffs;
+
+  void reserve(unsigned int n); // makes room for a witness set of n shares
+  void clear(); // empties the index vectors, keeping their capacity
+};
+
+template <class Placement>
 class KPABE {
+ public:
+  typedef typename Placement::AttGroup AttGroup;
+  typedef typename Placement::KeyGroup KeyGroup;
+
+ private:
   shared_ptr<SecretSharing> m_scheme;
   PFC& m_pfc;
   unsigned int m_nAttr;
@@ -24,36 +130,23 @@ class KPABE {
   Big m_order;
 
   vector<Big> m_privateAttributes;
-
-#ifdef AttOnG1_KeyOnG2
-  vector<G1> m_publicAtts;
-#endif
-#ifdef AttOnG2_KeyOnG1
-  vector<G2> m_publicAtts;
-#endif
+  vector<AttGroup> m_publicAtts;
 
   G1 m_P;
-  G2 m_Q; 
+  G2 m_Q;
   GT m_publicCTBlinder;
 
-#ifdef AttOnG1_KeyOnG2
-  vector<G2> makeKeyFrags(std::vector<ShareTuple> shares);
-  bool encrypt_main_body(const vector<int> &atts, vector<G1>& attFrags, GT& blinder);
-  bool decrypt_main_body(vector<G2> keyFrags, const vector<int>& atts, vector<G1>& attFrags, GT& blinder);
-#endif
-#ifdef AttOnG2_KeyOnG1
-  vector<G1> makeKeyFrags(std::vector<ShareTuple> shares);
-  bool encrypt_main_body(const vector<int> &atts, vector<G2>& attFrags, GT& blinder);
-  bool decrypt_main_body(vector<G1> keyFrags, const vector<int>& atts, vector<G2>& attFrags, GT& blinder);
-#endif
-
+  vector<KeyGroup> makeKeyFrags(std::vector<ShareTuple> shares);
+  bool encrypt_main_body(const vector<int> &atts, vector<AttGroup>& attFrags, GT& blinder);
+  bool decrypt_main_body(const vector<KeyGroup>& keyFrags, const vector<int>& atts, vector<AttGroup>& attFrags, GT& blinder);
 
+  static DecryptWorkspace<Placement>& getWorkspace(); // the workspace of the calling thread
 
 public:
 
   KPABE(PFC &pfc, int nAttr);
   KPABE(shared_ptr<SecretSharing> scheme, PFC &pfc, int nAttr);
-  void paramsgen(G1& P, G2& Q, Big& order);  
+  void paramsgen(G1& P, G2& Q, Big& order);
   unsigned int numberAttr() const;
   void setup();
   vector<Big>& getPrivateAttributes() ;
@@ -69,27 +162,24 @@ public:
     return m_scheme->getPolicy();
   }
 
+  inline GroupPlacement getPlacement() const {
+    return Placement::placement;
+  }
 
-#ifdef AttOnG1_KeyOnG2
-  vector<G1>& getPublicAttributes() ;
-  vector<G2> genKey();
-  vector<G2> genKey(vector<Big> randomness);
-  bool encrypt(const vector<int> &atts, const GT& M, GT& CT, vector<G1>& attFrags);
-  bool encryptS(const vector<int> &atts, const Big& M, Big& CT, vector<G1>& attFrags);
-  bool decrypt(vector<G2> keyFrags, const vector<int>& atts, const GT& CT,  vector<G1>& attFrags, GT& PT);
-  bool decryptS(vector<G2> keyFrags, const vector<int>& atts, const Big& CT,  vector<G1>& attFrags, Big& PT);
-#endif
-
-#ifdef AttOnG2_KeyOnG1
-  vector<G2>& getPublicAttributes() ;
-  vector<G1> genKey();
-  vector<G1> genKey(vector<Big> randomness);
-  bool encrypt(const vector<int> &atts, const GT& M, GT& CT, vector<G2>& attFrags);
-  bool encryptS(const vector<int> &atts, const Big& M, Big& CT, vector<G2>& attFrags);
-  bool decrypt(vector<G1> keyFrags, const vector<int>& atts, const GT& CT,  vector<G2>& attFrags, GT& PT);
-  bool decryptS(vector<G1> keyFrags, const vector<int>& atts, const Big& CT,  vector<G2>& attFrags, Big& PT);
-#endif
+  vector<AttGroup>& getPublicAttributes() ;
+  vector<KeyGroup> genKey();
+  vector<KeyGroup> genKey(vector<Big> randomness);
+  vector<KeyGroup> genKeyFromSeed(const vector<char>& seed); // reproduces the key of a distribution from its seed (SecretSharing::getLastSeed)
+  bool encrypt(const vector<int> &atts, const GT& M, GT& CT, vector<AttGroup>& attFrags);
+  bool encryptS(const vector<int> &atts, const Big& M, Big& CT, vector<AttGroup>& attFrags);
+  bool decrypt(const vector<KeyGroup>& keyFrags, const vector<int>& atts, const GT& CT,  vector<AttGroup>& attFrags, GT& PT);
+  bool decryptS(const vector<KeyGroup>& keyFrags, const vector<int>& atts, const Big& CT,  vector<AttGroup>& attFrags, Big& PT);
 };
 
+// both placements are instantiated in kpabe.cpp
+extern template struct DecryptWorkspace<AttOnG1_KeyOnG2>;
+extern template struct DecryptWorkspace<AttOnG2_KeyOnG1>;
+extern template class KPABE<AttOnG1_KeyOnG2>;
+extern template class KPABE<AttOnG2_KeyOnG1>;
 
 
@@ -0,0 +1,347 @@
+/*
+  Testbed for empirical evaluation of KP-ABE schemes, according to Crampton, Pinto (CSF2014).
+  Code by: Alexandre Miranda Pinto
+
+  This file implements the binary format of policies and the policy cache declared in policycache.h
+*/
+
+#ifndef DEF_POLICY_CACHE
+#include "policycache.h"
+#endif
+
+#include <fstream>
+#include <cstdio>
+#include <unistd.h>
+
+bool PolicyCodec::kindOf(shared_ptr<AccessPolicy> policy, PolicyKind &kind) {
+  if (std::dynamic_pointer_cast<BLAccessPolicy>(policy)) {
+    kind = blPolicy;
+    return true;
+  }
+  if (std::dynamic_pointer_cast<ShTreeAccessPolicy>(policy)) {
+    kind = shTreePolicy;
+    return true;
+  }
+  return false;
+}
+
+std::string PolicyCodec::descriptionOf(shared_ptr<AccessPolicy> policy) {
+  shared_ptr<BLAccessPolicy> blPolicy = std::dynamic_pointer_cast<BLAccessPolicy>(policy);
+  if (blPolicy) return blPolicy->getDescription();
+  shared_ptr<ShTreeAccessPolicy> treePolicy = std::dynamic_pointer_cast<ShTreeAccessPolicy>(policy);
+  if (treePolicy) return treePolicy->getDescription();
+  return "";
+}
+
+shared_ptr<AccessPolicy> PolicyCodec::compile(PolicyKind kind, const std::string &description, const vector<int> &parts) {
+  switch (kind) {
+  case blPolicy: return make_shared<BLAccessPolicy>(description, parts);
+  case shTreePolicy: return make_shared<ShTreeAccessPolicy>(description, parts);
+  }
+  stringstream ss;
+  ss << ERR_BAD_POLICY << ": unknown kind of policy: " << kind << std::endl;
+  throw std::runtime_error(ss.str());
+}
+
+void PolicyCodec::serialize(shared_ptr<AccessPolicy> policy, vector<char> &out) {
+  PolicyKind kind;
+  guard("PolicyCodec: the type of policy is not known to the codec", kindOf(policy, kind));
+  BinaryWriter writer(out);
+  writer.putUInt(MAGIC);
+  writer.putUInt(VERSION);
+  writer.putByte(kind);
+  switch (kind) {
+  case blPolicy: std::dynamic_pointer_cast<BLAccessPolicy>(policy)->writeBinary(writer); break;
+  case shTreePolicy: std::dynamic_pointer_cast<ShTreeAccessPolicy>(policy)->writeBinary(writer); break;
+  }
+}
+
+shared_ptr<AccessPolicy> PolicyCodec::deserialize(const vector<char> &in) {
+  BinaryReader reader(in);
+  if (reader.getUInt() != MAGIC) reader.fail("not a binary policy");
+  if (reader.getUInt() != VERSION) reader.fail("unknown version of the binary policy");
+  shared_ptr<AccessPolicy> policy;
+  switch (reader.getByte()) {
+  case blPolicy: policy = BLAccessPolicy::readBinary(reader); break;
+  case shTreePolicy: policy = ShTreeAccessPolicy::readBinary(reader); break;
+  default: reader.fail("unknown kind of policy");
+  }
+  if (!reader.atEnd()) reader.fail("content beyond the end of the policy");
+  return policy;
+}
+
+//==============================================
+
+PolicyCache::PolicyCache(const std::string &dir):
+  m_dir(dir), m_hits(0), m_misses(0)
+{}
+
+// the version is part of the key, so that entries in an older format are never read
+std::string PolicyCache::key(PolicyKind kind, const std::string &description, const vector<int> &parts) {
+  vector<char> input;
+  BinaryWriter writer(input);
+  writer.putUInt(PolicyCodec::VERSION);
+  writer.putByte(kind);
+  writer.putString(description);
+  writer.putInts(parts);
+
+  sha256 sh;
+  shs256_init(&sh);
+  for (unsigned int i = 0; i < input.size(); i++) {
+    shs256_process(&sh, input[i]);
+  }
+  char digest[32];
+  shs256_hash(&sh, digest);
+
+  static const char hex[] = "0123456789abcdef";
+  std::string key;
+  for (unsigned int i = 0; i < 32; i++) {
+    key += hex[(digest[i] >> 4) & 0xF];
+    key += hex[digest[i] & 0xF];
+  }
+  return key;
+}
+
+std::string PolicyCache::path(const std::string &key) const {
+  return m_dir + "/" + key + ".pol";
+}
+
+bool PolicyCache::readFile(const std::string &path, vector<char> &data) {
+  std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+  if (!file) return false;
+  std::streamoff size = file.tellg();
+  if (size < 0) return false;
+  data.resize(size);
+  file.seekg(0);
+  if (size > 0) file.read(&data[0], size);
+  return (bool) file;
+}
+
+bool PolicyCache::writeFile(const std::string &path, const vector<char> &data) const {
+  static std::atomic<unsigned int> counter(0);
+  std::string tmp = path + ".tmp." + convertIntToStr(getpid()) + "." + convertIntToStr(counter++);
+  {
+    std::ofstream file(tmp.c_str(), std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+    if (!data.empty()) file.write(&data[0], data.size());
+    if (!file) {
+      file.close();
+      std::remove(tmp.c_str());
+      return false;
+    }
+  }
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+// an entry is only used if it holds the policy that was asked for, which also guards against a damaged file that happens to parse
+shared_ptr<AccessPolicy> PolicyCache::load(PolicyKind kind, const std::string &description, const vector<int> &parts) {
+  std::string file = path(key(kind, description, parts));
+  vector<char> data;
+  if (readFile(file, data)) {
+    try {
+      shared_ptr<AccessPolicy> policy = PolicyCodec::deserialize(data);
+      PolicyKind storedKind;
+      if (PolicyCodec::kindOf(policy, storedKind) && (storedKind == kind) && (PolicyCodec::descriptionOf(policy) == description)
+	  && (policy->getParticipants() == parts)) {
+	m_hits++;
+	return policy;
+      }
+    } catch (std::runtime_error &e) {
+      DEBUG("PolicyCache: discarding entry " << file << ": " << e.what());
+    }
+  }
+
+  m_misses++;
+  shared_ptr<AccessPolicy> policy = PolicyCodec::compile(kind, description, parts);
+  data.clear();
+  PolicyCodec::serialize(policy, data);
+  writeFile(file, data); // a cache that can not be written only costs the next load a compilation
+  return policy;
+}
+
+shared_ptr<AccessPolicy> PolicyCache::load(PolicyKind kind, const std::string &description, const int n) {
+  vector<int> parts;
+  for (int i = 1; i <= n; i++) {
+    parts.push_back(i);
+  }
+  return load(kind, description, parts);
+}
+
+unsigned int PolicyCache::getHits() const {
+  return m_hits;
+}
+
+unsigned int PolicyCache::getMisses() const {
+  return m_misses;
+}
+
+//==============================================
+
+PolicyRegistry::PolicyRegistry(PolicyCache *cache):
+  m_cache(cache), m_sweepAt(MIN_SWEEP), m_hits(0), m_misses(0)
+{}
+
+PolicyRegistry& PolicyRegistry::global() {
+  static PolicyRegistry registry;
+  return registry;
+}
+
+std::string PolicyRegistry::textKey(PolicyKind kind, const std::string &description, const vector<int> &parts) {
+  stringstream ss;
+  ss << kind << ":";
+  for (unsigned int i = 0; i < parts.size(); i++) {
+    ss << parts[i] << ",";
+  }
+  ss << ":" << description;
+  return ss.str();
+}
+
+bool PolicyRegistry::samePolicy(const shared_ptr<AccessPolicy> &a, const shared_ptr<AccessPolicy> &b) {
+  shared_ptr<BLAccessPolicy> blA = std::dynamic_pointer_cast<BLAccessPolicy>(a);
+  shared_ptr<BLAccessPolicy> blB = std::dynamic_pointer_cast<BLAccessPolicy>(b);
+  if (blA && blB) return *blA == *blB;
+  shared_ptr<ShTreeAccessPolicy> treeA = std::dynamic_pointer_cast<ShTreeAccessPolicy>(a);
+  shared_ptr<ShTreeAccessPolicy> treeB = std::dynamic_pointer_cast<ShTreeAccessPolicy>(b);
+  if (treeA && treeB) return *treeA == *treeB;
+  return false;
+}
+
+shared_ptr<AccessPolicy> PolicyRegistry::findStructure(const shared_ptr<AccessPolicy> &policy) const {
+  std::pair<StructureTable::const_iterator, StructureTable::const_iterator> range = m_byStructure.equal_range(policy->getStructuralHash());
+  for (StructureTable::const_iterator it = range.first; it != range.second; ++it) {
+    shared_ptr<AccessPolicy> live = it->second.lock();
+    if (live && samePolicy(live, policy)) return live;
+  }
+  return shared_ptr<AccessPolicy>();
+}
+
+void PolicyRegistry::add(const std::string &key, const shared_ptr<AccessPolicy> &policy, bool newStructure) {
+  if (!key.empty()) {
+    m_byText[key] = policy;
+  }
+  if (newStructure) {
+    m_byStructure.insert(StructureTable::value_type(policy->getStructuralHash(), policy));
+  }
+  if (m_byText.size() + m_byStructure.size() >= m_sweepAt) {
+    sweep();
+  }
+}
+
+// the next sweep waits until the live entries have doubled, so that the cost of the sweeps is spread over the insertions
+void PolicyRegistry::sweep() {
+  for (TextTable::iterator it = m_byText.begin(); it != m_byText.end(); ) {
+    if (it->second.expired()) {
+      m_byText.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+  for (StructureTable::iterator it = m_byStructure.begin(); it != m_byStructure.end(); ) {
+    if (it->second.expired()) {
+      m_byStructure.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+  m_sweepAt = 2 * (m_byText.size() + m_byStructure.size());
+  if (m_sweepAt < MIN_SWEEP) {
+    m_sweepAt = MIN_SWEEP;
+  }
+}
+
+shared_ptr<AccessPolicy> PolicyRegistry::intern(PolicyKind kind, const std::string &description, const vector<int> &parts) {
+  std::string key = textKey(kind, description, parts);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    TextTable::iterator it = m_byText.find(key);
+    if (it != m_byText.end()) {
+      shared_ptr<AccessPolicy> live = it->second.lock();
+      if (live) {
+	m_hits++;
+	return live;
+      }
+    }
+  }
+
+  shared_ptr<AccessPolicy> compiled = m_cache ? m_cache->load(kind, description, parts) : PolicyCodec::compile(kind, description, parts);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  TextTable::iterator it = m_byText.find(key); // another thread may have interned the same text while this one compiled
+  if (it != m_byText.end()) {
+    shared_ptr<AccessPolicy> live = it->second.lock();
+    if (live) {
+      m_hits++;
+      return live;
+    }
+  }
+  shared_ptr<AccessPolicy> existing = findStructure(compiled);
+  if (existing) {
+    m_hits++;
+    add(key, existing, false);
+    return existing;
+  }
+  m_misses++;
+  add(key, compiled, true);
+  return compiled;
+}
+
+shared_ptr<AccessPolicy> PolicyRegistry::intern(PolicyKind kind, const std::string &description, const int n) {
+  vector<int> parts;
+  for (int i = 1; i <= n; i++) {
+    parts.push_back(i);
+  }
+  return intern(kind, description, parts);
+}
+
+shared_ptr<AccessPolicy> PolicyRegistry::intern(shared_ptr<AccessPolicy> policy) {
+  PolicyKind kind;
+  if (!PolicyCodec::kindOf(policy, kind)) return policy; // can not be compared with other policies
+  std::string key = textKey(kind, PolicyCodec::descriptionOf(policy), policy->getParticipants());
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  shared_ptr<AccessPolicy> existing = findStructure(policy);
+  if (existing) {
+    m_hits++;
+    add(key, existing, false);
+    return existing;
+  }
+  m_misses++;
+  add(key, policy, true);
+  return policy;
+}
+
+shared_ptr<BLAccessPolicy> PolicyRegistry::internBL(const std::string &description, const vector<int> &parts) {
+  return std::dynamic_pointer_cast<BLAccessPolicy>(intern(blPolicy, description, parts));
+}
+
+shared_ptr<ShTreeAccessPolicy> PolicyRegistry::internShTree(const std::string &description, const vector<int> &parts) {
+  return std::dynamic_pointer_cast<ShTreeAccessPolicy>(intern(shTreePolicy, description, parts));
+}
+
+unsigned int PolicyRegistry::size() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  unsigned int count = 0;
+  for (StructureTable::const_iterator it = m_byStructure.begin(); it != m_byStructure.end(); ++it) {
+    if (!it->second.expired()) count++;
+  }
+  return count;
+}
+
+void PolicyRegistry::purge() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  sweep();
+}
+
+unsigned int PolicyRegistry::getHits() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_hits;
+}
+
+unsigned int PolicyRegistry::getMisses() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_misses;
+}
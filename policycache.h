@@ -0,0 +1,125 @@
+/*
+  Testbed for empirical evaluation of KP-ABE schemes, according to Crampton, Pinto (CSF2014).
+  Code by: Alexandre Miranda Pinto
+
+  This file declares a binary format for compiled policies and an on-disk cache of policies in that format.
+  Building a policy from its description means parsing it and compiling the result: for ShTree, the parse tree and the flat node array with the layout of
+  the shares and of the randomness; for BL, the minimal sets and their order by size. A process that loads many keys does this over and over for the same
+  few descriptions. The binary form holds the compiled structures themselves, so that reading a policy back is a sequence of array reads.
+
+  There are three classes declared here:
+  - PolicyCodec: writes a policy to its binary form and reads it back. The form starts with a magic number, a version and the kind of policy
+  - PolicyCache: a directory of binary policies, content-addressed by a hash of the kind, the description and the participants. A policy that is not in
+    the cache is compiled from its description and written there, so that the next load reads it
+  - PolicyRegistry: the policies in use by the process, interned, so that all the keys with the same policy share one compiled object
+*/
+
+#define DEF_POLICY_CACHE
+
+#ifndef DEF_UTILS
+#include "utils.h"
+#endif
+
+#ifndef DEF_SECRET_SHARING
+#include "secretsharing.h"
+#endif
+
+#ifndef DEF_BL_CANON
+#include "BLcanonical.h"
+#endif
+
+#ifndef DEF_SH_TREE
+#include "ShTree.h"
+#endif
+
+#include <atomic>
+#include <mutex>
+
+enum PolicyKind {blPolicy = 1, shTreePolicy = 2};
+
+class PolicyCodec {
+ public:
+  static const unsigned int MAGIC = 0x4C4F504B; // "KPOL", as written least significant byte first
+  static const unsigned int VERSION = 1;
+
+  static bool kindOf(shared_ptr<AccessPolicy> policy, PolicyKind &kind); // false if the type of policy is not known to the codec
+  static std::string descriptionOf(shared_ptr<AccessPolicy> policy);
+  static shared_ptr<AccessPolicy> compile(PolicyKind kind, const std::string &description, const vector<int> &parts);
+
+  static void serialize(shared_ptr<AccessPolicy> policy, vector<char> &out); // appends the binary form to out
+  static shared_ptr<AccessPolicy> deserialize(const vector<char> &in); // throws an ERR_BAD_SERIAL runtime_error on any malformed input
+};
+
+//=============================================================================
+
+/*
+  Entries are written to a temporary file and then renamed, so that a reader, in this process or in another one, sees either the whole entry or no entry.
+  An entry that can not be read, or that was written for another policy, is compiled again and replaced. The directory must exist.
+*/
+class PolicyCache {
+  std::string m_dir;
+  std::atomic<unsigned int> m_hits;
+  std::atomic<unsigned int> m_misses;
+
+  static bool readFile(const std::string &path, vector<char> &data);
+  bool writeFile(const std::string &path, const vector<char> &data) const;
+
+ public:
+  PolicyCache(const std::string &dir);
+  static std::string key(PolicyKind kind, const std::string &description, const vector<int> &parts); // the SHA-256 of the inputs, in hexadecimal
+  std::string path(const std::string &key) const;
+  shared_ptr<AccessPolicy> load(PolicyKind kind, const std::string &description, const vector<int> &parts);
+  shared_ptr<AccessPolicy> load(PolicyKind kind, const std::string &description, const int n); // participants numbered from 1 to n
+  unsigned int getHits() const;
+  unsigned int getMisses() const;
+};
+
+//=============================================================================
+
+/*
+  Schemes read their policy but never change it, so every key with the same policy can hold the same object. The registry gives out one live object for
+  each policy, and only builds a policy when no key holds it.
+  A request is looked up first by its text (the kind, the description and the participants), which finds a repeated description without parsing it.
+  A new text is compiled, through the policy cache if the registry has one, and then looked up by structure (the structural hash, then operator==), so
+  that descriptions that only differ in white space or in the way they write a gate also share one object.
+  The registry holds its policies weakly: a policy lives as long as some key holds it, and is built again if it is asked for after that. The entries of
+  released policies are swept when the tables have doubled since the last sweep, or by purge.
+  A mutex guards the tables. Compilation happens outside it, and when two threads compile the same policy at once the first one to finish is kept.
+  Interned policies must not be changed: BLAccessPolicy::setMinimalSetChoice, in particular, would change the policy of every key. A caller that needs
+  another setting copies the policy.
+*/
+class PolicyRegistry {
+  typedef std::map<std::string, weak_ptr<AccessPolicy> > TextTable;
+  typedef std::multimap<StructuralHash, weak_ptr<AccessPolicy> > StructureTable;
+
+  TextTable m_byText;
+  StructureTable m_byStructure;
+  PolicyCache *m_cache;
+  unsigned int m_sweepAt; // the size of the tables that triggers the next sweep
+  unsigned int m_hits; // requests answered by a live policy, by text or by structure
+  unsigned int m_misses;
+  mutable std::mutex m_mutex;
+
+  static std::string textKey(PolicyKind kind, const std::string &description, const vector<int> &parts);
+  static bool samePolicy(const shared_ptr<AccessPolicy> &a, const shared_ptr<AccessPolicy> &b);
+  shared_ptr<AccessPolicy> findStructure(const shared_ptr<AccessPolicy> &policy) const; // the live policy equal to this one, if any
+  void add(const std::string &key, const shared_ptr<AccessPolicy> &policy, bool newStructure); // key may be empty, for a policy without a text
+  void sweep(); // drops the entries of released policies
+
+ public:
+  static const unsigned int MIN_SWEEP = 64;
+
+  PolicyRegistry(PolicyCache *cache = NULL); // the cache, if given, must outlive the registry
+  static PolicyRegistry& global(); // the registry of the process. It compiles without a policy cache
+
+  shared_ptr<AccessPolicy> intern(PolicyKind kind, const std::string &description, const vector<int> &parts);
+  shared_ptr<AccessPolicy> intern(PolicyKind kind, const std::string &description, const int n); // participants numbered from 1 to n
+  shared_ptr<AccessPolicy> intern(shared_ptr<AccessPolicy> policy); // the live policy equal to this one, or this one, which is then registered
+  shared_ptr<BLAccessPolicy> internBL(const std::string &description, const vector<int> &parts);
+  shared_ptr<ShTreeAccessPolicy> internShTree(const std::string &description, const vector<int> &parts);
+
+  unsigned int size() const; // the number of live policies
+  void purge();
+  unsigned int getHits() const;
+  unsigned int getMisses() const;
+};
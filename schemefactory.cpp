@@ -0,0 +1,203 @@
+/*
+  Testbed for empirical evaluation of KP-ABE schemes, according to Crampton, Pinto (CSF2014).
+  Code by: Alexandre Miranda Pinto
+
+  This file implements the conversion to minimal sets, the cost model and the scheme factory declared in schemefactory.h
+*/
+
+#ifndef DEF_SCHEME_FACTORY
+#include "schemefactory.h"
+#endif
+
+#include <algorithm>
+#include <iterator>
+
+typedef vector<vector<int> > SetList;
+
+// drops the repeated sets and those that contain another set. The first copy of each remaining set keeps its place
+static void minimize(SetList& sets) {
+  SetList kept;
+  for (unsigned int i = 0; i < sets.size(); i++) {
+    bool absorbed = false;
+    for (unsigned int j = 0; (j < sets.size()) && !absorbed; j++) {
+      if ((i == j) || (sets[j].size() > sets[i].size())) continue;
+      if (std::includes(sets[i].begin(), sets[i].end(), sets[j].begin(), sets[j].end())) {
+	// of two equal sets, the later one is dropped
+	absorbed = (sets[j].size() < sets[i].size()) || (j < i);
+      }
+    }
+    if (!absorbed) {
+      kept.push_back(sets[i]);
+    }
+  }
+  sets.swap(kept);
+}
+
+// the unions of every set of a with every set of b. False if there would be more than maxProduct of them
+static bool product(const SetList& a, const SetList& b, SetList& result, unsigned int maxProduct) {
+  result.clear();
+  if ((unsigned long long) a.size() * b.size() > maxProduct) return false;
+  for (unsigned int i = 0; i < a.size(); i++) {
+    for (unsigned int j = 0; j < b.size(); j++) {
+      vector<int> joined;
+      std::set_union(a[i].begin(), a[i].end(), b[j].begin(), b[j].end(), std::back_inserter(joined));
+      result.push_back(joined);
+    }
+  }
+  return true;
+}
+
+static bool convertNode(shared_ptr<TreeNode> node, SetList& sets, unsigned int maxSets) {
+  sets.clear();
+  if (node->isNil()) {
+    return true;
+  }
+  if (node->isLeaf()) {
+    sets.push_back(vector<int>(1, node->getNode()->getLeafValue()));
+    return true;
+  }
+
+  // chosen[c] holds the sets of the ways of satisfying c of the children seen so far. Counts that the remaining children can not bring up to the
+  // threshold are not computed. A product is allowed to grow past maxSets before it is minimized
+  unsigned int threshold = node->getThreshold();
+  unsigned int numChildren = node->getNumChildren();
+  unsigned int maxProduct = maxSets * maxSets;
+  vector<SetList> chosen(threshold + 1);
+  chosen[0].push_back(vector<int>());
+  SetList childSets, joined;
+  for (unsigned int i = 0; i < numChildren; i++) {
+    if (!convertNode(node->getChild(i), childSets, maxSets)) return false;
+    unsigned int remaining = numChildren - 1 - i;
+    unsigned int lowest = (threshold > remaining + 1) ? threshold - remaining : 1;
+    for (unsigned int c = std::min(i + 1, threshold); c >= lowest; c--) {
+      if (!product(chosen[c-1], childSets, joined, maxProduct)) return false;
+      addVector(chosen[c], joined);
+      minimize(chosen[c]);
+      if (chosen[c].size() > maxSets) return false;
+    }
+  }
+  sets.swap(chosen[threshold]);
+  return true;
+}
+
+bool DNFConverter::toMinimalSets(shared_ptr<TreeNode> tree, vector<vector<int> >& sets, unsigned int maxSets) {
+  if (!convertNode(tree, sets, maxSets)) return false;
+  for (unsigned int i = 0; i < sets.size(); i++) {
+    if (sets[i].empty()) return false;
+  }
+  return true;
+}
+
+std::string DNFConverter::toDescription(const vector<vector<int> >& sets) {
+  if (sets.empty()) {
+    return "";
+  }
+  stringstream ss;
+  ss << op_OR << "(";
+  for (unsigned int i = 0; i < sets.size(); i++) {
+    ss << op_AND << "(";
+    for (unsigned int j = 0; j < sets[i].size(); j++) {
+      ss << sets[i][j];
+      if (j < sets[i].size() - 1) ss << ",";
+    }
+    ss << ")";
+    if (i < sets.size() - 1) ss << ",";
+  }
+  ss << ")";
+  return ss.str();
+}
+
+//==============================================
+
+// the times, in milliseconds, are those of the key generation and decryption tasks of the reports, for policies of 8 leaves
+CostWeights::CostWeights():
+  keyFragmentTime(1.9),
+  pairingTime(1.72),
+  exponentiationTime(0.33),
+  decryptBaseTime(3.3),
+  keygenWeight(1),
+  decryptWeight(1)
+{}
+
+CostModel::CostModel(const CostWeights& weights):
+  m_weights(weights)
+{}
+
+void CostModel::estimateTimes(SchemeCost& cost) const {
+  cost.keygenTime = cost.keyFragments * m_weights.keyFragmentTime;
+  cost.decryptTime = m_weights.decryptBaseTime + cost.decryptPairings * m_weights.pairingTime + cost.decryptExponentiations * m_weights.exponentiationTime;
+}
+
+// BL reconstructs by adding the shares of one minimal set, so its coefficients are all 1
+SchemeCost CostModel::estimateBL(const vector<vector<int> >& sets) const {
+  SchemeCost cost;
+  cost.keyFragments = 0;
+  cost.randomness = 0;
+  cost.decryptPairings = 0;
+  cost.decryptExponentiations = 0;
+  for (unsigned int i = 0; i < sets.size(); i++) {
+    cost.keyFragments += sets[i].size();
+    cost.randomness += sets[i].size() - 1;
+    if ((i == 0) || (sets[i].size() < cost.decryptPairings)) {
+      cost.decryptPairings = sets[i].size();
+    }
+  }
+  estimateTimes(cost);
+  return cost;
+}
+
+SchemeCost CostModel::estimateShTree(shared_ptr<TreeNode> tree) const {
+  const TreeStats &stats = tree->getStats();
+  SchemeCost cost;
+  cost.keyFragments = stats.numLeaves;
+  cost.randomness = stats.numRandomness;
+  cost.decryptPairings = (stats.minSatisfyingSet == TreeStats::UNSATISFIABLE) ? 0 : stats.minSatisfyingSet;
+  cost.decryptExponentiations = cost.decryptPairings;
+  estimateTimes(cost);
+  return cost;
+}
+
+double CostModel::score(const SchemeCost& cost) const {
+  return m_weights.keygenWeight * cost.keygenTime + m_weights.decryptWeight * cost.decryptTime;
+}
+
+//==============================================
+
+SchemeFactory::Choice SchemeFactory::choose(const std::string& description, const CostModel& model, unsigned int maxSets) {
+  TreeArena arena;
+  ShTreeAccessPolicy::parseIntoArena(description, arena);
+  shared_ptr<TreeNode> tree = TreeOptimizer::optimize(arena.toTree());
+
+  Choice choice;
+  choice.kind = shTreePolicy;
+  choice.description = TreeOptimizer::toDescription(tree);
+  choice.treeCost = model.estimateShTree(tree);
+
+  vector<vector<int> > sets;
+  choice.blFeasible = DNFConverter::toMinimalSets(tree, sets, maxSets);
+  if (choice.blFeasible) {
+    choice.blCost = model.estimateBL(sets);
+    // on a tie, BL is kept, since its decryption does not compute coefficients
+    if (model.score(choice.blCost) <= model.score(choice.treeCost)) {
+      choice.kind = blPolicy;
+      choice.description = DNFConverter::toDescription(sets);
+    }
+  }
+  DEBUG("SchemeFactory: " << description << " -> " << ((choice.kind == blPolicy) ? "BL " : "ShTree ") << choice.description);
+  return choice;
+}
+
+shared_ptr<AccessPolicy> SchemeFactory::makePolicy(const Choice& choice, const vector<int>& parts) {
+  return PolicyCodec::compile(choice.kind, choice.description, parts);
+}
+
+shared_ptr<SecretSharing> SchemeFactory::makeScheme(const Choice& choice, const vector<int>& parts, PFC& pfc) {
+  if (choice.kind == blPolicy) {
+    return make_shared<BLSS>(make_shared<BLAccessPolicy>(choice.description, parts), pfc);
+  }
+  return make_shared<ShTreeSS>(make_shared<ShTreeAccessPolicy>(choice.description, parts), pfc);
+}
+
+shared_ptr<SecretSharing> SchemeFactory::makeScheme(const std::string& description, const vector<int>& parts, PFC& pfc) {
+  return makeScheme(choose(description), parts, pfc);
+}
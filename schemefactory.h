@@ -0,0 +1,113 @@
+/*
+  Testbed for empirical evaluation of KP-ABE schemes, according to Crampton, Pinto (CSF2014).
+  Code by: Alexandre Miranda Pinto
+
+  This file declares the automatic choice between the two secret sharing schemes of the library.
+  BL shares over the minimal sets of a policy in disjunctive normal form, and its decryption needs no Lagrange coefficients; ShTree shares over the policy
+  tree, which can be exponentially smaller than the minimal sets when the tree has thresholds or ANDs of ORs. Which one is cheaper depends on the shape of
+  the policy, so the choice is made per policy, from an estimate of the cost of each scheme.
+
+  There are three classes declared here:
+  - DNFConverter: converts a policy tree to its minimal sets, when there are not too many of them, and writes the minimal sets as a BL description
+  - CostModel: estimates the key size, the key generation time and the decryption work of a policy in each scheme
+  - SchemeFactory: optimizes a policy, estimates both schemes and builds the cheaper one
+*/
+
+#define DEF_SCHEME_FACTORY
+
+#ifndef DEF_UTILS
+#include "utils.h"
+#endif
+
+#ifndef DEF_BL_CANON
+#include "BLcanonical.h"
+#endif
+
+#ifndef DEF_SH_TREE
+#include "ShTree.h"
+#endif
+
+#ifndef DEF_POLICY_CACHE
+#include "policycache.h"
+#endif
+
+/*
+  The minimal sets of a tree are built bottom-up: a leaf has one set with its attribute, and a gate of threshold k takes the union of the products of the
+  sets of every k of its children, computed one child at a time. After each step, repeated sets and sets that contain another one are dropped, since any
+  set of attributes that satisfies them also satisfies the smaller one. The conversion gives up as soon as a step holds more than maxSets sets.
+  The sets are kept sorted, and the list of sets is in the order in which the sets first appear in the tree.
+*/
+class DNFConverter {
+ public:
+  static const unsigned int MAX_MINIMAL_SETS = 64;
+
+  // false if the tree has more than maxSets minimal sets, or is satisfied by the empty set, which BL can not share
+  static bool toMinimalSets(shared_ptr<TreeNode> tree, vector<vector<int> >& sets, unsigned int maxSets = MAX_MINIMAL_SETS);
+  static std::string toDescription(const vector<vector<int> >& sets); // the BL description of the sets. Also a valid ShTree description
+};
+
+//=============================================================================
+
+/*
+  The estimates count the operations that dominate each algorithm and weigh them by their time. The default times are those measured for the reports
+  (report-BL-1.csv and report-SH-1.csv): a key fragment costs one exponentiation in the key group, and a decryption costs a fixed part, one pairing per share
+  of the witness set and, for ShTree, one exponentiation by the Lagrange coefficient of each of those shares. The witness set is the smallest satisfying
+  set of the policy, which both schemes find when the ciphertext has every attribute.
+  The score of a scheme is the weighted sum of its key generation and decryption times, so that a deployment that decrypts many times with each key can
+  weigh decryption more.
+*/
+struct SchemeCost {
+  unsigned int keyFragments; // the size of a key, in group elements
+  unsigned int randomness; // the random values taken by a distribution
+  unsigned int decryptPairings; // 0 for a policy that can not be satisfied
+  unsigned int decryptExponentiations;
+  double keygenTime; // milliseconds
+  double decryptTime; // milliseconds
+};
+
+struct CostWeights {
+  double keyFragmentTime;
+  double pairingTime;
+  double exponentiationTime;
+  double decryptBaseTime;
+  double keygenWeight;
+  double decryptWeight;
+
+  CostWeights(); // the times of the reports, and equal weights
+};
+
+class CostModel {
+  CostWeights m_weights;
+
+  void estimateTimes(SchemeCost& cost) const;
+
+ public:
+  CostModel(const CostWeights& weights = CostWeights());
+  SchemeCost estimateBL(const vector<vector<int> >& sets) const;
+  SchemeCost estimateShTree(shared_ptr<TreeNode> tree) const;
+  double score(const SchemeCost& cost) const;
+};
+
+//=============================================================================
+
+/*
+  The factory takes a policy in the language of ShTree, which includes the language of BL. The policy is first optimized (TreeOptimizer), and both
+  schemes are estimated on the optimized tree; BL is only a candidate if the tree converts to few enough minimal sets. The chosen scheme is built on the
+  description of the policy in its own language, so the keys of the two schemes have different shares and are not interchangeable.
+*/
+class SchemeFactory {
+ public:
+  struct Choice {
+    PolicyKind kind;
+    std::string description; // the description for the chosen scheme
+    bool blFeasible; // false if the minimal sets were too many, and BL was not estimated
+    SchemeCost blCost;
+    SchemeCost treeCost;
+  };
+
+  // throws a BAD_POLICY runtime_error if the description does not parse
+  static Choice choose(const std::string& description, const CostModel& model = CostModel(), unsigned int maxSets = DNFConverter::MAX_MINIMAL_SETS);
+  static shared_ptr<AccessPolicy> makePolicy(const Choice& choice, const vector<int>& parts);
+  static shared_ptr<SecretSharing> makeScheme(const Choice& choice, const vector<int>& parts, PFC& pfc);
+  static shared_ptr<SecretSharing> makeScheme(const std::string& description, const vector<int>& parts, PFC& pfc); // chooses with the default model
+};
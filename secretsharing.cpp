@@ -13,12 +13,47 @@
 
 #include "secretsharing.h"
 
+#include <algorithm>
+
+
+ShareID::ShareID():
+  m_index(0), m_childNo(ROOT_SHARE)
+{}
+
+ShareID::ShareID(unsigned int index, int childNo):
+  m_index(index), m_childNo(childNo)
+{}
+
+bool ShareID::operator==(const ShareID& rhs) const {
+  return (m_index == rhs.m_index) && (m_childNo == rhs.m_childNo);
+}
+
+bool ShareID::operator!=(const ShareID& rhs) const {
+  return !(*this == rhs);
+}
+
+bool ShareID::operator<(const ShareID& rhs) const {
+  if (m_index != rhs.m_index) return m_index < rhs.m_index;
+  return m_childNo < rhs.m_childNo;
+}
+
+std::string ShareID::to_string() const {
+  std::stringstream sstrm;
+  sstrm << "#" << m_index << "/" << m_childNo;
+  return sstrm.str();
+}
+
+std::ostream& operator<<(ostream& out, const ShareID &id) {
+  return out << id.to_string();
+}
+
+//==================================================================
 
 ShareTuple::ShareTuple():
-  partIndex(0), share(0), shareID("")
+  partIndex(0), share(0), shareID()
 {}
 
-ShareTuple::ShareTuple(const int pi, const Big s, const std::string si):
+ShareTuple::ShareTuple(const int pi, const Big s, const ShareID si):
   partIndex(pi), share(s), shareID(si)
 {}
 
@@ -36,7 +71,7 @@ ShareTuple& ShareTuple::operator=(const ShareTuple& other)
   return *this;
 }
 
-void ShareTuple::setValues(const int pi, const Big s, const int si)
+void ShareTuple::setValues(const int pi, const Big s, const ShareID si)
 {
   partIndex = pi;
   share = s;
@@ -65,7 +100,7 @@ Big ShareTuple::getShare() const {
     return share;
 }
 
-std::string ShareTuple::getShareID() const{
+const ShareID& ShareTuple::getShareID() const{
   return shareID;
 }
 
@@ -75,6 +110,315 @@ std::ostream& operator<<(ostream& out, const ShareTuple &sp) {
 
 //==================================================================
 
+CoveredSet::CoveredSet()
+{}
+
+CoveredSet::CoveredSet(const vector<int> &atts)
+{
+  assign(atts);
+}
+
+void CoveredSet::assign(const vector<int> &atts) {
+  clear();
+  for (unsigned int i = 0; i < atts.size(); i++) {
+    int att = atts[i];
+    if (att < 0) continue;
+    if ((unsigned int) att >= m_positions.size()) {
+      m_positions.resize(att + 1);
+      m_words.resize((att >> 6) + 1, 0);
+    }
+    if (contains(att)) continue;
+    m_words[att >> 6] |= 1ULL << (att & 63);
+    m_positions[att] = i;
+    m_members.push_back(att);
+  }
+}
+
+void CoveredSet::clear() {
+  for (unsigned int i = 0; i < m_members.size(); i++) {
+    m_words[m_members[i] >> 6] = 0;
+  }
+  m_members.clear();
+}
+
+unsigned int CoveredSet::size() const {
+  return m_members.size();
+}
+
+//==================================================================
+
+BigArena::BigArena():
+  m_used(0)
+{}
+
+Big& BigArena::get() {
+  if (m_used == m_slab.size()) {
+    m_slab.push_back(Big(0));
+  }
+  m_used++;
+  return m_slab[m_used - 1];
+}
+
+unsigned int BigArena::mark() const {
+  return m_used;
+}
+
+void BigArena::release(unsigned int mark) {
+  guard("BigArena: released to a mark beyond the Bigs in use", mark <= m_used);
+  m_used = mark;
+}
+
+unsigned int BigArena::used() const {
+  return m_used;
+}
+
+unsigned int BigArena::capacity() const {
+  return m_slab.size();
+}
+
+BigArena& BigArena::local() {
+  static thread_local BigArena arena;
+  return arena;
+}
+
+BigScope::BigScope():
+  m_arena(BigArena::local()), m_mark(m_arena.mark())
+{}
+
+BigScope::BigScope(BigArena& arena):
+  m_arena(arena), m_mark(arena.mark())
+{}
+
+BigScope::~BigScope() {
+  m_arena.release(m_mark);
+}
+
+Big& BigScope::get() {
+  return m_arena.get();
+}
+
+//==================================================================
+
+LagrangeEngine::LagrangeEngine(const Big& order, unsigned int maxPoints):
+  m_order(order)
+{
+  unsigned int n = (maxPoints > 0) ? maxPoints : 1;
+  m_fact.resize(n);
+  m_invFact.resize(n);
+  m_fact[0] = 1;
+  for (unsigned int i = 1; i < n; i++) {
+    m_fact[i] = m_fact[i-1];
+    m_fact[i] *= i;
+    m_fact[i] %= m_order;
+  }
+  m_invFact[n-1] = moddiv(1, m_fact[n-1], m_order);
+  for (unsigned int i = n - 1; i > 0; i--) {
+    m_invFact[i-1] = m_invFact[i];
+    m_invFact[i-1] *= i;
+    m_invFact[i-1] %= m_order;
+  }
+}
+
+unsigned int LagrangeEngine::getMaxPoints() const {
+  return m_fact.size();
+}
+
+void LagrangeEngine::batchInvert(vector<Big>& values, const Big& order) {
+  if (values.empty()) return;
+  BigScope scope;
+  Big& acc = scope.get();
+  Big& inv = scope.get();
+  Big& temp = scope.get();
+
+  // prefixes[i] is the product of the values before i
+  vector<Big> prefixes(values.size());
+  acc = 1;
+  for (unsigned int i = 0; i < values.size(); i++) {
+    prefixes[i] = acc;
+    acc = modmult(acc, values[i], order);
+  }
+  guard("batchInvert: one of the values is not invertible", acc != 0);
+  inv = moddiv(1, acc, order);
+  // inv is now the inverse of the product of values[0..i]
+  for (int i = values.size() - 1; i >= 0; i--) {
+    temp = modmult(inv, prefixes[i], order);
+    inv = modmult(inv, values[i], order);
+    values[i] = temp;
+  }
+}
+
+void LagrangeEngine::coefficients(const vector<int>& points, vector<Big>& coeffs) const {
+  unsigned int t = points.size();
+  coeffs.assign(t, Big(1));
+  if (t <= 1) return;
+
+  BigScope scope;
+  Big& prefix = scope.get();
+  Big& temp = scope.get();
+
+  int minPoint = points[0];
+  int maxPoint = points[0];
+  for (unsigned int i = 1; i < t; i++) {
+    minPoint = std::min(minPoint, points[i]);
+    maxPoint = std::max(maxPoint, points[i]);
+  }
+
+  // the inverses of the denominators go into coeffs
+  if ((maxPoint - minPoint + 1 == (int) t) && (t <= getMaxPoints())) {
+    for (unsigned int i = 0; i < t; i++) {
+      unsigned int j = points[i] - minPoint;
+      coeffs[i] = modmult(m_invFact[j], m_invFact[t-1-j], m_order);
+      if ((j % 2 == 1) && (coeffs[i] != 0)) {
+	coeffs[i] = m_order - coeffs[i];
+      }
+    }
+  } else {
+    for (unsigned int i = 0; i < t; i++) {
+      for (unsigned int k = 0; k < t; k++) {
+	if (k == i) continue;
+	// x_k - x_i, moved to a positive value below the order
+	temp = points[k] - points[i];
+	if (temp < 0) temp += m_order;
+	coeffs[i] = modmult(coeffs[i], temp, m_order);
+      }
+    }
+    batchInvert(coeffs, m_order);
+  }
+
+  // suffixes[i] is the product of the points from i on
+  vector<Big> suffixes(t + 1);
+  suffixes[t] = 1;
+  for (int i = t - 1; i >= 0; i--) {
+    suffixes[i] = suffixes[i+1];
+    suffixes[i] *= points[i];
+    suffixes[i] %= m_order;
+  }
+  prefix = 1;
+  for (unsigned int i = 0; i < t; i++) {
+    temp = modmult(prefix, suffixes[i+1], m_order);
+    coeffs[i] = modmult(coeffs[i], temp, m_order);
+    prefix *= points[i];
+    prefix %= m_order;
+  }
+}
+
+//==================================================================
+
+void SharePolynomial::evaluate(const Big& secret, const Big* coeffs, unsigned int degree, int x, const Big& order, Big& value) {
+  if (degree == 0) {
+    value = secret;
+    return;
+  }
+  value = coeffs[degree - 1];
+  for (int k = degree - 2; k >= -1; k--) {
+    value *= x;
+    value += (k >= 0) ? coeffs[k] : secret;
+    value %= order;
+  }
+}
+
+void SharePolynomial::evaluateConsecutive(const Big& secret, const Big* coeffs, unsigned int degree, unsigned int n, const Big& order, const vector<Big*>& values) {
+  guard("SharePolynomial: fewer values than points", values.size() >= n);
+  if ((degree < 2) || (n <= 2 * (degree + 1))) {
+    for (unsigned int j = 0; j < n; j++) {
+      evaluate(secret, coeffs, degree, j + 1, order, *values[j]);
+    }
+    return;
+  }
+
+  BigScope scope;
+  vector<Big*> diffs(degree + 1);
+  for (unsigned int i = 0; i <= degree; i++) {
+    diffs[i] = &scope.get();
+    evaluate(secret, coeffs, degree, i + 1, order, *diffs[i]);
+  }
+  // diffs[i] becomes the difference of order i at the point 1
+  for (unsigned int level = 1; level <= degree; level++) {
+    for (unsigned int i = degree; i >= level; i--) {
+      *diffs[i] += order;
+      *diffs[i] -= *diffs[i-1];
+      if (*diffs[i] >= order) *diffs[i] -= order;
+    }
+  }
+  // each step moves every difference to the next point, starting from the highest order one, which does not change
+  for (unsigned int j = 0; j < n; j++) {
+    *values[j] = *diffs[0];
+    for (unsigned int i = 0; i < degree; i++) {
+      *diffs[i] += *diffs[i+1];
+      if (*diffs[i] >= order) *diffs[i] -= order;
+    }
+  }
+}
+
+//==================================================================
+
+VectorRandomness::VectorRandomness(const vector<Big>& values):
+  m_values(values)
+{}
+
+void VectorRandomness::get(unsigned int first, unsigned int count, Big* values) const {
+  guard("tried to access randomness vector out of bounds", first + count <= m_values.size());
+  for (unsigned int i = 0; i < count; i++) {
+    values[i] = m_values[first + i];
+  }
+}
+
+SeededPRG::SeededPRG(const vector<char>& seed, const Big& order):
+  m_seed(seed), m_order(order)
+{
+  guard("SeededPRG: the seed must have 32 bytes", seed.size() == SEED_BYTES);
+  m_highShift = pow((Big) 2, (Big) 256, m_order);
+}
+
+const vector<char>& SeededPRG::getSeed() const {
+  return m_seed;
+}
+
+void SeededPRG::value(unsigned int j, Big& out) const {
+  char digest[64];
+  for (int block = 0; block < 2; block++) {
+    sha256 sh;
+    shs256_init(&sh);
+    for (unsigned int i = 0; i < m_seed.size(); i++) {
+      shs256_process(&sh, m_seed[i]);
+    }
+    for (int shift = 24; shift >= 0; shift -= 8) {
+      shs256_process(&sh, (j >> shift) & 0xFF);
+    }
+    shs256_process(&sh, block);
+    shs256_hash(&sh, digest + 32 * block);
+  }
+  // 512 bits do not fit in a Big, so the number is hi * 2^256 + lo, with each half reduced on its own
+  Big hi = from_binary(32, digest);
+  out = from_binary(32, digest + 32);
+  hi %= m_order;
+  out %= m_order;
+  out += modmult(hi, m_highShift, m_order);
+  out %= m_order;
+}
+
+void SeededPRG::get(unsigned int first, unsigned int count, Big* values) const {
+  for (unsigned int i = 0; i < count; i++) {
+    value(first + i, values[i]);
+  }
+}
+
+vector<Big> SeededPRG::expand(unsigned int n) const {
+  vector<Big> values(n);
+  if (n > 0) get(0, n, &values[0]);
+  return values;
+}
+
+vector<char> SeededPRG::randomSeed(PFC& pfc) {
+  vector<char> seed(SEED_BYTES);
+  Big r;
+  pfc.random(r);
+  to_binary(r, SEED_BYTES, &seed[0], TRUE);
+  return seed;
+}
+
+//==================================================================
+
 AccessPolicy::AccessPolicy()
 {
   m_participants.push_back(1);
@@ -96,6 +440,15 @@ unsigned int AccessPolicy::getNumParticipants() const
   return m_participants.size();
 }
 
+StructuralHash AccessPolicy::hashParticipants(StructuralHash h) const
+{
+  h = hashCombine(h, m_participants.size());
+  for (unsigned int i = 0; i < m_participants.size(); i++) {
+    h = hashCombine(h, m_participants[i]);
+  }
+  return h;
+}
+
 vector<int> AccessPolicy::getParticipants() const
 {
   return m_participants;
@@ -104,7 +457,8 @@ vector<int> AccessPolicy::getParticipants() const
 bool AccessPolicy::evaluate(const vector<ShareTuple> shares, vector<ShareTuple> &witnessShares) const{
   witnessShares.clear();
  
-  vector<std::string> shareIDs;
+  vector<ShareID> shareIDs;
+  shareIDs.reserve(shares.size());
   for (unsigned int i = 0; i < shares.size(); i++) {
     shareIDs.push_back(shares[i].getShareID());
   }
@@ -122,6 +476,21 @@ bool AccessPolicy::evaluate(const vector<ShareTuple> shares, vector<ShareTuple>
   return success;
 }
 
+void AccessPolicy::obtainCoveredFrags(const vector<int> &atts, vector<int> &attFragIndices, vector<int> &keyFragIndices, vector<ShareID> &coveredShareIDs) const {
+  CoveredSet covered(atts);
+  obtainCoveredFrags(covered, attFragIndices, keyFragIndices, coveredShareIDs);
+}
+
+vector<Big> AccessPolicy::findCoefficients(const vector<ShareID>& shareIDs, const Big& order) const {
+  vector<Big> coeffs;
+  findCoefficients(shareIDs, order, coeffs);
+  return coeffs;
+}
+
+std::string AccessPolicy::renderShareID(const ShareID& id) const {
+  return id.to_string();
+}
+
 
 //================================================================
 
@@ -135,6 +504,32 @@ SecretSharing::SecretSharing(shared_ptr<AccessPolicy> policy, const Big &order,
 SecretSharing::~SecretSharing(){
 }
 
+const vector<char>& SecretSharing::getLastSeed() const {
+  return m_seed;
+}
+
+vector<Big> SecretSharing::getDistribRandomness() {
+  if (m_seed.empty()) {
+    return vector<Big>(getNumRandomness(), Big(0));
+  }
+  return SeededPRG(m_seed, m_order).expand(getNumRandomness());
+}
+
+std::vector<ShareTuple> SecretSharing::distribute_random(const Big& s) {
+  m_seed = SeededPRG::randomSeed(m_pfc);
+  return distribute_seeded(s, m_seed);
+}
+
+std::vector<ShareTuple> SecretSharing::distribute_seeded(const Big& s, const vector<char>& seed) {
+  SeededPRG prg(seed, m_order);
+  return distribute_determ(s, prg);
+}
+
+std::vector<ShareTuple> SecretSharing::distribute_determ(const Big& s, const vector<Big>& randomness) {
+  VectorRandomness source(randomness);
+  return distribute_determ(s, source);
+}
+
 
 Big SecretSharing::getOrder() const{
   return m_order;
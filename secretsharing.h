@@ -4,12 +4,17 @@
 
   This file holds the declarations for the basic classes implementing the notion of Secret Sharing scheme.
   It declares three classes: 
+  - ShareID: the identifier of a share within its policy, described below
+  - CoveredSet: the attributes of a ciphertext, indexed for the search of the shares that they cover
   - ShareTuple: describes each share individual share of a secret sharing scheme. It has three relevant pieces of information: 
     * the value of the share
     * the participant of the scheme that holds the share
     * a unique identifier for each share within the policy. This identifier must hold all the information necessary to reconstruct the secret from the shares, including all the information associated to the share that must be publicly known.
   - AccessPolicy: it is an abstract class that describes an access policy for a generic secret sharing scheme
   - SecretSharing: also an abstract class, that describes a generic secret sharing scheme. Each such scheme holds exactly one Access Policy that it enforces.
+  It also declares BigArena and BigScope, a per-thread pool of Big temporaries for the arithmetic of distribution and reconstruction,
+  and LagrangeEngine and SharePolynomial, which compute the Lagrange coefficients of a set of shares and the shares of a Shamir gate.
+  The randomness of a distribution is read from a RandomnessSource: either a vector of values (VectorRandomness) or a generator seeded with 32 bytes (SeededPRG).
 */
 
 
@@ -19,33 +24,221 @@
 #include "utils.h"
 #endif
 
+#include <deque>
 
 
+/*
+  A share is identified by two small integers:
+  - the index: the position of the share in the order in which the policy distributes its shares. This is also the position of the corresponding key
+    fragment, so a policy can find everything it knows about a share with a direct access to its own tables.
+  - the child number: the position of the share among the shares that were computed from the same secret. In ShTree, this is the child of the threshold gate
+    that holds the share, which is the public information needed for the Lagrange coefficients; it is negative for a share that is held by the root.
+    In BL, it is the position of the share within its minimal set. LSSS numbers its shares as ShTree does, one for each leaf.
+  Identifiers are only meaningful for the policy that issued them. The policy can render them in a readable form for debugging (renderShareID).
+*/
+class ShareID {
+  unsigned int m_index;
+  int m_childNo;
+
+ public:
+  static const int ROOT_SHARE = -1;
+
+  ShareID();
+  ShareID(unsigned int index, int childNo);
+  inline unsigned int getIndex() const {
+    return m_index;
+  }
+  inline int getChildNo() const {
+    return m_childNo;
+  }
+  inline bool isRootShare() const {
+    return m_childNo < 0;
+  }
+  bool operator==(const ShareID& rhs) const;
+  bool operator!=(const ShareID& rhs) const;
+  bool operator<(const ShareID& rhs) const;
+  std::string to_string() const;
+};
+
+std::ostream& operator<<(std::ostream& out, const ShareID &id);
+
 class ShareTuple{
   int partIndex;
   Big share;
-  std::string shareID;
+  ShareID shareID;
 
  public:
   ShareTuple();
-  ShareTuple(const int pi, const Big s, const std::string si);
+  ShareTuple(const int pi, const Big s, const ShareID si);
   ShareTuple(const ShareTuple& other);
   ShareTuple& operator=(const ShareTuple& other);
-  void setValues(const int pi, const Big s, const int si) ;
+  void setValues(const int pi, const Big s, const ShareID si) ;
   bool operator==(const ShareTuple& rhs) const;
   std::string to_string() const;
   int getPartIndex() const;
-  std::string getShareID() const;
+  const ShareID& getShareID() const;
   Big getShare() const;
 };
 
 
+//=============================================================================
+
+/*
+  A ciphertext holds a vector of attributes, and a key holds one share for each leaf of its policy. Decryption must find, for every leaf, whether its
+  attribute is in the ciphertext and at which position, which is a search in the attribute vector for each leaf.
+  CoveredSet holds the attributes as a dense bitset, together with the position of each one in the vector, so that each leaf is answered with one access.
+  A set can be assigned the attributes of another ciphertext, and then only clears the entries of the previous one, so it can be kept and reused.
+  Attributes are expected to be small non-negative integers; negative ones are never covered.
+*/
+class CoveredSet {
+  vector<unsigned long long> m_words; // bit a is set if attribute a is in the ciphertext
+  vector<int> m_positions; // the position of attribute a in the ciphertext vector. Only valid if bit a is set
+  vector<int> m_members; // the distinct attributes in the set
+
+ public:
+  CoveredSet();
+  CoveredSet(const vector<int> &atts);
+  void assign(const vector<int> &atts); // if an attribute is repeated, its first position is kept
+  void clear();
+  unsigned int size() const; // the number of distinct attributes
+
+  inline bool contains(int att) const {
+    return (att >= 0) && ((unsigned int) att < (m_words.size() << 6)) && ((m_words[att >> 6] >> (att & 63)) & 1ULL);
+  }
+
+  inline int position(int att) const { // -1 if the attribute is not in the set
+    return contains(att) ? m_positions[att] : -1;
+  }
+};
+
+//=============================================================================
+
+/*
+  Every Big allocates its memory through MIRACL when it is built and frees it when it is destroyed. The loops that compute shares and coefficients
+  would otherwise build and destroy a few Bigs per share.
+  The arena keeps the Bigs it has built, in a slab that only grows, and hands them out in order. A BigScope marks how much of the arena is in use when it is
+  created, and gives back everything taken after it when it is destroyed. Scopes nest like the calls that create them, so recursive computations can
+  take their own temporaries while the caller's are still alive.
+  A Big obtained from a scope keeps whatever value its last user left in it, and its value must be copied out before the scope ends.
+*/
+class BigArena {
+  std::deque<Big> m_slab; // a deque, so that Bigs already handed out do not move when the slab grows
+  unsigned int m_used;
+
+ public:
+  BigArena();
+  Big& get();
+  unsigned int mark() const;
+  void release(unsigned int mark); // gives back all the Bigs taken after mark
+  unsigned int used() const;
+  unsigned int capacity() const;
+
+  static BigArena& local(); // the arena of the calling thread
+};
+
+class BigScope {
+  BigArena& m_arena;
+  unsigned int m_mark;
+
+  BigScope(const BigScope&);
+  BigScope& operator=(const BigScope&);
+
+ public:
+  BigScope(); // works on the arena of the calling thread
+  BigScope(BigArena& arena);
+  ~BigScope();
+  Big& get();
+};
+
+//=============================================================================
+
+/*
+  The Lagrange coefficient at 0 of the share at point x_i, among the shares at points x_1..x_t, is the product over k != i of x_k / (x_k - x_i).
+  Computing each term with its own division costs t^2 inversions for a set of t shares. The engine computes the coefficients of the whole set at once:
+  - the numerators, the product of the other points, come from prefix and suffix products of the points
+  - when the points are consecutive integers, the denominator of the share at position j of the run is (-1)^j * j! * (t-1-j)!, and its inverse is read
+    from tables of inverse factorials, which the engine builds once for sets of up to maxPoints shares
+  - otherwise, the denominators are multiplied out and all inverted together, with a single inversion (batchInvert)
+  Shamir shares are given at the points 1 to arity of their gate, so a set of shares is consecutive whenever no child is missing between the first and
+  the last one. Points must be distinct and non-zero.
+*/
+class LagrangeEngine {
+  Big m_order;
+  vector<Big> m_fact; // m_fact[i] is i! modulo the order
+  vector<Big> m_invFact; // the inverses of m_fact
+
+ public:
+  LagrangeEngine(const Big& order, unsigned int maxPoints);
+  unsigned int getMaxPoints() const;
+  void coefficients(const vector<int>& points, vector<Big>& coeffs) const; // one coefficient for each point, in the same order
+
+  // replaces every value by its inverse modulo order, with one inversion for the whole vector. No value can be 0
+  static void batchInvert(vector<Big>& values, const Big& order);
+};
+
+//=============================================================================
+
+/*
+  A Shamir gate of threshold t gives its children the values of a polynomial of degree t-1 at the points 1 to n. The polynomial is the secret,
+  followed by the t-1 coefficients in coeffs, so that p(x) = secret + coeffs[0]*x + ... + coeffs[t-2]*x^(t-1).
+  - evaluate uses Horner's rule: one multiplication by the small point, one addition and one reduction per coefficient.
+  - evaluateConsecutive gives the values at all the points 1 to n. When n is well above the degree, it evaluates the first degree+1 points, turns them into
+    the forward differences of the polynomial at 1, and then finds each further value with degree modular additions, since the difference of order
+    degree is constant. Otherwise, it evaluates each point with Horner's rule.
+*/
+class SharePolynomial {
+ public:
+  static void evaluate(const Big& secret, const Big* coeffs, unsigned int degree, int x, const Big& order, Big& value);
+  // values must hold n Bigs, and receives p(1) to p(n)
+  static void evaluateConsecutive(const Big& secret, const Big* coeffs, unsigned int degree, unsigned int n, const Big& order, const vector<Big*>& values);
+};
+
+//=============================================================================
+
+/*
+  A distribution takes its random values in a fixed order, which each scheme defines, and asks the source for them by position.
+  A SeededPRG derives value j from the seed and j alone, as SHA-256(seed || j || 0) followed by SHA-256(seed || j || 1), read as a 512-bit number and
+  reduced modulo the order; j is written in 4 bytes, most significant first. The 512 bits make the bias of the reduction negligible.
+  A key is then reproduced from its 32-byte seed, and no vector of randomness as large as the policy is kept for it.
+*/
+class RandomnessSource {
+ public:
+  virtual void get(unsigned int first, unsigned int count, Big* values) const = 0; // the values first to first+count-1
+  virtual ~RandomnessSource() {}
+};
+
+class VectorRandomness : public RandomnessSource {
+  const vector<Big>& m_values;
+
+ public:
+  explicit VectorRandomness(const vector<Big>& values);
+  void get(unsigned int first, unsigned int count, Big* values) const;
+};
+
+class SeededPRG : public RandomnessSource {
+  vector<char> m_seed;
+  Big m_order;
+  Big m_highShift; // 2^256 modulo the order, the weight of the first digest
+
+ public:
+  static const unsigned int SEED_BYTES = 32;
+
+  SeededPRG(const vector<char>& seed, const Big& order);
+  const vector<char>& getSeed() const;
+  void value(unsigned int j, Big& out) const;
+  void get(unsigned int first, unsigned int count, Big* values) const;
+  vector<Big> expand(unsigned int n) const; // the values 0 to n-1
+
+  static vector<char> randomSeed(PFC& pfc);
+};
+
 //=============================================================================
 
 class AccessPolicy{
  protected:
   vector<int> m_participants; // the names of the participants
   // policy parameters depend on the type of policy, and have to be defined in the base classes. This includes, for example, the association between shares and users
+  StructuralHash hashParticipants(StructuralHash h) const; // folds the participants into a hash
 
  public:
   AccessPolicy();
@@ -57,13 +250,21 @@ class AccessPolicy{
   unsigned int getNumParticipants() const;
   vector<int> getParticipants() const;
   virtual unsigned int getNumShares() = 0; // returns the number of shares distributed by this policy
+  // a hash of the kind of policy, its participants and its structure, fixed when the policy is built. Policies with different hashes are different, so
+  // it can key tables of policies; the description is not part of it, and two descriptions of the same structure have the same hash
+  virtual StructuralHash getStructuralHash() const = 0;
 
   // evaluate: evaluates the received shares according to the policy and returns a set of shares that are enough to reconstruct the secret if
   // the policy is satisfied by the first argument
-  virtual vector<Big> findCoefficients(const vector<std::string> shareIDs, const Big& order) const = 0; // every linear secret sharing scheme can produce coefficients for reconstruction
-  virtual bool evaluateIDs(const vector<std::string> shareIDs, vector<int> &witnessSharesIndices) const = 0;
+  // every linear secret sharing scheme can produce coefficients for reconstruction. The coefficients are written over coeffs, so that a caller may reuse it
+  virtual void findCoefficients(const vector<ShareID>& shareIDs, const Big& order, vector<Big>& coeffs) const = 0;
+  vector<Big> findCoefficients(const vector<ShareID>& shareIDs, const Big& order) const;
+  virtual bool evaluateIDs(const vector<ShareID>& shareIDs, vector<int> &witnessSharesIndices) const = 0;
   bool evaluate(const vector<ShareTuple> shares, vector<ShareTuple> &witnessShares) const;
-  virtual void obtainCoveredFrags(const vector<int> &atts, vector<int> &attFragIndices, vector<int> &keyFragIndices, vector<std::string> &coveredShareIDs) const = 0;
+  // obtainCoveredFrags: finds the shares whose attribute is in the ciphertext, with the position of the share (keyFragIndices) and of the attribute (attFragIndices)
+  virtual void obtainCoveredFrags(const CoveredSet &covered, vector<int> &attFragIndices, vector<int> &keyFragIndices, vector<ShareID> &coveredShareIDs) const = 0;
+  void obtainCoveredFrags(const vector<int> &atts, vector<int> &attFragIndices, vector<int> &keyFragIndices, vector<ShareID> &coveredShareIDs) const;
+  virtual std::string renderShareID(const ShareID& id) const; // a readable form of the identifier, for debugging
   virtual ~AccessPolicy(){};
 };
 
@@ -72,8 +273,6 @@ class AccessPolicy{
 class SecretSharing
 {
  protected:
-  enum RandomnessActions {init, randomize};
-
   shared_ptr<AccessPolicy> m_policy;
   Big m_order;	// the order of the base group
   PFC &m_pfc;   //not sure if this should go in the AccessPolicy as well.
@@ -82,6 +281,7 @@ class SecretSharing
   // However, this evaluation may not require actual compuation, just a formal check that the right shares exist.
   // For this reason, I have removed both the order and pfc from the Policy
 		// the particular structures implementing this secret sharing scheme can only be defined in the base classes
+  vector<char> m_seed; // the seed of the last random distribution. Empty before the first one
 
 
 public:
@@ -102,9 +302,13 @@ public:
   vector<int> getParticipants() const;
   static vector<ShareTuple> getSharesForParticipants(const vector<int> &parts, const vector<ShareTuple> &shares); // returns the subset of shares that are held by certain participants
   virtual bool evaluate(const vector<ShareTuple> uniqueShares, vector<ShareTuple> &witnessShares) const;
-  virtual vector<Big> getDistribRandomness() = 0;
-  virtual std::vector<ShareTuple> distribute_random(const Big& s) = 0;
-  virtual std::vector<ShareTuple> distribute_determ(const Big& s, const vector<Big>& randomness) = 0;
+  virtual unsigned int getNumRandomness() = 0; // the number of random values that a distribution takes
+  const vector<char>& getLastSeed() const;
+  virtual vector<Big> getDistribRandomness(); // the values of randomness of the last random distribution, derived again from its seed
+  virtual std::vector<ShareTuple> distribute_random(const Big& s); // draws a new seed
+  std::vector<ShareTuple> distribute_seeded(const Big& s, const vector<char>& seed);
+  std::vector<ShareTuple> distribute_determ(const Big& s, const vector<Big>& randomness);
+  virtual std::vector<ShareTuple> distribute_determ(const Big& s, const RandomnessSource& randomness) = 0;
   virtual Big reconstruct (const vector<ShareTuple> shares) = 0;
 
   virtual ~SecretSharing();
@@ -0,0 +1,298 @@
+/*
+  Testbed for empirical evaluation of KP-ABE schemes, according to Crampton, Pinto (CSF2014).
+  Code by: Alexandre Miranda Pinto
+
+  This file implements the single-gate Shamir scheme declared in shamir.h
+*/
+
+#ifndef DEF_SHAMIR
+#include "shamir.h"
+#endif
+
+#ifndef DEF_SH_TREE
+#include "ShTree.h"
+#endif
+
+
+// the kind comes first, with a value that no other kind of policy has, followed by the threshold and the attributes of the shares
+StructuralHash ShamirAccessPolicy::hashPolicy() const {
+  StructuralHash h = hashCombine(hashParticipants(hashCombine(HASH_SEED, 4)), m_threshold);
+  h = hashCombine(h, m_shareAtts.size());
+  for (unsigned int i = 0; i < m_shareAtts.size(); i++) {
+    h = hashCombine(h, (StructuralHash) (long long) m_shareAtts[i]);
+  }
+  return h;
+}
+
+bool ShamirAccessPolicy::assignFromTree(const CompiledTree& tree) {
+  if (tree.size() == 0) return false;
+  const CompiledTree::Node &root = tree.getNode(tree.root());
+  if ((root.kind != CompiledTree::gateNode) || (root.threshold == 0) || (root.numChildren == 0)) return false;
+  vector<int> shareAtts;
+  shareAtts.reserve(root.numChildren);
+  for (unsigned int j = 0; j < root.numChildren; j++) {
+    const CompiledTree::Node &child = tree.getNode(tree.getChild(root, j));
+    if (child.kind != CompiledTree::leafNode) return false;
+    shareAtts.push_back(child.leafValue);
+  }
+  m_threshold = root.threshold;
+  m_shareAtts.swap(shareAtts);
+  m_hash = hashPolicy();
+  return true;
+}
+
+void ShamirAccessPolicy::initFromDescription(const std::string& description) {
+  TreeArena arena;
+  ShTreeAccessPolicy::parseIntoArena(description, arena);
+  if (!assignFromTree(CompiledTree(arena))) {
+    stringstream ss;
+    ss << ERR_BAD_POLICY << ": not a single threshold gate over attributes: " << description << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+}
+
+ShamirAccessPolicy::ShamirAccessPolicy():
+  m_threshold(0)
+{
+  m_hash = hashPolicy();
+}
+
+ShamirAccessPolicy::ShamirAccessPolicy(unsigned int threshold, const vector<int> &shareAtts, const int n):
+  AccessPolicy(n),
+  m_threshold(threshold),
+  m_shareAtts(shareAtts)
+{
+  m_hash = hashPolicy();
+}
+
+ShamirAccessPolicy::ShamirAccessPolicy(unsigned int threshold, const vector<int> &shareAtts, const vector<int> &parts):
+  AccessPolicy(parts),
+  m_threshold(threshold),
+  m_shareAtts(shareAtts)
+{
+  m_hash = hashPolicy();
+}
+
+ShamirAccessPolicy::ShamirAccessPolicy(const std::string &description, const int n):
+  AccessPolicy(n),
+  m_threshold(0)
+{
+  initFromDescription(description);
+}
+
+ShamirAccessPolicy::ShamirAccessPolicy(const std::string &description, const vector<int> &parts):
+  AccessPolicy(parts),
+  m_threshold(0)
+{
+  initFromDescription(description);
+}
+
+ShamirAccessPolicy::ShamirAccessPolicy(const ShamirAccessPolicy& other):
+  AccessPolicy(other.m_participants),
+  m_threshold(other.m_threshold),
+  m_shareAtts(other.m_shareAtts),
+  m_hash(other.m_hash)
+{
+  std::lock_guard<std::mutex> lock(other.m_engineMutex);
+  m_engine = other.m_engine;
+  m_engineOrder = other.m_engineOrder;
+}
+
+ShamirAccessPolicy& ShamirAccessPolicy::operator=(const ShamirAccessPolicy& other)
+{
+  if (this == &other) return *this;
+  m_participants = other.m_participants;
+  m_threshold = other.m_threshold;
+  m_shareAtts = other.m_shareAtts;
+  m_hash = other.m_hash;
+  shared_ptr<LagrangeEngine> engine;
+  Big engineOrder;
+  {
+    std::lock_guard<std::mutex> lock(other.m_engineMutex);
+    engine = other.m_engine;
+    engineOrder = other.m_engineOrder;
+  }
+  std::lock_guard<std::mutex> lock(m_engineMutex);
+  m_engine = engine;
+  m_engineOrder = engineOrder;
+  return *this;
+}
+
+bool ShamirAccessPolicy::operator==(const ShamirAccessPolicy& rhs) const
+{
+  if (this == &rhs) return true;
+  return (m_hash == rhs.m_hash) && (m_threshold == rhs.m_threshold) && (m_participants == rhs.m_participants) && (m_shareAtts == rhs.m_shareAtts);
+}
+
+shared_ptr<ShamirAccessPolicy> ShamirAccessPolicy::fromCompiledTree(const CompiledTree& tree, const vector<int> &parts) {
+  shared_ptr<ShamirAccessPolicy> policy = make_shared<ShamirAccessPolicy>(0, vector<int>(), parts);
+  if (!policy->assignFromTree(tree)) {
+    return shared_ptr<ShamirAccessPolicy>();
+  }
+  return policy;
+}
+
+unsigned int ShamirAccessPolicy::getThreshold() const {
+  return m_threshold;
+}
+
+const vector<int>& ShamirAccessPolicy::getShareAttributes() const {
+  return m_shareAtts;
+}
+
+shared_ptr<LagrangeEngine> ShamirAccessPolicy::getEngine(const Big& order) const {
+  std::lock_guard<std::mutex> lock(m_engineMutex);
+  if (!m_engine || (m_engineOrder != order)) {
+    m_engine = make_shared<LagrangeEngine>(order, m_shareAtts.size());
+    m_engineOrder = order;
+  }
+  return m_engine;
+}
+
+StructuralHash ShamirAccessPolicy::getStructuralHash() const {
+  return m_hash;
+}
+
+unsigned int ShamirAccessPolicy::getNumShares() {
+  return m_shareAtts.size();
+}
+
+// the shares received are marked in a bitset, and the witness is the first threshold of them, in the order of the shares, as ShTree would choose them
+bool ShamirAccessPolicy::evaluateIDs(const vector<ShareID>& shareIDs, vector<int> &witnessSharesIndices) const {
+  witnessSharesIndices.clear();
+  if (m_threshold == 0) return false;
+
+  // an identifier that the policy did not issue is ignored. If a share was received twice, the first one is used
+  unsigned int nShares = m_shareAtts.size();
+  vector<unsigned long long> received((nShares + 63) / 64, 0);
+  vector<int> sharePositions(nShares, -1);
+  unsigned int count = 0;
+  for (unsigned int i = 0; i < shareIDs.size(); i++) {
+    unsigned int index = shareIDs[i].getIndex();
+    if ((index < nShares) && (sharePositions[index] < 0)) {
+      sharePositions[index] = i;
+      received[index >> 6] |= 1ULL << (index & 63);
+      count++;
+    }
+  }
+  if (count < m_threshold) return false;
+
+  for (unsigned int w = 0; (w < received.size()) && (witnessSharesIndices.size() < m_threshold); w++) {
+    unsigned long long word = received[w];
+    while ((word != 0) && (witnessSharesIndices.size() < m_threshold)) {
+      unsigned int index = (w << 6) + __builtin_ctzll(word);
+      witnessSharesIndices.push_back(sharePositions[index]);
+      word &= word - 1;
+    }
+  }
+  return true;
+}
+
+void ShamirAccessPolicy::findCoefficients(const vector<ShareID>& shareIDs, const Big& order, vector<Big>& coeffs) const {
+  vector<int> points;
+  points.reserve(shareIDs.size());
+  for (unsigned int i = 0; i < shareIDs.size(); i++) {
+    guard("findCoefficients: share identifier beyond the shares of the policy", shareIDs[i].getIndex() < m_shareAtts.size());
+    points.push_back(shareIDs[i].getIndex() + 1);
+  }
+  getEngine(order)->coefficients(points, coeffs);
+}
+
+void ShamirAccessPolicy::obtainCoveredFrags(const CoveredSet &covered, vector<int> &attFragIndices, vector<int> &keyFragIndices, vector<ShareID> &coveredShareIDs) const {
+  for (unsigned int i = 0; i < m_shareAtts.size(); i++) {
+    int n = covered.position(m_shareAtts[i]);
+    if (n >= 0) {
+      keyFragIndices.push_back(i);
+      attFragIndices.push_back(n);
+      coveredShareIDs.push_back(ShareID(i, i));
+    }
+  }
+}
+
+std::string ShamirAccessPolicy::renderShareID(const ShareID& id) const {
+  if (id.getIndex() >= m_shareAtts.size()) {
+    return AccessPolicy::renderShareID(id);
+  }
+  return "0:" + convertIntToStr(id.getIndex()) + ":=" + convertIntToStr(m_shareAtts[id.getIndex()]);
+}
+
+//==============================================
+
+void ShamirSS::initPolicy(){
+  i_policy = std::dynamic_pointer_cast<ShamirAccessPolicy>(m_policy);
+  if (!i_policy) {
+    stringstream ss;
+    ss << ERR_BAD_POLICY << ": ShamirSS has an AccessPolicy that is not ShamirAccessPolicy!" << std::endl;
+    throw std::runtime_error(ss.str());
+  }
+}
+
+void ShamirSS::init(){
+  initPolicy();
+}
+
+ShamirSS::ShamirSS(shared_ptr<ShamirAccessPolicy>  policy, PFC &pfc):
+  SecretSharing(policy, pfc)
+{
+  init();
+}
+
+ShamirSS::ShamirSS(shared_ptr<ShamirAccessPolicy>  policy, const Big &order, PFC &pfc):
+  SecretSharing(policy, order, pfc)
+{
+  init();
+}
+
+// virtual inherited methods:
+
+unsigned int ShamirSS::getNumRandomness() {
+  return (i_policy->getThreshold() > 0) ? i_policy->getThreshold() - 1 : 0;
+}
+
+// the polynomial is the secret followed by the randomness, and share i is its value at i+1. All the values are computed in one pass
+std::vector<ShareTuple> ShamirSS::distribute_determ(const Big& s, const RandomnessSource& randomness){
+  const vector<int> &shareAtts = i_policy->getShareAttributes();
+  vector<ShareTuple> shares;
+  if (shareAtts.empty()) {
+    return shares;
+  }
+  shares.reserve(shareAtts.size());
+
+  unsigned int degree = getNumRandomness();
+  vector<Big> coeffs(degree);
+  if (degree > 0) {
+    randomness.get(0, degree, &coeffs[0]);
+  }
+
+  BigScope scope;
+  vector<Big*> values(shareAtts.size());
+  for (unsigned int i = 0; i < shareAtts.size(); i++) {
+    values[i] = &scope.get();
+  }
+  SharePolynomial::evaluateConsecutive(s, coeffs.data(), degree, shareAtts.size(), m_order, values);
+  for (unsigned int i = 0; i < shareAtts.size(); i++) {
+    shares.push_back(ShareTuple(shareAtts[i], *values[i], ShareID(i, i)));
+  }
+  return shares;
+}
+
+Big ShamirSS::reconstruct(const vector<ShareTuple> shares){
+  vector<ShareTuple> witnessShares;
+  if (!i_policy->evaluate(shares, witnessShares)) return -1;
+
+  vector<ShareID> shareIDs;
+  shareIDs.reserve(witnessShares.size());
+  for (unsigned int i = 0; i < witnessShares.size(); i++) {
+    shareIDs.push_back(witnessShares[i].getShareID());
+  }
+  vector<Big> coeffs = i_policy->findCoefficients(shareIDs, m_order);
+
+  BigScope scope;
+  Big& sum = scope.get();
+  sum = 0;
+  for (unsigned int i = 0; i < witnessShares.size(); i++) {
+    sum += modmult(coeffs[i], witnessShares[i].getShare(), m_order);
+    sum %= m_order;
+  }
+  return sum;
+}
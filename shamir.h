@@ -0,0 +1,94 @@
+/*
+  Testbed for empirical evaluation of KP-ABE schemes, according to Crampton, Pinto (CSF2014).
+  Code by: Alexandre Miranda Pinto
+
+  This file implements a specific Secret Sharing scheme: a single Shamir threshold gate over attributes.
+  It is the policy THR(k, a_1, ..., a_n) of ShTree, without the tree: the shares are the values of one polynomial at the points 1 to n, evaluated all at
+  once, the coefficients of reconstruction come from one LagrangeEngine, and a set of shares is evaluated as a bitset of the shares received.
+  ShTree hands its policies that are a single gate over leaves to this scheme. The shares, their identifiers and the randomness are the same in both,
+  so a key is the same whichever of the two computes it.
+  There are two classes implemented here:
+  - ShamirAccessPolicy is a subclass of the abstract AccessPolicy
+  - ShamirSS is a subclass of the abstract SecretSharing
+*/
+
+#ifndef DEF_UTILS
+#include "utils.h"
+#endif
+
+#ifndef DEF_SECRET_SHARING
+#include "secretsharing.h"
+#endif
+
+#define DEF_SHAMIR
+
+#include <mutex>
+
+class CompiledTree;
+
+
+/*
+  Share i is held by the attribute of leaf i, at the point i+1. Its identifier has the index i and the child number i, as the child i of the root gate
+  of ShTree.
+  The Lagrange engine holds the tables of the n points of the policy for one order. It is built the first time coefficients are asked for, and again if
+  they are asked for another order; a mutex guards it, since it is shared by every copy of the policy and by all threads.
+*/
+class ShamirAccessPolicy : public AccessPolicy
+{
+  unsigned int m_threshold;
+  vector<int> m_shareAtts; // the attribute of each share
+  StructuralHash m_hash;
+  mutable std::mutex m_engineMutex;
+  mutable shared_ptr<LagrangeEngine> m_engine;
+  mutable Big m_engineOrder;
+
+  StructuralHash hashPolicy() const;
+  bool assignFromTree(const CompiledTree& tree); // false if the tree is not a single gate over leaves
+  void initFromDescription(const std::string& description);
+
+ public:
+  ShamirAccessPolicy();
+  ShamirAccessPolicy(unsigned int threshold, const vector<int> &shareAtts, const int n); // participants numbered from 1 to n
+  ShamirAccessPolicy(unsigned int threshold, const vector<int> &shareAtts, const vector<int> &parts);
+  // a description in the language of ShTree. Throws a BAD_POLICY runtime_error if it is not a single gate of threshold at least 1 over leaves
+  ShamirAccessPolicy(const std::string &description, const int n);
+  ShamirAccessPolicy(const std::string &description, const vector<int> &parts);
+  ShamirAccessPolicy(const ShamirAccessPolicy& other);
+  ShamirAccessPolicy& operator=(const ShamirAccessPolicy& other);
+  bool operator==(const ShamirAccessPolicy& rhs) const;
+
+  // the flat policy of a compiled tree, or an empty pointer if the tree is not a single gate of threshold at least 1 whose children are all leaves
+  static shared_ptr<ShamirAccessPolicy> fromCompiledTree(const CompiledTree& tree, const vector<int> &parts);
+
+  unsigned int getThreshold() const;
+  const vector<int>& getShareAttributes() const;
+  shared_ptr<LagrangeEngine> getEngine(const Big& order) const;
+  StructuralHash getStructuralHash() const;
+  unsigned int getNumShares();
+  bool evaluateIDs(const vector<ShareID>& shareIDs, vector<int> &witnessSharesIndices) const;
+  using AccessPolicy::findCoefficients;
+  void findCoefficients(const vector<ShareID>& shareIDs, const Big& order, vector<Big>& coeffs) const;
+  using AccessPolicy::obtainCoveredFrags;
+  void obtainCoveredFrags(const CoveredSet &covered, vector<int> &attFragIndices, vector<int> &keyFragIndices, vector<ShareID> &coveredShareIDs) const;
+  std::string renderShareID(const ShareID& id) const; // as ShTree renders the child of the root, "0:2:=5"
+};
+
+class ShamirSS : public SecretSharing
+{
+ private:
+  shared_ptr<ShamirAccessPolicy>  i_policy;
+
+ protected:
+  void init();
+  void initPolicy();
+
+ public:
+  ShamirSS(shared_ptr<ShamirAccessPolicy> policy, PFC &pfc);
+  ShamirSS(shared_ptr<ShamirAccessPolicy> policy, const Big &order, PFC &pfc);
+
+  // virtual inherited methods:
+  unsigned int getNumRandomness(); // the threshold-1 coefficients of the polynomial
+  using SecretSharing::distribute_determ;
+  std::vector<ShareTuple> distribute_determ(const Big& s, const RandomnessSource& randomness);
+  Big reconstruct (const vector<ShareTuple> shares);
+};
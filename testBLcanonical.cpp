@@ -178,6 +178,39 @@ test_diagnosis(base + expr + "]", false, errors);
 }
 
 
+int testParseIntoLayout() {
+  int errors = 0;
+  std::string base = "testParseIntoLayout - [";
+
+  std::string expr = " " + op_OR + "( 4, " + op_AND + " (1,2 ,3), " + op_AND + "(5,6) )";
+  vector<int> members;
+  vector<unsigned int> offsets;
+  BLAccessPolicy::parseFromExpression(expr, members, offsets);
+  int verifMembers[] = {4, 1, 2, 3, 5, 6};
+  unsigned int verifOffsets[] = {0, 1, 4, 6};
+  test_diagnosis(base + expr + "] members", members == vector<int>(verifMembers, verifMembers + 6), errors);
+  test_diagnosis(base + expr + "] offsets", offsets == vector<unsigned int>(verifOffsets, verifOffsets + 4), errors);
+
+  // the error names the position of the nested AND
+  expr = op_OR + "(1, " + op_AND + "(2, " + op_AND + "(3,4)))";
+  try {
+    BLAccessPolicy::parseFromExpression(expr, members, offsets);
+    test_diagnosis(base + expr + "] error position", false, errors);
+  } catch (std::exception &e) {
+    test_diagnosis(base + expr + "] error position", std::string(e.what()).find("at position 13:") != std::string::npos, errors);
+  }
+
+  expr = op_OR + "(1,,2)"; // empty arguments are not minimal sets
+  try {
+    BLAccessPolicy::parseFromExpression(expr, members, offsets);
+    test_diagnosis(base + expr + "]", false, errors);
+  } catch (std::exception &e) {
+    test_diagnosis(base + expr + "]", true, errors);
+  }
+
+  return errors;
+}
+
 int testVectors(int errors, vector<vector<ShareTuple> > testRun, vector<vector<ShareTuple> > witnessRun, BLAccessPolicy pol, std::string expr) {
   ENHDEBUG("===============");
   ENHDEBUG("Testing vectors");
@@ -220,16 +253,21 @@ int testVectors(int errors, vector<vector<ShareTuple> > testRun, vector<vector<S
 }
 
 
+// Share identifiers are the position of the share in the order of distribution, and its position within its minimal set.
+// The comments give the identifiers in readable form, "<minimal set>:<attribute>". Shares that the policy does not issue, because the minimal set
+// does not hold the attribute, get an index beyond the shares of the policy.
+const unsigned int NOT_ISSUED = 1000;
+
 int testExpr1(int errors) {
 
   std::string expr1 = op_OR + "(1,2,3)";
   BLAccessPolicy pol1(expr1, 5);
 
-  ShareTuple s11(1,0,"1:1");
-  ShareTuple s12(2,0,"2:2");
-  ShareTuple s13(3,0,"3:3");
-  ShareTuple s14(4,0,"4:4");
-  ShareTuple s15(5,0,"5:5");
+  ShareTuple s11(1,0,ShareID(0,0)); // 1:1
+  ShareTuple s12(2,0,ShareID(1,0)); // 2:2
+  ShareTuple s13(3,0,ShareID(2,0)); // 3:3
+  ShareTuple s14(4,0,ShareID(NOT_ISSUED,0)); // 4:4
+  ShareTuple s15(5,0,ShareID(NOT_ISSUED+1,0)); // 5:5
 
   vector<ShareTuple> ex1Test1;
   vector<ShareTuple> ex1Test2;
@@ -300,12 +338,12 @@ int testExpr2(int errors) {
   std::string expr2 = op_OR + "(" + op_AND + "(1,2)," + op_AND + "(3,4))";
   BLAccessPolicy pol2(expr2, 4);
 
-  ShareTuple s11(1,0,"1:1");
-  ShareTuple s12(2,0,"1:2");
-  ShareTuple s13(3,0,"1:3");
-  ShareTuple s22(2,0,"2:2");
-  ShareTuple s23(3,0,"2:3");
-  ShareTuple s24(4,0,"2:4");
+  ShareTuple s11(1,0,ShareID(0,0)); // 1:1
+  ShareTuple s12(2,0,ShareID(1,1)); // 1:2
+  ShareTuple s13(3,0,ShareID(NOT_ISSUED,0)); // 1:3
+  ShareTuple s22(2,0,ShareID(NOT_ISSUED+1,0)); // 2:2
+  ShareTuple s23(3,0,ShareID(2,0)); // 2:3
+  ShareTuple s24(4,0,ShareID(3,1)); // 2:4
   
 
   vector<ShareTuple> ex2TestA1;
@@ -390,20 +428,20 @@ int testExpr3(int errors) {
   std::string expr3 = op_OR + "(" + op_AND + "(3,4,5)," + op_AND + "(1,2)," + op_AND + "(4,1,6,5))";
   BLAccessPolicy pol3(expr3, 6);
 
-  ShareTuple s11(1,0,"1:1");
-  ShareTuple s12(2,0,"1:2");
-  ShareTuple s13(3,0,"1:3");
-  ShareTuple s14(4,0,"1:4");
-  ShareTuple s15(5,0,"1:5");
-  ShareTuple s21(1,0,"2:1");
-  ShareTuple s22(2,0,"2:2");
-  ShareTuple s23(3,0,"2:3");
-  ShareTuple s31(1,0,"3:1");
-  ShareTuple s32(2,0,"3:2");
-  ShareTuple s33(3,0,"3:3");
-  ShareTuple s34(4,0,"3:4");
-  ShareTuple s35(5,0,"3:5");
-  ShareTuple s36(6,0,"3:6");
+  ShareTuple s11(1,0,ShareID(NOT_ISSUED,0)); // 1:1
+  ShareTuple s12(2,0,ShareID(NOT_ISSUED+1,0)); // 1:2
+  ShareTuple s13(3,0,ShareID(0,0)); // 1:3
+  ShareTuple s14(4,0,ShareID(1,1)); // 1:4
+  ShareTuple s15(5,0,ShareID(2,2)); // 1:5
+  ShareTuple s21(1,0,ShareID(3,0)); // 2:1
+  ShareTuple s22(2,0,ShareID(4,1)); // 2:2
+  ShareTuple s23(3,0,ShareID(NOT_ISSUED+2,0)); // 2:3
+  ShareTuple s31(1,0,ShareID(6,1)); // 3:1
+  ShareTuple s32(2,0,ShareID(NOT_ISSUED+3,0)); // 3:2
+  ShareTuple s33(3,0,ShareID(NOT_ISSUED+4,0)); // 3:3
+  ShareTuple s34(4,0,ShareID(5,0)); // 3:4
+  ShareTuple s35(5,0,ShareID(8,3)); // 3:5
+  ShareTuple s36(6,0,ShareID(7,2)); // 3:6
   
 
   vector<ShareTuple> ex3TestA3A4A5;
@@ -492,6 +530,112 @@ int testEvaluate() {
   return errors;
 }
 
+int testMinimalSetChoice() {
+  int errors = 0;
+  std::string base = "testMinimalSetChoice: ";
+
+  std::string expr = op_OR + "(" + op_AND + "(1,2,3)," + op_AND + "(4,5),6," + op_AND + "(1,6))";
+  BLAccessPolicy pol(expr, 6);
+
+  vector<ShareID> shareIDs;
+  vector<vector<int> > minimalSets = pol.getMinimalSets();
+  for (unsigned int i = 0; i < minimalSets.size(); i++) {
+    for (unsigned int j = 0; j < minimalSets[i].size(); j++) {
+      shareIDs.push_back(pol.createShareID(i, j));
+    }
+  }
+
+  vector<int> witnessIndices;
+  vector<int> verifFirst;
+  verifFirst.push_back(0);
+  verifFirst.push_back(1);
+  verifFirst.push_back(2);
+  test_diagnosis(base + "first set", pol.evaluateIDs(shareIDs, witnessIndices) && (witnessIndices == verifFirst), errors);
+
+  pol.setMinimalSetChoice(BLAccessPolicy::smallestSatisfiedSet);
+  vector<int> verifSmallest;
+  verifSmallest.push_back(5);
+  test_diagnosis(base + "smallest set", pol.evaluateIDs(shareIDs, witnessIndices) && (witnessIndices == verifSmallest), errors);
+
+  // without the share of 6, the smallest satisfied sets have two shares, and the first of them is chosen
+  shareIDs.erase(shareIDs.begin() + 5);
+  vector<int> verifSmallest2;
+  verifSmallest2.push_back(3);
+  verifSmallest2.push_back(4);
+  test_diagnosis(base + "smallest set, with a tie", pol.evaluateIDs(shareIDs, witnessIndices) && (witnessIndices == verifSmallest2), errors);
+
+  // sets that span several words of the bitset. The first set misses its last share, in the second word
+  std::string expr2 = op_OR + "(" + op_AND + "(";
+  for (int i = 1; i <= 70; i++) {
+    expr2 += convertIntToStr(i) + ((i < 70) ? "," : "),");
+  }
+  expr2 += op_AND + "(";
+  for (int i = 1; i <= 60; i++) {
+    expr2 += convertIntToStr(i) + ((i < 60) ? "," : "))");
+  }
+  BLAccessPolicy pol2(expr2, 70);
+  vector<ShareID> shareIDs2;
+  vector<int> verifLarge;
+  for (unsigned int i = 0; i < 130; i++) {
+    if (i == 69) continue;
+    if (i >= 70) verifLarge.push_back(shareIDs2.size());
+    shareIDs2.push_back(ShareID(i, 0));
+  }
+  test_diagnosis(base + "sets across words", pol2.evaluateIDs(shareIDs2, witnessIndices) && (witnessIndices == verifLarge), errors);
+  shareIDs2.erase(shareIDs2.begin() + 100);
+  test_diagnosis(base + "sets across words, none satisfied", !pol2.evaluateIDs(shareIDs2, witnessIndices) && witnessIndices.empty(), errors);
+
+  return errors;
+}
+
+// the hash follows the minimal sets and the participants, and not the description or the choice of minimal set
+int testStructuralHash() {
+  int errors = 0;
+  std::string base = "testStructuralHash - ";
+
+  BLAccessPolicy policy(op_OR + "(1, " + op_AND + "(2,3))", 4);
+  BLAccessPolicy spaced(" " + op_OR + " ( 1 , " + op_AND + " ( 2 , 3 ) ) ", 4);
+  spaced.setMinimalSetChoice(BLAccessPolicy::smallestSatisfiedSet);
+  test_diagnosis(base + "same sets", (policy.getStructuralHash() == spaced.getStructuralHash()) && (policy == spaced), errors);
+
+  BLAccessPolicy regrouped(op_OR + "(" + op_AND + "(1,2),3)", 4);
+  BLAccessPolicy otherParts(op_OR + "(1, " + op_AND + "(2,3))", 5);
+  test_diagnosis(base + "other sets", (policy.getStructuralHash() != regrouped.getStructuralHash()) && !(policy == regrouped), errors);
+  test_diagnosis(base + "other participants", (policy.getStructuralHash() != otherParts.getStructuralHash()) && !(policy == otherParts), errors);
+
+  vector<char> bytes;
+  BinaryWriter out(bytes);
+  policy.writeBinary(out);
+  BinaryReader in(bytes);
+  shared_ptr<BLAccessPolicy> read = BLAccessPolicy::readBinary(in);
+  test_diagnosis(base + "read back", (read->getStructuralHash() == policy.getStructuralHash()) && (*read == policy), errors);
+
+  return errors;
+}
+
+int testMinimalSetLayout() {
+  int errors = 0;
+  std::string base = "testMinimalSetLayout: ";
+
+  std::string expr = op_OR + "(" + op_AND + "(1,2,3)," + op_AND + "(4,5),6," + op_AND + "(1,6))";
+  BLAccessPolicy pol(expr, 6);
+
+  int members[] = {1,2,3, 4,5, 6, 1,6};
+  unsigned int offsets[] = {0, 3, 5, 6, 8};
+  test_diagnosis(base + "number of sets", pol.getNumMinimalSets() == 4, errors);
+  test_diagnosis(base + "members", pol.getSetMembers() == vector<int>(members, members + 8), errors);
+  test_diagnosis(base + "offsets", pol.getSetOffsets() == vector<unsigned int>(offsets, offsets + 5), errors);
+  test_diagnosis(base + "nested copy", pol.getMinimalSets() == BLAccessPolicy::parseFromExpression(0, expr), errors);
+
+  BLAccessPolicy copy(pol);
+  test_diagnosis(base + "copied layout", (copy.getSetMembers() == pol.getSetMembers()) && (copy.getSetOffsets() == pol.getSetOffsets()), errors);
+
+  BLAccessPolicy empty;
+  test_diagnosis(base + "empty policy", (empty.getNumMinimalSets() == 0) && (empty.getNumShares() == 0), errors);
+
+  return errors;
+}
+
 int testGetNumShares() {
 	int errors = 0;
 
@@ -527,14 +671,14 @@ int testGetSharesForParticipants(PFC &pfc) {
   BLSS testScheme(policy, pfc.order(), pfc);
 
   ENHDEBUG("Creating shares");
-  ShareTuple s1a(1, 0, "1a");
-  ShareTuple s1b(1, 0, "1b");
-  ShareTuple s2a(2, 0, "2a");
-  ShareTuple s3a(3, 0, "3a");
-  ShareTuple s3b(3, 0, "3b");
-  ShareTuple s3c(3, 0, "3c");
-  ShareTuple s4a(4, 0, "4a");
-  ShareTuple s5a(5, 0, "5a");
+  ShareTuple s1a(1, 0, ShareID(0, 0));
+  ShareTuple s1b(1, 0, ShareID(1, 0));
+  ShareTuple s2a(2, 0, ShareID(2, 0));
+  ShareTuple s3a(3, 0, ShareID(3, 0));
+  ShareTuple s3b(3, 0, ShareID(4, 0));
+  ShareTuple s3c(3, 0, ShareID(5, 0));
+  ShareTuple s4a(4, 0, ShareID(6, 0));
+  ShareTuple s5a(5, 0, ShareID(7, 0));
 
   vector<ShareTuple> shares;
 
@@ -708,6 +852,29 @@ int testDistributeAndReconstruct(PFC &pfc){
     return errors;
 }
 
+int testSeededDistribution(PFC &pfc){
+  int errors = 0;
+  std::string base = "testSeededDistribution: ";
+
+  std::string expr = op_OR + "(" + op_AND + "(1,2,3)," + op_AND + "(4,5),6)";
+  shared_ptr<BLAccessPolicy> policy = make_shared<BLAccessPolicy>(expr, 6);
+  BLSS testScheme(policy, pfc);
+  Big s;
+  pfc.random(s);
+
+  vector<ShareTuple> shares = testScheme.distribute_random(s);
+  vector<ShareTuple> again = testScheme.distribute_seeded(s, testScheme.getLastSeed());
+  bool same = (shares.size() == again.size());
+  for (unsigned int i = 0; same && (i < shares.size()); i++) {
+    same = (shares[i].getShare() == again[i].getShare());
+  }
+  test_diagnosis(base + "reproduced from the seed", same, errors);
+  test_diagnosis(base + "amount of randomness", testScheme.getDistribRandomness().size() == 3, errors);
+  test_diagnosis(base + "reconstruction", testScheme.reconstruct(shares) == s, errors);
+
+  return errors;
+}
+
 int testObtainCoveredFrags() {
   int errors = 0;
 
@@ -723,7 +890,7 @@ int testObtainCoveredFrags() {
   
   vector<int> attFragIndices;
   vector<int> keyFragIndices;
-  vector<std::string> coveredShareIDs;
+  vector<ShareID> coveredShareIDs;
 
   std::string expr = op_OR + "(1, " + op_AND + "(2,3,4), " + op_AND + "(2,5), " + op_AND + "(4,5))";
   shared_ptr<BLAccessPolicy> policy = make_shared<BLAccessPolicy>(expr, 5);
@@ -756,7 +923,8 @@ int testObtainCoveredFrags() {
 
   test_diagnosis(base + "number of covered IDs", coveredShareIDs.size() == 6, errors);
   for (unsigned int i = 0; i < coveredShareIDs.size(); i++) {
-    test_diagnosis(base + "coveredID " + convertIntToStr(i), coveredShareIDs[i] == verifShareIDs[i], errors);
+    test_diagnosis(base + "coveredID " + convertIntToStr(i), policy->renderShareID(coveredShareIDs[i]) == verifShareIDs[i], errors);
+    test_diagnosis(base + "coveredID index " + convertIntToStr(i), (int) coveredShareIDs[i].getIndex() == keyFragIndices[i], errors);
   }
 
   test_diagnosis(base + "number of keyFragIndices", keyFragIndices.size() == 6, errors);
@@ -778,7 +946,11 @@ int runTests(PFC &pfc) {
   // Policy tests
   ENHOUT("Secret sharing policy tests");
   errors += testParseExpression();
+  errors += testParseIntoLayout();
   errors += testEvaluate();
+  errors += testMinimalSetChoice();
+  errors += testMinimalSetLayout();
+  errors += testStructuralHash();
   errors += testGetNumShares();
   errors += testObtainCoveredFrags();
   
@@ -786,6 +958,7 @@ int runTests(PFC &pfc) {
   ENHOUT("Secret sharing scheme tests");
   errors += testGetSharesForParticipants(pfc);
   errors += testDistributeAndReconstruct(pfc);
+  errors += testSeededDistribution(pfc);
 
 
   return errors;
@@ -0,0 +1,217 @@
+/*
+  Testbed for empirical evaluation of KP-ABE schemes, according to Crampton, Pinto (CSF2014).
+  Code by: Alexandre Miranda Pinto
+
+  This file holds tests for the span program and the LSSS scheme (LSSS.cpp).
+  The access structure of each policy is checked against ShTree, which shares over the same tree, by evaluating both over every set of a few attributes.
+*/
+
+#ifndef DEF_UTILS
+#include "utils.h"
+#endif
+
+#ifndef DEF_LSSS
+#include "LSSS.h"
+#endif
+
+int testSpanProgram() {
+  int errors = 0;
+  std::string base = "testSpanProgram: ";
+
+  LSSSAccessPolicy andPolicy(op_AND + "(1,2,3)", 3);
+  const SpanProgram &andProgram = andPolicy.getSpanProgram();
+  test_diagnosis(base + "AND size", (andProgram.getNumRows() == 3) && (andProgram.getNumColumns() == 3), errors);
+  test_diagnosis(base + "AND rows", (andProgram.rowToString(0) == "1:1") && (andProgram.rowToString(1) == "2:1")
+		 && (andProgram.rowToString(2) == "0:1 1:-1 2:-1"), errors);
+
+  LSSSAccessPolicy orPolicy(op_OR + "(1,2)", 2);
+  const SpanProgram &orProgram = orPolicy.getSpanProgram();
+  test_diagnosis(base + "OR", (orProgram.getNumColumns() == 1) && (orProgram.rowToString(0) == "0:1") && (orProgram.rowToString(1) == "0:1"), errors);
+
+  LSSSAccessPolicy thrPolicy(op_THR + "(3, 1,2,3,4)", 4);
+  const SpanProgram &thrProgram = thrPolicy.getSpanProgram();
+  test_diagnosis(base + "THR", (thrProgram.getNumColumns() == 3) && (thrProgram.rowToString(0) == "0:1 1:1 2:1")
+		 && (thrProgram.rowToString(3) == "0:1 1:4 2:16"), errors);
+
+  // powers too large for a long long are written as base^exponent
+  std::string large = op_THR + "(30";
+  for (int i = 1; i <= 40; i++) {
+    large += ", " + convertIntToStr(i);
+  }
+  large += ")";
+  LSSSAccessPolicy largePolicy(large, 40);
+  const SpanProgram &largeProgram = largePolicy.getSpanProgram();
+  test_diagnosis(base + "large powers", (largeProgram.getExponent(largeProgram.rowEnd(1) - 1) == 29)
+		 && (largeProgram.rowToString(1).find("29:536870912") != std::string::npos)
+		 && (largeProgram.rowToString(39).find("29:40^29") != std::string::npos), errors);
+
+  // the AND below the OR gets the vector of the OR, which is that of the secret
+  LSSSAccessPolicy nested(op_OR + "(1, " + op_AND + "(2,3))", 3);
+  const SpanProgram &nestedProgram = nested.getSpanProgram();
+  test_diagnosis(base + "nested", (nestedProgram.getNumRows() == 3) && (nestedProgram.rowToString(1) == "1:1")
+		 && (nestedProgram.rowToString(2) == "0:1 1:-1"), errors);
+  test_diagnosis(base + "render", nested.renderShareID(ShareID(2, 1)) == "3=[0:1 1:-1]", errors);
+
+  LSSSAccessPolicy empty("", 1);
+  test_diagnosis(base + "empty policy", (empty.getNumShares() == 0) && (empty.getSpanProgram().getNumColumns() == 1), errors);
+
+  return errors;
+}
+
+int testStructuralHash() {
+  int errors = 0;
+  std::string base = "testStructuralHash: ";
+
+  LSSSAccessPolicy orPolicy(op_OR + "(1,2)", 2);
+  LSSSAccessPolicy thrPolicy(op_THR + "(1, 1,2)", 2);
+  test_diagnosis(base + "same structure", (orPolicy.getStructuralHash() == thrPolicy.getStructuralHash()) && (orPolicy == thrPolicy), errors);
+
+  LSSSAccessPolicy andPolicy(op_AND + "(1,2)", 2);
+  test_diagnosis(base + "different structure", (orPolicy.getStructuralHash() != andPolicy.getStructuralHash()) && !(orPolicy == andPolicy), errors);
+
+  ShTreeAccessPolicy treePolicy(op_OR + "(1,2)", 2);
+  test_diagnosis(base + "different scheme", orPolicy.getStructuralHash() != treePolicy.getStructuralHash(), errors);
+
+  return errors;
+}
+
+// every set of the attributes 1 to nAtts is authorized in both schemes or in neither, and the authorized ones reconstruct the secret
+int testAccessStructure(PFC &pfc, const std::string& expr, int nAtts) {
+  int errors = 0;
+  std::string base = "testAccessStructure: " + expr;
+
+  shared_ptr<LSSSAccessPolicy> policy = make_shared<LSSSAccessPolicy>(expr, nAtts);
+  LSSSSS scheme(policy, pfc);
+  ShTreeAccessPolicy treePolicy(expr, nAtts);
+  Big s = rand();
+  vector<ShareTuple> shares = scheme.distribute_random(s);
+  test_diagnosis(base + " shares", shares.size() == treePolicy.getNumShares(), errors);
+  test_diagnosis(base + " randomness", scheme.getNumRandomness() == treePolicy.getCompiledTree().getNumRandomness(), errors);
+
+  bool sameStructure = true;
+  bool reconstructed = true;
+  for (unsigned int set = 0; set < (1U << nAtts); set++) {
+    vector<int> party;
+    for (int a = 0; a < nAtts; a++) {
+      if ((set >> a) & 1) party.push_back(a + 1);
+    }
+    vector<ShareTuple> partyShares = SecretSharing::getSharesForParticipants(party, shares);
+    vector<ShareTuple> witnessShares;
+    vector<ShareTuple> treeWitnessShares;
+    bool authorized = scheme.evaluate(partyShares, witnessShares);
+    if (authorized != treePolicy.evaluate(partyShares, treeWitnessShares)) {
+      sameStructure = false;
+    }
+    if (authorized && (scheme.reconstruct(partyShares) != s)) {
+      reconstructed = false;
+    }
+  }
+  test_diagnosis(base + " authorized sets", sameStructure, errors);
+  test_diagnosis(base + " reconstruction", reconstructed, errors);
+  return errors;
+}
+
+int testDistributeAndReconstruct(PFC &pfc) {
+  int errors = 0;
+  errors += testAccessStructure(pfc, op_AND + "(1,2,3,4)", 4);
+  errors += testAccessStructure(pfc, op_OR + "(1,2,3,4)", 4);
+  errors += testAccessStructure(pfc, op_THR + "(3, 1,2,3,4,5)", 5);
+  errors += testAccessStructure(pfc, op_OR + "(" + op_AND + "(1,2), " + op_AND + "(3,4), 5)", 5);
+  errors += testAccessStructure(pfc, op_AND + "(" + op_OR + "(1,2), " + op_THR + "(2, 3,4,5), 6)", 6);
+  errors += testAccessStructure(pfc, op_THR + "(2, " + op_AND + "(1,2), " + op_OR + "(3,4), " + op_THR + "(2, 4,5,6))", 6);
+
+  // a gate whose powers are far larger than the order: any threshold of the shares reconstructs the secret, and fewer do not
+  std::string base = "testDistributeAndReconstruct: large threshold";
+  std::string expr = op_THR + "(60";
+  for (int i = 1; i <= 64; i++) {
+    expr += ", " + convertIntToStr(i);
+  }
+  expr += ")";
+  shared_ptr<LSSSAccessPolicy> policy = make_shared<LSSSAccessPolicy>(expr, 64);
+  LSSSSS scheme(policy, pfc);
+  Big s = rand();
+  vector<ShareTuple> shares = scheme.distribute_random(s);
+  vector<int> party;
+  for (int i = 5; i <= 64; i++) party.push_back(i);
+  test_diagnosis(base + " reconstruction", scheme.reconstruct(SecretSharing::getSharesForParticipants(party, shares)) == s, errors);
+  party.pop_back();
+  test_diagnosis(base + " below the threshold", scheme.reconstruct(SecretSharing::getSharesForParticipants(party, shares)) == -1, errors);
+  return errors;
+}
+
+int testFindCoefficients(PFC &pfc) {
+  int errors = 0;
+  std::string base = "testFindCoefficients: ";
+
+  std::string expr = op_AND + "(" + op_OR + "(1,2), " + op_THR + "(2, 3,4,5))";
+  shared_ptr<LSSSAccessPolicy> policy = make_shared<LSSSAccessPolicy>(expr, 5);
+  LSSSSS scheme(policy, pfc);
+  Big order = scheme.getOrder();
+  Big s = rand();
+  vector<ShareTuple> shares = scheme.distribute_random(s);
+
+  // a set that is not minimal: the rows that are not needed receive 0, and the combination is still the secret
+  vector<ShareID> shareIDs;
+  for (unsigned int i = 0; i < shares.size(); i++) {
+    shareIDs.push_back(shares[i].getShareID());
+  }
+  vector<Big> coeffs = policy->findCoefficients(shareIDs, order);
+  Big sum = 0;
+  for (unsigned int i = 0; i < shares.size(); i++) {
+    sum = (sum + modmult(coeffs[i], shares[i].getShare(), order)) % order;
+  }
+  test_diagnosis(base + "all the shares", sum == s, errors);
+  test_diagnosis(base + "cached", policy->getCoefficientCache()->size() == 1, errors);
+
+  // the same rows in another order take the cached coefficients, in that order
+  vector<ShareID> reversed(shareIDs.rbegin(), shareIDs.rend());
+  vector<Big> reversedCoeffs = policy->findCoefficients(reversed, order);
+  test_diagnosis(base + "cache reorders", (policy->getCoefficientCache()->size() == 1) && (reversedCoeffs[0] == coeffs[shares.size() - 1]), errors);
+
+  vector<ShareID> unauthorized;
+  unauthorized.push_back(shareIDs[0]);
+  unauthorized.push_back(shareIDs[1]);
+  unauthorized.push_back(shareIDs[2]);
+  vector<Big> solved;
+  test_diagnosis(base + "unauthorized rows", !LSSSAccessPolicy::solveCoefficients(policy->getSpanProgram(), vector<int>(1, 2), order, solved), errors);
+  try {
+    policy->findCoefficients(unauthorized, order);
+    test_diagnosis(base + "unauthorized throws", false, errors);
+  } catch (std::runtime_error &e) {
+    test_diagnosis(base + "unauthorized throws", true, errors);
+  }
+
+  return errors;
+}
+
+int runTests(PFC &pfc) {
+  int errors = 0;
+
+  ENHOUT("Span program tests");
+  errors += testSpanProgram();
+  errors += testStructuralHash();
+
+  ENHOUT("Secret sharing scheme tests");
+  errors += testDistributeAndReconstruct(pfc);
+  errors += testFindCoefficients(pfc);
+
+  return errors;
+}
+
+int main() {
+  PFC pfc(AES_SECURITY);  // initialise pairing-friendly curve
+  miracl *mip=get_mip();  // get handle on mip (Miracl Instance Pointer)
+
+  mip->IOBASE=10;
+
+  time_t seed;
+  time(&seed);
+  irand((long)seed);
+  srand((long)seed);
+
+  std::string test_name = "Test LSSS";
+  int result = runTests(pfc);
+  print_test_result(result,test_name);
+
+  return 0;
+}
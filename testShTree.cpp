@@ -188,6 +188,48 @@ int testParseTreeFromExpression() {
   return errors;
 }
 
+// the message of a parse error must point at the position where the description stopped making sense
+bool failsAtPosition(ShTreeAccessPolicy &policy, const std::string &expr, unsigned int pos) {
+  try {
+    policy.parseTreeFromExpression(expr);
+  } catch (std::exception &e) {
+    std::string message = e.what();
+    DEBUG("parse error: " << message);
+    return (message.find(ERR_BAD_POLICY) == 0) && (message.find("at position " + convertIntToStr(pos) + ":") != std::string::npos);
+  }
+  return false;
+}
+
+int testParseErrorPositions() {
+  int errors = 0;
+  ShTreeAccessPolicy testPolicy;
+  std::string base = "testParseErrorPositions - [";
+
+  std::string expr = op_AND + "(1, XOR(2,3))";
+  test_diagnosis(base + expr + "]", failsAtPosition(testPolicy, expr, 7), errors);
+  expr = op_OR + "(1,2";
+  test_diagnosis(base + expr + "]", failsAtPosition(testPolicy, expr, 6), errors);
+  expr = op_OR + "(1,2) 3";
+  test_diagnosis(base + expr + "]", failsAtPosition(testPolicy, expr, 8), errors);
+  expr = op_THR + "(5,1,2)";
+  test_diagnosis(base + expr + "]", failsAtPosition(testPolicy, expr, 4), errors);
+  expr = op_OR + "(1,2a)";
+  test_diagnosis(base + expr + "]", failsAtPosition(testPolicy, expr, 5), errors);
+
+  // white space is allowed between any two tokens
+  expr = " " + op_THR + " ( 2 , 1,\t" + op_AND + "(2, 3) , 4 ) ";
+  shared_ptr<TreeNode> spaced = testPolicy.parseTreeFromExpression(expr);
+  shared_ptr<TreeNode> compact = testPolicy.parseTreeFromExpression(op_THR + "(2,1," + op_AND + "(2,3),4)");
+  test_diagnosis(base + expr + "]", *spaced == *compact, errors);
+
+  // an empty argument is a NIL child
+  expr = op_OR + "(1,,2)";
+  shared_ptr<TreeNode> tree = testPolicy.parseTreeFromExpression(expr);
+  test_diagnosis(base + expr + "]", (tree->getNumChildren() == 3) && tree->getChild(1)->isNil(), errors);
+
+  return errors;
+}
+
 
 // this test tries several simple trees with different sets of shares. The argument of a share is its participant, identified by a simple integer.
 // but a share has an implicit ID, defined by the policy that supports its issue. SatisfyNode verifies that the right shares are present, according to a policy.
@@ -276,22 +318,23 @@ int testSatisfyNode() {
   // AND: {}, {}, {}, {3,4,1,2}
   // THR: {}, {}, {4,1,3}, {2,4,1}
 
-  // Leaf Node labels: "<the Id of the parent> := <the participant>"
+  // Share identifiers: <the number of the leaf, in the order of distribution> / <the child number of the leaf in its gate>
+  // In these trees, both are the position of the leaf under the root. The comments give the path of the leaf: "<the Id of the parent> := <the participant>"
 
-  ShareTuple o1(1, 0, "0:0:=1");
-  ShareTuple o2(2, 0, "0:1:=2");
-  ShareTuple o3(3, 0, "0:2:=3");
-  ShareTuple o4(4, 0, "0:3:=4");
+  ShareTuple o1(1, 0, ShareID(0,0)); // 0:0:=1
+  ShareTuple o2(2, 0, ShareID(1,1)); // 0:1:=2
+  ShareTuple o3(3, 0, ShareID(2,2)); // 0:2:=3
+  ShareTuple o4(4, 0, ShareID(3,3)); // 0:3:=4
 
-  ShareTuple a3(3,0,"0:0:=3");
-  ShareTuple a4(4,0,"0:1:=4");
-  ShareTuple a1(1,0,"0:2:=1");
-  ShareTuple a2(2,0,"0:3:=2");
+  ShareTuple a3(3,0,ShareID(0,0)); // 0:0:=3
+  ShareTuple a4(4,0,ShareID(1,1)); // 0:1:=4
+  ShareTuple a1(1,0,ShareID(2,2)); // 0:2:=1
+  ShareTuple a2(2,0,ShareID(3,3)); // 0:3:=2
 
-  ShareTuple t2(2,0,"0:0:=2");
-  ShareTuple t4(4,0,"0:1:=4");
-  ShareTuple t1(1,0,"0:2:=1");
-  ShareTuple t3(3,0,"0:3:=3");
+  ShareTuple t2(2,0,ShareID(0,0)); // 0:0:=2
+  ShareTuple t4(4,0,ShareID(1,1)); // 0:1:=4
+  ShareTuple t1(1,0,ShareID(2,2)); // 0:2:=1
+  ShareTuple t3(3,0,ShareID(3,3)); // 0:3:=3
 
   vector<ShareTuple> orSet;
   vector<ShareTuple> andSet;
@@ -441,11 +484,11 @@ int testExpr1() {
   std::string expr = "";
   ShTreeAccessPolicy pol(expr, 0);
 
-  ShareTuple s11(1,0,"1:1");
-  ShareTuple s12(2,0,"2:2");
-  ShareTuple s13(3,0,"3:3");
-  ShareTuple s14(4,0,"4:4");
-  ShareTuple s15(5,0,"5:5");
+  ShareTuple s11(1,0,ShareID(0,0));
+  ShareTuple s12(2,0,ShareID(1,1));
+  ShareTuple s13(3,0,ShareID(2,2));
+  ShareTuple s14(4,0,ShareID(3,3));
+  ShareTuple s15(5,0,ShareID(4,4));
 
   vector<ShareTuple> shareList;
   shareList.push_back(s11);
@@ -475,11 +518,12 @@ int testExpr2() {
   std::string expr = "4";
   ShTreeAccessPolicy pol(expr, 0);
 
-  ShareTuple s11(1,0,"0:=1");
-  ShareTuple s12(2,0,"0:=2");
-  ShareTuple s13(3,0,"0:=3");
-  ShareTuple s14(4,0,"0:=4");
-  ShareTuple s15(5,0,"0:=5");
+  // only the share of participant 4 is held by the leaf. The others get an index beyond the shares of the policy
+  ShareTuple s11(1,0,ShareID(1,ShareID::ROOT_SHARE)); // 0:=1
+  ShareTuple s12(2,0,ShareID(2,ShareID::ROOT_SHARE)); // 0:=2
+  ShareTuple s13(3,0,ShareID(3,ShareID::ROOT_SHARE)); // 0:=3
+  ShareTuple s14(4,0,ShareID(0,ShareID::ROOT_SHARE)); // 0:=4
+  ShareTuple s15(5,0,ShareID(4,ShareID::ROOT_SHARE)); // 0:=5
 
   vector<ShareTuple> shareList;
   shareList.push_back(s11);
@@ -512,15 +556,15 @@ int testExpr3() {
   //  OUT("Expr3: " << expr);
   ShTreeAccessPolicy pol(expr, 6);
 
-  ShareTuple s11(1,0,"0:0:=1");
-  ShareTuple s22(2,0,"0:1:0:=2");
-  ShareTuple s35(5,0,"0:1:1:0:=5");
-  ShareTuple s32(2,0,"0:1:1:1:=2");
-  ShareTuple s33(3,0,"0:1:1:2:=3");
-  ShareTuple s34(4,0,"0:1:1:3:=4");
-  ShareTuple s44(4,0,"0:2:=4");
-  ShareTuple s56(6,0,"0:3:0:=6");
-  ShareTuple s51(1,0,"0:3:1:=1");
+  ShareTuple s11(1,0,ShareID(0,0)); // 0:0:=1
+  ShareTuple s22(2,0,ShareID(1,0)); // 0:1:0:=2
+  ShareTuple s35(5,0,ShareID(2,0)); // 0:1:1:0:=5
+  ShareTuple s32(2,0,ShareID(3,1)); // 0:1:1:1:=2
+  ShareTuple s33(3,0,ShareID(4,2)); // 0:1:1:2:=3
+  ShareTuple s34(4,0,ShareID(5,3)); // 0:1:1:3:=4
+  ShareTuple s44(4,0,ShareID(6,2)); // 0:2:=4
+  ShareTuple s56(6,0,ShareID(7,0)); // 0:3:0:=6
+  ShareTuple s51(1,0,ShareID(8,1)); // 0:3:1:=1
 
   vector<ShareTuple> sl;
   sl.push_back(s11);
@@ -533,6 +577,20 @@ int testExpr3() {
   sl.push_back(s56);
   sl.push_back(s51);
 
+  vector<std::string> paths;
+  paths.push_back("0:0:=1");
+  paths.push_back("0:1:0:=2");
+  paths.push_back("0:1:1:0:=5");
+  paths.push_back("0:1:1:1:=2");
+  paths.push_back("0:1:1:2:=3");
+  paths.push_back("0:1:1:3:=4");
+  paths.push_back("0:2:=4");
+  paths.push_back("0:3:0:=6");
+  paths.push_back("0:3:1:=1");
+  for (unsigned int i = 0; i < sl.size(); i++) {
+    test_diagnosis("testRenderShareID [" + expr + "]: " + paths[i], pol.renderShareID(sl[i].getShareID()) == paths[i], errors);
+  }
+
   vector<ShareTuple> run1;
   run1.push_back(sl[0]);
   run1.push_back(sl[6]);
@@ -658,7 +716,7 @@ int testObtainCoveredFrags() {
   
   vector<int> attFragIndices;
   vector<int> keyFragIndices;
-  vector<std::string> coveredShareIDs;
+  vector<ShareID> coveredShareIDs;
 
   std::string expr = op_OR + "(1, " + op_OR + "(2, " + op_THR + "(2,1,2,3)), 4, " + op_AND + "(1,2))"; 
   shared_ptr<ShTreeAccessPolicy> policy = make_shared<ShTreeAccessPolicy>(expr, 5);
@@ -691,7 +749,7 @@ int testObtainCoveredFrags() {
 
   test_diagnosis(base + "number of covered IDs", coveredShareIDs.size() == verifShareIDs.size(), errors);
   for (unsigned int i = 0; i < coveredShareIDs.size(); i++) {
-    test_diagnosis(base + "coveredID " + convertIntToStr(i), coveredShareIDs[i] == verifShareIDs[i], errors);
+    test_diagnosis(base + "coveredID " + convertIntToStr(i), policy->renderShareID(coveredShareIDs[i]) == verifShareIDs[i], errors);
   }
 
   test_diagnosis(base + "number of keyFragIndices", keyFragIndices.size() == verifKeyFragIDs.size(), errors);
@@ -707,6 +765,49 @@ int testObtainCoveredFrags() {
   return errors;
 }
 
+int testCoveredSet() {
+  int errors = 0;
+
+  std::string base = "testCoveredSet: ";
+
+  vector<int> atts;
+  atts.push_back(7);
+  atts.push_back(2);
+  atts.push_back(70);
+  atts.push_back(2);
+  atts.push_back(-1);
+
+  CoveredSet covered(atts);
+  test_diagnosis(base + "size ignores repetitions and negative attributes", covered.size() == 3, errors);
+  test_diagnosis(base + "position of 7", covered.position(7) == 0, errors);
+  test_diagnosis(base + "first position of repeated 2", covered.position(2) == 1, errors);
+  test_diagnosis(base + "position in second word", covered.position(70) == 2, errors);
+  test_diagnosis(base + "absent attribute", !covered.contains(3) && (covered.position(3) == -1), errors);
+  test_diagnosis(base + "negative attribute", !covered.contains(-1), errors);
+  test_diagnosis(base + "beyond the largest attribute", !covered.contains(500), errors);
+
+  // the set is reused for another ciphertext, and must forget the previous one
+  vector<int> atts2;
+  atts2.push_back(3);
+  atts2.push_back(1);
+  covered.assign(atts2);
+  test_diagnosis(base + "size after reuse", covered.size() == 2, errors);
+  test_diagnosis(base + "previous attributes cleared", !covered.contains(7) && !covered.contains(2) && !covered.contains(70), errors);
+  test_diagnosis(base + "new positions", (covered.position(3) == 0) && (covered.position(1) == 1), errors);
+
+  // both forms of obtainCoveredFrags give the same result
+  std::string expr = op_OR + "(1, " + op_OR + "(2, " + op_THR + "(2,1,2,3)), 4, " + op_AND + "(1,2))"; 
+  shared_ptr<ShTreeAccessPolicy> policy = make_shared<ShTreeAccessPolicy>(expr, 5);
+  vector<int> attFragIndices, keyFragIndices, attFragIndices2, keyFragIndices2;
+  vector<ShareID> coveredShareIDs, coveredShareIDs2;
+  policy->obtainCoveredFrags(atts2, attFragIndices, keyFragIndices, coveredShareIDs);
+  policy->obtainCoveredFrags(covered, attFragIndices2, keyFragIndices2, coveredShareIDs2);
+  test_diagnosis(base + "same covered shares", (coveredShareIDs == coveredShareIDs2) && (coveredShareIDs.size() == 4), errors);
+  test_diagnosis(base + "same fragment indices", (attFragIndices == attFragIndices2) && (keyFragIndices == keyFragIndices2), errors);
+
+  return errors;
+}
+
 int testGetSharesForParticipants() {
   int errors = 0;
 
@@ -716,14 +817,14 @@ int testGetSharesForParticipants() {
   //  ShTreeSS testScheme(policy, pfc.order(), pfc);
 
   ENHDEBUG("Creating shares");
-  ShareTuple s1a(1, 0, "1a");
-  ShareTuple s1b(1, 0, "1b");
-  ShareTuple s2a(2, 0, "2a");
-  ShareTuple s3a(3, 0, "3a");
-  ShareTuple s3b(3, 0, "3b");
-  ShareTuple s3c(3, 0, "3c");
-  ShareTuple s4a(4, 0, "4a");
-  ShareTuple s5a(5, 0, "5a");
+  ShareTuple s1a(1, 0, ShareID(0, 0));
+  ShareTuple s1b(1, 0, ShareID(1, 1));
+  ShareTuple s2a(2, 0, ShareID(2, 2));
+  ShareTuple s3a(3, 0, ShareID(3, 3));
+  ShareTuple s3b(3, 0, ShareID(4, 4));
+  ShareTuple s3c(3, 0, ShareID(5, 5));
+  ShareTuple s4a(4, 0, ShareID(6, 6));
+  ShareTuple s5a(5, 0, ShareID(7, 7));
 
   vector<ShareTuple> shares;
 
@@ -821,6 +922,48 @@ int testReconFromShares(vector<int> party, std::string message,
   return errors;
 }
 
+// compares the values of two lists of shares
+bool sameShareValues(const vector<ShareTuple> &a, const vector<ShareTuple> &b) {
+  if (a.size() != b.size()) return false;
+  for (unsigned int i = 0; i < a.size(); i++) {
+    if (a[i].getShare() != b[i].getShare()) return false;
+  }
+  return true;
+}
+
+int testSeededDistribution(PFC &pfc){
+  int errors = 0;
+  std::string base = "testSeededDistribution: ";
+
+  std::string expr = op_THR + "(2, 1, " + op_AND + "(2,3), " + op_THR + "(3,1,2,3,4,5))";
+  shared_ptr<ShTreeAccessPolicy> policy = make_shared<ShTreeAccessPolicy>(expr, 5);
+  ShTreeSS testScheme(policy, pfc);
+  Big s;
+  pfc.random(s);
+
+  test_diagnosis(base + "no seed before the first distribution", testScheme.getLastSeed().empty(), errors);
+  vector<ShareTuple> shares = testScheme.distribute_random(s);
+  vector<char> seed = testScheme.getLastSeed();
+  test_diagnosis(base + "seed size", seed.size() == SeededPRG::SEED_BYTES, errors);
+  test_diagnosis(base + "amount of randomness", testScheme.getDistribRandomness().size() == 4, errors);
+
+  test_diagnosis(base + "reproduced from the seed", sameShareValues(shares, testScheme.distribute_seeded(s, seed)), errors);
+  test_diagnosis(base + "reproduced from the expanded randomness", sameShareValues(shares, testScheme.distribute_determ(s, testScheme.getDistribRandomness())), errors);
+
+  vector<char> otherSeed = seed;
+  otherSeed[0] ^= 1;
+  test_diagnosis(base + "another seed gives other shares", !sameShareValues(shares, testScheme.distribute_seeded(s, otherSeed)), errors);
+  test_diagnosis(base + "reconstruction", testScheme.reconstruct(shares) == s, errors);
+
+  SeededPRG prg(seed, pfc.order());
+  Big v3;
+  prg.value(3, v3);
+  test_diagnosis(base + "values are found by position", prg.expand(4)[3] == v3, errors);
+  test_diagnosis(base + "values are reduced", v3 < pfc.order(), errors);
+
+  return errors;
+}
+
 int testSmallDistributeAndReconstruct(PFC &pfc){
   int errors = 0;
 
@@ -916,6 +1059,7 @@ int testDistributeAndReconstruct(PFC &pfc){
     vector<ShareTuple> shares = testScheme.distribute_random(s);
     
     test_diagnosis(base + "number of shares:", shares.size() == policy->getNumShares(), errors);
+    test_diagnosis(base + "temporaries given back to the arena:", BigArena::local().used() == 0, errors);
     
     errors += testReconFromShares(party1, base + "[1]: ", testScheme, shares, true, 1, s);
     errors += testReconFromShares(party234, base + "[234]: ", testScheme, shares, true, 3, s);
@@ -930,140 +1074,210 @@ int testDistributeAndReconstruct(PFC &pfc){
 }
 
 
-int testUpdateSet(){
-  int errors = 0;
-
-  std::map<std::string, vector<ShareTuple> > map;
-  std::string prefix1 = "prefix1"; 
-  std::string prefix2 = "prefix2"; 
-  ShareTuple s1(1,0,"a");
-  ShareTuple s2(2,0,"b");
-  ShareTuple s3(3,0,"c");
-
-  vector<ShareTuple> vec1;
-  vector<ShareTuple> vec2;
-  vec1.push_back(s1);
-  vec2.push_back(s2);
-
-  map[prefix1] = vec1;
-  map[prefix2] = vec2;
-
-  test_diagnosis("testUpdateSet - initial state size", map.size() == 2, errors);
-  test_diagnosis("testUpdateSet - initial state vec1 size", map.find(prefix1)->second.size() == 1, errors);
-  test_diagnosis("testUpdateSet - initial state vec2 size", map.find(prefix2)->second.size() == 1, errors);
-  ShTreeSS::updateSet(map, prefix2, s3);
-  test_diagnosis("testUpdateSet - after state size", map.size() == 2, errors);
-  test_diagnosis("testUpdateSet - initial state vec1 size", map.find(prefix1)->second.size() == 1, errors);
-  test_diagnosis("testUpdateSet - initial state vec2 size", map.find(prefix2)->second.size() == 2, errors);
-
-  std::map<std::string, vector<ShareTuple> >::iterator it;
-  it = map.find(prefix2);
-  
-  test_diagnosis("testUpdateSet - vec2 contents 0", it->second[0] == s2, errors);
-  test_diagnosis("testUpdateSet - vec2 contents 1", it->second[1] == s3, errors);
-    
+// compares the coefficients of the engine with the ones computed one term at a time
+int checkLagrangeEngine(const std::string &name, vector<int> childNos, const LagrangeEngine &engine, const Big &order, int errors) {
+  vector<Big> coeffs;
+  ShTreeAccessPolicy::computeLagrangeCoefficientsChildNos(childNos, engine, coeffs);
+  test_diagnosis("testLagrangeEngine: " + name + " number of coefficients", coeffs.size() == childNos.size(), errors);
+  for (unsigned int i = 0; (i < coeffs.size()) && (i < childNos.size()); i++) {
+    test_diagnosis("testLagrangeEngine: " + name + " coefficient " + convertIntToStr(i),
+		   coeffs[i] == ShTreeAccessPolicy::computeLagrangeCoefficientChildNos(i, childNos, order), errors);
+  }
   return errors;
 }
 
-int testAddNewSet(){
+int testLagrangeEngine(PFC &pfc) {
   int errors = 0;
-
-  std::map<std::string, vector<ShareTuple> > map;
-  std::string prefix1 = "prefix1"; 
-  std::string prefix2 = "prefix2"; 
-  ShareTuple s1(1,0,"a");
-  ShareTuple s2(2,0,"b");
-
-  vector<ShareTuple> vec1;
-  vector<ShareTuple> vec2;
-  vec1.push_back(s1);
-
-  map[prefix1] = vec1;
-
-  test_diagnosis("testAddNewSet - initial state size", map.size() == 1, errors);
-  test_diagnosis("testAddNewSet - initial state vec1 size", map.find(prefix1)->second.size() == 1, errors);
-  ShTreeSS::addNewSet(map, prefix2, s2);
-  test_diagnosis("testAddNewSet - after state size", map.size() == 2, errors);
-  test_diagnosis("testAddNewSet - initial state vec1 size", map.find(prefix1)->second.size() == 1, errors);
-  test_diagnosis("testAddNewSet - initial state vec2 size", map.find(prefix2)->second.size() == 1, errors);
-
-  std::map<std::string, vector<ShareTuple> >::iterator it;
-  it = map.find(prefix2);
-  
-  test_diagnosis("testUpdateSet - vec2 contents 0", it->second[0] == s2, errors);
+  Big order = pfc.order();
+  LagrangeEngine engine(order, 40);
+
+  vector<int> consecutive; // children 3 to 9, out of order
+  for (int i = 9; i >= 3; i--) consecutive.push_back(i);
+  errors = checkLagrangeEngine("consecutive", consecutive, engine, order, errors);
+
+  vector<int> gaps; // children with gaps between them
+  gaps.push_back(3);
+  gaps.push_back(12);
+  gaps.push_back(26);
+  gaps.push_back(7);
+  errors = checkLagrangeEngine("with gaps", gaps, engine, order, errors);
+
+  vector<int> large; // a consecutive run larger than the tables
+  for (int i = 0; i < 50; i++) large.push_back(i);
+  errors = checkLagrangeEngine("beyond the tables", large, engine, order, errors);
+
+  vector<int> single(1, 5);
+  errors = checkLagrangeEngine("single share", single, engine, order, errors);
+
+  vector<Big> values;
+  for (int i = 1; i <= 5; i++) values.push_back(Big(i * 7));
+  vector<Big> inverses = values;
+  LagrangeEngine::batchInvert(inverses, order);
+  for (unsigned int i = 0; i < values.size(); i++) {
+    test_diagnosis("testLagrangeEngine: batch inverse " + convertIntToStr(i), modmult(values[i], inverses[i], order) == 1, errors);
+  }
 
   return errors;
 }
 
-int testPutShareInSet(){
+int testCoefficientCache(PFC &pfc) {
   int errors = 0;
+  std::string base = "testCoefficientCache: ";
+  Big order = pfc.order();
 
-  std::map<std::string, vector<ShareTuple> > map;
-  std::string prefix1 = "prefix1"; 
-  std::string prefix2 = "prefix2"; 
-  ShareTuple s1(1,0,"a");
-  ShareTuple s2(2,0,"b");
-  ShareTuple s3(3,0,"c");
-
-  ShTreeSS::putShareInSet(map, prefix1, s1);
-  ShTreeSS::putShareInSet(map, prefix2, s2);
+  // the root has arity 3 and threshold 2, and the AND gate arity 2 and threshold 2
+  std::string expr = op_THR + "(2, 1, 2, " + op_AND + "(3,4))";
+  shared_ptr<ShTreeAccessPolicy> pol = make_shared<ShTreeAccessPolicy>(expr, 4);
+  test_diagnosis(base + "empty before the scheme", pol->getCoefficientCache()->size() == 0, errors);
+  ShTreeSS scheme(pol, pfc);
+  test_diagnosis(base + "nothing computed by the scheme", pol->getCoefficientCache()->size() == 0, errors);
+
+  // the children of the root are found in the order 2, 1, and those of the AND gate in the order 1, 0
+  vector<ShareID> shareIDs;
+  shareIDs.push_back(ShareID(3,1)); // 0:2:1:=4
+  shareIDs.push_back(ShareID(2,0)); // 0:2:0:=3
+  shareIDs.push_back(ShareID(1,1)); // 0:1:=2
+  vector<Big> cached = pol->findCoefficients(shareIDs, order);
+  test_diagnosis(base + "gates filled on first use", pol->getCoefficientCache()->size() == 4, errors);
+
+  vector<int> rootSet;
+  rootSet.push_back(2);
+  rootSet.push_back(1);
+  vector<int> andSet;
+  andSet.push_back(1);
+  andSet.push_back(0);
+  Big rootOfAnd = ShTreeAccessPolicy::computeLagrangeCoefficientChildNos(0, rootSet, order);
+  bool same = (cached.size() == 3) && (cached[2] == ShTreeAccessPolicy::computeLagrangeCoefficientChildNos(1, rootSet, order))
+    && (cached[0] == modmult(rootOfAnd, ShTreeAccessPolicy::computeLagrangeCoefficientChildNos(0, andSet, order), order))
+    && (cached[1] == modmult(rootOfAnd, ShTreeAccessPolicy::computeLagrangeCoefficientChildNos(1, andSet, order), order));
+  test_diagnosis(base + "same coefficients as without the cache", same, errors);
+  test_diagnosis(base + "cached again", pol->findCoefficients(shareIDs, order) == cached, errors);
+
+  // a copy shares the cache, whose gates are already filled for this order
+  ShTreeAccessPolicy copy(*pol);
+  copy.precomputeCoefficients(order);
+  shared_ptr<CoefficientCache> cache = pol->getCoefficientCache();
+  test_diagnosis(base + "filled once", (copy.getCoefficientCache() == cache) && (cache->size() == 4) && !cache->claimFill(order, 3, 2)
+		 && !cache->claimFill(order, 2, 2), errors);
+
+  // a set larger than the threshold was not precomputed, and is added
+  shareIDs.push_back(ShareID(0,0)); // 0:0:=1
+  pol->findCoefficients(shareIDs, order);
+  test_diagnosis(base + "new set added", pol->getCoefficientCache()->size() == 5, errors);
+
+  // another order does not use the cache
+  vector<Big> other = pol->findCoefficients(shareIDs, Big(101));
+  vector<int> rootChildNos;
+  rootChildNos.push_back(2);
+  rootChildNos.push_back(1);
+  rootChildNos.push_back(0);
+  test_diagnosis(base + "other order", other[3] == ShTreeAccessPolicy::computeLagrangeCoefficientChildNos(2, rootChildNos, Big(101)), errors);
+  test_diagnosis(base + "other order not kept", pol->getCoefficientCache()->size() == 5, errors);
+
+  // an arity above PRECOMPUTED_ARITY is never filled, whatever maxArity is asked for
+  std::string wide = op_AND + "(" + op_THR + "(2";
+  for (int i = 1; i <= 40; i++) {
+    wide += ", " + convertIntToStr(i);
+  }
+  wide += "), 41)";
+  ShTreeAccessPolicy widePolicy(wide, 41);
+  widePolicy.precomputeCoefficients(order, 64);
+  test_diagnosis(base + "wide gate not filled", (widePolicy.getCoefficientCache()->size() == 1) && widePolicy.getCoefficientCache()->claimFill(order, 40, 2),
+		 errors);
 
-  test_diagnosis("testPutShareInSet - initial state size", map.size() == 2, errors);
-  test_diagnosis("testPutShareInSet - initial state vec1 size", map.find(prefix1)->second.size() == 1, errors);
-  test_diagnosis("testPutShareInSet - initial state vec2 size", map.find(prefix2)->second.size() == 1, errors);
-  ShTreeSS::putShareInSet(map, prefix2, s3);  
-  test_diagnosis("testPutShareInSet - after state size", map.size() == 2, errors);
-  test_diagnosis("testPutShareInSet - initial state vec1 size", map.find(prefix1)->second.size() == 1, errors);
-  test_diagnosis("testPutShareInSet - initial state vec2 size", map.find(prefix2)->second.size() == 2, errors);
+  return errors;
+}
 
-  std::map<std::string, vector<ShareTuple> >::iterator it;
-  it = map.find(prefix1);
-  test_diagnosis("testPutShareInSet - vec1 contents 0", it->second[0] == s1, errors);
+// reconstruction combines the values of the witness set from the leaves up, so it must not depend on the order of the shares, and a set that does not
+// satisfy the policy gives -1
+int testReconstructBottomUp(PFC &pfc) {
+  int errors = 0;
+  std::string base = "testReconstructBottomUp: ";
+
+  std::string expr = op_THR + "(2, " + op_AND + "(1,2), " + op_OR + "(3, " + op_THR + "(2, 4,5,6)), 7)";
+  shared_ptr<ShTreeAccessPolicy> pol = make_shared<ShTreeAccessPolicy>(expr, 7);
+  ShTreeSS scheme(pol, pfc);
+  Big s = rand();
+  vector<ShareTuple> shares = scheme.distribute_random(s);
+
+  bool reconstructed = true;
+  for (unsigned int set = 0; set < (1U << 7); set++) {
+    vector<int> party;
+    for (int a = 0; a < 7; a++) {
+      if ((set >> a) & 1) party.push_back(a + 1);
+    }
+    vector<ShareTuple> partyShares = SecretSharing::getSharesForParticipants(party, shares);
+    vector<ShareTuple> reversed(partyShares.rbegin(), partyShares.rend());
+    vector<ShareTuple> witnessShares;
+    Big expected = pol->evaluate(partyShares, witnessShares) ? s : Big(-1);
+    if ((scheme.reconstruct(partyShares) != expected) || (scheme.reconstruct(reversed) != expected)) {
+      reconstructed = false;
+    }
+  }
+  test_diagnosis(base + expr, reconstructed, errors);
 
-  it = map.find(prefix2);
-  test_diagnosis("testPutShareInSet - vec2 contents 0", it->second[0] == s2, errors);
-  test_diagnosis("testPutShareInSet - vec2 contents 1", it->second[1] == s3, errors);
+  // a gate above the precomputed arity: its set of children is computed once and then kept
+  expr = op_AND + "(" + op_THR + "(18, ";
+  for (int i = 1; i <= 20; i++) {
+    expr += convertIntToStr(i) + ",";
+  }
+  expr += "21), 22)";
+  pol = make_shared<ShTreeAccessPolicy>(expr, 22);
+  ShTreeSS largeScheme(pol, pfc);
+  shares = largeScheme.distribute_random(s);
+  unsigned int cached = pol->getCoefficientCache()->size();
+  vector<int> party;
+  for (int i = 3; i <= 22; i++) party.push_back(i);
+  vector<ShareTuple> partyShares = SecretSharing::getSharesForParticipants(party, shares);
+  test_diagnosis(base + "large gate", largeScheme.reconstruct(partyShares) == s, errors);
+  test_diagnosis(base + "large gate kept", pol->getCoefficientCache()->size() == cached + 2, errors); // and the AND gate, filled on first use
+  test_diagnosis(base + "large gate cached", largeScheme.reconstruct(partyShares) == s, errors);
 
   return errors;
 }
 
-int testGetSetPrefix(){
+// the value of the polynomial at x, one power at a time
+Big naivePolynomial(const Big &secret, const vector<Big> &coeffs, int x, const Big &order) {
+  Big value = secret;
+  Big power = 1;
+  for (unsigned int k = 0; k < coeffs.size(); k++) {
+    power = modmult(power, x, order);
+    value = (value + modmult(coeffs[k], power, order)) % order;
+  }
+  return value;
+}
+
+int testSharePolynomial(PFC &pfc) {
   int errors = 0;
+  std::string base = "testSharePolynomial: ";
+  Big order = pfc.order();
 
-  std::string s1 = "0";
-  std::string s2 = "0:=7";
-  std::string s3 = "0:1:3";
-  std::string s4 = "0:1:3:=19";
-  std::string s5 = "0:1:3:9:7";
-  std::string s6 = "0:1:3:9:7:=21";
-
-
-  std::string vs1 = "";
-  std::string vs2 = "";
-  std::string vs3 = "0:1";
-  std::string vs4 = "0:1";
-  std::string vs5 = "0:1:3:9";
-  std::string vs6 = "0:1:3:9";
-
-
-  vector<std::string> testCases;
-  testCases.push_back(s1);
-  testCases.push_back(s2);
-  testCases.push_back(s3);
-  testCases.push_back(s4);
-  testCases.push_back(s5);
-  testCases.push_back(s6);
-
-  vector<std::string> verifCases;
-  verifCases.push_back(vs1);
-  verifCases.push_back(vs2);
-  verifCases.push_back(vs3);
-  verifCases.push_back(vs4);
-  verifCases.push_back(vs5);
-  verifCases.push_back(vs6);
-
-  for (unsigned int i = 0; i < testCases.size(); i++) {
-    test_diagnosis("testGetSetPrefix - " + convertIntToStr(i), ShTreeSS::getSetPrefix(testCases[i]) == verifCases[i], errors);
+  Big secret;
+  pfc.random(secret);
+  vector<Big> coeffs(6);
+  for (unsigned int k = 0; k < coeffs.size(); k++) {
+    pfc.random(coeffs[k]);
+  }
+
+  Big value;
+  SharePolynomial::evaluate(secret, coeffs.data(), 6, 9, order, value);
+  test_diagnosis(base + "Horner", value == naivePolynomial(secret, coeffs, 9, order), errors);
+  SharePolynomial::evaluate(secret, coeffs.data(), 0, 9, order, value);
+  test_diagnosis(base + "degree 0", value == secret, errors);
+
+  // 5 points take Horner's rule, and 40 points take the finite differences
+  unsigned int sizes[] = {5, 40};
+  for (unsigned int s = 0; s < 2; s++) {
+    unsigned int n = sizes[s];
+    vector<Big> storage(n);
+    vector<Big*> values;
+    for (unsigned int j = 0; j < n; j++) values.push_back(&storage[j]);
+    SharePolynomial::evaluateConsecutive(secret, coeffs.data(), 6, n, order, values);
+    bool same = true;
+    for (unsigned int j = 0; j < n; j++) {
+      same = same && (storage[j] == naivePolynomial(secret, coeffs, j + 1, order));
+    }
+    test_diagnosis(base + "consecutive points, n = " + convertIntToStr(n), same, errors);
   }
 
   return errors;
@@ -1082,10 +1296,10 @@ int testLagrangeCoefficient(PFC &pfc) {
   int x2 = 27;
   int x3 = 8;
 
-  ShareTuple s1(1,0,"0:" + convertIntToStr(x0-1) + ":=x");
-  ShareTuple s2(2,0,"0:" + convertIntToStr(x1-1) + ":=y");
-  ShareTuple s3(3,0,"0:" + convertIntToStr(x2-1) + ":=z");
-  ShareTuple s4(4,0,"0:" + convertIntToStr(x3-1) + ":=w");
+  ShareTuple s1(1,0,ShareID(0, x0-1));
+  ShareTuple s2(2,0,ShareID(1, x1-1));
+  ShareTuple s3(3,0,ShareID(2, x2-1));
+  ShareTuple s4(4,0,ShareID(3, x3-1));
 
   shares.push_back(s1);
   shares.push_back(s2);
@@ -1126,149 +1340,183 @@ int testLagrangeCoefficient(PFC &pfc) {
 int testExtractPublicInfoFromID() {
   int errors = 0;
 
-  std::string s1 = "0:1:4";
-  std::string s2 = "0:1:4:=8";
-  std::string s3 = "0:=9";
+  ShareID s1(3, 4);
+  ShareID s2(8, 4);
+  ShareID s3(0, ShareID::ROOT_SHARE);
 
-  test_diagnosis("testExtractPublicInfoFromID - " + s1, 
+  test_diagnosis("testExtractPublicInfoFromID - " + s1.to_string(), 
 		 ShTreeAccessPolicy::extractPublicInfoFromChildNo(ShTreeAccessPolicy::extractChildNoFromID(s1)) == 5 , errors);
-  test_diagnosis("testExtractPublicInfoFromID - " + s2, 
-		 ShTreeAccessPolicy::extractPublicInfoFromChildNo(ShTreeAccessPolicy::extractChildNoFromID(s2)) == 5 , errors);
+  test_diagnosis("testExtractPublicInfoFromID - " + s2.to_string(), 
+		 ShTreeAccessPolicy::extractPublicInfoFromID(s2) == 5 , errors);
 
   try {
     ShTreeAccessPolicy::extractPublicInfoFromChildNo(ShTreeAccessPolicy::extractChildNoFromID(s3));
-    test_diagnosis("testExtractPublicInfoFromID - exception " + s3, false, errors);
+    test_diagnosis("testExtractPublicInfoFromID - exception " + s3.to_string(), false, errors);
   } catch (std::runtime_error &e) {
-    test_diagnosis("testExtractPublicInfoFromID - exception " + s3, true, errors);
+    test_diagnosis("testExtractPublicInfoFromID - exception " + s3.to_string(), true, errors);
   }
 
 
   return errors;
 }
 
-int testextractPrefixAndNoFromID() {
+// policies with the same structure have the same hash, whatever their descriptions
+int testStructuralHash() {
   int errors = 0;
+  std::string base = "testStructuralHash - ";
+
+  ShTreeAccessPolicy compact(op_THR + "(2,1," + op_AND + "(2,3),4)", 4);
+  ShTreeAccessPolicy spaced(" " + op_THR + " ( 2 , 1, " + op_AND + "(2, 3) , 4 ) ", 4);
+  test_diagnosis(base + "white space", (compact.getStructuralHash() == spaced.getStructuralHash()) && (compact == spaced), errors);
+
+  // AND and OR are compiled as thresholds
+  ShTreeAccessPolicy withOr(op_OR + "(1,2)", 4);
+  ShTreeAccessPolicy withThr(op_THR + "(1,1,2)", 4);
+  test_diagnosis(base + "OR as THR", (withOr.getStructuralHash() == withThr.getStructuralHash()) && (withOr == withThr), errors);
+
+  ShTreeAccessPolicy otherLeaf(op_THR + "(2,1," + op_AND + "(2,3),5)", 5);
+  ShTreeAccessPolicy otherParts(op_THR + "(2,1," + op_AND + "(2,3),4)", 5);
+  ShTreeAccessPolicy otherThreshold(op_THR + "(1,1," + op_AND + "(2,3),4)", 4);
+  test_diagnosis(base + "other leaf", (compact.getStructuralHash() != otherLeaf.getStructuralHash()) && !(compact == otherLeaf), errors);
+  test_diagnosis(base + "other participants", (compact.getStructuralHash() != otherParts.getStructuralHash()) && !(compact == otherParts), errors);
+  test_diagnosis(base + "other threshold", compact.getStructuralHash() != otherThreshold.getStructuralHash(), errors);
+
+  ShTreeAccessPolicy copy(compact);
+  ShTreeAccessPolicy assigned;
+  assigned = compact;
+  test_diagnosis(base + "copies", (copy == compact) && (assigned.getStructuralHash() == compact.getStructuralHash()), errors);
+
+  vector<char> bytes;
+  BinaryWriter out(bytes);
+  compact.writeBinary(out);
+  BinaryReader in(bytes);
+  shared_ptr<ShTreeAccessPolicy> read = ShTreeAccessPolicy::readBinary(in);
+  test_diagnosis(base + "read back", (read->getStructuralHash() == compact.getStructuralHash()) && (*read == compact), errors);
 
-  std::string s1 = "0:1:7:4:=3";
-  std::string s2 = "1:7:4:=3";
-  std::string s3 = "7:4:=3";
-  std::string s4 = "4:=3";
-  std::string s5 = "4:=3:";
-
-  std::string prefix;
-  int childNo;
-
-  bool success = ShTreeAccessPolicy::extractPrefixAndNoFromID(s1, prefix, childNo);
-  test_diagnosis("testextractPrefixAndNoFromID: " + s1 + " [success]", success, errors);
-  test_diagnosis("testextractPrefixAndNoFromID: " + s1 + " [s1]", s1 == "1:7:4:=3", errors);
-  test_diagnosis("testextractPrefixAndNoFromID: " + s1 + " [prefix]", prefix == "0:", errors);
-  test_diagnosis("testextractPrefixAndNoFromID: " + s1 + " [childNo]", childNo == 1, errors);
-
-  success = ShTreeAccessPolicy::extractPrefixAndNoFromID(s2, prefix, childNo);
-  test_diagnosis("testextractPrefixAndNoFromID: " + s2 + " [success]", success, errors);
-  test_diagnosis("testextractPrefixAndNoFromID: " + s2 + " [s2]", s2 == "7:4:=3", errors);
-  test_diagnosis("testextractPrefixAndNoFromID: " + s2 + " [prefix]", prefix == "1:", errors);
-  test_diagnosis("testextractPrefixAndNoFromID: " + s2 + " [childNo]", childNo == 7, errors);
-
-  success = ShTreeAccessPolicy::extractPrefixAndNoFromID(s3, prefix, childNo);
-  test_diagnosis("testextractPrefixAndNoFromID: " + s3 + " [success]", success, errors);
-  test_diagnosis("testextractPrefixAndNoFromID: " + s3 + " [s3]", s3 == "4:=3", errors);
-  test_diagnosis("testextractPrefixAndNoFromID: " + s3 + " [prefix]", prefix == "7:", errors);
-  test_diagnosis("testextractPrefixAndNoFromID: " + s3 + " [childNo]", childNo == 4, errors);
-
-  success = ShTreeAccessPolicy::extractPrefixAndNoFromID(s4, prefix, childNo);
-  test_diagnosis("testextractPrefixAndNoFromID: " + s4 + " [success]", !success, errors);
-  test_diagnosis("testextractPrefixAndNoFromID: " + s4 + " [s4]", s4 == "4:=3", errors);
-  test_diagnosis("testextractPrefixAndNoFromID: " + s4 + " [prefix]", prefix == "7:", errors);
-  test_diagnosis("testextractPrefixAndNoFromID: " + s4 + " [childNo]", childNo == 4, errors);
-
-  success = ShTreeAccessPolicy::extractPrefixAndNoFromID(s5, prefix, childNo);
-  test_diagnosis("testextractPrefixAndNoFromID: " + s5 + " [success]", !success, errors);
-  test_diagnosis("testextractPrefixAndNoFromID: " + s5 + " [s5]", s5 == "4:=3:", errors);
-  test_diagnosis("testextractPrefixAndNoFromID: " + s5 + " [prefix]", prefix == "7:", errors);
-  test_diagnosis("testextractPrefixAndNoFromID: " + s5 + " [childNo]", childNo == 4, errors);
+  return errors;
+}
 
+// the optimized policy has fewer shares, and is satisfied by the same sets of attributes
+int testOptimizeDescription() {
+  int errors = 0;
+  std::string base = "testOptimizeDescription - ";
+
+  std::string expr = op_AND + "(" + op_AND + "(1,2), " + op_THR + "(1, 3, 3, " + op_OR + "(4,5)), " + op_THR + "(2, ,6,7))";
+  std::string optimized = ShTreeAccessPolicy::optimizeDescription(expr);
+  test_diagnosis(base + "description", optimized == op_AND + "(1, 2, " + op_OR + "(3, 4, 5), 6, 7)", errors);
+
+  ShTreeAccessPolicy original(expr, 8);
+  ShTreeAccessPolicy smaller(optimized, 8);
+  test_diagnosis(base + "fewer shares", smaller.getNumShares() < original.getNumShares(), errors);
+  for (unsigned int atts = 0; atts < 256; atts++) {
+    vector<int> attributes;
+    for (int a = 0; a < 8; a++) {
+      if ((atts >> a) & 1) attributes.push_back(a);
+    }
+    vector<int> attFragIndices, keyFragIndices, witness;
+    vector<ShareID> originalIDs, smallerIDs;
+    original.obtainCoveredFrags(attributes, attFragIndices, keyFragIndices, originalIDs);
+    attFragIndices.clear();
+    keyFragIndices.clear();
+    smaller.obtainCoveredFrags(attributes, attFragIndices, keyFragIndices, smallerIDs);
+    if (original.evaluateIDs(originalIDs, witness) != smaller.evaluateIDs(smallerIDs, witness)) {
+      test_diagnosis(base + "attributes " + convertIntToStr(atts), false, errors);
+    }
+  }
   return errors;
 }
 
-int testStoreSharePrefixes() {
+int testCompiledTree() {
   int errors = 0;
+  std::string base = "testCompiledTree: ";
+
+  // post-order: 1, 2, 3, AND, 4, 5, OR, THR
+  std::string expr = op_THR + "(2, 1, " + op_AND + "(2,3), " + op_OR + "(4,5))";
+  ShTreeAccessPolicy pol(expr, 5);
+  const CompiledTree &tree = pol.getCompiledTree();
+
+  test_diagnosis(base + "number of nodes", tree.size() == 8, errors);
+  test_diagnosis(base + "number of leaves", tree.getNumLeaves() == 5, errors);
+  test_diagnosis(base + "number of gates", tree.getNumGates() == 3, errors);
+  test_diagnosis(base + "randomness", tree.getNumRandomness() == 2, errors);
+  if (tree.size() != 8) return errors;
+
+  const CompiledTree::Node &root = tree.getNode(tree.root());
+  test_diagnosis(base + "root", (root.kind == CompiledTree::gateNode) && (root.threshold == 2) && (root.numChildren == 3) && (root.gateNo == 0)
+		 && (root.parent == -1) && (root.childNo == ShareID::ROOT_SHARE), errors);
+  test_diagnosis(base + "children of root", (tree.getChild(root, 0) == 0) && (tree.getChild(root, 1) == 3) && (tree.getChild(root, 2) == 6), errors);
+  const CompiledTree::Node &andGate = tree.getNode(3);
+  test_diagnosis(base + "AND gate", (andGate.threshold == 2) && (andGate.gateNo == 1) && (andGate.randomnessBase == 1) && (andGate.childNo == 1), errors);
+  const CompiledTree::Node &orGate = tree.getNode(6);
+  test_diagnosis(base + "OR gate", (orGate.threshold == 1) && (orGate.gateNo == 2) && (orGate.randomnessBase == 2) && (orGate.parent == 7), errors);
+  const CompiledTree::Node &leaf = tree.getNode(tree.getLeafNode(3));
+  test_diagnosis(base + "leaf 3", (leaf.kind == CompiledTree::leafNode) && (leaf.leafValue == 4) && (leaf.leafNo == 3) && (leaf.parent == 6) && (leaf.childNo == 0), errors);
+
+  vector<int> witness;
+  int positions1[] = {-1, 0, 1, -1, 2};
+  int verif1[] = {0, 1, 2};
+  test_diagnosis(base + "AND and OR satisfy the root", tree.satisfy(vector<int>(positions1, positions1 + 5), witness) && (witness == vector<int>(verif1, verif1 + 3)), errors);
+  int positions2[] = {0, 1, 2, 3, 4};
+  test_diagnosis(base + "only the first satisfied children are used", tree.satisfy(vector<int>(positions2, positions2 + 5), witness) && (witness == vector<int>(verif1, verif1 + 3)), errors);
+  int positions3[] = {0, 1, -1, -1, -1};
+  test_diagnosis(base + "not satisfied", !tree.satisfy(vector<int>(positions3, positions3 + 5), witness) && witness.empty(), errors);
+
+  CompiledTree empty;
+  test_diagnosis(base + "empty tree", (empty.size() == 0) && !empty.satisfy(vector<int>(), witness), errors);
 
-  std::string s1 = "0:1:0:=2";
-  std::string s2 = "0:1:1:=3";
-  std::string s3 = "0:1:2:=4";
-  std::string s5 = "0:2:2:1:=4";
-  std::string s4 = "0:2:1:=2";
+  return errors;
+}
+
+int testCollectGateChildNos() {
+  int errors = 0;
 
+  // gates, in pre-order: "0", "0:1", "0:2", "0:2:2"
+  std::string expr = op_OR + "(1, " + op_AND + "(2,3,4), " + op_THR + "(2, 1, 2, " + op_OR + "(3,4)))";
+  ShTreeAccessPolicy pol(expr, 4);
+  std::string base = "testCollectGateChildNos: ";
 
-  std::map<std::string, vector<int> > setChildNos;
+  vector<ShareID> shareIDs;
+  shareIDs.push_back(ShareID(1,0)); // 0:1:0:=2
+  shareIDs.push_back(ShareID(2,1)); // 0:1:1:=3
+  shareIDs.push_back(ShareID(3,2)); // 0:1:2:=4
+  shareIDs.push_back(ShareID(5,1)); // 0:2:1:=2
+  shareIDs.push_back(ShareID(7,1)); // 0:2:2:1:=4
 
-  ShTreeAccessPolicy::storeSharePrefixes(setChildNos, s1);
+  vector<vector<int> > gateChildNos;
+  pol.collectGateChildNos(shareIDs, gateChildNos);
 
-  //  REPORT("s1");
-  vector<int> vec = setChildNos["0:"];
   vector<int> verif0;
   verif0.push_back(1);
-  debugVector("vec [0:]", vec);
-  debugVector("verif0", verif0);
-  test_diagnosis("testStoreSharePrefixes: " + s1 + "[0:]", verif0 == vec, errors);
-
-  vec = setChildNos["0:1:"];
+  verif0.push_back(2);
   vector<int> verif01;
-  verif01.clear();
   verif01.push_back(0);
-  debugVector("vec [0:1:]", vec);
-  debugVector("verif01", verif01);
-  test_diagnosis("testStoreSharePrefixes: " + s1 + "[0:1:]", verif01 == vec, errors);
-
-  //  REPORT("s2");
-  ShTreeAccessPolicy::storeSharePrefixes(setChildNos, s2);
-  vec = setChildNos["0:"];
-  debugVector("vec [0:]", vec);
-  debugVector("verif0", verif0);
-  test_diagnosis("testStoreSharePrefixes: " + s2 + "[0:]", verif0 == vec, errors);
-
-  vec = setChildNos["0:1:"];
   verif01.push_back(1);
-  debugVector("vec  [0:1:]", vec);
-  debugVector("verif01", verif01);
-  test_diagnosis("testStoreSharePrefixes: " + s2 + "[0:1:]", verif01 == vec, errors);
-
-  //   REPORT("s3");
-  ShTreeAccessPolicy::storeSharePrefixes(setChildNos, s3);
-  vec = setChildNos["0:"];
-  test_diagnosis("testStoreSharePrefixes: " + s3 + "[0:]", verif0 == vec, errors);
-  vec = setChildNos["0:1:"];
   verif01.push_back(2);
-  test_diagnosis("testStoreSharePrefixes: " + s3 + "[0:1:]", verif01 == vec, errors);
-
-  //   REPORT("s4");
-   ShTreeAccessPolicy::storeSharePrefixes(setChildNos, s4);
-   vec = setChildNos["0:"];
-   verif0.push_back(2);
-   test_diagnosis("testStoreSharePrefixes: " + s4 + "[0:]", verif0 == vec, errors);
-   vec = setChildNos["0:1:"];
-   test_diagnosis("testStoreSharePrefixes: " + s4 + "[0:1:]", verif01 == vec, errors);
-   debugVector("vec [0:1:]", vec);
-   debugVector("verif01", verif01);
-   vector<int> verif02;
-   vec = setChildNos["0:2:"];
-   verif02.push_back(1);
-   test_diagnosis("testStoreSharePrefixes: " + s4 + "[0:2:]", verif02 == vec, errors);
-
-   //   REPORT("s5");
-  ShTreeAccessPolicy::storeSharePrefixes(setChildNos, s5);
-  vec = setChildNos["0:"];
-  test_diagnosis("testStoreSharePrefixes: " + s5 + "[0:]", verif0 == vec, errors);
-  vec = setChildNos["0:1:"];
-  test_diagnosis("testStoreSharePrefixes: " + s5 + "[0:1:]", verif01 == vec, errors);
-  vec = setChildNos["0:2:"];
+  vector<int> verif02;
+  verif02.push_back(1);
   verif02.push_back(2);
-  test_diagnosis("testStoreSharePrefixes: " + s4 + "[0:2:]", verif02 == vec, errors);
   vector<int> verif022;
-  vec = setChildNos["0:2:2:"];
   verif022.push_back(1);
-  test_diagnosis("testStoreSharePrefixes: " + s5 + "[0:2:2:]", verif022 == vec, errors);
+
+  test_diagnosis(base + "number of gates", gateChildNos.size() == 4, errors);
+  if (gateChildNos.size() == 4) {
+    debugVector("gate [0]", gateChildNos[0]);
+    test_diagnosis(base + "[0]", gateChildNos[0] == verif0, errors);
+    test_diagnosis(base + "[0:1]", gateChildNos[1] == verif01, errors);
+    test_diagnosis(base + "[0:2]", gateChildNos[2] == verif02, errors);
+    test_diagnosis(base + "[0:2:2]", gateChildNos[3] == verif022, errors);
+  }
+
+  // the coefficients of a share are the product of the Lagrange coefficients along its path
+  Big order = 101;
+  vector<Big> coeffs = pol.findCoefficients(shareIDs, order);
+  Big c0_2 = ShTreeAccessPolicy::computeLagrangeCoefficientChildNos(1, verif0, order);
+  Big c02_2 = ShTreeAccessPolicy::computeLagrangeCoefficientChildNos(1, verif02, order);
+  Big c022_1 = ShTreeAccessPolicy::computeLagrangeCoefficientChildNos(0, verif022, order);
+  test_diagnosis(base + "number of coefficients", coeffs.size() == shareIDs.size(), errors);
+  if (coeffs.size() == shareIDs.size()) {
+    test_diagnosis(base + "coefficient of 0:2:2:1:=4", coeffs[4] == modmult(modmult(c0_2, c02_2, order), c022_1, order), errors);
+  }
 
   return errors;
 }
@@ -1279,26 +1527,31 @@ int runTests(PFC &pfc) {
   // Policy tests
   ENHOUT("Secret sharing policy tests");
   errors += testParseTreeFromExpression();
+  errors += testParseErrorPositions();
   errors += testSatisfyNode();
   errors += testEvaluate();
   errors += testGetNumShares();
   errors += testObtainCoveredFrags(); 
+  errors += testCoveredSet();
   
   ENHOUT("Secret sharing static utils tests");
-  errors += testextractPrefixAndNoFromID();
-  errors += testStoreSharePrefixes();
-  errors += testUpdateSet();
-  errors += testAddNewSet();
-  errors += testPutShareInSet();
-  errors += testGetSetPrefix();
+  errors += testCompiledTree();
+  errors += testStructuralHash();
+  errors += testOptimizeDescription();
+  errors += testCollectGateChildNos();
   errors += testGetSharesForParticipants();
   errors += testExtractPublicInfoFromID();
   
   // Secret Sharing tests
   ENHOUT("Secret sharing scheme tests");
   errors += testLagrangeCoefficient(pfc);
+  errors += testLagrangeEngine(pfc);
+  errors += testCoefficientCache(pfc);
+  errors += testSharePolynomial(pfc);
   errors += testSmallDistributeAndReconstruct(pfc);
+  errors += testSeededDistribution(pfc);
   errors += testDistributeAndReconstruct(pfc);
+  errors += testReconstructBottomUp(pfc);
 
   return errors;
 }
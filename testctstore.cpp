@@ -0,0 +1,195 @@
+/*
+  Testbed for empirical evaluation of KP-ABE schemes, according to Crampton, Pinto (CSF2014).
+  Code by: Alexandre Miranda Pinto
+
+  This file holds tests for the compressed bitmap (bitmap.cpp) and for the ciphertext store (ctstore.cpp).
+  The store is tested by comparing the candidates obtained from the index with the ones obtained by trial evaluation of every ciphertext.
+*/
+
+#ifndef DEF_UTILS
+#include "utils.h"
+#endif
+
+#ifndef DEF_CT_STORE
+#include "ctstore.h"
+#endif
+
+#include <algorithm>
+
+// builds a random set of identifiers. The spread allows the set to cover several chunks of the bitmap
+vector<unsigned int> randomIDs(unsigned int count, unsigned int spread) {
+  vector<unsigned int> ids;
+  for (unsigned int i = 0; i < count; i++) {
+    ids.push_back(rand() % spread);
+  }
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  return ids;
+}
+
+Bitmap makeBitmap(const vector<unsigned int> &ids) {
+  Bitmap b;
+  for (unsigned int i = 0; i < ids.size(); i++) {
+    b.add(ids[i]);
+  }
+  return b;
+}
+
+int testBitmapBasics() {
+  int errors = 0;
+  std::string base = "testBitmapBasics: ";
+
+  Bitmap b;
+  test_diagnosis(base + "empty", b.isEmpty() && (b.cardinality() == 0), errors);
+
+  b.add(5);
+  b.add(3);
+  b.add(70000);
+  b.add(5);
+  test_diagnosis(base + "cardinality with repeated element", b.cardinality() == 3, errors);
+  test_diagnosis(base + "contains 3", b.contains(3), errors);
+  test_diagnosis(base + "contains 70000", b.contains(70000), errors);
+  test_diagnosis(base + "does not contain 4", !b.contains(4), errors);
+
+  vector<unsigned int> verif;
+  verif.push_back(3);
+  verif.push_back(5);
+  verif.push_back(70000);
+  test_diagnosis(base + "toVector is sorted", b.toVector() == verif, errors);
+
+  // a chunk with many elements is converted to a dense container
+  Bitmap dense;
+  vector<unsigned int> denseIDs;
+  for (unsigned int i = 0; i < 3 * Bitmap::MAX_SPARSE; i += 2) {
+    dense.add(i);
+    denseIDs.push_back(i);
+  }
+  test_diagnosis(base + "dense cardinality", dense.cardinality() == denseIDs.size(), errors);
+  test_diagnosis(base + "dense contents", dense.toVector() == denseIDs, errors);
+  test_diagnosis(base + "dense does not contain odd", !dense.contains(7), errors);
+
+  return errors;
+}
+
+int testBitmapOperations() {
+  int errors = 0;
+  std::string base = "testBitmapOperations: ";
+
+  for (int run = 0; run < 20; run++) {
+    unsigned int nOperands = 1 + rand() % 6;
+    // alternate between sparse chunks and chunks that become dense
+    unsigned int count = (run % 2 == 0) ? 200 : 20000;
+    vector<vector<unsigned int> > sets;
+    vector<Bitmap> bitmaps;
+    for (unsigned int i = 0; i < nOperands; i++) {
+      sets.push_back(randomIDs(count, 200000));
+      bitmaps.push_back(makeBitmap(sets[i]));
+    }
+    vector<const Bitmap*> operands;
+    for (unsigned int i = 0; i < nOperands; i++) {
+      operands.push_back(&bitmaps[i]);
+    }
+
+    std::map<unsigned int, unsigned int> counts;
+    for (unsigned int i = 0; i < nOperands; i++) {
+      for (unsigned int j = 0; j < sets[i].size(); j++) {
+	counts[sets[i][j]]++;
+      }
+    }
+
+    for (unsigned int k = 1; k <= nOperands; k++) {
+      vector<unsigned int> verif;
+      for (std::map<unsigned int, unsigned int>::iterator it = counts.begin(); it != counts.end(); ++it) {
+	if (it->second >= k) verif.push_back(it->first);
+      }
+      Bitmap result = Bitmap::Threshold(k, operands);
+      test_diagnosis(base + "run " + convertIntToStr(run) + " threshold " + convertIntToStr(k) + "/" + convertIntToStr(nOperands),
+		     result.toVector() == verif, errors);
+    }
+
+    test_diagnosis(base + "run " + convertIntToStr(run) + " OR", Bitmap::Or(operands) == Bitmap::Threshold(1, operands), errors);
+    test_diagnosis(base + "run " + convertIntToStr(run) + " AND", Bitmap::And(operands) == Bitmap::Threshold(nOperands, operands), errors);
+    test_diagnosis(base + "run " + convertIntToStr(run) + " threshold above number of operands",
+		   Bitmap::Threshold(nOperands + 1, operands).isEmpty(), errors);
+  }
+
+  return errors;
+}
+
+int testCompile() {
+  int errors = 0;
+  std::string base = "testCompile: ";
+
+  std::string expr = op_OR + "(1, " + op_AND + "(2,3))";
+  shared_ptr<BLAccessPolicy> blPolicy = make_shared<BLAccessPolicy>(expr, 3);
+  IndexQuery blQuery;
+  test_diagnosis(base + "BL compiles", CiphertextStore::compile(blPolicy, blQuery), errors);
+  test_diagnosis(base + "BL query", blQuery.to_string() == "LOAD(1) THR(1/1) LOAD(2) LOAD(3) THR(2/2) THR(1/2)", errors);
+
+  expr = op_THR + "(2, 1, " + op_AND + "(2,3), 4)";
+  shared_ptr<ShTreeAccessPolicy> treePolicy = make_shared<ShTreeAccessPolicy>(expr, 4);
+  IndexQuery treeQuery;
+  test_diagnosis(base + "ShTree compiles", CiphertextStore::compile(treePolicy, treeQuery), errors);
+  test_diagnosis(base + "ShTree query", treeQuery.to_string() == "LOAD(1) LOAD(2) LOAD(3) THR(2/2) LOAD(4) THR(2/3)", errors);
+
+  return errors;
+}
+
+int testFindCandidates() {
+  int errors = 0;
+  std::string base = "testFindCandidates: ";
+
+  const int nAttr = 12;
+  CiphertextStore store;
+  for (int i = 0; i < 3000; i++) {
+    vector<int> atts;
+    int nAtts = 1 + rand() % 6;
+    for (int j = 0; j < nAtts; j++) {
+      atts.push_back(rand() % nAttr);
+    }
+    store.add(atts);
+  }
+  test_diagnosis(base + "store size", store.size() == 3000, errors);
+
+  vector<shared_ptr<AccessPolicy> > policies;
+  policies.push_back(make_shared<BLAccessPolicy>(op_OR + "(1, " + op_AND + "(2,3,4), " + op_AND + "(2,5), " + op_AND + "(4,5))", nAttr));
+  policies.push_back(make_shared<BLAccessPolicy>(op_OR + "(" + op_AND + "(7,8), " + op_AND + "(9,10,11))", nAttr));
+  policies.push_back(make_shared<ShTreeAccessPolicy>(op_THR + "(2, 1, " + op_AND + "(2,3,4), " + op_THR + "(2,2,5, " + op_OR + "(1,4,5)))", nAttr));
+  policies.push_back(make_shared<ShTreeAccessPolicy>(op_THR + "(3, 0,1,2,3,4,5)", nAttr));
+  policies.push_back(make_shared<ShTreeAccessPolicy>("6", nAttr));
+
+  for (unsigned int i = 0; i < policies.size(); i++) {
+    Bitmap indexed = store.findCandidates(policies[i]);
+    Bitmap scanned = store.findCandidatesByScan(policies[i]);
+    DEBUG("candidates: " << indexed.cardinality() << " / " << scanned.cardinality());
+    test_diagnosis(base + "policy " + convertIntToStr(i), indexed == scanned, errors);
+  }
+
+  return errors;
+}
+
+int runTests() {
+  int errors = 0;
+
+  ENHOUT("Bitmap tests");
+  errors += testBitmapBasics();
+  errors += testBitmapOperations();
+
+  ENHOUT("Ciphertext store tests");
+  errors += testCompile();
+  errors += testFindCandidates();
+
+  return errors;
+}
+
+int main() {
+  time_t seed;
+  time(&seed);
+  srand((long)seed);
+
+  std::string test_name = "Test CiphertextStore";
+  int result = runTests();
+  print_test_result(result,test_name);
+
+  return 0;
+}
@@ -4,7 +4,7 @@
 
   This file implements tests for the KPABE class. 
   The tests are run for two specific secret sharing schemes, the canonical Benaloh-Leichter and the tree of Shamir gates. 
-  The tests run for each scheme are exactly the same.
+  The tests run for each scheme are exactly the same, and they are run for both placements of the attributes on the groups (G1 or G2).
 */
 
 
@@ -41,7 +41,8 @@ vector<int> pol_parts;
 //------------------- Main Level ----------------------------
 
 
-int test1(int errors, KPABE& testClass, PFC& m_pfc, G1 &P, G2 &Q, Big order){
+template <class Placement>
+int test1(int errors, KPABE<Placement>& testClass, PFC& m_pfc, G1 &P, G2 &Q, Big order){
   //------------------ Test 1: scheme params generation ------------------------
   OUT("==============================<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>==============================");
   OUT("Beginning of test 1");
@@ -56,7 +57,8 @@ int test1(int errors, KPABE& testClass, PFC& m_pfc, G1 &P, G2 &Q, Big order){
   return errors;
 }
 
-int test2(int errors, KPABE& testClass, PFC& m_pfc, G1 &P, G2 &Q){  
+template <class Placement>
+int test2(int errors, KPABE<Placement>& testClass, PFC& m_pfc, G1 &P, G2 &Q){  
   //------------------ Test 2: scheme setup ------------------------
   OUT("==============================<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>==============================");
   OUT("Beginning of test 2");
@@ -65,12 +67,7 @@ int test2(int errors, KPABE& testClass, PFC& m_pfc, G1 &P, G2 &Q){
   Big& privateKeyBlinder = testClass.getPrivateKeyRand();
   GT& publicCTBlinder = testClass.getPublicCTBlinder();
 
-#ifdef AttOnG1_KeyOnG2
-  vector<G1> &publicKeyAtts = testClass.getPublicAttributes();
-#endif
-#ifdef AttOnG2_KeyOnG1
-  vector<G2> &publicKeyAtts = testClass.getPublicAttributes();
-#endif
+  vector<typename Placement::AttGroup> &publicKeyAtts = testClass.getPublicAttributes();
     
   DEBUG("size of private key: " << privateKeyAtts.size() << " -- expected: " << nattr);
   test_diagnosis("Test 2: attribute data structures", privateKeyAtts.size() == nattr, errors);
@@ -81,14 +78,8 @@ int test2(int errors, KPABE& testClass, PFC& m_pfc, G1 &P, G2 &Q){
   for (unsigned int i = 0; i < privateKeyAtts.size(); i++){
     ss << "Test 2 - " << i << ": attributes' computation";
 
-#ifdef AttOnG1_KeyOnG2
-    G1 temp1 = m_pfc.mult(P, privateKeyAtts[i]);
-    test_diagnosis(ss.str(), temp1 == publicKeyAtts[i], errors);
-#endif
-#ifdef AttOnG2_KeyOnG1
-    G2 temp2 = m_pfc.mult(Q, privateKeyAtts[i]);
-    test_diagnosis(ss.str(), temp2 == publicKeyAtts[i], errors);
-#endif
+    typename Placement::AttGroup temp = m_pfc.mult(Placement::attBase(P,Q), privateKeyAtts[i]);
+    test_diagnosis(ss.str(), temp == publicKeyAtts[i], errors);
 
     ss.str("");
   }
@@ -99,31 +90,21 @@ int test2(int errors, KPABE& testClass, PFC& m_pfc, G1 &P, G2 &Q){
 }
 
 
-int test3(int errors, KPABE& testClass, PFC& m_pfc, miracl *mip, G1 &P, G2 &Q, vector<int>& CTAtts, vector<int>& badCTAtts){
+template <class Placement>
+int test3(int errors, KPABE<Placement>& testClass, PFC& m_pfc, miracl *mip, G1 &P, G2 &Q, vector<int>& CTAtts, vector<int>& badCTAtts){
   //------------------ Test 3: Encryption ------------------------
   OUT("==============================<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>==============================");
   OUT("Beginning of test 3");
 
   GT& publicCTBlinder  = testClass.getPublicCTBlinder();
 
-#ifdef AttOnG1_KeyOnG2
-  vector<G1> &publicKeyAtts = testClass.getPublicAttributes();
-#endif
-#ifdef AttOnG2_KeyOnG1
-  vector<G2> &publicKeyAtts = testClass.getPublicAttributes();
-#endif
+  vector<typename Placement::AttGroup> &publicKeyAtts = testClass.getPublicAttributes();
 
   GT CT;
   Big sCT;
 
-#ifdef AttOnG1_KeyOnG2
-  vector<G1> AttFrags;
-  vector<G1> BadAttFrags;
-#endif
-#ifdef AttOnG2_KeyOnG1
-  vector<G2> AttFrags;
-  vector<G2> BadAttFrags;
-#endif
+  vector<typename Placement::AttGroup> AttFrags;
+  vector<typename Placement::AttGroup> BadAttFrags;
 
 
   Big rand;
@@ -171,14 +152,8 @@ int test3(int errors, KPABE& testClass, PFC& m_pfc, miracl *mip, G1 &P, G2 &Q, v
   for (unsigned int i = 0; i < CTAtts.size(); i++){
     ss << "Test 3 - " << i << ": attribute fragments well-formedness";
 
-#ifdef AttOnG1_KeyOnG2
-    G1 temp1 = m_pfc.mult(publicKeyAtts[CTAtts[i]], CTrand);
-    test_diagnosis(ss.str(), temp1 == AttFrags[i], errors);
-#endif
-#ifdef AttOnG2_KeyOnG1
-    G2 temp2 = m_pfc.mult(publicKeyAtts[CTAtts[i]], CTrand);
-    test_diagnosis(ss.str(), temp2 == AttFrags[i], errors);
-#endif
+    typename Placement::AttGroup temp = m_pfc.mult(publicKeyAtts[CTAtts[i]], CTrand);
+    test_diagnosis(ss.str(), temp == AttFrags[i], errors);
 
     ss.str("");
   }
@@ -186,7 +161,8 @@ int test3(int errors, KPABE& testClass, PFC& m_pfc, miracl *mip, G1 &P, G2 &Q, v
   return errors;
 }
 
-int test4(int errors, KPABE& testClass, PFC& m_pfc, G1 &P, G2 &Q, Big order){
+template <class Placement>
+int test4(int errors, KPABE<Placement>& testClass, PFC& m_pfc, G1 &P, G2 &Q, Big order){
   //------------------ Test 4: Key Generation ------------------------
   OUT("==============================<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>==============================");
   OUT("Beginning of test 4");
@@ -197,14 +173,8 @@ int test4(int errors, KPABE& testClass, PFC& m_pfc, G1 &P, G2 &Q, Big order){
   vector<Big> &privateKeyAtts = testClass.getPrivateAttributes();
 
 
-#ifdef AttOnG1_KeyOnG2
-  vector<G1> AttFrags;
-  vector<G1> BadAttFrags;
-#endif
-#ifdef AttOnG2_KeyOnG1
-  vector<G2> AttFrags;
-  vector<G2> BadAttFrags;
-#endif
+  vector<typename Placement::AttGroup> AttFrags;
+  vector<typename Placement::AttGroup> BadAttFrags;
 
     
   //  ShamirAccessPolicy policy(threshold, pol_parts, order);
@@ -220,12 +190,7 @@ int test4(int errors, KPABE& testClass, PFC& m_pfc, G1 &P, G2 &Q, Big order){
   Big privateAtt;
 
   DEBUG("------------ Start GEN KEY --------------");
-#ifdef AttOnG1_KeyOnG2
-  vector<G2> keyFrags = testClass.genKey(randomness);
-#endif
-#ifdef AttOnG2_KeyOnG1
-  vector<G1> keyFrags = testClass.genKey(randomness);
-#endif
+  vector<typename Placement::KeyGroup> keyFrags = testClass.genKey(randomness);
 
   DEBUG("------------ Start TEST COMPARISON --------------");
 
@@ -233,15 +198,9 @@ int test4(int errors, KPABE& testClass, PFC& m_pfc, G1 &P, G2 &Q, Big order){
     ss << "Test 4 - " << i << ": key fragments well-formedness";
     privateAtt = privateKeyAtts[shares[i].getPartIndex()];
 
-#ifdef AttOnG1_KeyOnG2
-    G2 tmp = m_pfc.mult(Q, moddiv(shares[i].getShare(),privateAtt,order)); // for some reason, if tmp is not defined and this expression is written as is on
-    // in the next line, the compiler will interpret the result of m_pfc::mult as G2& and will not compile. 
-    // This error does not occur for AttOnG2_KeyOnG1
+    typename Placement::KeyGroup tmp = m_pfc.mult(Placement::keyBase(P,Q), moddiv(shares[i].getShare(),privateAtt,order)); // for some reason, if tmp is not
+    // defined and this expression is written as is in the next line, the compiler will interpret the result of m_pfc::mult on G2 as G2& and will not compile.
     test_diagnosis(ss.str(), tmp == keyFrags[i], errors);
-#endif
-#ifdef AttOnG2_KeyOnG1
-    test_diagnosis(ss.str(), m_pfc.mult(P, moddiv(shares[i].getShare(),privateAtt,order)) == keyFrags[i], errors);
-#endif
     DEBUG("Iter: " << i << " Share: " << shares[i].getShare() 
 	  << " Attribute: " << privateAtt);    
     ss.str("");
@@ -250,7 +209,8 @@ int test4(int errors, KPABE& testClass, PFC& m_pfc, G1 &P, G2 &Q, Big order){
 }
 
 
-int test5(int errors, KPABE& testClass, PFC& m_pfc, miracl* mip, G1 &P, G2 &Q, vector<int> authCTAtts, vector<int> unauthCTAtts){
+template <class Placement>
+int test5(int errors, KPABE<Placement>& testClass, PFC& m_pfc, miracl* mip, G1 &P, G2 &Q, vector<int> authCTAtts, vector<int> unauthCTAtts){
   //------------------ Test 5: Decryption ------------------------
   OUT("==============================<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>==============================");
   OUT("Beginning of test 5");
@@ -265,26 +225,15 @@ int test5(int errors, KPABE& testClass, PFC& m_pfc, miracl* mip, G1 &P, G2 &Q, v
     
   // DEBUG("[TEST5] Distributed secret (t): " << privateKeyBlinder);
 
-#ifdef AttOnG1_KeyOnG2
-  vector<G2> keyFrags = testClass.genKey();
-#endif
-#ifdef AttOnG2_KeyOnG1
-  vector<G1> keyFrags = testClass.genKey();
-#endif
+  vector<typename Placement::KeyGroup> keyFrags = testClass.genKey();
    
   mip->IOBASE=256;
   const Big sM = (char *)"hello world to be encrypted"; 
   mip->IOBASE=16;
 
 
-#ifdef AttOnG1_KeyOnG2
-  vector<G1> AttFrags;
-  vector<G1> BadAttFrags;
-#endif
-#ifdef AttOnG2_KeyOnG1
-  vector<G2> AttFrags;
-  vector<G2> BadAttFrags;
-#endif
+  vector<typename Placement::AttGroup> AttFrags;
+  vector<typename Placement::AttGroup> BadAttFrags;
     
   Big sCT;
   Big sPT;
@@ -366,7 +315,8 @@ const string name() {
 } 
 
 
-int runTests(KPABE testClass, PFC &pfc, miracl *mip, G1 &P, G2 &Q, Big order,
+template <class Placement>
+int runTests(KPABE<Placement> testClass, PFC &pfc, miracl *mip, G1 &P, G2 &Q, Big order,
 	     vector<int> authCTAtts, vector<int> badCTAtts, vector<int> unauthCTAtts ){
   int errors = 0;
 
@@ -379,7 +329,8 @@ int runTests(KPABE testClass, PFC &pfc, miracl *mip, G1 &P, G2 &Q, Big order,
   return errors;
 }
 
-void classSetup(KPABE &testClass, G1 &P, G2 &Q, Big &order, int nparts){
+template <class Placement>
+void classSetup(KPABE<Placement> &testClass, G1 &P, G2 &Q, Big &order, int nparts){
   testClass.paramsgen(P, Q, order);
   testClass.setup();
   for (int i = 0; i < nparts; i++){
@@ -388,39 +339,17 @@ void classSetup(KPABE &testClass, G1 &P, G2 &Q, Big &order, int nparts){
 }
 
 
-int main() {
-  //  miracl *mip = mirsys(5000,0); // C version: this is necessary to get the MIRACL functioning, which means that then I can call Bigs and so forth.
-  // Miracl precision(5,0); // C++ version for the above, together with the next line
-  // miracl* mip = &precision;
-
-  // The constructor of PFC (in bn_pair.cpp) already invokes mirsys and initializes the mip pointer.
-  // Because of this, I don't do that explicitly here.
-  // It also sets the base to 16, but I include that here for clarity. One should not have to read the code of library classes to understand this code
-
-  //  DEBUG("Starting Miracl setup");
-
-  PFC pfc(AES_SECURITY);  // initialise pairing-friendly curve
-  miracl *mip=get_mip();  // get handle on mip (Miracl Instance Pointer)
-
-  mip->IOBASE=16;
-
-  //  DEBUG("Finished Miracl setup");
-
-  time_t seed;            // crude randomisation. Check if this is the version that is crypto-secure.
-  time(&seed);
-  irand((long)seed);
-
-  //  DEBUG("Finished rand setup");
-
-
-  REPORT("Tests for KPABE scheme based on Canonical Benaloh-Leichter");
+// runs the full set of tests for one placement of attributes and keys on the groups
+template <class Placement>
+void runPlacementTests(PFC &pfc, miracl *mip) {
+  REPORT("Tests for KPABE scheme based on Canonical Benaloh-Leichter, " << Placement::name());
   std::string expr = op_OR + "(1, " + op_AND + "(2,3,4), " + op_AND + "(2,5), " + op_AND + "(4,5))";
   shared_ptr<BLAccessPolicy> policy = make_shared<BLAccessPolicy>(expr, polNAttr);
   shared_ptr<BLSS> testSchemeBL = make_shared<BLSS>(policy, pfc);
   
   //  DEBUG("Created BL");
 
-  KPABE testClass(testSchemeBL, pfc, nattr);
+  KPABE<Placement> testClass(testSchemeBL, pfc, nattr);
 
   //  DEBUG("Created KPABE");
 
@@ -429,7 +358,7 @@ int main() {
   Big order = pfc.order();
   
   classSetup(testClass, P, Q, order, nattr);
-  std::string test_name = "Test KPABE: " "BL canonical";
+  std::string test_name = "Test KPABE: " "BL canonical, " + Placement::name();
 
   //  DEBUG("Finished KPABE Setup");
 
@@ -471,7 +400,7 @@ int main() {
 
   //==============================================================================================================
 
-  REPORT("Tests for KPABE scheme based on Tree of Shamir schemes");
+  REPORT("Tests for KPABE scheme based on Tree of Shamir schemes, " << Placement::name());
 
   std::string exprSH = op_THR + "(2, 1, " + op_AND + "(2,3,4), " + op_THR + "(2,2,5, " + op_OR + "(1,4,5)))";
   shared_ptr<ShTreeAccessPolicy> policySH = make_shared<ShTreeAccessPolicy>(exprSH, polNAttr);
@@ -479,11 +408,11 @@ int main() {
   
   //  DEBUG("Created ShTree");
 
-  KPABE testClassSH(testSchemeShTree, pfc, nattr);
+  KPABE<Placement> testClassSH(testSchemeShTree, pfc, nattr);
 
   
   classSetup(testClassSH, P, Q, order, nattr);
-  std::string test_nameSH = "Test KPABE: " "Shamir Tree";
+  std::string test_nameSH = "Test KPABE: " "Shamir Tree, " + Placement::name();
 
 
   vector<int> authCTAttsSH; // all valid attribute indices, authorized set
@@ -516,6 +445,50 @@ int main() {
   result += runTests(testClassSH, pfc, mip, P, Q, order, authCTAttsSH, badCTAttsSH, unauthCTAttsSH);
   print_test_result(result, test_nameSH);
 
+}
+
+// the placement is selected at runtime, through runWithPlacement, as an application would
+struct PlacementTests {
+  PFC &pfc;
+  miracl *mip;
+
+  PlacementTests(PFC &p, miracl *m): pfc(p), mip(m) {}
+
+  template <class Placement>
+  void run() {
+    runPlacementTests<Placement>(pfc, mip);
+  }
+};
+
+int main() {
+  //  miracl *mip = mirsys(5000,0); // C version: this is necessary to get the MIRACL functioning, which means that then I can call Bigs and so forth.
+  // Miracl precision(5,0); // C++ version for the above, together with the next line
+  // miracl* mip = &precision;
+
+  // The constructor of PFC (in bn_pair.cpp) already invokes mirsys and initializes the mip pointer.
+  // Because of this, I don't do that explicitly here.
+  // It also sets the base to 16, but I include that here for clarity. One should not have to read the code of library classes to understand this code
+
+  //  DEBUG("Starting Miracl setup");
+
+  PFC pfc(AES_SECURITY);  // initialise pairing-friendly curve
+  miracl *mip=get_mip();  // get handle on mip (Miracl Instance Pointer)
+
+  mip->IOBASE=16;
+
+  //  DEBUG("Finished Miracl setup");
+
+  time_t seed;            // crude randomisation. Check if this is the version that is crypto-secure.
+  time(&seed);
+  irand((long)seed);
+
+  //  DEBUG("Finished rand setup");
+
+
+  PlacementTests tests(pfc, mip);
+  GroupPlacement placement;
+  if (parsePlacement("g1", placement)) runWithPlacement(placement, tests);
+  if (parsePlacement("g2", placement)) runWithPlacement(placement, tests);
 
   return 0;
 }
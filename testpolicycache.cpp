@@ -0,0 +1,319 @@
+/*
+  Testbed for empirical evaluation of KP-ABE schemes, according to Crampton, Pinto (CSF2014).
+  Code by: Alexandre Miranda Pinto
+
+  This file holds tests for the binary format of policies, for the policy cache and for the policy registry (policycache.cpp).
+  A policy read back from its binary form is compared with the one compiled from its description, by evaluating both over random sets of attributes.
+*/
+
+#ifndef DEF_UTILS
+#include "utils.h"
+#endif
+
+#ifndef DEF_POLICY_CACHE
+#include "policycache.h"
+#endif
+
+#include <cstdlib>
+#include <cstdio>
+#include <unistd.h>
+#include <thread>
+
+const int nAttr = 12;
+
+vector<shared_ptr<AccessPolicy> > makePolicies() {
+  vector<shared_ptr<AccessPolicy> > policies;
+  policies.push_back(make_shared<BLAccessPolicy>(op_OR + "(1, " + op_AND + "(2,3,4), " + op_AND + "(2,5), " + op_AND + "(4,5))", nAttr));
+  policies.push_back(make_shared<BLAccessPolicy>("", nAttr));
+  policies.push_back(make_shared<ShTreeAccessPolicy>(op_THR + "(2, 1, " + op_AND + "(2,3,4), " + op_THR + "(2,2,5, " + op_OR + "(1,4,5)))", nAttr));
+  policies.push_back(make_shared<ShTreeAccessPolicy>(op_THR + "(3, 0,1,2,3,4,5)", nAttr));
+  policies.push_back(make_shared<ShTreeAccessPolicy>("6", nAttr));
+  policies.push_back(make_shared<ShTreeAccessPolicy>("", nAttr));
+  return policies;
+}
+
+// both policies must cover the same shares and find the same witnesses for every set of attributes
+bool sameBehaviour(shared_ptr<AccessPolicy> a, shared_ptr<AccessPolicy> b) {
+  if ((a->getNumShares() != b->getNumShares()) || (a->getParticipants() != b->getParticipants())) return false;
+  for (int run = 0; run < 200; run++) {
+    vector<int> atts;
+    int nAtts = rand() % 8;
+    for (int j = 0; j < nAtts; j++) {
+      atts.push_back(rand() % nAttr);
+    }
+    vector<int> attIndicesA, keyIndicesA, witnessesA, attIndicesB, keyIndicesB, witnessesB;
+    vector<ShareID> sharesA, sharesB;
+    a->obtainCoveredFrags(atts, attIndicesA, keyIndicesA, sharesA);
+    b->obtainCoveredFrags(atts, attIndicesB, keyIndicesB, sharesB);
+    if ((attIndicesA != attIndicesB) || (keyIndicesA != keyIndicesB) || !(sharesA == sharesB)) return false;
+    if (a->evaluateIDs(sharesA, witnessesA) != b->evaluateIDs(sharesB, witnessesB)) return false;
+    if (witnessesA != witnessesB) return false;
+  }
+  return true;
+}
+
+int testRoundTrip() {
+  int errors = 0;
+  std::string base = "testRoundTrip: ";
+
+  vector<shared_ptr<AccessPolicy> > policies = makePolicies();
+  for (unsigned int i = 0; i < policies.size(); i++) {
+    std::string name = base + "policy " + convertIntToStr(i) + " [" + PolicyCodec::descriptionOf(policies[i]) + "] ";
+    vector<char> data;
+    PolicyCodec::serialize(policies[i], data);
+    shared_ptr<AccessPolicy> read = PolicyCodec::deserialize(data);
+    PolicyKind kindA, kindB;
+    test_diagnosis(name + "kind", PolicyCodec::kindOf(policies[i], kindA) && PolicyCodec::kindOf(read, kindB) && (kindA == kindB), errors);
+    test_diagnosis(name + "description", PolicyCodec::descriptionOf(read) == PolicyCodec::descriptionOf(policies[i]), errors);
+    test_diagnosis(name + "behaviour", sameBehaviour(policies[i], read), errors);
+    vector<char> again;
+    PolicyCodec::serialize(read, again);
+    test_diagnosis(name + "serializes to the same bytes", again == data, errors);
+  }
+
+  // a tree read back has no parse tree until it is asked for one
+  shared_ptr<ShTreeAccessPolicy> tree = std::dynamic_pointer_cast<ShTreeAccessPolicy>(policies[2]);
+  vector<char> data;
+  PolicyCodec::serialize(tree, data);
+  shared_ptr<ShTreeAccessPolicy> read = std::dynamic_pointer_cast<ShTreeAccessPolicy>(PolicyCodec::deserialize(data));
+  test_diagnosis(base + "parse tree built on demand", read && (*read->getPolicy() == *tree->getPolicy()), errors);
+
+  return errors;
+}
+
+bool rejects(const vector<char> &data) {
+  try {
+    PolicyCodec::deserialize(data);
+  } catch (std::runtime_error &e) {
+    return std::string(e.what()).find(ERR_BAD_SERIAL) == 0;
+  }
+  return false;
+}
+
+bool treeRejects(const vector<char> &data) {
+  BinaryReader reader(data);
+  try {
+    CompiledTree::readBinary(reader);
+  } catch (std::runtime_error &e) {
+    return std::string(e.what()).find(ERR_BAD_SERIAL) == 0;
+  }
+  return false;
+}
+
+// overwrites the unsigned int at pos, as BinaryWriter writes it
+void putUIntAt(vector<char> &data, unsigned int pos, unsigned int n) {
+  for (int shift = 0; shift < 32; shift += 8) {
+    data[pos++] = (char) ((n >> shift) & 0xFF);
+  }
+}
+
+int testMalformedInput() {
+  int errors = 0;
+  std::string base = "testMalformedInput: ";
+
+  vector<shared_ptr<AccessPolicy> > policies = makePolicies();
+  for (unsigned int i = 0; i < policies.size(); i++) {
+    vector<char> data;
+    PolicyCodec::serialize(policies[i], data);
+    bool allRejected = true;
+    for (unsigned int len = 0; len < data.size(); len++) {
+      allRejected = allRejected && rejects(vector<char>(data.begin(), data.begin() + len));
+    }
+    test_diagnosis(base + "policy " + convertIntToStr(i) + " truncated", allRejected, errors);
+    vector<char> longer(data);
+    longer.push_back(0);
+    test_diagnosis(base + "policy " + convertIntToStr(i) + " trailing content", rejects(longer), errors);
+  }
+
+  vector<char> data;
+  PolicyCodec::serialize(policies[2], data);
+  vector<char> badMagic(data);
+  badMagic[0] ^= 1;
+  test_diagnosis(base + "magic number", rejects(badMagic), errors);
+  vector<char> badVersion(data);
+  badVersion[4] ^= 1;
+  test_diagnosis(base + "version", rejects(badVersion), errors);
+
+  // the trees below are changed in one field each. The first child of the root, which is the last node, is made to point at the root itself
+  const CompiledTree &compiled = std::dynamic_pointer_cast<ShTreeAccessPolicy>(policies[2])->getCompiledTree();
+  vector<char> treeData;
+  BinaryWriter writer(treeData);
+  compiled.writeBinary(writer);
+  const CompiledTree::Node &root = compiled.getNode(compiled.root());
+  unsigned int rootPos = 4 + compiled.root() * 37; // each node takes 1 + 9 * 4 bytes
+  unsigned int childrenPos = 4 + compiled.size() * 37 + 4 + 4 * root.firstChild;
+  vector<char> badChild(treeData);
+  putUIntAt(badChild, childrenPos, compiled.root());
+  test_diagnosis(base + "child placed after its parent", treeRejects(badChild), errors);
+
+  vector<char> badThreshold(treeData);
+  putUIntAt(badThreshold, rootPos + 1, root.numChildren + 1);
+  test_diagnosis(base + "threshold above the children", treeRejects(badThreshold), errors);
+
+  vector<char> badRandomness(treeData);
+  putUIntAt(badRandomness, rootPos + 33, compiled.getNumRandomness());
+  test_diagnosis(base + "randomness beyond the tree", treeRejects(badRandomness), errors);
+
+  unsigned int childPos = 4 + compiled.getChild(root, 0) * 37;
+  vector<char> badChildNo(treeData);
+  putUIntAt(badChildNo, childPos + 29, 1);
+  test_diagnosis(base + "child number", treeRejects(badChildNo), errors);
+  vector<char> badParent(treeData);
+  putUIntAt(badParent, childPos + 25, compiled.getChild(root, 1));
+  test_diagnosis(base + "parent", treeRejects(badParent), errors);
+
+  // a node that names as its parent a leaf, or itself, which no gate lists
+  vector<char> leafParent(treeData);
+  putUIntAt(leafParent, 4 + 37 + 25, 0);
+  test_diagnosis(base + "leaf as parent", (compiled.getNode(0).kind == CompiledTree::leafNode) && treeRejects(leafParent), errors);
+  vector<char> ownParent(treeData);
+  putUIntAt(ownParent, 4 + 37 + 25, 1);
+  test_diagnosis(base + "own parent", treeRejects(ownParent), errors);
+  vector<char> orphan(treeData);
+  putUIntAt(orphan, 4 + 37 + 25, (unsigned int) -1);
+  test_diagnosis(base + "node other than the root without a parent", treeRejects(orphan), errors);
+  // the root no longer lists its last child, which still names the root as its parent
+  vector<char> unlisted(treeData);
+  putUIntAt(unlisted, rootPos + 9, root.numChildren - 1);
+  test_diagnosis(base + "child not listed by its parent", treeRejects(unlisted), errors);
+  vector<char> leafChildren(treeData);
+  putUIntAt(leafChildren, 4 + 9, 1);
+  test_diagnosis(base + "children of a leaf", treeRejects(leafChildren), errors);
+
+  return errors;
+}
+
+int testPolicyCache() {
+  int errors = 0;
+  std::string base = "testPolicyCache: ";
+
+  char dirTemplate[] = "/tmp/policycacheXXXXXX";
+  char *dir = mkdtemp(dirTemplate);
+  if (dir == NULL) {
+    test_diagnosis(base + "temporary directory", false, errors);
+    return errors;
+  }
+  PolicyCache cache(dir);
+  std::string expr = op_THR + "(2, 1, " + op_AND + "(2,3,4), 5)";
+
+  shared_ptr<AccessPolicy> first = cache.load(shTreePolicy, expr, nAttr);
+  test_diagnosis(base + "first load compiles", (cache.getMisses() == 1) && (cache.getHits() == 0), errors);
+  shared_ptr<AccessPolicy> second = cache.load(shTreePolicy, expr, nAttr);
+  test_diagnosis(base + "second load reads the cache", (cache.getMisses() == 1) && (cache.getHits() == 1), errors);
+  test_diagnosis(base + "cached policy behaves as compiled", sameBehaviour(first, second), errors);
+
+  // the same description is another entry for another kind of policy or other participants
+  std::string blExpr = op_OR + "(1, " + op_AND + "(2,3))";
+  cache.load(blPolicy, blExpr, nAttr);
+  cache.load(shTreePolicy, blExpr, nAttr);
+  cache.load(shTreePolicy, blExpr, nAttr + 1);
+  test_diagnosis(base + "distinct keys", cache.getMisses() == 4, errors);
+  shared_ptr<AccessPolicy> bl = cache.load(blPolicy, blExpr, nAttr);
+  PolicyKind kind;
+  test_diagnosis(base + "kind of the entry", (cache.getHits() == 2) && PolicyCodec::kindOf(bl, kind) && (kind == blPolicy), errors);
+
+  // a damaged entry is compiled again and replaced
+  vector<int> parts;
+  for (int i = 1; i <= nAttr; i++) parts.push_back(i);
+  std::string file = cache.path(PolicyCache::key(shTreePolicy, expr, parts));
+  FILE *f = fopen(file.c_str(), "r+b");
+  if (f != NULL) {
+    fputc('X', f);
+    fclose(f);
+  }
+  shared_ptr<AccessPolicy> third = cache.load(shTreePolicy, expr, nAttr);
+  test_diagnosis(base + "damaged entry is compiled", (cache.getMisses() == 5) && sameBehaviour(first, third), errors);
+  cache.load(shTreePolicy, expr, nAttr);
+  test_diagnosis(base + "damaged entry is replaced", cache.getHits() == 3, errors);
+
+  std::string cleanup = std::string("rm -rf ") + dir;
+  if (system(cleanup.c_str()) != 0) {
+    DEBUG("could not remove " << dir);
+  }
+  return errors;
+}
+
+int testPolicyRegistry() {
+  int errors = 0;
+  std::string base = "testPolicyRegistry: ";
+
+  PolicyRegistry registry;
+  std::string expr = op_THR + "(2, 1, " + op_AND + "(2,3,4), 5)";
+  shared_ptr<AccessPolicy> first = registry.intern(shTreePolicy, expr, nAttr);
+  shared_ptr<AccessPolicy> second = registry.intern(shTreePolicy, expr, nAttr);
+  test_diagnosis(base + "same text", (first == second) && (registry.getHits() == 1) && (registry.getMisses() == 1), errors);
+
+  // the same structure, written in another way
+  shared_ptr<AccessPolicy> spaced = registry.intern(shTreePolicy, op_THR + "(2,1," + op_AND + "( 2,3,4 ),5)", nAttr);
+  test_diagnosis(base + "same structure", (first == spaced) && (registry.getHits() == 2), errors);
+  shared_ptr<AccessPolicy> built = registry.intern(make_shared<ShTreeAccessPolicy>(expr, nAttr));
+  test_diagnosis(base + "policy built elsewhere", first == built, errors);
+
+  vector<int> parts;
+  for (int i = 1; i <= nAttr; i++) parts.push_back(i);
+  shared_ptr<BLAccessPolicy> bl = registry.internBL(op_OR + "(1, " + op_AND + "(2,3))", parts);
+  shared_ptr<AccessPolicy> otherParts = registry.intern(shTreePolicy, expr, nAttr + 1);
+  test_diagnosis(base + "distinct policies", bl && (otherParts != first) && (registry.size() == 3), errors);
+
+  // released policies are dropped, and built again when asked for
+  StructuralHash hash = first->getStructuralHash();
+  first.reset();
+  second.reset();
+  spaced.reset();
+  built.reset();
+  registry.purge();
+  test_diagnosis(base + "released policy", registry.size() == 2, errors);
+  shared_ptr<AccessPolicy> again = registry.intern(shTreePolicy, expr, nAttr);
+  test_diagnosis(base + "built again", (again->getStructuralHash() == hash) && (registry.getMisses() == 4), errors);
+
+  // threads that ask for the same policy at once get the same object
+  const unsigned int nThreads = 4;
+  vector<shared_ptr<AccessPolicy> > results(nThreads);
+  vector<std::thread> threads;
+  std::string shared = op_OR + "(" + op_AND + "(1,2), " + op_AND + "(3,4), 6)";
+  for (unsigned int i = 0; i < nThreads; i++) {
+    threads.push_back(std::thread([&registry, &results, &shared, i]() {
+	  for (int run = 0; run < 50; run++) {
+	    results[i] = registry.intern(shTreePolicy, shared, nAttr);
+	  }
+	}));
+  }
+  for (unsigned int i = 0; i < nThreads; i++) {
+    threads[i].join();
+  }
+  bool same = true;
+  for (unsigned int i = 1; i < nThreads; i++) {
+    same = same && (results[i] == results[0]);
+  }
+  test_diagnosis(base + "threads", same && (registry.size() == 4), errors);
+
+  return errors;
+}
+
+int runTests() {
+  int errors = 0;
+
+  ENHOUT("Binary policy tests");
+  errors += testRoundTrip();
+  errors += testMalformedInput();
+
+  ENHOUT("Policy cache tests");
+  errors += testPolicyCache();
+
+  ENHOUT("Policy registry tests");
+  errors += testPolicyRegistry();
+
+  return errors;
+}
+
+int main() {
+  time_t seed;
+  time(&seed);
+  srand((long)seed);
+
+  std::string test_name = "Test PolicyCache";
+  int result = runTests();
+  print_test_result(result,test_name);
+
+  return 0;
+}
@@ -0,0 +1,171 @@
+/*
+  Testbed for empirical evaluation of KP-ABE schemes, according to Crampton, Pinto (CSF2014).
+  Code by: Alexandre Miranda Pinto
+
+  This file holds tests for the conversion to minimal sets, the cost model and the scheme factory (schemefactory.cpp).
+  Converted policies are compared with the trees they come from by evaluating both over every set of a few attributes.
+*/
+
+#ifndef DEF_UTILS
+#include "utils.h"
+#endif
+
+#ifndef DEF_SCHEME_FACTORY
+#include "schemefactory.h"
+#endif
+
+shared_ptr<TreeNode> parseTree(const std::string& expr) {
+  TreeArena arena;
+  ShTreeAccessPolicy::parseIntoArena(expr, arena);
+  return arena.toTree();
+}
+
+bool satisfies(AccessPolicy& policy, const vector<int>& atts) {
+  vector<int> attFragIndices, keyFragIndices, witness;
+  vector<ShareID> shareIDs;
+  policy.obtainCoveredFrags(atts, attFragIndices, keyFragIndices, shareIDs);
+  return policy.evaluateIDs(shareIDs, witness);
+}
+
+// both descriptions are satisfied by the same sets of the attributes 0 to nAtts-1
+bool sameAccessStructure(const std::string& treeExpr, const std::string& blExpr, int nAtts) {
+  ShTreeAccessPolicy tree(treeExpr, nAtts);
+  BLAccessPolicy bl(blExpr, nAtts);
+  for (unsigned int set = 0; set < (1U << nAtts); set++) {
+    vector<int> atts;
+    for (int a = 0; a < nAtts; a++) {
+      if ((set >> a) & 1) atts.push_back(a);
+    }
+    if (satisfies(tree, atts) != satisfies(bl, atts)) return false;
+  }
+  return true;
+}
+
+int testMinimalSets() {
+  int errors = 0;
+  std::string base = "testMinimalSets: ";
+  vector<vector<int> > sets;
+
+  std::string expr = op_THR + "(2, 1,2,3)";
+  bool converted = DNFConverter::toMinimalSets(parseTree(expr), sets);
+  test_diagnosis(base + expr, converted && (DNFConverter::toDescription(sets) == op_OR + "(AND(1,2),AND(1,3),AND(2,3))"), errors);
+
+  expr = op_OR + "(1, " + op_AND + "(1,2), " + op_AND + "(2,3,2))";
+  converted = DNFConverter::toMinimalSets(parseTree(expr), sets);
+  test_diagnosis(base + "absorption", converted && (DNFConverter::toDescription(sets) == op_OR + "(AND(1),AND(2,3))"), errors);
+
+  expr = op_AND + "(" + op_OR + "(0,1), " + op_OR + "(2,3), " + op_OR + "(4,5), " + op_OR + "(6,7), " + op_OR + "(8,9), " + op_OR + "(10,11), "
+    + op_OR + "(12,13))";
+  test_diagnosis(base + "too many sets", !DNFConverter::toMinimalSets(parseTree(expr), sets), errors);
+  test_diagnosis(base + "bound", DNFConverter::toMinimalSets(parseTree(expr), sets, 128) && (sets.size() == 128), errors);
+
+  test_diagnosis(base + "empty policy", DNFConverter::toMinimalSets(parseTree(""), sets) && sets.empty(), errors);
+
+  vector<std::string> policies;
+  policies.push_back(op_THR + "(2, 0, " + op_AND + "(1,2), " + op_OR + "(3, " + op_AND + "(4,5)))");
+  policies.push_back(op_AND + "(" + op_OR + "(0,1), " + op_THR + "(2, 1,2,3), " + op_OR + "(4, " + op_AND + "(5,0)))");
+  policies.push_back(op_THR + "(3, 0,1,2,3,4,5)");
+  policies.push_back(op_OR + "(" + op_THR + "(2, 0,1,2), " + op_THR + "(2, 2,3,4), 5)");
+  for (unsigned int i = 0; i < policies.size(); i++) {
+    converted = DNFConverter::toMinimalSets(parseTree(policies[i]), sets);
+    test_diagnosis(base + policies[i], converted && sameAccessStructure(policies[i], DNFConverter::toDescription(sets), 6), errors);
+  }
+
+  return errors;
+}
+
+int testCostModel() {
+  int errors = 0;
+  std::string base = "testCostModel: ";
+
+  // the same minimal sets: BL needs no coefficients
+  SchemeFactory::Choice choice = SchemeFactory::choose(op_OR + "(" + op_AND + "(1,2), " + op_AND + "(3,4))");
+  test_diagnosis(base + "OR of ANDs", (choice.kind == blPolicy) && (choice.blCost.keyFragments == choice.treeCost.keyFragments)
+		 && (choice.blCost.decryptExponentiations == 0), errors);
+
+  // 8 minimal sets of 3 attributes against a tree of 6 leaves
+  std::string expr = op_AND + "(" + op_OR + "(1,2), " + op_OR + "(3,4), " + op_OR + "(5,6))";
+  choice = SchemeFactory::choose(expr);
+  test_diagnosis(base + "AND of ORs", (choice.kind == shTreePolicy) && choice.blFeasible && (choice.blCost.keyFragments == 24)
+		 && (choice.treeCost.keyFragments == 6) && (choice.treeCost.decryptPairings == 3), errors);
+
+  // a deployment that only counts decryption prefers BL for the same policy
+  CostWeights weights;
+  weights.keygenWeight = 0;
+  choice = SchemeFactory::choose(expr, CostModel(weights));
+  test_diagnosis(base + "decryption only", choice.kind == blPolicy, errors);
+
+  choice = SchemeFactory::choose(op_THR + "(4, 1,2,3,4,5,6,7,8)");
+  test_diagnosis(base + "threshold with 70 minimal sets", (choice.kind == shTreePolicy) && !choice.blFeasible, errors);
+
+  // the optimizer runs first: a nested AND is one minimal set
+  choice = SchemeFactory::choose(op_AND + "(" + op_AND + "(1,2), 3)");
+  test_diagnosis(base + "optimized first", (choice.kind == blPolicy) && (choice.description == op_OR + "(AND(1,2,3))"), errors);
+
+  return errors;
+}
+
+int testMakeScheme(PFC &pfc) {
+  int errors = 0;
+  std::string base = "testMakeScheme: ";
+
+  vector<int> parts;
+  for (int i = 1; i <= 6; i++) parts.push_back(i);
+  vector<std::string> policies;
+  policies.push_back(op_OR + "(" + op_AND + "(1,2), " + op_AND + "(3,4))");
+  policies.push_back(op_AND + "(" + op_OR + "(1,2), " + op_OR + "(3,4), " + op_OR + "(5,6))");
+
+  for (unsigned int i = 0; i < policies.size(); i++) {
+    SchemeFactory::Choice choice = SchemeFactory::choose(policies[i]);
+    shared_ptr<SecretSharing> scheme = SchemeFactory::makeScheme(choice, parts, pfc);
+    bool rightKind = (choice.kind == blPolicy) ? (bool) std::dynamic_pointer_cast<BLSS>(scheme) : (bool) std::dynamic_pointer_cast<ShTreeSS>(scheme);
+    SchemeCost cost = (choice.kind == blPolicy) ? choice.blCost : choice.treeCost;
+    test_diagnosis(base + policies[i] + " kind", rightKind && (scheme->getPolicy()->getNumShares() == cost.keyFragments), errors);
+
+    Big s = rand();
+    vector<ShareTuple> shares = scheme->distribute_random(s);
+    vector<int> party;
+    party.push_back(1);
+    party.push_back(3);
+    party.push_back(4);
+    party.push_back(6);
+    vector<ShareTuple> witnessShares;
+    bool success = scheme->evaluate(SecretSharing::getSharesForParticipants(party, shares), witnessShares);
+    test_diagnosis(base + policies[i] + " reconstruction", success && (scheme->reconstruct(witnessShares) == s), errors);
+  }
+
+  return errors;
+}
+
+int runTests(PFC &pfc) {
+  int errors = 0;
+
+  ENHOUT("Minimal set tests");
+  errors += testMinimalSets();
+
+  ENHOUT("Cost model tests");
+  errors += testCostModel();
+
+  ENHOUT("Scheme factory tests");
+  errors += testMakeScheme(pfc);
+
+  return errors;
+}
+
+int main() {
+  PFC pfc(AES_SECURITY);  // initialise pairing-friendly curve
+  miracl *mip=get_mip();  // get handle on mip (Miracl Instance Pointer)
+
+  mip->IOBASE=10;
+
+  time_t seed;
+  time(&seed);
+  irand((long)seed);
+  srand((long)seed);
+
+  std::string test_name = "Test SchemeFactory";
+  int result = runTests(pfc);
+  print_test_result(result,test_name);
+
+  return 0;
+}
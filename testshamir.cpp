@@ -0,0 +1,166 @@
+/*
+  Testbed for empirical evaluation of KP-ABE schemes, according to Crampton, Pinto (CSF2014).
+  Code by: Alexandre Miranda Pinto
+
+  This file holds tests for the single-gate Shamir scheme (shamir.cpp), and for its selection by ShTree.
+*/
+
+#ifndef DEF_UTILS
+#include "utils.h"
+#endif
+
+#ifndef DEF_SH_TREE
+#include "ShTree.h"
+#endif
+
+#ifndef DEF_SHAMIR
+#include "shamir.h"
+#endif
+
+int testFlatSelection() {
+  int errors = 0;
+  std::string base = "testFlatSelection: ";
+
+  ShTreeAccessPolicy thr(op_THR + "(2, 4,5,6)", 6);
+  shared_ptr<ShamirAccessPolicy> flat = thr.getFlatPolicy();
+  test_diagnosis(base + "threshold", flat && (flat->getThreshold() == 2), errors);
+  test_diagnosis(base + "attributes", flat && (flat->getShareAttributes().size() == 3) && (flat->getShareAttributes()[2] == 6), errors);
+
+  ShTreeAccessPolicy andPolicy(op_AND + "(1,2)", 2);
+  test_diagnosis(base + "AND", andPolicy.getFlatPolicy() && (andPolicy.getFlatPolicy()->getThreshold() == 2), errors);
+
+  ShTreeAccessPolicy nested(op_OR + "(1, " + op_AND + "(2,3))", 3);
+  test_diagnosis(base + "nested", !nested.getFlatPolicy(), errors);
+  ShTreeAccessPolicy leaf("1", 1);
+  test_diagnosis(base + "single leaf", !leaf.getFlatPolicy(), errors);
+
+  ShamirAccessPolicy parsed(op_THR + "(2, 4,5,6)", 6);
+  test_diagnosis(base + "description", parsed == *flat, errors);
+  try {
+    ShamirAccessPolicy bad(op_OR + "(1, " + op_AND + "(2,3))", 3);
+    test_diagnosis(base + "nested description throws", false, errors);
+  } catch (std::runtime_error &e) {
+    test_diagnosis(base + "nested description throws", true, errors);
+  }
+
+  return errors;
+}
+
+int testEvaluateIDs() {
+  int errors = 0;
+  std::string base = "testEvaluateIDs: ";
+
+  vector<int> atts;
+  for (int i = 1; i <= 70; i++) atts.push_back(i);
+  ShamirAccessPolicy policy(3, atts, 70);
+
+  // the shares are given out of order, with a repeated one and one that the policy did not issue. The witness is the first three shares by index
+  vector<ShareID> shareIDs;
+  shareIDs.push_back(ShareID(66, 66));
+  shareIDs.push_back(ShareID(5, 5));
+  shareIDs.push_back(ShareID(80, 80));
+  shareIDs.push_back(ShareID(5, 5));
+  shareIDs.push_back(ShareID(2, 2));
+  shareIDs.push_back(ShareID(40, 40));
+  vector<int> witness;
+  bool satisfied = policy.evaluateIDs(shareIDs, witness);
+  test_diagnosis(base + "witness", satisfied && (witness.size() == 3) && (witness[0] == 4) && (witness[1] == 1) && (witness[2] == 5), errors);
+
+  shareIDs.resize(4);
+  test_diagnosis(base + "repeated share counts once", !policy.evaluateIDs(shareIDs, witness) && witness.empty(), errors);
+
+  ShamirAccessPolicy unsatisfiable(4, vector<int>(3, 1), 1);
+  shareIDs.clear();
+  for (int i = 0; i < 3; i++) shareIDs.push_back(ShareID(i, i));
+  test_diagnosis(base + "threshold above the shares", !unsatisfiable.evaluateIDs(shareIDs, witness), errors);
+
+  return errors;
+}
+
+int testDistributeAndReconstruct(PFC &pfc) {
+  int errors = 0;
+  std::string base = "testDistributeAndReconstruct: ";
+
+  shared_ptr<ShamirAccessPolicy> policy = make_shared<ShamirAccessPolicy>(op_THR + "(3, 1,2,3,4,5)", 5);
+  ShamirSS scheme(policy, pfc);
+  Big order = scheme.getOrder();
+  Big s = rand();
+
+  // the shares are the values of the polynomial at 1 to n
+  vector<Big> randomness;
+  randomness.push_back(rand());
+  randomness.push_back(rand());
+  vector<ShareTuple> shares = scheme.distribute_determ(s, randomness);
+  bool onPolynomial = (shares.size() == 5);
+  Big expected;
+  for (unsigned int i = 0; i < shares.size(); i++) {
+    SharePolynomial::evaluate(s, randomness.data(), 2, i + 1, order, expected);
+    onPolynomial = onPolynomial && (shares[i].getShare() == expected) && (shares[i].getShareID() == ShareID(i, i)) && (shares[i].getPartIndex() == (int) i + 1);
+  }
+  test_diagnosis(base + "polynomial", onPolynomial, errors);
+
+  // the tree hands the same policy to the flat scheme, and gives the same shares
+  shared_ptr<ShTreeAccessPolicy> treePolicy = make_shared<ShTreeAccessPolicy>(op_THR + "(3, 1,2,3,4,5)", 5);
+  ShTreeSS treeScheme(treePolicy, pfc);
+  test_diagnosis(base + "same shares as ShTree", treeScheme.distribute_determ(s, randomness) == shares, errors);
+
+  bool reconstructed = true;
+  bool authorizedIffThreshold = true;
+  for (unsigned int set = 0; set < 32; set++) {
+    vector<int> party;
+    for (int a = 0; a < 5; a++) {
+      if ((set >> a) & 1) party.push_back(a + 1);
+    }
+    vector<ShareTuple> partyShares = SecretSharing::getSharesForParticipants(party, shares);
+    vector<ShareTuple> witnessShares;
+    bool authorized = scheme.evaluate(partyShares, witnessShares);
+    authorizedIffThreshold = authorizedIffThreshold && (authorized == (party.size() >= 3));
+    if (authorized) {
+      reconstructed = reconstructed && (scheme.reconstruct(partyShares) == s) && (treeScheme.reconstruct(partyShares) == s);
+    }
+  }
+  test_diagnosis(base + "authorized sets", authorizedIffThreshold, errors);
+  test_diagnosis(base + "reconstruction", reconstructed, errors);
+
+  // the point of a share is given by its index, whatever child number the identifier carries
+  vector<ShareID> byIndex;
+  vector<ShareID> otherChildNos;
+  for (int i = 1; i < 4; i++) {
+    byIndex.push_back(ShareID(i, i));
+    otherChildNos.push_back(ShareID(i, 0));
+  }
+  test_diagnosis(base + "points from the index", policy->findCoefficients(otherChildNos, order) == policy->findCoefficients(byIndex, order), errors);
+
+  return errors;
+}
+
+int runTests(PFC &pfc) {
+  int errors = 0;
+
+  ENHOUT("Shamir policy tests");
+  errors += testFlatSelection();
+  errors += testEvaluateIDs();
+
+  ENHOUT("Shamir scheme tests");
+  errors += testDistributeAndReconstruct(pfc);
+
+  return errors;
+}
+
+int main() {
+  PFC pfc(AES_SECURITY);  // initialise pairing-friendly curve
+  miracl *mip=get_mip();  // get handle on mip (Miracl Instance Pointer)
+
+  mip->IOBASE=10;
+
+  time_t seed;
+  time(&seed);
+  irand((long)seed);
+  srand((long)seed);
+
+  std::string test_name = "Test Shamir";
+  int result = runTests(pfc);
+  print_test_result(result,test_name);
+
+  return 0;
+}
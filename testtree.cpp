@@ -10,6 +10,9 @@
 #include "tree.h"
 #endif
 
+#include <algorithm>
+#include <thread>
+
 
   std::string message;
   std::string base;
@@ -626,6 +629,334 @@ int testNilTree() {
   return errors;
 }
 
+// IDs are derived from the position of each node, so they stay right however the tree was assembled, and a subtree that outlives its tree keeps its ID
+int testLazyNodeIDs() {
+  int errors = 0;
+
+  // a chain of 200 AND gates, assembled from the bottom up as the parser used to do
+  const int depth = 200;
+  shared_ptr<TreeNode> tree = TreeNode::makeTree(NodeContent::makeLeafNode(5));
+  for (int i = 0; i < depth; i++) {
+    shared_ptr<TreeNode> gate = TreeNode::makeTree(NodeContent::makeAndNode(2));
+    gate->appendChild(NodeContent::makeLeafNode(i));
+    gate->appendTree(tree);
+    tree = gate;
+  }
+  shared_ptr<TreeNode> bottom = tree;
+  std::string verif = "0";
+  for (int i = 0; i < depth; i++) {
+    bottom = bottom->getChild(1);
+    verif += ":1";
+  }
+  test_diagnosis("testLazyNodeIDs - deepest leaf", bottom->getNodeID() == verif + ":=5", errors);
+  test_diagnosis("testLazyNodeIDs - first leaf", tree->getChild(0)->getNodeID() == "0:0:=" + convertIntToStr(depth - 1), errors);
+
+  shared_ptr<TreeNode> subtree = tree->getChild(1)->getChild(1);
+  std::string subtreeID = subtree->getNodeID();
+  std::string leafID = subtree->getChild(0)->getNodeID();
+  tree.reset(); // the subtree is still held here
+  test_diagnosis("testLazyNodeIDs - subtree outlives its tree", subtree->getNodeID() == subtreeID, errors);
+  test_diagnosis("testLazyNodeIDs - below a subtree that outlives its tree", subtree->getChild(0)->getNodeID() == leafID, errors);
+
+  // appending the surviving subtree to another tree moves it there
+  shared_ptr<TreeNode> root = TreeNode::makeTree(NodeContent::makeOrNode(2));
+  root->appendChild(NodeContent::makeLeafNode(1));
+  root->appendTree(subtree);
+  test_diagnosis("testLazyNodeIDs - moved subtree", subtree->getNodeID() == "0:1", errors);
+  test_diagnosis("testLazyNodeIDs - below the moved subtree", subtree->getChild(0)->getNodeID() == "0:1:0:=" + convertIntToStr(depth - 3), errors);
+
+  // an assigned node takes the children of the other one: their IDs and the statistics follow the assigned node
+  shared_ptr<TreeNode> source = TreeNode::makeTree(NodeContent::makeAndNode(1));
+  shared_ptr<TreeNode> gate = TreeNode::makeTree(NodeContent::makeOrNode(2));
+  gate->appendChild(NodeContent::makeLeafNode(1));
+  source->appendTree(gate);
+  TreeNode assigned;
+  assigned = *source;
+  source.reset();
+  assigned.updateID("0:9", 2);
+  test_diagnosis("testLazyNodeIDs - below an assigned node", gate->getChild(0)->getNodeID() == "0:9:2:0:0:=1", errors);
+  test_diagnosis("testLazyNodeIDs - assigned node before an append", assigned.getNumLeaves() == 1, errors);
+  gate->appendChild(NodeContent::makeLeafNode(2));
+  test_diagnosis("testLazyNodeIDs - assigned node after an append", assigned.getNumLeaves() == 2, errors);
+
+  return errors;
+}
+
+bool statsAre(const TreeStats& stats, unsigned int numLeaves, unsigned int height, unsigned int numRandomness, unsigned int minSatisfyingSet,
+	       unsigned int numDistinctAttributes) {
+  return (stats.numLeaves == numLeaves) && (stats.height == height) && (stats.numRandomness == numRandomness)
+    && (stats.minSatisfyingSet == minSatisfyingSet) && (stats.numDistinctAttributes == numDistinctAttributes);
+}
+
+// the statistics must follow the tree as it grows, also when a node is appended below a subtree that is already part of the tree
+int testTreeStats() {
+  int errors = 0;
+
+  shared_ptr<TreeNode> root = TreeNode::makeTree(NodeContent::makeOrNode(2));
+  shared_ptr<TreeNode> and12 = TreeNode::makeTree(NodeContent::makeAndNode(2));
+  and12->appendChild(NodeContent::makeLeafNode(1));
+  and12->appendChild(NodeContent::makeLeafNode(2));
+  test_diagnosis("testTreeStats - AND(1,2)", statsAre(and12->getStats(), 2, 2, 1, 2, 2), errors);
+
+  root->appendTree(and12);
+  test_diagnosis("testTreeStats - OR(AND(1,2))", statsAre(root->getStats(), 2, 3, 1, 2, 2), errors);
+
+  shared_ptr<TreeNode> thr = TreeNode::makeTree(NodeContent::makeThreshNode(3, 2));
+  thr->appendChild(NodeContent::makeLeafNode(3));
+  root->appendTree(thr);
+  test_diagnosis("testTreeStats - gate with too few children is unsatisfiable", thr->getStats().minSatisfyingSet == TreeStats::UNSATISFIABLE, errors);
+  test_diagnosis("testTreeStats - OR(AND(1,2), THR(3))", statsAre(root->getStats(), 3, 3, 2, 2, 3), errors);
+
+  thr->appendChild(NodeContent::makeLeafNode(4));
+  shared_ptr<TreeNode> and156 = TreeNode::makeTree(NodeContent::makeAndNode(3));
+  thr->appendTree(and156);
+  and156->appendChild(NodeContent::makeLeafNode(1));
+  and156->appendChild(NodeContent::makeLeafNode(5));
+  and156->appendChild(NodeContent::makeLeafNode(6));
+  test_diagnosis("testTreeStats - THR(3,4,AND(1,5,6))", statsAre(thr->getStats(), 5, 3, 3, 2, 5), errors);
+  test_diagnosis("testTreeStats - whole tree", statsAre(root->getStats(), 7, 4, 4, 2, 6), errors);
+  test_diagnosis("testTreeStats - leaves", root->getNumLeaves() == 7, errors);
+
+  // a NIL child can not be satisfied, and a threshold of 2 then needs both other children
+  shared_ptr<TreeNode> withNil = TreeNode::makeTree(NodeContent::makeThreshNode(3, 2));
+  withNil->appendTree(make_shared<TreeNode>());
+  withNil->appendChild(NodeContent::makeLeafNode(7));
+  withNil->appendTree(and12);
+  test_diagnosis("testTreeStats - NIL child", statsAre(withNil->getStats(), 3, 3, 2, 3, 3), errors);
+
+  // threads that share a tree fill its caches under the lock: each one finds the statistics of the whole tree and of a subtree
+  shared_ptr<TreeNode> shared = TreeNode::makeTree(NodeContent::makeAndNode(64));
+  for (int g = 0; g < 64; g++) {
+    shared_ptr<TreeNode> gate = TreeNode::makeTree(NodeContent::makeOrNode(8));
+    for (int i = 0; i < 8; i++) {
+      gate->appendChild(NodeContent::makeLeafNode(g + i));
+    }
+    shared->appendTree(gate);
+  }
+  vector<char> agree(8, 0);
+  vector<std::thread> threads;
+  for (unsigned int t = 0; t < agree.size(); t++) {
+    threads.push_back(std::thread([&shared, &agree, t]() {
+	  agree[t] = statsAre(shared->getChild(t)->getStats(), 8, 2, 0, 1, 8) && statsAre(shared->getStats(), 512, 3, 63, 64, 71);
+	}));
+  }
+  for (unsigned int t = 0; t < threads.size(); t++) {
+    threads[t].join();
+  }
+  test_diagnosis("testTreeStats - shared between threads", std::count(agree.begin(), agree.end(), 1) == (int) agree.size(), errors);
+
+  return errors;
+}
+
+// equal trees have equal hashes wherever they are, and the hash of a tree follows the appends below it
+int testStructuralHash() {
+  int errors = 0;
+
+  // the gates have room for a fourth child, appended at the end
+  shared_ptr<TreeNode> a = TreeNode::makeTree(NodeContent::makeThreshNode(4, 2));
+  shared_ptr<TreeNode> b = TreeNode::makeTree(NodeContent::makeThreshNode(4, 2));
+  for (int i = 1; i <= 3; i++) {
+    a->appendChild(NodeContent::makeLeafNode(i));
+    b->appendChild(NodeContent::makeLeafNode(i));
+  }
+  b->updateID("0:4", 1);
+  test_diagnosis("testStructuralHash - equal trees", (a->getStructuralHash() == b->getStructuralHash()) && (*a == *b), errors);
+
+  shared_ptr<TreeNode> c = TreeNode::makeTree(NodeContent::makeThreshNode(4, 2));
+  c->appendChild(NodeContent::makeLeafNode(1));
+  c->appendChild(NodeContent::makeLeafNode(3));
+  c->appendChild(NodeContent::makeLeafNode(2));
+  test_diagnosis("testStructuralHash - children in another order", (a->getStructuralHash() != c->getStructuralHash()) && !(*a == *c), errors);
+
+  shared_ptr<TreeNode> d = TreeNode::makeTree(NodeContent::makeAndNode(3));
+  for (int i = 1; i <= 3; i++) {
+    d->appendChild(NodeContent::makeLeafNode(i));
+  }
+  test_diagnosis("testStructuralHash - other gate", a->getStructuralHash() != d->getStructuralHash(), errors);
+
+  // a subtree appended to both trees changes their hashes in the same way
+  shared_ptr<TreeNode> rootA = TreeNode::makeTree(NodeContent::makeOrNode(2));
+  shared_ptr<TreeNode> rootB = TreeNode::makeTree(NodeContent::makeOrNode(2));
+  rootA->appendTree(a);
+  rootB->appendTree(b);
+  StructuralHash before = rootA->getStructuralHash();
+  test_diagnosis("testStructuralHash - equal roots", before == rootB->getStructuralHash(), errors);
+  a->appendChild(NodeContent::makeLeafNode(4));
+  test_diagnosis("testStructuralHash - append below a subtree", rootA->getStructuralHash() != before, errors);
+  b->appendChild(NodeContent::makeLeafNode(4));
+  test_diagnosis("testStructuralHash - same appends", (rootA->getStructuralHash() == rootB->getStructuralHash()) && (*rootA == *rootB), errors);
+
+  // threads that compare two shared trees fill their hashes under the lock, as threads that ask for the statistics
+  vector<shared_ptr<TreeNode> > shared(2);
+  for (unsigned int k = 0; k < shared.size(); k++) {
+    shared[k] = TreeNode::makeTree(NodeContent::makeAndNode(64));
+    for (int g = 0; g < 64; g++) {
+      shared_ptr<TreeNode> gate = TreeNode::makeTree(NodeContent::makeOrNode(8));
+      for (int i = 0; i < 8; i++) {
+	gate->appendChild(NodeContent::makeLeafNode(g + i));
+      }
+      shared[k]->appendTree(gate);
+    }
+  }
+  vector<char> agree(8, 0);
+  vector<std::thread> threads;
+  for (unsigned int t = 0; t < agree.size(); t++) {
+    threads.push_back(std::thread([&shared, &agree, t]() {
+	  agree[t] = (*shared[0] == *shared[1]) && !(*shared[0]->getChild(t) == *shared[1]->getChild(t + 1));
+	}));
+  }
+  for (unsigned int t = 0; t < threads.size(); t++) {
+    threads[t].join();
+  }
+  test_diagnosis("testStructuralHash - shared between threads", std::count(agree.begin(), agree.end(), 1) == (int) agree.size(), errors);
+
+  return errors;
+}
+
+shared_ptr<TreeNode> makeLeaf(int value) {
+  return TreeNode::makeTree(NodeContent::makeLeafNode(value));
+}
+
+// a gate over the given children. A threshold of 0 makes an AND, and a negative one an OR
+shared_ptr<TreeNode> makeGate(int threshold, const vector<shared_ptr<TreeNode> >& children) {
+  shared_ptr<TreeNode> node;
+  if (threshold == 0) {
+    node = TreeNode::makeTree(NodeContent::makeAndNode(children.size()));
+  } else if (threshold < 0) {
+    node = TreeNode::makeTree(NodeContent::makeOrNode(children.size()));
+  } else {
+    node = TreeNode::makeTree(NodeContent::makeThreshNode(children.size(), threshold));
+  }
+  for (unsigned int i = 0; i < children.size(); i++) {
+    node->appendTree(children[i]);
+  }
+  return node;
+}
+
+shared_ptr<TreeNode> makeGate(int threshold, shared_ptr<TreeNode> a, shared_ptr<TreeNode> b, shared_ptr<TreeNode> c = shared_ptr<TreeNode>()) {
+  vector<shared_ptr<TreeNode> > children;
+  children.push_back(a);
+  children.push_back(b);
+  if (c) children.push_back(c);
+  return makeGate(threshold, children);
+}
+
+// the attributes in the set are the bits of atts
+bool satisfiedBy(shared_ptr<TreeNode> tree, unsigned int atts) {
+  if (tree->isNil()) return false;
+  if (tree->isLeaf()) return (atts >> tree->getNode()->getLeafValue()) & 1;
+  unsigned int count = 0;
+  for (unsigned int i = 0; i < tree->getNumChildren(); i++) {
+    if (satisfiedBy(tree->getChild(i), atts)) count++;
+  }
+  return count >= tree->getThreshold();
+}
+
+// both trees are satisfied by the same sets of the attributes 0 to nAtts-1
+bool sameAccessStructure(shared_ptr<TreeNode> a, shared_ptr<TreeNode> b, unsigned int nAtts) {
+  for (unsigned int atts = 0; atts < (1U << nAtts); atts++) {
+    if (satisfiedBy(a, atts) != satisfiedBy(b, atts)) return false;
+  }
+  return true;
+}
+
+shared_ptr<TreeNode> randomTree(unsigned int depth, unsigned int nAtts) {
+  unsigned int choice = rand() % 8;
+  if ((depth == 0) || (choice < 2)) return makeLeaf(rand() % nAtts);
+  if (choice == 2) return make_shared<TreeNode>();
+  vector<shared_ptr<TreeNode> > children;
+  unsigned int n = 1 + rand() % 4;
+  for (unsigned int i = 0; i < n; i++) {
+    children.push_back(randomTree(depth - 1, nAtts));
+  }
+  return makeGate((int) (rand() % (n + 2)) - 1, children);
+}
+
+int testTreeOptimizer() {
+  int errors = 0;
+  std::string base = "testTreeOptimizer - ";
+  shared_ptr<TreeNode> nil = make_shared<TreeNode>();
+
+  shared_ptr<TreeNode> nested = makeGate(0, makeGate(0, makeLeaf(1), makeLeaf(2)), makeLeaf(3));
+  test_diagnosis(base + "AND of AND", TreeOptimizer::toDescription(TreeOptimizer::optimize(nested)) == op_AND + "(1, 2, 3)", errors);
+  test_diagnosis(base + "input unchanged", nested->getNumChildren() == 2, errors);
+
+  TreeOptimizer::Report report;
+  shared_ptr<TreeNode> repeated = makeGate(-1, makeLeaf(1), makeLeaf(1), makeGate(-1, makeLeaf(2), makeLeaf(1)));
+  shared_ptr<TreeNode> result = TreeOptimizer::optimize(repeated, report);
+  test_diagnosis(base + "duplicates", (TreeOptimizer::toDescription(result) == op_OR + "(1, 2)") && (report.duplicatesDropped == 2)
+		 && (report.gatesFlattened == 1), errors);
+
+  test_diagnosis(base + "1 of n", TreeOptimizer::toDescription(TreeOptimizer::optimize(makeGate(1, makeLeaf(1), makeLeaf(2), makeLeaf(3)))) == op_OR + "(1, 2, 3)", errors);
+  test_diagnosis(base + "n of n", TreeOptimizer::toDescription(TreeOptimizer::optimize(makeGate(3, makeLeaf(1), makeLeaf(2), makeLeaf(3)))) == op_AND + "(1, 2, 3)", errors);
+  test_diagnosis(base + "threshold kept", TreeOptimizer::toDescription(TreeOptimizer::optimize(makeGate(2, makeLeaf(1), makeLeaf(1), makeLeaf(3))))
+		 == op_THR + "(2, 1, 1, 3)", errors);
+  test_diagnosis(base + "NIL in a threshold", TreeOptimizer::toDescription(TreeOptimizer::optimize(makeGate(2, nil, makeLeaf(1), makeLeaf(2)))) == op_AND + "(1, 2)", errors);
+  test_diagnosis(base + "NIL in an AND", TreeOptimizer::optimize(makeGate(0, makeLeaf(1), make_shared<TreeNode>()))->isNil(), errors);
+  result = TreeOptimizer::optimize(makeGate(-1, makeGate(0, makeLeaf(4), makeLeaf(4)), make_shared<TreeNode>()), report);
+  test_diagnosis(base + "single child", (TreeOptimizer::toDescription(result) == "4") && (report.gatesCollapsed == 2) && (result->getNodeID() == "0:=4"), errors);
+
+  // random trees keep their access structure and never grow
+  const unsigned int nAtts = 6;
+  for (int run = 0; run < 200; run++) {
+    shared_ptr<TreeNode> tree = randomTree(4, nAtts);
+    shared_ptr<TreeNode> optimized = TreeOptimizer::optimize(tree);
+    bool same = sameAccessStructure(tree, optimized, nAtts) && (optimized->getNumLeaves() <= tree->getNumLeaves());
+    test_diagnosis(base + "random tree " + tree->to_string(), same, errors);
+    test_diagnosis(base + "idempotent " + tree->to_string(), *TreeOptimizer::optimize(optimized) == *optimized, errors);
+  }
+
+  return errors;
+}
+
+// the IDs of the nodes of a tree in an arena must be the ones that TreeNode computes for the same tree
+bool sameIDs(shared_ptr<TreeNode> tree, const TreeArena& arena, unsigned int n) {
+  if (tree->getNodeID() != arena.getNodeID(n)) return false;
+  const TreeArena::Node &node = arena.getNode(n);
+  if (tree->getNumChildren() != node.numChildren) return false;
+  for (unsigned int i = 0; i < node.numChildren; i++) {
+    if (!sameIDs(tree->getChild(i), arena, arena.getChild(node, i))) return false;
+  }
+  return true;
+}
+
+int testTreeArena() {
+  int errors = 0;
+
+  // OR(8, AND(6, 2), THR(2; 1, 3, nil)) built bottom-up
+  TreeArena arena;
+  unsigned int leaf8 = arena.addLeaf(8);
+  unsigned int andChildren[] = {arena.addLeaf(6), arena.addLeaf(2)};
+  unsigned int andGate = arena.addGate(InnerNodeType::AND, 0, andChildren, 2);
+  unsigned int thrChildren[] = {arena.addLeaf(1), arena.addLeaf(3), arena.addNil()};
+  unsigned int thrGate = arena.addGate(InnerNodeType::THR, 2, thrChildren, 3);
+  unsigned int orChildren[] = {leaf8, andGate, thrGate};
+  unsigned int orGate = arena.addGate(InnerNodeType::OR, 0, orChildren, 3);
+
+  test_diagnosis("testTreeArena - root is the last node", arena.root() == orGate, errors);
+  test_diagnosis("testTreeArena - size", arena.size() == 9, errors);
+  test_diagnosis("testTreeArena - thresholds", (arena.getNode(andGate).threshold == 2) && (arena.getNode(orGate).threshold == 1), errors);
+  test_diagnosis("testTreeArena - root ID", arena.getNodeID(orGate) == "0", errors);
+  test_diagnosis("testTreeArena - leaf ID", arena.getNodeID(andChildren[1]) == "0:1:1:=2", errors);
+  test_diagnosis("testTreeArena - gate ID", arena.getNodeID(thrGate) == "0:2", errors);
+  test_diagnosis("testTreeArena - nil ID", arena.getNodeID(thrChildren[2]) == "0:2:2", errors);
+  test_diagnosis("testTreeArena - leaves", arena.getNumLeaves(orGate) == 5, errors);
+
+  shared_ptr<TreeNode> tree = arena.toTree();
+  test_diagnosis("testTreeArena - to_string", tree->to_string() == arena.to_string(orGate), errors);
+  test_diagnosis("testTreeArena - IDs of the pointer-based tree", sameIDs(tree, arena, orGate), errors);
+  test_diagnosis("testTreeArena - leaves of the pointer-based tree", tree->getNumLeaves() == 5, errors);
+
+  TreeArena copy(tree);
+  test_diagnosis("testTreeArena - round trip", copy.equal(copy.root(), arena, arena.root()) && (copy.size() == arena.size()), errors);
+  test_diagnosis("testTreeArena - subtrees differ", !arena.equal(andGate, arena, thrGate), errors);
+
+  arena.clear();
+  test_diagnosis("testTreeArena - clear", (arena.size() == 0) && arena.toTree()->isNil(), errors);
+
+  return errors;
+}
+
 int runTests() {
   int errors = 0;
 
@@ -637,6 +968,11 @@ int runTests() {
   errors += testNodeIDAfterAppends();
   errors += testUpdateID();
   errors += testNilTree();
+  errors += testLazyNodeIDs();
+  errors += testTreeArena();
+  errors += testTreeStats();
+  errors += testStructuralHash();
+  errors += testTreeOptimizer();
   
   DEBUG("Returning from runTests");
 
@@ -9,6 +9,14 @@
 #include "tree.h"
 #endif
 
+#include <algorithm>
+#include <mutex>
+
+// guards the statistics caches of every TreeNode, with their structural hashes. A tree may be shared by threads, as the parse tree of a policy is,
+// and the caches are filled from const methods, operator== among them. The lock is taken by the public methods only, so that refreshStats can recurse
+// below it
+static std::mutex statsMutex;
+
 //NodeContent::nilNode = NodeContent();
 
 NodeContent::NodeContent():
@@ -104,6 +112,25 @@ bool NodeContent::operator==(const NodeContent& rhs) const {
   return true;
 }
 
+StructuralHash NodeContent::getHash() const {
+  StructuralHash h = hashCombine(HASH_SEED, m_type);
+  switch(m_type) {
+  case(NodeContentType::inner):
+    h = hashCombine(h, m_innerNode.type);
+    h = hashCombine(h, m_innerNode.arg1);
+    if (m_innerNode.type == InnerNodeType::THR) {
+      h = hashCombine(h, m_innerNode.arg2);
+    }
+    break;
+  case(NodeContentType::leaf):
+    h = hashCombine(h, m_leafValue);
+    break;
+  case(NodeContentType::nil):
+    break;
+  }
+  return h;
+}
+
 std::string NodeContent::to_string(){
   switch(m_type) {
   case NodeContentType::leaf:
@@ -156,32 +183,30 @@ unsigned int NodeContent::getThreshold(){
 
 TreeNode::TreeNode():
   m_node(NodeContent::makeNILNode()),
-  m_nodeID("")
-  //  ,m_parent(NULL)
-{
-  m_children.clear();
-}
-
-std::string TreeNode::initNodeID(shared_ptr<NodeContent> node) {
- switch (node->getType()) {
-  case NodeContentType::nil:
-    return ""; break;
-  case NodeContentType::leaf:
-    return "0:=" + convertIntToStr(node->getLeafValue());
-    break;
-  case NodeContentType::inner:
-    return "0";
-    break;
- default: return ""; //should never reach here
-  }
- 
-}
+  m_parent(NULL),
+  m_childNo(0),
+  m_hash(0),
+  m_statsValid(false),
+  m_distinctValid(false)
+{}
 
 TreeNode::TreeNode(shared_ptr<NodeContent> node):
-  m_node(node)
-{
-  m_nodeID = initNodeID(node);
-  m_children.clear();
+  m_node(node),
+  m_parent(NULL),
+  m_childNo(0),
+  m_hash(0),
+  m_statsValid(false),
+  m_distinctValid(false)
+{}
+
+// a child that is still held elsewhere becomes a root, with the path it had below this node
+TreeNode::~TreeNode() {
+  for (unsigned int i = 0; i < m_children.size(); i++) {
+    if ((m_children[i]->m_parent == this) && (m_children[i].use_count() > 1)) {
+      m_children[i]->m_rootPath = m_children[i]->getPath();
+      m_children[i]->m_parent = NULL;
+    }
+  }
 }
 
 shared_ptr<TreeNode> TreeNode::makeTree(shared_ptr<NodeContent> node){
@@ -191,6 +216,8 @@ shared_ptr<TreeNode> TreeNode::makeTree(shared_ptr<NodeContent> node){
 }
 
 bool TreeNode::operator==(const TreeNode& rhs) const {
+  if (this == &rhs) return true;
+  if (getStructuralHash() != rhs.getStructuralHash()) return false;
   if (!(*m_node == *rhs.m_node)) return false;
   // Does not check IDs. The reason is that two subtrees of different trees might still be equal if they have the same shape and elements, but due to their
   // different positions they will have different IDs.
@@ -207,8 +234,13 @@ TreeNode& TreeNode::operator=(const TreeNode& other)
 {
   if (this == &other) return *this;
   m_node = other.m_node;
-  m_nodeID = other.m_nodeID;
-  m_children = other.m_children;  
+  m_rootPath = other.getPath();
+  m_children = other.m_children;
+  // the children are shared with other, and now name this node as their parent, as a tree appended with appendTree
+  for (unsigned int i = 0; i < m_children.size(); i++) {
+    adopt(m_children[i], i);
+  }
+  invalidateStats();
   return *this;
 }
 
@@ -257,14 +289,20 @@ std::string TreeNode::findIDForNode(const std::string& parent, int childno, Node
   return "";
 }
 
+void TreeNode::adopt(shared_ptr<TreeNode> child, int childNo) {
+  child->m_parent = this;
+  child->m_childNo = childNo;
+  child->m_rootPath.clear();
+}
+
 bool TreeNode::appendChild(shared_ptr<NodeContent> node){
   //  DEBUG("appendChild entry point");
   switch (m_node->getType()){
   case NodeContentType::nil:
      {
        //       DEBUG("nil node");
-       setNodeID(initNodeID(node));
        m_node = node;
+       invalidateStats();
      }
      break;
   case NodeContentType::leaf:
@@ -280,11 +318,8 @@ bool TreeNode::appendChild(shared_ptr<NodeContent> node){
 
        shared_ptr<TreeNode> pNode = TreeNode::makeTree(node);
        m_children.push_back(pNode);
-       int count = m_children.size()-1;
-       
-       std::string newId = findIDForNode(m_nodeID, count, node);
-       //       DEBUG("New ID: " << newId);
-       pNode->setNodeID(newId);
+       adopt(pNode, m_children.size()-1);
+       invalidateStats();
      }
      break;
    }
@@ -296,7 +331,10 @@ bool TreeNode::appendTree(shared_ptr<TreeNode> pTree){
   case NodeContentType::nil:
     m_node = pTree->m_node;
     m_children = pTree->m_children;
-    setNodeID(initNodeID(m_node));    
+    for (unsigned int i = 0; i < m_children.size(); i++) {
+      adopt(m_children[i], i);
+    }
+    invalidateStats();
     break;
   case NodeContentType::leaf:
     throw std::runtime_error("An attempt was made to append a tree to a leaf node");
@@ -305,37 +343,20 @@ bool TreeNode::appendTree(shared_ptr<TreeNode> pTree){
     if (m_children.size() == m_node->getArity()) return false;
     
     m_children.push_back(pTree);
-    pTree->updateID(getNodeID(), m_children.size()-1);
+    adopt(pTree, m_children.size()-1);
+    invalidateStats();
     break;
   }
   return true;
 }
 
 
+// Examples:
+// a tree with a leaf 0:1:=7, moved to position 3 of 0:2 ---> 0:2:3:1:=7
+// --- a rootleaf 0:=7, moved to the same position ---> 0:2:3:=7
+// The IDs of the nodes below follow, since they are derived from this one
 void TreeNode::updateID(std::string parentID, int count){
-  // this is only called after an insert. The tree on which this is called is a sub-tree of someone else.
-  // this tree might be a free hanging leaf or a whole tree
-  // in any case, the logic is the same: whatever is before the first ":" is replaced by parentID + count. There is no need to treat leaves separately
-  // Examples: 
-  // a tree with a leaf 0:1:=7 is added to a tree 0:2 at position 3. ---> 0:2:3:1:=7
-  // --- a rootleaf 0:=7 is added to the same tree and position. ---> 0:2:3:=7
-
-  std::string newID;
-  std::string currentID = getNodeID();
-  int index = currentID.find(":");
-  std::string tailID;
-  if (index == -1) {
-    tailID = "";
-  } else {
-    tailID = currentID.substr(index);
-  }
-  newID = parentID + ":" + convertIntToStr(count) + tailID;
-  //  DEBUG("Setting new ID: " << newID);
-  setNodeID(newID);
-
-  for (unsigned int i = 0; i < getNumChildren(); i++) {
-    getChild(i)->updateID(parentID, count);
-  }
+  m_rootPath = parentID + ":" + convertIntToStr(count);
 }
 
 std::string TreeNode::full_to_string() {
@@ -373,15 +394,110 @@ std::string TreeNode::to_string() {
 }
 
 unsigned int TreeNode::getNumLeaves(){
+  std::lock_guard<std::mutex> lock(statsMutex);
+  return refreshStats().numLeaves;
+}
+
+unsigned int TreeNode::getThreshold() const {
+  if (m_node->getType() != NodeContentType::inner) {
+    return 0;
+  }
+  switch (m_node->getInnerNodeType()) {
+  case InnerNodeType::OR: return 1;
+  case InnerNodeType::AND: return m_children.size();
+  default: return m_node->getThreshold();
+  }
+}
+
+// the caches are cleared up to the root: a node may have a valid count of distinct attributes while the nodes below it do not
+void TreeNode::invalidateStats() {
+  std::lock_guard<std::mutex> lock(statsMutex);
+  for (TreeNode *node = this; node != NULL; node = node->m_parent) {
+    node->m_statsValid = false;
+    node->m_distinctValid = false;
+  }
+}
+
+// the smallest satisfying set of a gate takes the smallest sets of threshold of its children
+const TreeStats& TreeNode::refreshStats() const {
+  if (m_statsValid) {
+    return m_stats;
+  }
+  TreeStats stats;
+  stats.numLeaves = 0;
+  stats.height = 0;
+  stats.numRandomness = 0;
+  stats.minSatisfyingSet = TreeStats::UNSATISFIABLE;
+  stats.numDistinctAttributes = 0; // left to getStats
+  StructuralHash hash = hashCombine(m_node->getHash(), m_children.size());
+  switch (m_node->getType()) {
+  case NodeContentType::nil:
+    break;
+  case NodeContentType::leaf:
+    stats.numLeaves = 1;
+    stats.height = 1;
+    stats.minSatisfyingSet = 1;
+    break;
+  case NodeContentType::inner:
+    {
+      unsigned int threshold = getThreshold();
+      vector<unsigned int> childSets;
+      for (unsigned int i = 0; i < m_children.size(); i++) {
+	const TreeStats &child = m_children[i]->refreshStats();
+	hash = hashCombine(hash, m_children[i]->m_hash);
+	stats.numLeaves += child.numLeaves;
+	stats.height = std::max(stats.height, child.height);
+	stats.numRandomness += child.numRandomness;
+	if (child.minSatisfyingSet != TreeStats::UNSATISFIABLE) {
+	  childSets.push_back(child.minSatisfyingSet);
+	}
+      }
+      stats.height++;
+      if (threshold > 0) {
+	stats.numRandomness += threshold - 1;
+      }
+      if (childSets.size() >= threshold) {
+	std::partial_sort(childSets.begin(), childSets.begin() + threshold, childSets.end());
+	stats.minSatisfyingSet = 0;
+	for (unsigned int i = 0; i < threshold; i++) {
+	  stats.minSatisfyingSet += childSets[i];
+	}
+      }
+    }
+    break;
+  }
+  m_stats = stats;
+  m_hash = hash;
+  m_statsValid = true;
+  return m_stats;
+}
+
+void TreeNode::collectAttributes(vector<int>& atts) const {
   if (m_node->getType() == NodeContentType::leaf) {
-    return 1;
+    atts.push_back(m_node->getLeafValue());
   }
-  int nleaves = 0;
   for (unsigned int i = 0; i < m_children.size(); i++) {
-    int subleaves = getChild(i)->getNumLeaves();
-    nleaves += subleaves;
+    m_children[i]->collectAttributes(atts);
   }
-  return nleaves;
+}
+
+StructuralHash TreeNode::getStructuralHash() const {
+  std::lock_guard<std::mutex> lock(statsMutex);
+  refreshStats();
+  return m_hash;
+}
+
+const TreeStats& TreeNode::getStats() const {
+  std::lock_guard<std::mutex> lock(statsMutex);
+  refreshStats();
+  if (!m_distinctValid) {
+    vector<int> atts;
+    collectAttributes(atts);
+    std::sort(atts.begin(), atts.end());
+    m_stats.numDistinctAttributes = std::unique(atts.begin(), atts.end()) - atts.begin();
+    m_distinctValid = true;
+  }
+  return m_stats;
 }
 
 
@@ -390,12 +506,31 @@ unsigned int TreeNode::getNumChildren(){
 }
 
 
-std::string TreeNode::getNodeID() const{
-  return m_nodeID;
+// the child numbers are collected from the node up to its root, and written from the root down
+std::string TreeNode::getPath() const {
+  vector<int> childNos;
+  const TreeNode *node = this;
+  for (; node->m_rootPath.empty() && (node->m_parent != NULL); node = node->m_parent) {
+    childNos.push_back(node->m_childNo);
+  }
+  stringstream ss;
+  ss << (node->m_rootPath.empty() ? "0" : node->m_rootPath);
+  for (int i = childNos.size() - 1; i >= 0; i--) {
+    ss << ":" << childNos[i];
+  }
+  return ss.str();
 }
 
-void TreeNode::setNodeID(const std::string nodeID){
-  m_nodeID = nodeID;
+// a NIL node has no ID at the root of a tree, and the path of its position below a gate
+std::string TreeNode::getNodeID() const{
+  switch (m_node->getType()) {
+  case NodeContentType::nil:
+    return ((m_parent == NULL) && m_rootPath.empty()) ? "" : getPath();
+  case NodeContentType::leaf:
+    return getPath() + ":=" + convertIntToStr(m_node->getLeafValue());
+  default:
+    return getPath();
+  }
 }
 
 bool TreeNode::isLeaf() {
@@ -409,3 +544,331 @@ bool TreeNode::isInner() {
 bool TreeNode::isNil() {
   return (m_node->getType() == NodeContentType::nil);
 }
+
+//===================================================
+
+TreeArena::TreeArena()
+{}
+
+TreeArena::TreeArena(shared_ptr<TreeNode> tree)
+{
+  if (tree) {
+    addFromTree(tree);
+  }
+}
+
+unsigned int TreeArena::addFromTree(shared_ptr<TreeNode> tree) {
+  shared_ptr<NodeContent> content = tree->getNode();
+  switch (content->getType()) {
+  case NodeContentType::leaf:
+    return addLeaf(content->getLeafValue());
+  case NodeContentType::inner:
+    {
+      vector<unsigned int> children;
+      for (unsigned int i = 0; i < tree->getNumChildren(); i++) {
+	children.push_back(addFromTree(tree->getChild(i)));
+      }
+      InnerNodeType type = content->getInnerNodeType();
+      int threshold = (type == InnerNodeType::THR) ? (int) content->getThreshold() : 0;
+      unsigned int n = addGate(type, threshold, children.empty() ? NULL : &children[0], children.size());
+      m_nodes[n].arity = content->getArity(); // an incomplete gate keeps the arity it was declared with
+      return n;
+    }
+  default:
+    return addNil();
+  }
+}
+
+void TreeArena::reserve(unsigned int nodes) {
+  m_nodes.reserve(nodes);
+  m_children.reserve(nodes);
+}
+
+void TreeArena::clear() {
+  m_nodes.clear();
+  m_children.clear();
+}
+
+unsigned int TreeArena::add(const Node& node) {
+  m_nodes.push_back(node);
+  return m_nodes.size() - 1;
+}
+
+unsigned int TreeArena::addNil() {
+  Node node;
+  node.type = NodeContentType::nil;
+  node.gateType = InnerNodeType::OR;
+  node.arity = 0;
+  node.threshold = 0;
+  node.leafValue = 0;
+  node.firstChild = 0;
+  node.numChildren = 0;
+  node.parent = -1;
+  node.childNo = 0;
+  return add(node);
+}
+
+unsigned int TreeArena::addLeaf(int leafValue) {
+  unsigned int n = addNil();
+  m_nodes[n].type = NodeContentType::leaf;
+  m_nodes[n].leafValue = leafValue;
+  return n;
+}
+
+unsigned int TreeArena::addGate(InnerNodeType gateType, int threshold, const unsigned int* children, unsigned int numChildren) {
+  unsigned int n = addNil();
+  Node &node = m_nodes[n];
+  node.type = NodeContentType::inner;
+  node.gateType = gateType;
+  node.arity = numChildren;
+  switch (gateType) {
+  case InnerNodeType::OR: node.threshold = 1; break;
+  case InnerNodeType::AND: node.threshold = numChildren; break;
+  case InnerNodeType::THR: node.threshold = threshold; break;
+  }
+  node.firstChild = m_children.size();
+  node.numChildren = numChildren;
+  for (unsigned int i = 0; i < numChildren; i++) {
+    guard("TreeArena: a child must be added before its gate, and belong to a single gate", (children[i] < n) && (m_nodes[children[i]].parent < 0));
+    m_children.push_back(children[i]);
+    m_nodes[children[i]].parent = n;
+    m_nodes[children[i]].childNo = i;
+  }
+  return n;
+}
+
+// the ID of a node is the ID of its parent followed by its child number, and ends with the value of the leaf for leaves.
+// A node without a parent is the root of its tree, numbered 0. As with appendTree, a NIL node only has an ID below a gate
+std::string TreeArena::getNodeID(unsigned int n) const {
+  const Node &node = m_nodes[n];
+  if ((node.type == NodeContentType::nil) && (node.parent < 0)) {
+    return "";
+  }
+  vector<int> path;
+  for (int m = n; m_nodes[m].parent >= 0; m = m_nodes[m].parent) {
+    path.push_back(m_nodes[m].childNo);
+  }
+  stringstream ss;
+  ss << "0";
+  for (int i = path.size() - 1; i >= 0; i--) {
+    ss << ":" << path[i];
+  }
+  if (node.type == NodeContentType::leaf) {
+    ss << ":=" << node.leafValue;
+  }
+  return ss.str();
+}
+
+unsigned int TreeArena::getNumLeaves(unsigned int n) const {
+  const Node &node = m_nodes[n];
+  if (node.type == NodeContentType::leaf) {
+    return 1;
+  }
+  unsigned int nleaves = 0;
+  for (unsigned int i = 0; i < node.numChildren; i++) {
+    nleaves += getNumLeaves(getChild(node, i));
+  }
+  return nleaves;
+}
+
+std::string TreeArena::to_string(unsigned int n) const {
+  const Node &node = m_nodes[n];
+  std::string text;
+  switch (node.type) {
+  case NodeContentType::nil: text = "nil"; break;
+  case NodeContentType::leaf: text = convertIntToStr(node.leafValue); break;
+  case NodeContentType::inner:
+    switch (node.gateType) {
+    case InnerNodeType::OR: text = "OR[" + convertIntToStr(node.arity) + "]"; break;
+    case InnerNodeType::AND: text = "AND[" + convertIntToStr(node.arity) + "]"; break;
+    case InnerNodeType::THR: text = "THR[" + convertIntToStr(node.arity) + "," + convertIntToStr(node.threshold) + "]"; break;
+    }
+    break;
+  }
+  if (node.numChildren == 0) {
+    return text;
+  }
+  text += "(";
+  for (unsigned int i = 0; i < node.numChildren; i++) {
+    text += to_string(getChild(node, i));
+    if (i < node.numChildren - 1) {
+      text += ", ";
+    }
+  }
+  return text + ")";
+}
+
+bool TreeArena::equal(unsigned int n, const TreeArena& other, unsigned int m) const {
+  const Node &a = m_nodes[n];
+  const Node &b = other.m_nodes[m];
+  if (a.type != b.type) return false;
+  switch (a.type) {
+  case NodeContentType::nil:
+    return true;
+  case NodeContentType::leaf:
+    return a.leafValue == b.leafValue;
+  case NodeContentType::inner:
+    if ((a.gateType != b.gateType) || (a.arity != b.arity)) return false;
+    if ((a.gateType == InnerNodeType::THR) && (a.threshold != b.threshold)) return false;
+    break;
+  }
+  if (a.numChildren != b.numChildren) return false;
+  for (unsigned int i = 0; i < a.numChildren; i++) {
+    if (!equal(getChild(a, i), other, other.getChild(b, i))) return false;
+  }
+  return true;
+}
+
+shared_ptr<TreeNode> TreeArena::toTree(unsigned int n) const {
+  const Node &node = m_nodes[n];
+  switch (node.type) {
+  case NodeContentType::leaf:
+    return TreeNode::makeTree(NodeContent::makeLeafNode(node.leafValue));
+  case NodeContentType::inner:
+    {
+      shared_ptr<NodeContent> content;
+      switch (node.gateType) {
+      case InnerNodeType::OR: content = NodeContent::makeOrNode(node.arity); break;
+      case InnerNodeType::AND: content = NodeContent::makeAndNode(node.arity); break;
+      case InnerNodeType::THR: content = NodeContent::makeThreshNode(node.arity, node.threshold); break;
+      }
+      shared_ptr<TreeNode> tree = TreeNode::makeTree(content);
+      for (unsigned int i = 0; i < node.numChildren; i++) {
+	tree->appendTree(toTree(getChild(node, i)));
+      }
+      return tree;
+    }
+  default:
+    return make_shared<TreeNode>();
+  }
+}
+
+shared_ptr<TreeNode> TreeArena::toTree() const {
+  if (m_nodes.empty()) {
+    return make_shared<TreeNode>();
+  }
+  return toTree(root());
+}
+
+//===================================================
+
+shared_ptr<TreeNode> TreeOptimizer::optimize(shared_ptr<TreeNode> tree) {
+  Report report;
+  return optimize(tree, report);
+}
+
+shared_ptr<TreeNode> TreeOptimizer::optimize(shared_ptr<TreeNode> tree, Report& report) {
+  report.nilsDropped = 0;
+  report.thresholdsRewritten = 0;
+  report.gatesFlattened = 0;
+  report.duplicatesDropped = 0;
+  report.gatesCollapsed = 0;
+  shared_ptr<TreeNode> result = optimizeNode(tree, report);
+  // a collapsed gate may leave as the result a node that was a child of a discarded copy
+  result->m_parent = NULL;
+  result->m_rootPath.clear();
+  return result;
+}
+
+// the children are optimized first, so that what they are after their own rewriting decides the rules that apply to the gate
+shared_ptr<TreeNode> TreeOptimizer::optimizeNode(shared_ptr<TreeNode> node, Report& report) {
+  switch (node->getNode()->getType()) {
+  case NodeContentType::nil:
+    return make_shared<TreeNode>();
+  case NodeContentType::leaf:
+    return TreeNode::makeTree(NodeContent::makeLeafNode(node->getNode()->getLeafValue()));
+  case NodeContentType::inner:
+    break;
+  }
+
+  unsigned int threshold = node->getThreshold();
+  InnerNodeType original = node->getNode()->getInnerNodeType();
+  vector<shared_ptr<TreeNode> > children;
+  for (unsigned int i = 0; i < node->getNumChildren(); i++) {
+    shared_ptr<TreeNode> child = optimizeNode(node->getChild(i), report);
+    if (child->isNil()) {
+      report.nilsDropped++;
+    } else {
+      children.push_back(child);
+    }
+  }
+  if (threshold > children.size()) {
+    return make_shared<TreeNode>();
+  }
+
+  InnerNodeType type = InnerNodeType::THR;
+  if (threshold == 1) {
+    type = InnerNodeType::OR;
+  } else if ((threshold == children.size()) && (threshold > 0)) {
+    type = InnerNodeType::AND;
+  }
+  if ((original == InnerNodeType::THR) && (type != InnerNodeType::THR)) {
+    report.thresholdsRewritten++;
+  }
+
+  if (type != InnerNodeType::THR) {
+    vector<shared_ptr<TreeNode> > flat;
+    for (unsigned int i = 0; i < children.size(); i++) {
+      shared_ptr<TreeNode> child = children[i];
+      if (child->isInner() && (child->getNode()->getInnerNodeType() == type)) {
+	report.gatesFlattened++;
+	addVector(flat, child->m_children);
+      } else {
+	flat.push_back(child);
+      }
+    }
+    children.clear();
+    for (unsigned int i = 0; i < flat.size(); i++) {
+      bool repeated = false;
+      for (unsigned int j = 0; (j < children.size()) && !repeated; j++) {
+	repeated = (*children[j] == *flat[i]);
+      }
+      if (repeated) {
+	report.duplicatesDropped++;
+      } else {
+	children.push_back(flat[i]);
+      }
+    }
+  }
+
+  if ((children.size() == 1) && (type != InnerNodeType::THR)) {
+    report.gatesCollapsed++;
+    return children[0];
+  }
+
+  shared_ptr<TreeNode> gate;
+  switch (type) {
+  case InnerNodeType::OR: gate = TreeNode::makeTree(NodeContent::makeOrNode(children.size())); break;
+  case InnerNodeType::AND: gate = TreeNode::makeTree(NodeContent::makeAndNode(children.size())); break;
+  case InnerNodeType::THR: gate = TreeNode::makeTree(NodeContent::makeThreshNode(children.size(), threshold)); break;
+  }
+  for (unsigned int i = 0; i < children.size(); i++) {
+    gate->appendTree(children[i]);
+  }
+  return gate;
+}
+
+std::string TreeOptimizer::toDescription(shared_ptr<TreeNode> tree) {
+  switch (tree->getNode()->getType()) {
+  case NodeContentType::nil:
+    return "";
+  case NodeContentType::leaf:
+    return convertIntToStr(tree->getNode()->getLeafValue());
+  case NodeContentType::inner:
+    break;
+  }
+  stringstream ss;
+  switch (tree->getNode()->getInnerNodeType()) {
+  case InnerNodeType::OR: ss << op_OR << "("; break;
+  case InnerNodeType::AND: ss << op_AND << "("; break;
+  case InnerNodeType::THR: ss << op_THR << "(" << tree->getThreshold() << ", "; break;
+  }
+  for (unsigned int i = 0; i < tree->getNumChildren(); i++) {
+    ss << toDescription(tree->getChild(i));
+    if (i < tree->getNumChildren() - 1) {
+      ss << ", ";
+    }
+  }
+  ss << ")";
+  return ss.str();
+}
@@ -5,6 +5,9 @@
   This file declares the classes necessary to implement a tree data structure specific for the secret sharing.
   The basic class is TreeNode, which defines the framework for the interaction between nodes of the tree.
   The actual data of the tree is held in tree nodes, which are implemented by the class NodeContent.
+  TreeArena holds a whole tree in two arrays, for the code that builds and walks many trees, such as the parser of the policies. TreeNode is kept as the
+  pointer-based form of a tree, and an arena converts to and from it.
+  TreeOptimizer rewrites a tree into a smaller one with the same access structure.
 */
 
 #define DEF_TREE
@@ -42,6 +45,7 @@ class NodeContent {
   static std::shared_ptr<NodeContent> makeLeafNode(int leafValue);
 
   bool operator==(const NodeContent& rhs) const;
+  StructuralHash getHash() const; // equal contents, in the sense of operator==, have equal hashes
 
   NodeContentType getType();
   int getLeafValue();
@@ -55,37 +59,168 @@ class NodeContent {
 
 //===========================================
 
+/*
+  Node IDs give the path from the root to a node, as in "0:2:1:=4". They are not stored: each node knows the node above it and its position there, and
+  the ID is built from them when it is asked for. Appending a subtree is then constant work, however deep the subtree is.
+  A node without a node above it is a root, whose path is "0" unless updateID moved it. A subtree that outlives the tree above it keeps the ID it had.
+
+  Each node also caches statistics of its subtree (TreeStats), computed the first time they are asked for. Appending below a node clears the cache of
+  the node and of every node above it, so the statistics are always those of the current tree. Except for the number of distinct attributes, the
+  statistics of a node come from those of its children, and a tree that is asked again costs nothing. One lock guards the caches of all trees, so that
+  threads may ask for the statistics of a shared tree; the statistics are returned by reference, and stay valid while the tree is not changed.
+  The structural hash of a subtree is kept with the statistics, from the hash of the content of the node and those of its children, in order. Comparison
+  looks at the hashes first, so trees that differ are usually told apart without walking them.
+*/
+struct TreeStats {
+  static const unsigned int UNSATISFIABLE = ~0U;
+
+  unsigned int numLeaves;
+  unsigned int height; // the number of levels from the node to its deepest leaf: 1 for a leaf, 0 for a NIL node
+  unsigned int numRandomness; // the random values taken by distribution: threshold - 1 for each gate
+  unsigned int minSatisfyingSet; // the fewest leaves that satisfy the subtree, or UNSATISFIABLE
+  unsigned int numDistinctAttributes;
+};
+
 class TreeNode {
   std::shared_ptr<NodeContent> m_node;
-  std::string m_nodeID;
-  // m_parent;
+  TreeNode* m_parent; // the node that holds this one among its children. It owns this node, so it is a plain pointer. NULL for a root
+  int m_childNo; // the position of the node among the children of m_parent
+  std::string m_rootPath; // the path of the node, when updateID gave it one or it has no parent. Empty to derive it from the parent
   vector<std::shared_ptr<TreeNode> > m_children; // vector of pointers for TreeNodes.
+  mutable TreeStats m_stats;
+  mutable StructuralHash m_hash;
+  mutable bool m_statsValid; // the statistics and the hash, derived from the children
+  mutable bool m_distinctValid; // the number of distinct attributes
 
   TreeNode(std::shared_ptr<NodeContent> node);
-  std::string initNodeID(shared_ptr<NodeContent> node);
+  void adopt(std::shared_ptr<TreeNode> child, int childNo);
+  std::string getPath() const;
+  void invalidateStats();
+  const TreeStats& refreshStats() const; // the statistics other than the number of distinct attributes, and the hash
+  void collectAttributes(vector<int>& atts) const;
 
  public:
 
 
   TreeNode();
+  ~TreeNode();
   static std::shared_ptr<TreeNode> makeTree(std::shared_ptr<NodeContent> node);
   std::shared_ptr<NodeContent> getNode();
   std::shared_ptr<TreeNode> getChild(unsigned int i);
   bool operator==(const TreeNode& rhs) const;
-  TreeNode& operator=(const TreeNode& rhs);
+  TreeNode& operator=(const TreeNode& rhs); // the children of rhs are shared, and take this node as their parent
   bool appendChild(std::shared_ptr<NodeContent> node);
   bool appendTree(std::shared_ptr<TreeNode> tree);
   std::string full_to_string();
   std::string to_string();
   unsigned int getNumLeaves();
+  const TreeStats& getStats() const;
+  StructuralHash getStructuralHash() const; // does not depend on the IDs, as operator==
+  unsigned int getThreshold() const; // the number of children a gate needs: 1 for OR, every child for AND. 0 for other nodes
   unsigned int getNumChildren();
-  void updateID(std::string parentID, int count);
+  void updateID(std::string parentID, int count); // makes the node the root of a subtree at position count below parentID
   std::string getNodeID() const;
-  void setNodeID(std::string nodeID);
   bool isLeaf();
   bool isInner();
   bool isNil();
   static std::string findIDForNode(const std::string& parent, int childno, shared_ptr<NodeContent> node);
   static std::string findIDForNode(const std::string& parent, int childno, NodeContentType type, const std::string& value = "");
+
+  friend class TreeOptimizer;
 };
 
+//===========================================
+
+/*
+  A tree in one pool of nodes. Nodes are added bottom-up: a gate is added after its children, and takes them as a list of positions, so a tree built by a
+  recursive descent is in post-order and its root is the last node. The children of the gates are kept in a second array, where each gate has a range.
+  Nodes hold their content by value and no pointers, so building a tree costs two growing arrays instead of several allocations per node, and clearing
+  or destroying the arena releases the whole tree at once.
+  Node IDs are not stored: they are derived from the parent of each node and its position among the children of the parent, in the format of TreeNode.
+*/
+class TreeArena {
+ public:
+  struct Node {
+    NodeContentType type;
+    InnerNodeType gateType; // inner nodes
+    int arity; // inner nodes
+    int threshold; // inner nodes: only meaningful for THR. OR and AND have 1 and the arity
+    int leafValue; // leaves
+    unsigned int firstChild; // inner nodes: the children are m_children[firstChild] to m_children[firstChild + numChildren - 1]
+    unsigned int numChildren;
+    int parent; // -1 for a node that is not the child of any other
+    int childNo; // the position of the node among the children of its parent
+  };
+
+ private:
+  vector<Node> m_nodes;
+  vector<unsigned int> m_children;
+
+  unsigned int add(const Node& node);
+  unsigned int addFromTree(std::shared_ptr<TreeNode> tree);
+
+ public:
+  TreeArena();
+  explicit TreeArena(std::shared_ptr<TreeNode> tree); // copies a pointer-based tree
+  void reserve(unsigned int nodes);
+  void clear(); // keeps the capacity, for the next tree
+
+  unsigned int addNil();
+  unsigned int addLeaf(int leafValue);
+  // the children must already be in the arena, and must not be children of another gate. Returns the position of the gate
+  unsigned int addGate(InnerNodeType gateType, int threshold, const unsigned int* children, unsigned int numChildren);
+
+  inline unsigned int size() const {
+    return m_nodes.size();
+  }
+  inline unsigned int root() const { // the last node added. Only valid if the arena is not empty
+    return m_nodes.size() - 1;
+  }
+  inline const Node& getNode(unsigned int n) const {
+    return m_nodes[n];
+  }
+  inline unsigned int getChild(const Node& gate, unsigned int i) const {
+    return m_children[gate.firstChild + i];
+  }
+
+  std::string getNodeID(unsigned int n) const;
+  unsigned int getNumLeaves(unsigned int n) const;
+  std::string to_string(unsigned int n) const; // the same text as TreeNode::to_string
+  bool equal(unsigned int n, const TreeArena& other, unsigned int m) const; // compares the subtrees at n and at m of other, as TreeNode::operator==
+  std::shared_ptr<TreeNode> toTree(unsigned int n) const; // builds the pointer-based form of the subtree at n
+  std::shared_ptr<TreeNode> toTree() const; // the pointer-based form of the tree at the root. A NIL node for an empty arena
+};
+
+//===========================================
+
+/*
+  Rewrites a policy tree into a smaller one that is satisfied by exactly the same sets of attributes. Each rule is an identity of monotone formulas,
+  applied bottom-up, so the result is equivalent to the input by construction:
+  - a NIL child can never be satisfied: it is dropped from its gate, which keeps its threshold. A gate that can no longer reach its threshold is NIL
+  - a threshold of 1 is an OR and a threshold equal to the number of children is an AND
+  - an OR child of an OR, or an AND child of an AND, is replaced by its children
+  - AND and OR keep one copy of children that are equal. Threshold gates count their children, so their copies stay
+  - a gate with a single child is replaced by the child
+  Every attribute that has a leaf in a satisfiable part of the input still has at least one leaf in the result, so the covered fragments of a ciphertext
+  are found as before. Only the number and position of the shares change, so a key must be generated from the optimized tree.
+  The input is not changed.
+*/
+class TreeOptimizer {
+ public:
+  struct Report { // the number of times each rule was applied
+    unsigned int nilsDropped;
+    unsigned int thresholdsRewritten;
+    unsigned int gatesFlattened;
+    unsigned int duplicatesDropped;
+    unsigned int gatesCollapsed;
+  };
+
+ private:
+  static std::shared_ptr<TreeNode> optimizeNode(std::shared_ptr<TreeNode> node, Report& report);
+
+ public:
+  static std::shared_ptr<TreeNode> optimize(std::shared_ptr<TreeNode> tree);
+  static std::shared_ptr<TreeNode> optimize(std::shared_ptr<TreeNode> tree, Report& report);
+  // the tree in the policy language of the parsers, with the operators op_OR, op_AND and op_THR. A NIL node is an empty description
+  static std::string toDescription(std::shared_ptr<TreeNode> tree);
+};
@@ -8,6 +8,10 @@
 #include "utils.h"
 #endif
 
+#include <cctype>
+#include <climits>
+#include <algorithm>
+
 
 void print_test_result(int result, const string& name){
   if (result == 0) {
@@ -145,3 +149,225 @@ bool isSuffix(std::string& s1, std::string& s2) {
   }
   return true;
 }
+
+// the mixing function is the finalizer of splitmix64, applied to the hash and the value folded together
+StructuralHash hashCombine(StructuralHash h, unsigned long long value) {
+  unsigned long long x = h ^ (value + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+//==============================================
+
+PolicyParser::PolicyParser(const std::string& expr):
+  m_expr(expr), m_pos(0)
+{}
+
+size_t PolicyParser::position() const {
+  return m_pos;
+}
+
+bool PolicyParser::atEnd() {
+  while ((m_pos < m_expr.length()) && isspace((unsigned char) m_expr[m_pos])) m_pos++;
+  return m_pos == m_expr.length();
+}
+
+bool PolicyParser::peek(char c) {
+  return !atEnd() && (m_expr[m_pos] == c);
+}
+
+bool PolicyParser::accept(char c) {
+  if (!peek(c)) return false;
+  m_pos++;
+  return true;
+}
+
+void PolicyParser::expect(char c) {
+  if (!accept(c)) {
+    fail(std::string("expected [ ") + c + " ]");
+  }
+}
+
+bool PolicyParser::peekInteger() {
+  if (atEnd()) return false;
+  size_t p = m_pos;
+  if ((m_expr[p] == '-') || (m_expr[p] == '+')) p++;
+  return (p < m_expr.length()) && isdigit((unsigned char) m_expr[p]);
+}
+
+int PolicyParser::parseInteger() {
+  if (!peekInteger()) {
+    fail("expected an integer");
+  }
+  size_t start = m_pos;
+  bool negative = (m_expr[m_pos] == '-');
+  if ((m_expr[m_pos] == '-') || (m_expr[m_pos] == '+')) m_pos++;
+  long long value = 0;
+  while ((m_pos < m_expr.length()) && isdigit((unsigned char) m_expr[m_pos])) {
+    value = 10 * value + (m_expr[m_pos] - '0');
+    if (value > (long long) INT_MAX + 1) {
+      fail("integer out of range", start);
+    }
+    m_pos++;
+  }
+  if (negative) value = -value;
+  if (value > INT_MAX) {
+    fail("integer out of range", start);
+  }
+  // an integer glued to letters (1a) is not a literal
+  if ((m_pos < m_expr.length()) && isalpha((unsigned char) m_expr[m_pos])) {
+    fail("literals must be integers", start);
+  }
+  return (int) value;
+}
+
+bool PolicyParser::acceptOperator(const std::string& op) {
+  if (atEnd() || (m_expr.compare(m_pos, op.length(), op) != 0)) return false;
+  size_t next = m_pos + op.length();
+  if ((next < m_expr.length()) && isalnum((unsigned char) m_expr[next])) return false; // op is only a prefix of a longer word
+  m_pos = next;
+  return true;
+}
+
+std::string PolicyParser::nextWord() {
+  atEnd();
+  size_t end = m_pos;
+  while ((end < m_expr.length()) && isalnum((unsigned char) m_expr[end])) end++;
+  return m_expr.substr(m_pos, end - m_pos);
+}
+
+void PolicyParser::expectEnd() {
+  if (!atEnd()) {
+    fail("there is content beyond the end of the expression");
+  }
+}
+
+void PolicyParser::fail(const std::string& message) const {
+  fail(message, m_pos);
+}
+
+void PolicyParser::fail(const std::string& message, size_t pos) const {
+  stringstream ss;
+  ss << ERR_BAD_POLICY << ": Could not parse policy: " << message << " at position " << pos << ": [" << m_expr.substr(0, pos) << " <*> "
+     << m_expr.substr(std::min(pos, m_expr.length())) << "]" << std::endl;
+  throw std::runtime_error(ss.str());
+}
+
+//==============================================
+
+BinaryWriter::BinaryWriter(vector<char>& out):
+  m_out(out)
+{}
+
+void BinaryWriter::putByte(unsigned char b) {
+  m_out.push_back((char) b);
+}
+
+void BinaryWriter::putUInt(unsigned int n) {
+  for (int shift = 0; shift < 32; shift += 8) {
+    m_out.push_back((char) ((n >> shift) & 0xFF));
+  }
+}
+
+void BinaryWriter::putInt(int n) {
+  putUInt((unsigned int) n);
+}
+
+void BinaryWriter::putString(const std::string& s) {
+  putUInt(s.length());
+  m_out.insert(m_out.end(), s.begin(), s.end());
+}
+
+void BinaryWriter::putUInts(const vector<unsigned int>& v) {
+  putUInt(v.size());
+  m_out.reserve(m_out.size() + 4 * v.size());
+  for (unsigned int i = 0; i < v.size(); i++) {
+    putUInt(v[i]);
+  }
+}
+
+void BinaryWriter::putInts(const vector<int>& v) {
+  putUInt(v.size());
+  m_out.reserve(m_out.size() + 4 * v.size());
+  for (unsigned int i = 0; i < v.size(); i++) {
+    putInt(v[i]);
+  }
+}
+
+//==============================================
+
+BinaryReader::BinaryReader(const vector<char>& in):
+  m_in(in), m_pos(0)
+{}
+
+void BinaryReader::require(size_t n) const {
+  if (m_in.size() - m_pos < n) {
+    fail("unexpected end of input");
+  }
+}
+
+bool BinaryReader::atEnd() const {
+  return m_pos == m_in.size();
+}
+
+unsigned char BinaryReader::getByte() {
+  require(1);
+  return (unsigned char) m_in[m_pos++];
+}
+
+unsigned int BinaryReader::getUInt() {
+  require(4);
+  unsigned int n = 0;
+  for (int shift = 0; shift < 32; shift += 8) {
+    n |= ((unsigned int) (unsigned char) m_in[m_pos++]) << shift;
+  }
+  return n;
+}
+
+unsigned int BinaryReader::getUInt(unsigned int bound) {
+  unsigned int n = getUInt();
+  if (n >= bound) {
+    fail("value " + std::to_string(n) + " out of range");
+  }
+  return n;
+}
+
+int BinaryReader::getInt() {
+  return (int) getUInt();
+}
+
+std::string BinaryReader::getString() {
+  unsigned int n = getUInt();
+  require(n);
+  std::string s(m_in.begin() + m_pos, m_in.begin() + m_pos + n);
+  m_pos += n;
+  return s;
+}
+
+void BinaryReader::getUInts(vector<unsigned int>& v) {
+  unsigned int n = getUInt();
+  require(4 * (size_t) n); // checked before resizing, so that a corrupt size does not allocate
+  v.resize(n);
+  for (unsigned int i = 0; i < n; i++) {
+    v[i] = getUInt();
+  }
+}
+
+void BinaryReader::getInts(vector<int>& v) {
+  unsigned int n = getUInt();
+  require(4 * (size_t) n);
+  v.resize(n);
+  for (unsigned int i = 0; i < n; i++) {
+    v[i] = getInt();
+  }
+}
+
+void BinaryReader::fail(const std::string& message) const {
+  stringstream ss;
+  ss << ERR_BAD_SERIAL << ": " << message << " at byte " << m_pos << " of " << m_in.size() << std::endl;
+  throw std::runtime_error(ss.str());
+}
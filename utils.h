@@ -59,6 +59,7 @@
 #define ERR_BAD_TREE "BAD_TREE"
 #define ERR_CONVERSION "ERR_CONV"
 #define ERR_BAD_SHARE "BAD_SHARE"
+#define ERR_BAD_SERIAL "BAD_SERIAL"
 
 const std::string op_OR = "OR";
 const std::string op_AND = "AND";
@@ -82,4 +83,76 @@ void exprTokenize(const std::string &expr, vector<std::string> &tokens, const st
 std::string trim(std::string s);
 bool isSuffix(std::string& s1, std::string& s2);
 
+/*
+  Structural hashes of policies. A hash starts at HASH_SEED and takes the values that describe a structure one at a time, each one mixed into all the
+  bits of the hash, so that equal structures have equal hashes. Different hashes prove two structures different at the cost of one comparison; equal
+  hashes still need the full comparison, to rule out a collision.
+*/
+typedef unsigned long long StructuralHash;
+const StructuralHash HASH_SEED = 0x9e3779b97f4a7c15ULL;
+StructuralHash hashCombine(StructuralHash h, unsigned long long value);
+
 
+
+/*
+  A cursor over a policy description, for the recursive-descent parsers of the policies. The grammar shared by the policies is
+     expr := <empty> | integer | operator "(" expr { "," expr } ")"
+  with white space allowed between any two tokens. The parser walks the description once, in place: nothing is copied, and each policy builds its
+  structure while it descends. Errors throw a runtime_error with ERR_BAD_POLICY, and give the position at which the description stopped making sense.
+*/
+class PolicyParser {
+  const std::string& m_expr;
+  size_t m_pos;
+
+ public:
+  PolicyParser(const std::string& expr);
+  size_t position() const; // the position of the next token
+  bool atEnd(); // true if only white space remains
+  bool peek(char c); // true if the next token is the character c
+  bool accept(char c); // consumes the character c, if it is the next token
+  void expect(char c); // consumes the character c, or fails
+  bool peekInteger(); // true if the next token is an integer
+  int parseInteger();
+  bool acceptOperator(const std::string& op); // consumes the operator op, if it is the next token. It must be followed by "("
+  std::string nextWord(); // the next run of letters and digits, for error messages. Does not consume it
+  void expectEnd(); // fails if there is content beyond the expression
+  void fail(const std::string& message) const; // throws, reporting the current position
+  void fail(const std::string& message, size_t pos) const;
+};
+
+/*
+  Writer and reader of the binary formats of the library. Integers are written as 4 bytes, least significant first, so that files move between
+  machines; vectors are written as their size followed by their elements. The reader checks every read against the end of its input, and throws a
+  runtime_error with ERR_BAD_SERIAL when the input is short or a value is out of the range the caller allows.
+*/
+class BinaryWriter {
+  vector<char>& m_out;
+
+ public:
+  BinaryWriter(vector<char>& out); // appends to out
+  void putByte(unsigned char b);
+  void putUInt(unsigned int n);
+  void putInt(int n);
+  void putString(const std::string& s);
+  void putUInts(const vector<unsigned int>& v);
+  void putInts(const vector<int>& v);
+};
+
+class BinaryReader {
+  const vector<char>& m_in;
+  size_t m_pos;
+
+  void require(size_t n) const; // fails if fewer than n bytes remain
+
+ public:
+  BinaryReader(const vector<char>& in);
+  bool atEnd() const;
+  unsigned char getByte();
+  unsigned int getUInt();
+  unsigned int getUInt(unsigned int bound); // fails if the value is not below bound
+  int getInt();
+  std::string getString();
+  void getUInts(vector<unsigned int>& v);
+  void getInts(vector<int>& v);
+  void fail(const std::string& message) const;
+};